@@ -0,0 +1,125 @@
+//
+//  KlvBench.cpp
+//  libklv
+//
+
+#include "KlvBench.hpp"
+#include "KlvChecksum.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+#include <random>
+
+namespace {
+    std::atomic<size_t> num_allocations(0);
+
+    const std::vector<uint8_t> UAS_LS_KEY = {0x06, 0x0E, 0x2B, 0x34, 0x02, 0x0B, 0x01, 0x01,
+                                             0x0E, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00};
+}
+
+// count every allocation made by the library and the benchmarks
+void* operator new(size_t size) {
+    num_allocations.fetch_add(1, std::memory_order_relaxed);
+    void* p = malloc(size == 0 ? 1 : size);
+    if(p == NULL)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    free(p);
+}
+
+size_t getNumAllocations() {
+    return num_allocations.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Builds one ST 0601 packet with a valid checksum.
+ *
+ * @param  num_items number of items besides the timestamp and checksum
+ * @param  item_size size of the value of each item
+ * @param  timestamp value of the timestamp item (tag 2)
+ * @return           the encoded packet
+ */
+std::vector<uint8_t> makePacket(size_t num_items, size_t item_size, uint64_t timestamp) {
+    std::vector<uint8_t> ts(8);
+    for(size_t i = 0; i < 8; i++)
+        ts[i] = (uint8_t) (timestamp >> (56 - 8 * i));
+
+    KLV pkt(UAS_LS_KEY, std::vector<uint8_t>());
+    std::vector<KLV> items;
+    items.reserve(num_items + 2);
+    items.push_back(KLV({0x02}, ts));
+    for(size_t i = 0; i < num_items; i++)
+        items.push_back(KLV({(uint8_t) (3 + i % 120)}, std::vector<uint8_t>(item_size, (uint8_t) i)));
+    items.push_back(KLV({0x01}, {0x00, 0x00}));
+    for(size_t i = 0; i < items.size(); i++)
+        pkt.appendChild(&items[i]);
+
+    std::vector<uint8_t> bytes = pkt.toBytes();
+    uint16_t bcc = KlvChecksum::compute(bytes.data(), bytes.size() - 2);
+    bytes[bytes.size() - 2] = (uint8_t) (bcc >> 8);
+    bytes[bytes.size() - 1] = (uint8_t) bcc;
+    return bytes;
+}
+
+/**
+ * @brief Builds a stream of packets, see KlvBenchCorpus.
+ *
+ * @param  num_packets    number of packets
+ * @param  num_items      items per packet besides the timestamp and checksum
+ * @param  item_size      size of the value of each item
+ * @param  corruption_pct share of damaged packets, 0 to 100
+ * @param  seed           seed for the garbage and the choice of packets
+ * @return                the corpus
+ */
+KlvBenchCorpus makeCorpus(size_t num_packets, size_t num_items, size_t item_size, int corruption_pct, unsigned seed) {
+    std::mt19937 rng(seed);
+    std::uniform_int_distribution<int> pct(0, 99);
+    std::uniform_int_distribution<int> byte(0, 255);
+    std::uniform_int_distribution<size_t> garbage_size(64, 512);
+
+    KlvBenchCorpus corpus;
+    corpus.num_packets = num_packets;
+    corpus.num_corrupted = 0;
+
+    for(size_t i = 0; i < num_packets; i++) {
+        std::vector<uint8_t> pkt = makePacket(num_items, item_size, 1000000 + i * 33333);
+        if(pct(rng) < corruption_pct) {
+            size_t n = garbage_size(rng);
+            for(size_t j = 0; j < n; j++)
+                corpus.bytes.push_back((uint8_t) byte(rng));
+            pkt[pkt.size() / 2] ^= 0x5A;
+            corpus.num_corrupted++;
+        }
+        corpus.bytes.insert(corpus.bytes.end(), pkt.begin(), pkt.end());
+    }
+    return corpus;
+}
+
+void setThroughput(benchmark::State& state, size_t num_bytes, size_t num_packets, size_t allocs_before) {
+    double iterations = (double) state.iterations();
+    state.SetBytesProcessed((int64_t) (num_bytes * state.iterations()));
+    state.counters["packets/s"] = benchmark::Counter(num_packets * iterations, benchmark::Counter::kIsRate);
+    if(num_packets > 0)
+        state.counters["allocs/pkt"] = (getNumAllocations() - allocs_before) / (num_packets * iterations);
+}
+
+BENCHMARK_MAIN();
@@ -0,0 +1,47 @@
+//
+//  KlvBench.hpp
+//  libklv
+//
+
+#ifndef KlvBench_hpp
+#define KlvBench_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "benchmark/benchmark.h"
+#include "Klv.h"
+
+/**
+ * @brief Synthetic stream of ST 0601 packets.
+ *
+ * Each packet has a timestamp (tag 2), num_items further items of item_size
+ * bytes each, and a correct checksum (tag 1). A corruption_pct share of the
+ * packets is damaged: a run of random garbage is put in front of the packet
+ * and one of its value bytes is flipped, so the parser has to resync and the
+ * checksum fails. Corpora are built from a fixed seed and are the same on
+ * every run.
+ */
+struct KlvBenchCorpus {
+    std::vector<uint8_t> bytes;           /// the whole stream
+    size_t               num_packets;     /// number of packets in the stream
+    size_t               num_corrupted;   /// number of damaged packets
+};
+
+KlvBenchCorpus makeCorpus(size_t num_packets, size_t num_items, size_t item_size, int corruption_pct, unsigned seed = 1);
+std::vector<uint8_t> makePacket(size_t num_items, size_t item_size, uint64_t timestamp);
+
+/**
+ * @brief Number of calls to operator new so far. The benchmark binary replaces
+ *        the global allocation functions to count them.
+ */
+size_t getNumAllocations();
+
+/**
+ * @brief Reports throughput counters for a benchmark that went through
+ *        num_packets packets and num_bytes bytes per iteration: MB/s,
+ *        packets/s, and allocations per packet since allocs_before.
+ */
+void setThroughput(benchmark::State& state, size_t num_bytes, size_t num_packets, size_t allocs_before);
+
+#endif /* KlvBench_hpp */
@@ -0,0 +1,101 @@
+//
+//  KlvEncoderBench.cpp
+//  libklv
+//
+
+#include "KlvBench.hpp"
+#include "KlvChecksum.hpp"
+#include "KlvEncoder.hpp"
+#include "KlvParser.hpp"
+#include "KlvUniversalKey.hpp"
+
+namespace {
+    // one parsed packet with num_items items of item_size bytes
+    KLV* parsePacket(const benchmark::State& state) {
+        std::vector<uint8_t> bytes = makePacket((size_t) state.range(0), (size_t) state.range(1), 0);
+        KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+        return parser.parse(bytes)[0];
+    }
+}
+
+static void BM_ToBytes(benchmark::State& state) {
+    KLV* klv = parsePacket(state);
+    size_t size = 0;
+    size_t allocs = getNumAllocations();
+    for(auto _ : state) {
+        std::vector<uint8_t> bytes = klv->toBytes();
+        size = bytes.size();
+        benchmark::DoNotOptimize(bytes.data());
+    }
+    setThroughput(state, size, 1, allocs);
+    KLV::deleteTree(klv);
+}
+BENCHMARK(BM_ToBytes)->Args({24, 4})->Args({8, 64});
+
+static void BM_Encode(benchmark::State& state) {
+    KLV* klv = parsePacket(state);
+    KlvEncoder encoder;
+    std::vector<uint8_t> out(encoder.measure(*klv));
+    size_t allocs = getNumAllocations();
+    for(auto _ : state) {
+        benchmark::DoNotOptimize(encoder.encode(*klv, out.data(), out.size()));
+    }
+    setThroughput(state, out.size(), 1, allocs);
+    KLV::deleteTree(klv);
+}
+BENCHMARK(BM_Encode)->Args({24, 4})->Args({8, 64});
+
+static void BM_IndexToMap(benchmark::State& state) {
+    KLV* klv = parsePacket(state);
+    size_t allocs = getNumAllocations();
+    for(auto _ : state) {
+        std::unordered_map<std::vector<uint8_t>, KLV> map = klv->indexToMap();
+        benchmark::DoNotOptimize(map.size());
+    }
+    setThroughput(state, klv->getLen(), 1, allocs);
+    KLV::deleteTree(klv);
+}
+BENCHMARK(BM_IndexToMap)->Args({24, 4})->Args({8, 64});
+
+static void BM_HashKeyVector(benchmark::State& state) {
+    std::vector<uint8_t> pkt = makePacket(0, 0, 0);
+    std::vector<uint8_t> key(pkt.begin(), pkt.begin() + KLV_KEY_SIZE);
+    std::hash<std::vector<uint8_t>> hash;
+    for(auto _ : state)
+        benchmark::DoNotOptimize(hash(key));
+    state.SetBytesProcessed(state.iterations() * KLV_KEY_SIZE);
+}
+BENCHMARK(BM_HashKeyVector);
+
+static void BM_HashUniversalKey(benchmark::State& state) {
+    std::vector<uint8_t> pkt = makePacket(0, 0, 0);
+    KlvUniversalKey key(pkt.data());
+    std::hash<KlvUniversalKey> hash;
+    for(auto _ : state) {
+        benchmark::DoNotOptimize(key);
+        benchmark::DoNotOptimize(hash(key));
+    }
+    state.SetBytesProcessed(state.iterations() * KLV_KEY_SIZE);
+}
+BENCHMARK(BM_HashUniversalKey);
+
+static void BM_HashKlv(benchmark::State& state) {
+    KLV* klv = parsePacket(state);
+    KLV::hash hash;
+    for(auto _ : state)
+        benchmark::DoNotOptimize(hash(*klv));
+    state.SetBytesProcessed(state.iterations() * klv->getLen());
+    KLV::deleteTree(klv);
+}
+BENCHMARK(BM_HashKlv)->Args({24, 4});
+
+template<uint16_t (*Kernel)(const uint8_t*, size_t)>
+static void BM_Checksum(benchmark::State& state) {
+    std::vector<uint8_t> bytes((size_t) state.range(0), 0x5A);
+    for(auto _ : state)
+        benchmark::DoNotOptimize(Kernel(bytes.data(), bytes.size()));
+    state.SetBytesProcessed(state.iterations() * bytes.size());
+}
+BENCHMARK_TEMPLATE(BM_Checksum, KlvChecksum::computeScalar)->Arg(162)->Arg(1 << 16);
+BENCHMARK_TEMPLATE(BM_Checksum, KlvChecksum::computeWord)->Arg(162)->Arg(1 << 16);
+BENCHMARK_TEMPLATE(BM_Checksum, KlvChecksum::computeSse2)->Arg(162)->Arg(1 << 16);
@@ -0,0 +1,19 @@
+//
+//  KlvFileParserBench.cpp
+//  libklv
+//
+
+#include "KlvBench.hpp"
+#include "KlvFileParser.hpp"
+
+// Arguments: worker threads; 20000 packets (about 3.5 MB) in 256 KB chunks
+static void BM_FileParser(benchmark::State& state) {
+    KlvBenchCorpus corpus = makeCorpus(20000, 24, 4, 1);
+    KlvFileParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID},
+                         (size_t) state.range(0), 256 << 10);
+    size_t allocs = getNumAllocations();
+    for(auto _ : state)
+        parser.parse(corpus.bytes.data(), corpus.bytes.size(), KLV::deleteTree);
+    setThroughput(state, corpus.bytes.size(), corpus.num_packets, allocs);
+}
+BENCHMARK(BM_FileParser)->Arg(1)->Arg(2)->Arg(4)->Arg(8)->UseRealTime()->Unit(benchmark::kMillisecond);
@@ -0,0 +1,193 @@
+//
+//  KlvIngestLoopBench.cpp
+//  libklv
+//
+
+#include "KlvBench.hpp"
+#include "KlvIngestLoop.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+// Latency from the arrival of a packet's last byte at the reader to the packet's
+// delivery on the consumer thread. The reader hands over 1000 packets per
+// iteration, each in two pieces, one packet every <argument> microseconds.
+// Reported as p50_us and p99_us over all iterations.
+
+namespace {
+    const size_t NUM_PACKETS = 1000;
+
+    uint64_t nowNs() {
+        return (uint64_t) std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    void waitUntil(uint64_t t) {
+        while(nowNs() < t)
+            std::this_thread::yield();
+    }
+
+    void setLatency(benchmark::State& state, std::vector<uint64_t>& latencies) {
+        if(latencies.empty())
+            return;
+        std::sort(latencies.begin(), latencies.end());
+        state.counters["p50_us"] = latencies[latencies.size() / 2] / 1000.0;
+        state.counters["p99_us"] = latencies[latencies.size() * 99 / 100] / 1000.0;
+    }
+}
+
+// SPSC byte ring, bulk parse into recycled trees, SPSC output ring
+static void BM_IngestLatency(benchmark::State& state) {
+    const uint64_t period = (uint64_t) state.range(0) * 1000;
+    std::vector<uint8_t> pkt = makePacket(24, 4, 0);
+    const size_t split = pkt.size() / 2;
+
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    KlvIngestLoop loop(parser);
+    std::thread parse_thread([&]() { loop.run(); });
+
+    std::vector<uint64_t> latencies;
+    latencies.reserve(NUM_PACKETS * 100);
+    std::atomic<size_t> num_received(0);
+    std::atomic<bool> done(false);
+    std::thread consumer([&]() {
+        KlvIngestLoop::Packet packets[16];
+        while(!done.load(std::memory_order_relaxed)) {
+            size_t n = loop.poll(packets, 16);
+            if(n == 0) {
+                std::this_thread::yield();
+                continue;
+            }
+            uint64_t now = nowNs();
+            for(size_t i = 0; i < n; i++) {
+                latencies.push_back(now - packets[i].tag);
+                loop.recycle(packets[i].tree);
+            }
+            num_received.fetch_add(n, std::memory_order_release);
+        }
+    });
+
+    size_t allocs = getNumAllocations();
+    size_t expected = 0;
+    for(auto _ : state) {
+        uint64_t next = nowNs();
+        for(size_t i = 0; i < NUM_PACKETS; i++) {
+            waitUntil(next);
+            next += period;
+            loop.getInput().push(pkt.data(), split);
+            loop.getInput().push(pkt.data() + split, pkt.size() - split, nowNs());
+        }
+        expected += NUM_PACKETS;
+        while(num_received.load(std::memory_order_acquire) < expected)
+            std::this_thread::yield();
+    }
+
+    done.store(true);
+    consumer.join();
+    loop.close();
+    parse_thread.join();
+    setLatency(state, latencies);
+    setThroughput(state, pkt.size() * NUM_PACKETS, NUM_PACKETS, allocs);
+}
+BENCHMARK(BM_IngestLatency)->Arg(0)->Arg(20)->Arg(100)->UseRealTime()->Unit(benchmark::kMillisecond);
+
+// the hand-off it replaces: mutex-protected deques on both sides, parseByte()
+static void BM_IngestLatencyDeque(benchmark::State& state) {
+    const uint64_t period = (uint64_t) state.range(0) * 1000;
+    std::vector<uint8_t> pkt = makePacket(24, 4, 0);
+    const size_t split = pkt.size() / 2;
+
+    struct Chunk {
+        std::vector<uint8_t> bytes;
+        uint64_t         arrival;
+    };
+    std::mutex in_mutex;
+    std::condition_variable in_cond;
+    std::deque<Chunk> in;
+    std::mutex out_mutex;
+    std::deque<std::pair<KLV*, uint64_t> > out;
+    bool stop = false;
+
+    std::thread parse_thread([&]() {
+        KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+        for(;;) {
+            Chunk chunk;
+            {
+                std::unique_lock<std::mutex> lock(in_mutex);
+                in_cond.wait(lock, [&]() { return stop || !in.empty(); });
+                if(stop)
+                    return;
+                chunk = std::move(in.front());
+                in.pop_front();
+            }
+            for(size_t i = 0; i < chunk.bytes.size(); i++) {
+                KLV* klv = parser.parseByte(chunk.bytes[i]);
+                if(klv != NULL) {
+                    std::lock_guard<std::mutex> lock(out_mutex);
+                    out.push_back(std::make_pair(klv, chunk.arrival));
+                }
+            }
+        }
+    });
+
+    std::vector<uint64_t> latencies;
+    latencies.reserve(NUM_PACKETS * 100);
+    std::atomic<size_t> num_received(0);
+    std::atomic<bool> done(false);
+    std::thread consumer([&]() {
+        while(!done.load(std::memory_order_relaxed)) {
+            std::pair<KLV*, uint64_t> item(NULL, 0);
+            {
+                std::lock_guard<std::mutex> lock(out_mutex);
+                if(!out.empty()) {
+                    item = out.front();
+                    out.pop_front();
+                }
+            }
+            if(item.first == NULL) {
+                std::this_thread::yield();
+                continue;
+            }
+            latencies.push_back(nowNs() - item.second);
+            KLV::deleteTree(item.first);
+            num_received.fetch_add(1, std::memory_order_release);
+        }
+    });
+
+    size_t allocs = getNumAllocations();
+    size_t expected = 0;
+    for(auto _ : state) {
+        uint64_t next = nowNs();
+        for(size_t i = 0; i < NUM_PACKETS; i++) {
+            waitUntil(next);
+            next += period;
+            Chunk first = {std::vector<uint8_t>(pkt.begin(), pkt.begin() + split), 0};
+            Chunk second = {std::vector<uint8_t>(pkt.begin() + split, pkt.end()), nowNs()};
+            {
+                std::lock_guard<std::mutex> lock(in_mutex);
+                in.push_back(std::move(first));
+                in.push_back(std::move(second));
+            }
+            in_cond.notify_one();
+        }
+        expected += NUM_PACKETS;
+        while(num_received.load(std::memory_order_acquire) < expected)
+            std::this_thread::yield();
+    }
+
+    done.store(true);
+    consumer.join();
+    {
+        std::lock_guard<std::mutex> lock(in_mutex);
+        stop = true;
+    }
+    in_cond.notify_one();
+    parse_thread.join();
+    setLatency(state, latencies);
+    setThroughput(state, pkt.size() * NUM_PACKETS, NUM_PACKETS, allocs);
+}
+BENCHMARK(BM_IngestLatencyDeque)->Arg(0)->Arg(20)->Arg(100)->UseRealTime()->Unit(benchmark::kMillisecond);
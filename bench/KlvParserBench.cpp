@@ -0,0 +1,268 @@
+//
+//  KlvParserBench.cpp
+//  libklv
+//
+
+#include "BasicKlvParser.hpp"
+#include "KlvBench.hpp"
+#include "KlvKeyRegistry.hpp"
+#include "KlvParser.hpp"
+#include "KlvScan.hpp"
+#include "KlvTrace.hpp"
+
+// Arguments: packets per iteration, items per packet, item size, % corrupted packets
+#define KLV_BENCH_CORPORA \
+    Args({100, 24, 4, 0})->Args({100, 24, 4, 10})->Args({100, 8, 64, 0})
+
+namespace {
+    KlvBenchCorpus corpusFor(const benchmark::State& state) {
+        return makeCorpus((size_t) state.range(0), (size_t) state.range(1), (size_t) state.range(2), (int) state.range(3));
+    }
+
+    const std::vector<KlvParser::KeyEncoding> ST0601 = {KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID};
+}
+
+static void BM_ParseByte(benchmark::State& state) {
+    KlvBenchCorpus corpus = corpusFor(state);
+    KlvParser parser(ST0601);
+    size_t allocs = getNumAllocations();
+    for(auto _ : state) {
+        for(uint8_t byte : corpus.bytes)
+            KLV::deleteTree(parser.parseByte(byte));
+    }
+    setThroughput(state, corpus.bytes.size(), corpus.num_packets, allocs);
+}
+BENCHMARK(BM_ParseByte)->KLV_BENCH_CORPORA;
+
+// the same with the encodings fixed at compile time
+static void BM_ParseByteStatic(benchmark::State& state) {
+    KlvBenchCorpus corpus = corpusFor(state);
+    KlvSt0601Parser parser;
+    size_t allocs = getNumAllocations();
+    for(auto _ : state) {
+        for(uint8_t byte : corpus.bytes)
+            KLV::deleteTree(parser.parseByte(byte));
+    }
+    setThroughput(state, corpus.bytes.size(), corpus.num_packets, allocs);
+}
+BENCHMARK(BM_ParseByteStatic)->KLV_BENCH_CORPORA;
+
+// BM_ParseByte with tracing turned off at run time. Compare a -Dtrace=ON build
+// against the default build, where KLV_TRACE() compiles to nothing.
+static void BM_ParseByteTraceNone(benchmark::State& state) {
+    KlvBenchCorpus corpus = corpusFor(state);
+    KlvParser parser(ST0601);
+    KlvTraceLevel old_level = KlvTrace::getLevel();
+    KlvTrace::setLevel(KLV_TRACE_NONE);
+    size_t allocs = getNumAllocations();
+    for(auto _ : state) {
+        for(uint8_t byte : corpus.bytes)
+            KLV::deleteTree(parser.parseByte(byte));
+    }
+    setThroughput(state, corpus.bytes.size(), corpus.num_packets, allocs);
+    KlvTrace::setLevel(old_level);
+#ifdef KLV_ENABLE_TRACE
+    state.SetLabel("trace compiled in");
+#else
+    state.SetLabel("trace compiled out");
+#endif
+}
+BENCHMARK(BM_ParseByteTraceNone)->KLV_BENCH_CORPORA;
+
+static void BM_Parse(benchmark::State& state) {
+    KlvBenchCorpus corpus = corpusFor(state);
+    KlvParser parser(ST0601);
+    size_t allocs = getNumAllocations();
+    for(auto _ : state) {
+        std::vector<KLV*> klvs = parser.parse(corpus.bytes);
+        for(KLV* klv : klvs)
+            KLV::deleteTree(klv);
+    }
+    setThroughput(state, corpus.bytes.size(), corpus.num_packets, allocs);
+}
+BENCHMARK(BM_Parse)->KLV_BENCH_CORPORA;
+
+// only the timestamp and sensor position are built, the other items are skipped
+static void BM_ParseFiltered(benchmark::State& state) {
+    KlvBenchCorpus corpus = corpusFor(state);
+    KlvParser parser(ST0601);
+    parser.setFilter(1, KlvFilter({2, 13, 14, 15}));
+    size_t allocs = getNumAllocations();
+    for(auto _ : state) {
+        std::vector<KLV*> klvs = parser.parse(corpus.bytes);
+        for(KLV* klv : klvs)
+            KLV::deleteTree(klv);
+    }
+    setThroughput(state, corpus.bytes.size(), corpus.num_packets, allocs);
+}
+BENCHMARK(BM_ParseFiltered)->KLV_BENCH_CORPORA;
+
+static void BM_ParseStatic(benchmark::State& state) {
+    KlvBenchCorpus corpus = corpusFor(state);
+    KlvSt0601Parser parser;
+    size_t allocs = getNumAllocations();
+    for(auto _ : state) {
+        std::vector<KLV*> klvs = parser.parse(corpus.bytes);
+        for(KLV* klv : klvs)
+            KLV::deleteTree(klv);
+    }
+    setThroughput(state, corpus.bytes.size(), corpus.num_packets, allocs);
+}
+BENCHMARK(BM_ParseStatic)->KLV_BENCH_CORPORA;
+
+// top level only, to separate framing from nested ST 0601 decoding
+static void BM_ParseTopLevel(benchmark::State& state) {
+    KlvBenchCorpus corpus = corpusFor(state);
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE});
+    size_t allocs = getNumAllocations();
+    for(auto _ : state) {
+        std::vector<KLV*> klvs = parser.parse(corpus.bytes);
+        for(KLV* klv : klvs)
+            delete klv;
+    }
+    setThroughput(state, corpus.bytes.size(), corpus.num_packets, allocs);
+}
+BENCHMARK(BM_ParseTopLevel)->KLV_BENCH_CORPORA;
+
+static void BM_ParseLazy(benchmark::State& state) {
+    KlvBenchCorpus corpus = corpusFor(state);
+    KlvParser parser(ST0601);
+    parser.setLazyNesting(true);
+    size_t allocs = getNumAllocations();
+    for(auto _ : state) {
+        std::vector<KLV*> klvs = parser.parse(corpus.bytes);
+        for(KLV* klv : klvs)
+            KLV::deleteTree(klv);
+    }
+    setThroughput(state, corpus.bytes.size(), corpus.num_packets, allocs);
+}
+BENCHMARK(BM_ParseLazy)->KLV_BENCH_CORPORA;
+
+static void BM_ParseChecksum(benchmark::State& state) {
+    KlvBenchCorpus corpus = corpusFor(state);
+    KlvParser parser(ST0601);
+    parser.setChecksumMode(KlvParser::CHECKSUM_MARK);
+    size_t allocs = getNumAllocations();
+    for(auto _ : state) {
+        std::vector<KLV*> klvs = parser.parse(corpus.bytes);
+        for(KLV* klv : klvs)
+            KLV::deleteTree(klv);
+    }
+    setThroughput(state, corpus.bytes.size(), corpus.num_packets, allocs);
+}
+BENCHMARK(BM_ParseChecksum)->KLV_BENCH_CORPORA;
+
+static void BM_ParseViews(benchmark::State& state) {
+    KlvBenchCorpus corpus = corpusFor(state);
+    KlvParser parser(ST0601);
+    size_t allocs = getNumAllocations();
+    for(auto _ : state) {
+        std::vector<const KlvView*> views = parser.parseViews(corpus.bytes.data(), corpus.bytes.size());
+        benchmark::DoNotOptimize(views.data());
+    }
+    setThroughput(state, corpus.bytes.size(), corpus.num_packets, allocs);
+}
+BENCHMARK(BM_ParseViews)->KLV_BENCH_CORPORA;
+
+static void BM_ParseTree(benchmark::State& state) {
+    KlvBenchCorpus corpus = corpusFor(state);
+    KlvParser parser(ST0601);
+    KlvTree tree;
+    size_t allocs = getNumAllocations();
+    for(auto _ : state) {
+        size_t offset = 0;
+        while(offset < corpus.bytes.size()) {
+            offset += parser.parseTree(corpus.bytes.data() + offset, corpus.bytes.size() - offset, tree, false);
+            benchmark::DoNotOptimize(tree.find(2));
+        }
+    }
+    setThroughput(state, corpus.bytes.size(), corpus.num_packets, allocs);
+}
+BENCHMARK(BM_ParseTree)->KLV_BENCH_CORPORA;
+
+// the same, with each packet decoded by its rule among eight registered ULs
+static void BM_ParseTreeRegistry(benchmark::State& state) {
+    KlvBenchCorpus corpus = corpusFor(state);
+    size_t first = KlvScan::findUlHeader(corpus.bytes.data(), corpus.bytes.size());
+    std::vector<uint8_t> key(corpus.bytes.begin() + first, corpus.bytes.begin() + first + KLV_KEY_SIZE);
+    KlvKeyRegistry registry;
+    for(uint8_t i = 0; i < 8; i++) {
+        key[11] ^= i;
+        registry.add(KlvUniversalKey(key.data()), KlvKeyRegistry::Rule({KlvParser::KEY_ENCODING_BER_OID}));
+        key[11] ^= i;
+    }
+    KlvParser parser(ST0601);
+    parser.setKeyRegistry(registry);
+    KlvTree tree;
+    size_t allocs = getNumAllocations();
+    for(auto _ : state) {
+        size_t offset = 0;
+        while(offset < corpus.bytes.size()) {
+            offset += parser.parseTree(corpus.bytes.data() + offset, corpus.bytes.size() - offset, tree, false);
+            benchmark::DoNotOptimize(tree.find(2));
+        }
+    }
+    setThroughput(state, corpus.bytes.size(), corpus.num_packets, allocs);
+}
+BENCHMARK(BM_ParseTreeRegistry)->KLV_BENCH_CORPORA;
+
+static void BM_ParseFlat(benchmark::State& state) {
+    KlvBenchCorpus corpus = corpusFor(state);
+    KlvParser parser(ST0601);
+    KlvFlatTree tree;
+    size_t allocs = getNumAllocations();
+    for(auto _ : state) {
+        size_t offset = 0;
+        while(offset < corpus.bytes.size()) {
+            offset += parser.parseFlat(corpus.bytes.data() + offset, corpus.bytes.size() - offset, tree);
+            benchmark::DoNotOptimize(tree.find(2));
+        }
+    }
+    setThroughput(state, corpus.bytes.size(), corpus.num_packets, allocs);
+}
+BENCHMARK(BM_ParseFlat)->KLV_BENCH_CORPORA;
+
+// events only, picking out the timestamp of each packet
+namespace {
+    class TimestampVisitor : public KlvVisitor {
+    public:
+        TimestampVisitor() : timestamp(0) {}
+
+        void onItem(size_t depth, uint64_t tag, const KlvSpan& /*key*/, const KlvSpan& /*len*/, const KlvSpan& value) {
+            if(depth == 1 && tag == 2)
+                timestamp += value.size;
+        }
+
+        uint64_t timestamp;
+    };
+}
+
+static void BM_ParseVisitor(benchmark::State& state) {
+    KlvBenchCorpus corpus = corpusFor(state);
+    KlvParser parser(ST0601);
+    TimestampVisitor visitor;
+    size_t allocs = getNumAllocations();
+    for(auto _ : state) {
+        parser.parse(corpus.bytes.data(), corpus.bytes.size(), visitor);
+        benchmark::DoNotOptimize(visitor.timestamp);
+    }
+    setThroughput(state, corpus.bytes.size(), corpus.num_packets, allocs);
+}
+BENCHMARK(BM_ParseVisitor)->KLV_BENCH_CORPORA;
+
+// resync: a packet behind a long run of garbage
+static void BM_Resync(benchmark::State& state) {
+    std::vector<uint8_t> bytes((size_t) state.range(0), 0xA5);
+    std::vector<uint8_t> pkt = makePacket(24, 4, 0);
+    bytes.insert(bytes.end(), pkt.begin(), pkt.end());
+
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE});
+    size_t allocs = getNumAllocations();
+    for(auto _ : state) {
+        std::vector<KLV*> klvs = parser.parse(bytes);
+        for(KLV* klv : klvs)
+            delete klv;
+    }
+    setThroughput(state, bytes.size(), 1, allocs);
+}
+BENCHMARK(BM_Resync)->Arg(4096)->Arg(1 << 20);
@@ -0,0 +1,109 @@
+//
+//  KlvSt0601Bench.cpp
+//  libklv
+//
+
+#include "KlvBench.hpp"
+#include "KlvParser.hpp"
+#include "KlvSt0601.hpp"
+#include "KlvSt0601Batch.hpp"
+
+namespace {
+    // ST 0601 example packet with 26 items
+    const uint8_t st0601_pkt[] = {
+        0x06, 0x0E, 0x2B, 0x34, 0x02, 0x0B, 0x01, 0x01, 0x0E, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00,
+        0x81, 0x90, 0x02, 0x08, 0x00, 0x04, 0x6C, 0xAE, 0x70, 0xF9, 0x80, 0xCF, 0x41, 0x01, 0x01, 0x05,
+        0x02, 0xE1, 0x91, 0x06, 0x02, 0x06, 0x0D, 0x07, 0x02, 0x0A, 0xE1, 0x0B, 0x02, 0x49, 0x52, 0x0C,
+        0x0E, 0x47, 0x65, 0x6F, 0x64, 0x65, 0x74, 0x69, 0x63, 0x20, 0x57, 0x47, 0x53, 0x38, 0x34, 0x0D,
+        0x04, 0x4D, 0xCC, 0x41, 0x90, 0x0E, 0x04, 0xB1, 0xD0, 0x3D, 0x96, 0x0F, 0x02, 0x1B, 0x2E, 0x10,
+        0x02, 0x00, 0x84, 0x11, 0x02, 0x00, 0x4A, 0x12, 0x04, 0xE7, 0x23, 0x0B, 0x61, 0x13, 0x04, 0xFD,
+        0xE8, 0x63, 0x8E, 0x14, 0x04, 0x03, 0x0B, 0xC7, 0x1C, 0x15, 0x04, 0x00, 0x9F, 0xB9, 0x38, 0x16,
+        0x04, 0x00, 0x00, 0x01, 0xF8, 0x17, 0x04, 0x4D, 0xEC, 0xDA, 0xF4, 0x18, 0x04, 0xB1, 0xBC, 0x81,
+        0x74, 0x19, 0x02, 0x0B, 0x8A, 0x28, 0x04, 0x4D, 0xEC, 0xDA, 0xF4, 0x29, 0x04, 0xB1, 0xBC, 0x81,
+        0x74, 0x2A, 0x02, 0x0B, 0x8A, 0x38, 0x01, 0x31, 0x39, 0x04, 0x00, 0x9F, 0x85, 0x4D, 0x01, 0x02,
+        0xB7, 0xEB
+    };
+}
+
+// four typed lookups, as a consumer that only wants position and time would do
+static void BM_St0601Get(benchmark::State& state) {
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    KlvFlatTree tree;
+    parser.parseFlat(st0601_pkt, sizeof(st0601_pkt), tree);
+    size_t allocs = getNumAllocations();
+    for(auto _ : state) {
+        benchmark::DoNotOptimize(St0601::get<St0601::PrecisionTimeStamp>(tree));
+        benchmark::DoNotOptimize(St0601::get<St0601::SensorLatitude>(tree));
+        benchmark::DoNotOptimize(St0601::get<St0601::SensorLongitude>(tree));
+        benchmark::DoNotOptimize(St0601::get<St0601::SensorTrueAltitude>(tree));
+    }
+    setThroughput(state, sizeof(st0601_pkt), 1, allocs);
+}
+BENCHMARK(BM_St0601Get);
+
+static void BM_St0601DecodeFlat(benchmark::State& state) {
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    KlvFlatTree tree;
+    parser.parseFlat(st0601_pkt, sizeof(st0601_pkt), tree);
+    St0601::Values values;
+    size_t allocs = getNumAllocations();
+    for(auto _ : state) {
+        St0601::decode(tree, values);
+        benchmark::DoNotOptimize(values.present);
+    }
+    setThroughput(state, sizeof(st0601_pkt), 1, allocs);
+}
+BENCHMARK(BM_St0601DecodeFlat);
+
+static void BM_St0601DecodeKlv(benchmark::State& state) {
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    KLV* klv = parser.parse(std::vector<uint8_t>(st0601_pkt, st0601_pkt + sizeof(st0601_pkt)))[0];
+    St0601::Values values;
+    size_t allocs = getNumAllocations();
+    for(auto _ : state) {
+        St0601::decode(*klv, values);
+        benchmark::DoNotOptimize(values.present);
+    }
+    setThroughput(state, sizeof(st0601_pkt), 1, allocs);
+    KLV::deleteTree(klv);
+}
+BENCHMARK(BM_St0601DecodeKlv);
+
+// columnar decode of four tags from a block of 4096 packets
+static void BM_St0601BatchAdd(benchmark::State& state) {
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    std::vector<uint8_t> block;
+    for(int i = 0; i < 4096; i++)
+        block.insert(block.end(), st0601_pkt, st0601_pkt + sizeof(st0601_pkt));
+
+    St0601::Batch batch({St0601::PrecisionTimeStamp::TAG, St0601::SensorLatitude::TAG,
+                         St0601::SensorLongitude::TAG, St0601::SensorTrueAltitude::TAG});
+    batch.reserve(4096);
+    size_t allocs = getNumAllocations();
+    for(auto _ : state) {
+        batch.clear();
+        batch.add(parser, block.data(), block.size());
+        benchmark::DoNotOptimize(batch.getValues(St0601::SensorLatitude::TAG));
+        benchmark::DoNotOptimize(batch.getValues(St0601::SensorLongitude::TAG));
+        benchmark::DoNotOptimize(batch.getValues(St0601::SensorTrueAltitude::TAG));
+    }
+    setThroughput(state, block.size(), 4096, allocs);
+}
+BENCHMARK(BM_St0601BatchAdd);
+
+template<void (*Map)(const uint64_t*, size_t, double, double, double*)>
+static void BM_St0601BatchMap(benchmark::State& state) {
+    std::vector<uint64_t> raw(65536);
+    for(size_t i = 0; i < raw.size(); i++)
+        raw[i] = (uint64_t) (int64_t) (i * 2654435761u) >> 1;
+    std::vector<double> out(raw.size());
+    size_t allocs = getNumAllocations();
+    for(auto _ : state) {
+        Map(raw.data(), raw.size(), 180.0 / 4294967294.0, 0.0, out.data());
+        benchmark::DoNotOptimize(out.data());
+    }
+    setThroughput(state, raw.size() * sizeof(uint64_t), raw.size(), allocs);
+}
+BENCHMARK_TEMPLATE(BM_St0601BatchMap, St0601::Batch::mapScalar);
+BENCHMARK_TEMPLATE(BM_St0601BatchMap, St0601::Batch::mapSse2);
+BENCHMARK_TEMPLATE(BM_St0601BatchMap, St0601::Batch::mapAvx2);
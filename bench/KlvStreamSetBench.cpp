@@ -0,0 +1,34 @@
+//
+//  KlvStreamSetBench.cpp
+//  libklv
+//
+
+#include "KlvBench.hpp"
+#include "KlvStreamSet.hpp"
+#include <algorithm>
+
+// Arguments: streams, worker threads. Every stream carries the same 200 packets
+// (about 35 KB), submitted round robin in 1316 byte pieces (7 TS packets, a
+// typical UDP payload).
+static void BM_StreamSet(benchmark::State& state) {
+    const size_t num_streams = (size_t) state.range(0);
+    const size_t piece = 1316;
+    KlvBenchCorpus corpus = makeCorpus(200, 24, 4, 0);
+
+    KlvStreamSet set({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID}, (size_t) state.range(1));
+    for(size_t id = 0; id < num_streams; id++)
+        set.addStream((KlvStreamSet::StreamId) id, [](KlvStreamSet::StreamId, KLV* klv) { KLV::deleteTree(klv); });
+
+    size_t allocs = getNumAllocations();
+    for(auto _ : state) {
+        for(size_t offset = 0; offset < corpus.bytes.size(); offset += piece) {
+            size_t n = std::min(piece, corpus.bytes.size() - offset);
+            for(size_t id = 0; id < num_streams; id++)
+                set.submit((KlvStreamSet::StreamId) id, &corpus.bytes[offset], n);
+        }
+        set.flush();
+    }
+    setThroughput(state, num_streams * corpus.bytes.size(), num_streams * corpus.num_packets, allocs);
+}
+BENCHMARK(BM_StreamSet)->Args({200, 1})->Args({200, 2})->Args({200, 4})->Args({200, 8})->Args({16, 4})
+    ->UseRealTime()->Unit(benchmark::kMillisecond);
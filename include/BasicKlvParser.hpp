@@ -0,0 +1,561 @@
+//
+//  BasicKlvParser.hpp
+//  libklv
+//
+
+#ifndef BasicKlvParser_hpp
+#define BasicKlvParser_hpp
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <stdexcept>
+#include <vector>
+#include "Klv.h"
+#include "KlvChecksum.hpp"
+#include "KlvFormatException.hpp"
+#include "KlvParser.hpp"
+#include "KlvScan.hpp"
+
+/**
+ * @brief Key format of a KeyEncoding known at compile time. Each
+ *        specialization provides:
+ *   UNIVERSAL                     true for 16-byte universal keys, which are
+ *                                 found by scanning for the UL header
+ *   locate(data, size, key_size)  offset of the first key in data; sets its size
+ *   isLastKeyByte(byte, n)        true if byte, the n-th byte of a key, ends it
+ *   decodeTag(key, size)          see KlvParser::decodeTag()
+ *   frame(data, size, limits, f)  see KlvParser::frame()
+ */
+template<KlvParser::KeyEncoding E>
+struct KlvKeyFormat;
+
+/**
+ * @brief Common part of the key formats.
+ */
+template<typename Format>
+struct KlvKeyFormatBase {
+    static KlvStatus frame(const uint8_t* data, size_t size, const KlvParser::Limits& limits, KlvParser::Frame& f) {
+        f.key_offset = Format::locate(data, size, f.key_size);
+        return KlvParser::frameLength(data, size, limits, f);
+    }
+};
+
+/**
+ * @brief 1, 2, and 4 byte keys: big endian integers.
+ */
+template<size_t N>
+struct KlvFixedKeyFormat : KlvKeyFormatBase<KlvFixedKeyFormat<N> > {
+    static const bool UNIVERSAL = false;
+
+    static size_t locate(const uint8_t*, size_t, size_t& key_size) {
+        key_size = N;
+        return 0;
+    }
+    static bool isLastKeyByte(uint8_t, size_t n) { return n == N; }
+    static uint64_t decodeTag(const uint8_t* key, size_t) {
+        uint64_t tag = 0;
+        for(size_t i = 0; i < N; i++)
+            tag = (tag << 8) | key[i];
+        return tag;
+    }
+};
+
+template<>
+struct KlvKeyFormat<KlvParser::KEY_ENCODING_1_BYTE> : KlvFixedKeyFormat<1> {};
+template<>
+struct KlvKeyFormat<KlvParser::KEY_ENCODING_2_BYTE> : KlvFixedKeyFormat<2> {};
+template<>
+struct KlvKeyFormat<KlvParser::KEY_ENCODING_4_BYTE> : KlvFixedKeyFormat<4> {};
+
+template<>
+struct KlvKeyFormat<KlvParser::KEY_ENCODING_16_BYTE> : KlvKeyFormatBase<KlvKeyFormat<KlvParser::KEY_ENCODING_16_BYTE> > {
+    static const bool UNIVERSAL = true;
+
+    static size_t locate(const uint8_t* data, size_t size, size_t& key_size) {
+        key_size = KLV_KEY_SIZE;
+        return KlvScan::findUlHeader(data, size);
+    }
+    static bool isLastKeyByte(uint8_t, size_t n) { return n == KLV_KEY_SIZE; }
+    static uint64_t decodeTag(const uint8_t*, size_t) { return 0; }
+};
+
+template<>
+struct KlvKeyFormat<KlvParser::KEY_ENCODING_BER_OID> : KlvKeyFormatBase<KlvKeyFormat<KlvParser::KEY_ENCODING_BER_OID> > {
+    static const bool UNIVERSAL = false;
+
+    static size_t locate(const uint8_t* data, size_t size, size_t& key_size) {
+        // last byte of the BER-OID key has bit 8 cleared
+        size_t i = 0;
+        while(i < size && (data[i] & 0b10000000))
+            i++;
+        key_size = i + 1;
+        return 0;
+    }
+    static bool isLastKeyByte(uint8_t byte, size_t) { return !(byte & 0b10000000); }
+    static uint64_t decodeTag(const uint8_t* key, size_t size) {
+        uint64_t tag = 0;
+        for(size_t i = 0; i < size; i++)
+            tag = (tag << 7) | (key[i] & 0b01111111);
+        return tag;
+    }
+};
+
+/**
+ * @brief Builds the children of a KLV for the nested levels of a
+ *        BasicKlvParser, one template argument per level. Each level frames
+ *        the value of its parent in place and recurses into the next level, so
+ *        the whole descent is resolved at compile time. With no levels left,
+ *        link() does nothing.
+ */
+template<KlvParser::KeyEncoding... Encodings>
+struct KlvNestedLevels {
+    static void link(KLV*, const KlvParser::Limits&, size_t) {}
+};
+
+template<KlvParser::KeyEncoding E, KlvParser::KeyEncoding... Rest>
+struct KlvNestedLevels<E, Rest...> {
+    /**
+     * @brief Frames the embedded KLVs in the value of parent and links them in
+     *        as its children. Yields the same children as the nested parser of
+     *        a KlvParser: rejected items are skipped the way the state machine
+     *        skips them, and a truncated last item is dropped.
+     *
+     * @param parent    KLV whose value is to be parsed
+     * @param limits    limits on the children
+     * @param max_depth number of levels left to decode, nothing is done at 0
+     */
+    static void link(KLV* parent, const KlvParser::Limits& limits, size_t max_depth) {
+        if(max_depth == 0)
+            return;
+
+        const std::vector<uint8_t>& value = parent->getValue();
+        const uint8_t* data = value.data();
+        KLV* previous = NULL;
+        size_t offset = 0;
+        KlvParser::Frame f;
+        while(offset < value.size()) {
+            KlvStatus status = KlvKeyFormat<E>::frame(data + offset, value.size() - offset, limits, f);
+            if(status == KLV_INCOMPLETE)
+                break;
+            if(status != KLV_OK) {
+                offset += f.valueOffset();
+                continue;
+            }
+
+            const uint8_t* klv_data = data + offset;
+            KLV* klv = new KLV(klv_data + f.key_offset, f.key_size, klv_data + f.lenOffset(), f.len_size,
+                               klv_data + f.valueOffset(), f.value_size);
+            klv->setParent(parent);
+            if(previous == NULL) {
+                parent->setChild(klv);
+            } else {
+                previous->setNextSibling(klv);
+                klv->setPreviousSibling(previous);
+            }
+            KlvNestedLevels<Rest...>::link(klv, limits, max_depth - 1);
+
+            previous = klv;
+            offset += f.end();
+        }
+        parent->markDroppedItems();
+    }
+};
+
+/**
+ * @brief KLV parser with the key encoding of every level fixed at compile
+ *        time, e.g. for ST 0601:
+ *
+ *     BasicKlvParser<KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID> parser;
+ *     std::vector<KLV*> klvs = parser.parse(data, size);
+ *
+ * Produces the same KLVs as a KlvParser constructed with the same encodings,
+ * through the same parseByte()/parse() interface, checksum modes, and limits.
+ * Key framing is inlined per encoding instead of being picked by a switch on
+ * every byte, parseByte() is not virtual, and the nested levels are built by
+ * KlvNestedLevels without a parser object (or a copy of the encodings) per
+ * level. A KLV that lies entirely in the buffer passed to parse() is framed
+ * and built in place; only one that is split across calls is collected in the
+ * parser first.
+ *
+ * Lazy nesting, views, and arena trees are only offered by KlvParser, which
+ * remains the parser for key encodings that are only known at run time.
+ */
+template<KlvParser::KeyEncoding Encoding, KlvParser::KeyEncoding... Nested>
+class BasicKlvParser {
+
+public:
+    typedef KlvKeyFormat<Encoding> KeyFormat;
+
+    BasicKlvParser()
+        : checksum_mode(KlvParser::CHECKSUM_OFF), num_checksum_failures(0), num_errors(0), last_error(KLV_OK) {
+        resetFields();
+    }
+
+    KLV* parseByte(uint8_t byte);
+
+    std::vector<KLV*> parse(const uint8_t* data, size_t size);
+    std::vector<KLV*> parse(const std::vector<uint8_t>& data) { return parse(data.data(), data.size()); }
+    KlvStatus parse(const uint8_t* data, size_t size, std::vector<KLV*>& klvs);
+
+    /**
+     * Discards a partially parsed KLV, see KlvParser::reset().
+     */
+    void reset() { resetFields(); }
+
+    void setChecksumMode(KlvParser::ChecksumMode mode) { this->checksum_mode = mode; }
+    KlvParser::ChecksumMode getChecksumMode() const { return this->checksum_mode; }
+    unsigned long getNumChecksumFailures() const { return this->num_checksum_failures; }
+
+    void setLimits(const KlvParser::Limits& limits);
+    const KlvParser::Limits& getLimits() const { return this->limits; }
+    unsigned long getNumErrors() const { return this->num_errors; }
+    KlvStatus getLastError() const { return this->last_error; }
+
+    /**
+     * Locates the first complete KLV of this parser's top level encoding, see
+     * KlvParser::frame().
+     */
+    static KlvStatus frame(const uint8_t* data, size_t size, const KlvParser::Limits& limits, KlvParser::Frame& f) {
+        return KeyFormat::frame(data, size, limits, f);
+    }
+
+private:
+    BasicKlvParser(const BasicKlvParser&);  // not copyable
+    BasicKlvParser& operator=(const BasicKlvParser&);
+
+    size_t parseSpan(const uint8_t* data, size_t size);
+    size_t scanForKey(const uint8_t* data, size_t size);
+    KLV* finishKlv(const uint8_t* key, size_t key_size, const uint8_t* len, size_t len_size,
+                   const uint8_t* val, size_t val_size);
+    KlvChecksumStatus checkChecksum(const uint8_t* key, size_t key_size, const uint8_t* len, size_t len_size,
+                                    const uint8_t* val, size_t val_size) const;
+    void reject(KlvStatus status);
+    void resetFields();
+
+    /**
+     * Parser state enum, as in KlvParser
+     */
+    enum State {
+        STATE_INIT,       /// init state
+        STATE_KEY,        /// key read
+        STATE_LEN_HEADER, /// read long form BER length bytes
+        STATE_LEN,        /// length read, read value field
+        STATE_VALUE       /// KLV complete
+    };
+
+    State                state;           /// parser state
+    std::vector<uint8_t> key;             /// key of a KLV split across calls
+    std::vector<uint8_t> len;             /// BER-encoded length of a KLV split across calls
+    std::vector<uint8_t> val;             /// value of a KLV split across calls
+    unsigned long        ber_len;         /// length of BER-encoded length field in bytes
+    unsigned long        num_ber_len_bytes_read; /// number of bytes read for BER length field
+    unsigned long        val_len;         /// length of value field in bytes
+
+    KlvParser::ChecksumMode checksum_mode; /// what to do with the ST 0601 checksum
+    unsigned long        num_checksum_failures; /// KLVs dropped for a bad checksum
+
+    KlvParser::Limits    limits;          /// limits on accepted KLVs
+    unsigned long        num_errors;      /// KLVs rejected
+    KlvStatus            last_error;      /// status of the last rejected KLV
+};
+
+/**
+ * Parsers for the usual encodings
+ */
+typedef BasicKlvParser<KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID> KlvSt0601Parser;
+
+/**
+ * @brief Parses a single byte, see KlvParser::parseByte().
+ *
+ * @param  byte byte to parse
+ * @return      the KLV completed by this byte, NULL if none. Ownership is
+ *              transfered to the caller.
+ * @throws KlvFormatException in CHECKSUM_THROW mode for a bad checksum
+ */
+template<KlvParser::KeyEncoding Encoding, KlvParser::KeyEncoding... Nested>
+KLV* BasicKlvParser<Encoding, Nested...>::parseByte(uint8_t byte) {
+    KLV* klv = NULL;
+    parseSpan(&byte, 1);
+    if(state == STATE_VALUE) {
+        unsigned long failures = num_checksum_failures;
+        klv = finishKlv(key.data(), key.size(), len.data(), len.size(), val.data(), val.size());
+        resetFields();
+        if(checksum_mode == KlvParser::CHECKSUM_THROW && num_checksum_failures != failures)
+            throw KlvFormatException(KLV_ERROR_CHECKSUM);
+    }
+    return klv;
+}
+
+/**
+ * @brief Parses a buffer of bytes, see KlvParser::parse().
+ *
+ * @param  data pointer to the bytes to parse
+ * @param  size number of bytes to parse
+ * @return      the KLVs completed by this buffer, in stream order. Ownership of
+ *              each KLV is transfered to the caller.
+ * @throws KlvFormatException in CHECKSUM_THROW mode for a bad checksum, after
+ *         the rest of the buffer has been parsed and its KLVs freed
+ */
+template<KlvParser::KeyEncoding Encoding, KlvParser::KeyEncoding... Nested>
+std::vector<KLV*> BasicKlvParser<Encoding, Nested...>::parse(const uint8_t* data, size_t size) {
+    std::vector<KLV*> klvs;
+    unsigned long failures = num_checksum_failures;
+    parse(data, size, klvs);
+    if(checksum_mode == KlvParser::CHECKSUM_THROW && num_checksum_failures != failures) {
+        for(size_t i = 0; i < klvs.size(); i++)
+            KLV::deleteTree(klvs[i]);
+        throw KlvFormatException(KLV_ERROR_CHECKSUM);
+    }
+    return klvs;
+}
+
+/**
+ * @brief Parses a buffer of bytes and appends every complete KLV found in it
+ *        to klvs, see KlvParser::parse(). Never throws KlvFormatException.
+ *
+ * @param  data pointer to the bytes to parse
+ * @param  size number of bytes to parse
+ * @param  klvs receives the KLVs completed by this buffer, in stream order
+ * @return      KLV_OK, or the status of the last KLV rejected in this buffer
+ */
+template<KlvParser::KeyEncoding Encoding, KlvParser::KeyEncoding... Nested>
+KlvStatus BasicKlvParser<Encoding, Nested...>::parse(const uint8_t* data, size_t size, std::vector<KLV*>& klvs) {
+    unsigned long errors = num_errors;
+    size_t offset = 0;
+    KlvParser::Frame f;
+    while(offset < size) {
+        if(state == STATE_INIT && key.empty() && frame(data + offset, size - offset, limits, f) == KLV_OK) {
+            // the whole KLV is in the caller's buffer
+            const uint8_t* klv_data = data + offset;
+            KLV* klv = finishKlv(klv_data + f.key_offset, f.key_size, klv_data + f.lenOffset(), f.len_size,
+                                 klv_data + f.valueOffset(), f.value_size);
+            if(klv != NULL)
+                klvs.push_back(klv);
+            offset += f.end();
+            continue;
+        }
+
+        // split across calls, or rejected: the state machine deals with it
+        offset += parseSpan(data + offset, size - offset);
+        if(state != STATE_VALUE)
+            continue;
+
+        KLV* klv = finishKlv(key.data(), key.size(), len.data(), len.size(), val.data(), val.size());
+        resetFields();
+        if(klv != NULL)
+            klvs.push_back(klv);
+    }
+    return num_errors != errors ? last_error : KLV_OK;
+}
+
+/**
+ * @brief Sets the limits on accepted KLVs, see KlvParser::setLimits().
+ *
+ * @param limits new limits
+ * @throws std::invalid_argument if max_ber_bytes is more than an unsigned long
+ *         can hold
+ */
+template<KlvParser::KeyEncoding Encoding, KlvParser::KeyEncoding... Nested>
+void BasicKlvParser<Encoding, Nested...>::setLimits(const KlvParser::Limits& limits) {
+    if(limits.max_ber_bytes > sizeof(unsigned long))
+        throw std::invalid_argument("max_ber_bytes is larger than an unsigned long");
+    this->limits = limits;
+}
+
+/**
+ * @brief Runs the state machine over a span of bytes until either the span is
+ *        exhausted or a KLV has been completed, like KlvParser::parseSpan(). The
+ *        branches on the key encoding are constant and fold away.
+ *
+ * @param  data pointer to the bytes to parse
+ * @param  size number of bytes available
+ * @return      number of bytes consumed from data
+ */
+template<KlvParser::KeyEncoding Encoding, KlvParser::KeyEncoding... Nested>
+size_t BasicKlvParser<Encoding, Nested...>::parseSpan(const uint8_t* data, size_t size) {
+    size_t i = 0;
+    while(i < size) {
+        switch(state) {
+        case STATE_INIT: {
+            if(KeyFormat::UNIVERSAL) {
+                i += scanForKey(data + i, size - i);
+                break;
+            }
+            uint8_t byte = data[i++];
+            key.push_back(byte);
+            if(KeyFormat::isLastKeyByte(byte, key.size()))
+                state = STATE_KEY;
+            break;
+        }
+
+        case STATE_KEY: {
+            uint8_t byte = data[i++];
+            len.push_back(byte);
+            if(byte & 0b10000000) {
+                ber_len = byte & 0b01111111;
+                if(ber_len == 0 || ber_len > limits.max_ber_bytes) {
+                    reject(KLV_ERROR_BER_LENGTH);
+                    break;
+                }
+                state = STATE_LEN_HEADER;
+                val_len = 0;
+            } else {
+                val_len = byte;
+                if(val_len > limits.max_value_size) {
+                    reject(KLV_ERROR_VALUE_SIZE);
+                    break;
+                }
+                state = STATE_LEN;
+            }
+            break;
+        }
+
+        case STATE_LEN_HEADER: {
+            uint8_t byte = data[i++];
+            len.push_back(byte);
+            val_len = (val_len << 8) | byte;
+            if(++num_ber_len_bytes_read == ber_len) {
+                if(val_len > limits.max_value_size) {
+                    reject(KLV_ERROR_VALUE_SIZE);
+                    break;
+                }
+                state = STATE_LEN;
+            }
+            break;
+        }
+
+        case STATE_LEN: {
+            size_t n = std::min((size_t) (val_len - val.size()), size - i);
+            val.insert(val.end(), data + i, data + i + n);
+            i += n;
+            break;
+        }
+
+        default:
+            break;
+        }
+
+        // a zero-length value completes as soon as its length field has been read
+        if(state == STATE_LEN && val.size() == val_len) {
+            state = STATE_VALUE;
+            break;
+        }
+    }
+    return i;
+}
+
+/**
+ * @brief Collects a 16-byte universal key, skipping garbage in front of it,
+ *        like KlvParser::scanForKey().
+ *
+ * @param  data pointer to the bytes to parse
+ * @param  size number of bytes available
+ * @return      number of bytes consumed
+ */
+template<KlvParser::KeyEncoding Encoding, KlvParser::KeyEncoding... Nested>
+size_t BasicKlvParser<Encoding, Nested...>::scanForKey(const uint8_t* data, size_t size) {
+    size_t i = 0;
+
+    // continue a key started by an earlier call, one byte at a time
+    while(!key.empty() && i < size) {
+        key.push_back(data[i++]);
+
+        // drop leading bytes that can no longer be the start of a UL header
+        while(!key.empty() && memcmp(key.data(), SMPTE_KLV_UL_HEADER,
+                std::min(key.size(), (size_t) SMPTE_KLV_UL_HEADER_LEN)) != 0)
+            key.erase(key.begin());
+
+        if(key.size() == KLV_KEY_SIZE) {
+            state = STATE_KEY;
+            return i;
+        }
+    }
+    if(i == size)
+        return i;
+
+    size_t offset = KlvScan::findUlHeader(data + i, size - i);
+    if(offset == size - i) {
+        // no header, but the last few bytes may be the start of one
+        size_t keep = KlvScan::ulHeaderPrefixSuffix(data + i, size - i);
+        key.assign(data + size - keep, data + size);
+        return size;
+    }
+
+    // jump to the header and take as much of the key as there is
+    i += offset;
+    size_t n = std::min((size_t) KLV_KEY_SIZE, size - i);
+    key.assign(data + i, data + i + n);
+    i += n;
+    if(key.size() == KLV_KEY_SIZE)
+        state = STATE_KEY;
+    return i;
+}
+
+/**
+ * @brief Checks the checksum of a complete KLV and builds it, with its nested
+ *        levels, unless the checksum mode says to drop it.
+ *
+ * @return the new KLV, or NULL if it was dropped. Ownership is transfered to
+ *         the caller.
+ */
+template<KlvParser::KeyEncoding Encoding, KlvParser::KeyEncoding... Nested>
+KLV* BasicKlvParser<Encoding, Nested...>::finishKlv(const uint8_t* key, size_t key_size, const uint8_t* len, size_t len_size,
+                                                    const uint8_t* val, size_t val_size) {
+    KlvChecksumStatus status = checkChecksum(key, key_size, len, len_size, val, val_size);
+    if(status == KLV_CHECKSUM_INVALID && checksum_mode != KlvParser::CHECKSUM_MARK) {
+        num_checksum_failures++;
+        reject(KLV_ERROR_CHECKSUM);
+        return NULL;
+    }
+
+    KLV* klv = new KLV(key, key_size, len, len_size, val, val_size);
+    klv->setChecksumStatus(status);
+    KlvNestedLevels<Nested...>::link(klv, limits, limits.max_depth);
+    return klv;
+}
+
+/**
+ * @brief Compares the checksum of a complete KLV against its checksum item,
+ *        see KlvParser::checkChecksum().
+ */
+template<KlvParser::KeyEncoding Encoding, KlvParser::KeyEncoding... Nested>
+KlvChecksumStatus BasicKlvParser<Encoding, Nested...>::checkChecksum(const uint8_t* key, size_t key_size,
+                                                                     const uint8_t* len, size_t len_size,
+                                                                     const uint8_t* val, size_t val_size) const {
+    if(checksum_mode == KlvParser::CHECKSUM_OFF)
+        return KLV_CHECKSUM_UNCHECKED;
+    if(val_size < 4 || val[val_size-4] != 0x01 || val[val_size-3] != 0x02)
+        return KLV_CHECKSUM_INVALID;
+
+    KlvChecksum checksum;
+    checksum.update(key, key_size);
+    checksum.update(len, len_size);
+    checksum.update(val, val_size - 2);
+    uint16_t expected = (uint16_t) ((val[val_size-2] << 8) | val[val_size-1]);
+    return checksum.value() == expected ? KLV_CHECKSUM_VALID : KLV_CHECKSUM_INVALID;
+}
+
+/**
+ * @brief Drops the KLV being parsed and records why.
+ */
+template<KlvParser::KeyEncoding Encoding, KlvParser::KeyEncoding... Nested>
+void BasicKlvParser<Encoding, Nested...>::reject(KlvStatus status) {
+    num_errors++;
+    last_error = status;
+    resetFields();
+}
+
+template<KlvParser::KeyEncoding Encoding, KlvParser::KeyEncoding... Nested>
+void BasicKlvParser<Encoding, Nested...>::resetFields() {
+    state = STATE_INIT;
+    ber_len = 0;
+    val_len = 0;
+    num_ber_len_bytes_read = 0;
+    key.clear();
+    len.clear();
+    val.clear();
+}
+
+#endif /* BasicKlvParser_hpp */
@@ -2,7 +2,9 @@
 #define KLV_H
 
 #include <stdint.h>
+#include <stddef.h>
 #include <vector>
+#include <memory>
 #include <unordered_map>
 
 // Is this necessary? No rule saying KLV has a max payload size...
@@ -14,6 +16,52 @@
 const uint8_t SMPTE_KLV_UL_HEADER[] = {0x06, 0x0E, 0x2B, 0x34};   // SMPTE KLV Universal Label (UL) Header
                                                                   // SMPTE KLV headers will ALWAYS start with this
 
+class KLV;
+
+/**
+ * @brief Result of checking the ST 0601 checksum of a top level KLV (see
+ *        KlvParser::setChecksumMode()).
+ */
+enum KlvChecksumStatus {
+    KLV_CHECKSUM_UNCHECKED,   /// checksum was not checked
+    KLV_CHECKSUM_VALID,       /// last item is a checksum item and it matches
+    KLV_CHECKSUM_INVALID      /// checksum item is missing or does not match
+};
+
+/**
+ * @brief Outcome of framing or parsing a KLV. The error codes are what a
+ *        parser reports for a packet it rejected (see KlvParser::parse() and
+ *        KlvParser::Limits); none of them is thrown by the status-returning API.
+ */
+enum KlvStatus {
+    KLV_OK,                   /// no error
+    KLV_INCOMPLETE,           /// more bytes are needed to frame the KLV
+    KLV_ERROR_BER_LENGTH,     /// long form length with no length bytes, or more than the limit
+    KLV_ERROR_VALUE_SIZE,     /// value longer than the limit
+    KLV_ERROR_CHECKSUM        /// ST 0601 checksum is missing or does not match
+};
+
+const char* klvStatusString(KlvStatus status);
+
+/**
+ * @brief Decodes the value field of a KLV into its child KLVs when they are
+ *        first needed. Installed on a KLV by a parser in lazy nesting mode (see
+ *        KlvParser::setLazyNesting()).
+ */
+class KlvLazyDecoder {
+public:
+    virtual ~KlvLazyDecoder() {}
+
+    /**
+     * @brief Parses the value field of parent.
+     *
+     * @param  parent KLV whose value holds the embedded KLVs
+     * @return        the child KLVs in stream order. Ownership is transfered to
+     *                parent's tree, the same as for eagerly parsed children.
+     */
+    virtual std::vector<KLV*> decode(const KLV& parent) const = 0;
+};
+
 /**
  * @brief Simple class representing a Key-Length-Value (KLV).
  *
@@ -27,6 +75,11 @@ const uint8_t SMPTE_KLV_UL_HEADER[] = {0x06, 0x0E, 0x2B, 0x34};   // SMPTE KLV U
  *
  * A Map can be used to index each KLV with their key
  *
+ * Children may be decoded lazily: if a KlvLazyDecoder was installed, the value
+ * field is parsed the first time getChild() (or indexToMap()) needs the
+ * children, and the result is kept. This is not thread safe; share a lazily
+ * decoded KLV between threads only after touching its children once.
+ *
  * References:
  *   SMPTE 336-2007
  *   ST 0601.8          -   UAS Datalink Local Metadata Set
@@ -34,19 +87,34 @@ const uint8_t SMPTE_KLV_UL_HEADER[] = {0x06, 0x0E, 0x2B, 0x34};   // SMPTE KLV U
 class KLV {
 
 public:
-    KLV() {}
-    KLV(const std::vector<uint8_t> key, const std::vector<uint8_t> val);
-    KLV(const std::vector<uint8_t> key, const std::vector<uint8_t> len, const std::vector<uint8_t> val);
+    KLV() : len(0), ber_len(0), parent(NULL), child(NULL), previous_sibling(NULL), next_sibling(NULL),
+            checksum_status(KLV_CHECKSUM_UNCHECKED), dropped_items(false) {}
+    KLV(const std::vector<uint8_t>& key, const std::vector<uint8_t>& val);
+    KLV(const std::vector<uint8_t>& key, const std::vector<uint8_t>& len, const std::vector<uint8_t>& val);
+    KLV(const uint8_t* key, size_t key_size, const uint8_t* len, size_t len_size, const uint8_t* val, size_t val_size);
     virtual ~KLV();
 
-    std::vector<uint8_t> getKey() const { return this->key; }
-    std::vector<uint8_t> getLenEncoded() const { return this->len_encoded; }
-    std::vector<uint8_t> getValue() const { return this->value; }
+    /**
+     * @brief Deletes a KLV along with all of its decoded children (and theirs).
+     *        The destructor frees the node only. Siblings and the parent are
+     *        left alone. Does nothing for NULL.
+     *
+     * @param klv root of the tree to delete
+     */
+    static void deleteTree(KLV* klv);
+
+    const std::vector<uint8_t>& getKey() const { return this->key; }
+    const std::vector<uint8_t>& getLenEncoded() const { return this->len_encoded; }
+    const std::vector<uint8_t>& getValue() const { return this->value; }
     unsigned long getLen() const { return this->len; }
     unsigned long getBerLen() const { return ber_len; }
 
     KLV* getParent() const { return this->parent; }
-    KLV* getChild() const { return this->child; }
+    KLV* getChild() const {
+        if(this->lazy_decoder)
+            decodeChildren();
+        return this->child;
+    }
     KLV* getPrevious() const { return this->previous_sibling; }
     KLV* getNext() const { return this->next_sibling; }
 
@@ -54,6 +122,23 @@ public:
     void setChild(KLV* child) { this->child = child; }
     void setPreviousSibling(KLV* previous) { this->previous_sibling = previous; }
     void setNextSibling(KLV* next) { this->next_sibling = next; }
+    void appendChild(KLV* child);
+
+    void setLazyDecoder(const std::shared_ptr<const KlvLazyDecoder>& decoder) { this->lazy_decoder = decoder; }
+    bool isDecoded() const { return !this->lazy_decoder; }
+
+    KlvChecksumStatus getChecksumStatus() const { return this->checksum_status; }
+    void setChecksumStatus(KlvChecksumStatus status) { this->checksum_status = status; }
+
+    /**
+     * @brief Records whether the children just linked in account for the whole
+     *        value, i.e. whether the parser dropped some of it (a truncated
+     *        last item, a rejected item, or items skipped by a filter). Called
+     *        by the parsers once they have linked the children of a set.
+     */
+    void markDroppedItems();
+    bool hasDroppedItems() const { return this->dropped_items; }
+    void setDroppedItems(bool dropped) { this->dropped_items = dropped; }
 
     std::vector<uint8_t> toBytes();
     std::unordered_map<std::vector<uint8_t>, KLV> indexToMap();
@@ -82,7 +167,7 @@ public:
             //     hash = hash * 31 + secondField.GetHashCode();
             //     return hash;
             // }
-            int res = 17;
+            std::size_t res = 17;
             for(auto b : k.key)
                 res = res * 31 + hash<uint8_t>()(b);   
             for(auto b : k.len_encoded)
@@ -96,27 +181,35 @@ public:
     };
 
 private:
+    void decodeChildren() const;
+
     std::vector<uint8_t> key;             /// Key (1,2,4, or 16 bytes in length) (typically 16-byte universal key or BER-OID for LDS tags)
     std::vector<uint8_t> len_encoded;     /// Data length (BER) (short & long form)
     std::vector<uint8_t> value;           /// Value (variable-length)
     unsigned long        len;             /// Data length in human-readable format
     unsigned long        ber_len;         /// Length of BER len field
     KLV*                 parent;          /// parent KLV node, NULL if on top level branch
-    KLV*                 child;           /// first child in branch, NULL if leave node
+    mutable KLV*         child;           /// first child in branch, NULL if leave node
     KLV*                 previous_sibling;/// previous KLV node on branch, NULL if none. Typically if first node in branch, this will be NULL
     KLV*                 next_sibling;    /// next KLV node on branch, NULL if none
+    mutable std::shared_ptr<const KlvLazyDecoder> lazy_decoder; /// decodes the children on first access, empty once decoded
+    KlvChecksumStatus    checksum_status; /// ST 0601 checksum result, set by the parser
+    bool                 dropped_items;   /// true if the parser left some of the value out of the children
 };
 
 
 // specialize the hash function for std::vector<uint8_t> so that it may be used as a key in STL maps
+// (64-bit FNV-1a; for 16-byte universal keys prefer KlvUniversalKey, which does not allocate)
 namespace std {
     template <>
     struct hash<std::vector<uint8_t>> {
         std::size_t operator()(const std::vector<uint8_t>& k) const {
-            int res = 17;
-            for(auto b : k)
-                res = res * 31 + std::hash<uint8_t>()(b);
-            return res;
+            uint64_t res = 0xCBF29CE484222325ull;
+            for(auto b : k) {
+                res ^= b;
+                res *= 0x100000001B3ull;
+            }
+            return (std::size_t) res;
         }
     };
 }
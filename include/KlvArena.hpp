@@ -0,0 +1,66 @@
+//
+//  KlvArena.hpp
+//  libklv
+//
+
+#ifndef KlvArena_hpp
+#define KlvArena_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Bump allocator that hands out memory from large blocks and frees all of
+ *        it at once.
+ *
+ * Objects created in the arena never have their destructors run, so only
+ * trivially destructible types (such as KlvView) should be put in it.
+ *
+ * reset() makes all of the memory available again without returning it to the
+ * system. If the previous round needed more than one block, they are merged into
+ * a single block big enough for all of it, so a steady stream of similar packets
+ * settles on one contiguous block and no further allocations.
+ */
+class KlvArena {
+
+public:
+    explicit KlvArena(size_t block_size = 4096);
+    ~KlvArena();
+
+    void* allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+    uint8_t* copy(const uint8_t* data, size_t size);
+
+    template<typename T, typename... Args>
+    T* create(Args&&... args) {
+        return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+    }
+
+    void reset();
+    void release();
+
+    size_t getBytesUsed() const { return this->bytes_used; }
+    size_t getCapacity() const { return this->capacity; }
+    size_t getNumBlocks() const { return this->blocks.size(); }
+
+private:
+    KlvArena(const KlvArena&);              // not copyable
+    KlvArena& operator=(const KlvArena&);
+
+    void addBlock(size_t min_size);
+
+    struct Block {
+        uint8_t* data;      /// start of the block
+        size_t   size;      /// size of the block in bytes
+    };
+
+    std::vector<Block>   blocks;          /// blocks owned by this arena, the last one is being filled
+    size_t               offset;          /// first free byte in the last block
+    size_t               block_size;      /// minimum size of a new block
+    size_t               bytes_used;      /// bytes handed out since the last reset()
+    size_t               capacity;        /// total size of all blocks
+};
+
+#endif /* KlvArena_hpp */
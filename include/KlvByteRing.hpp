@@ -0,0 +1,106 @@
+//
+//  KlvByteRing.hpp
+//  libklv
+//
+
+#ifndef KlvByteRing_hpp
+#define KlvByteRing_hpp
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+/**
+ * @brief Lock-free ring of byte spans between one producer thread (e.g. a
+ *        network reader) and one consumer thread (e.g. a parser).
+ *
+ * push() copies a span into the ring, behind a small header holding its size
+ * and a 64-bit tag the producer may use for anything (an arrival time, a
+ * stream). The consumer takes spans in batches with pop() and parses them in
+ * place; they stay valid until it calls release(), which hands all of their
+ * room back to the producer with one store.
+ *
+ *     KlvByteRing::Span spans[64];
+ *     size_t n;
+ *     while((n = ring.pop(spans, 64)) > 0) {
+ *         for(size_t i = 0; i < n; i++)
+ *             parser.parse(spans[i].data, spans[i].size, klvs);
+ *         ring.release();
+ *     }
+ *
+ * As with KlvSpscRing, each side writes one index, on its own cache line. A
+ * consumer that finds the ring empty can wait in pop(): it announces that it
+ * is going to sleep, and the producer only takes the ring's mutex to wake it
+ * when it sees that announcement, so neither side locks while data flows.
+ *
+ * The indices are kept apart with alignas(64), which plain new does not
+ * honour before C++17. Place rings on the stack, as members, or in storage
+ * from posix_memalign() (as KlvStreamSet does for its workers), not on the
+ * heap with new.
+ */
+class KlvByteRing {
+
+public:
+    /**
+     * A span of bytes in the ring
+     */
+    struct Span {
+        const uint8_t*   data;            /// the bytes, valid until release()
+        size_t           size;            /// number of bytes, may be 0
+        uint64_t         tag;             /// the tag it was pushed with
+    };
+
+    explicit KlvByteRing(size_t capacity);
+
+    size_t capacity() const { return this->ring.size(); }
+    size_t getMaxSpan() const;
+
+    bool tryPush(const uint8_t* data, size_t size, uint64_t tag = 0);
+    void push(const uint8_t* data, size_t size, uint64_t tag = 0);
+
+    size_t tryPop(Span* spans, size_t max);
+    size_t pop(Span* spans, size_t max);
+    void release();
+
+    void close();
+    bool isClosed() const { return this->closed.load(); }
+
+    /**
+     * @return true if every span pushed so far has been released. Producer
+     *         side; the consumer may release more at any time.
+     */
+    bool empty() const {
+        return this->tail.load(std::memory_order_acquire) == this->head.load(std::memory_order_relaxed);
+    }
+
+private:
+    KlvByteRing(const KlvByteRing&);        // not copyable
+    KlvByteRing& operator=(const KlvByteRing&);
+
+    /**
+     * Header in front of each span. Headers start on a multiple of
+     * sizeof(Header).
+     */
+    struct Header {
+        uint64_t         tag;             /// tag of the span
+        uint32_t         size;            /// bytes following the header
+        uint32_t         pad;             /// nonzero for filler up to the end of the ring
+    };
+
+    static size_t recordSize(size_t size);
+
+    alignas(64) std::atomic<size_t> head; /// bytes pushed, written by the producer
+    size_t               cached_tail;     /// producer's copy of tail
+    alignas(64) std::atomic<size_t> tail; /// bytes released, written by the consumer
+    size_t               read;            /// bytes popped by the consumer, not yet released
+    alignas(64) std::atomic<bool> sleeping; /// true while the consumer waits in pop()
+    std::atomic<bool>    closed;          /// true once close() was called
+    std::vector<uint8_t> ring;            /// the spans, a power of two bytes
+    std::mutex           mutex;           /// only taken to sleep and to wake the consumer
+    std::condition_variable cond;
+};
+
+#endif /* KlvByteRing_hpp */
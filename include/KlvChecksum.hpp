@@ -0,0 +1,62 @@
+//
+//  KlvChecksum.hpp
+//  libklv
+//
+
+#ifndef KlvChecksum_hpp
+#define KlvChecksum_hpp
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief ST 0601 packet checksum.
+ *
+ * The checksum is the 16-bit running sum of every byte of the packet, from the
+ * first byte of the 16-byte key up to and including the checksum item's tag and
+ * length (01 02), with bytes at even offsets added to the high byte and bytes at
+ * odd offsets added to the low byte. So it is kept as two plain byte sums, one
+ * per parity, which makes it order independent within a parity and lets it be
+ * updated incrementally with spans of any size as the packet streams in.
+ *
+ * compute() and update() pick the fastest kernel the CPU supports at run time:
+ * SSE2 on x86, and otherwise a word-at-a-time kernel that sums 8 bytes per step.
+ * computeScalar() is the byte-by-byte reference from the standard. All kernels
+ * return the same result.
+ *
+ * References:
+ *   ST 0601.8          -   UAS Datalink Local Metadata Set, Checksum (tag 1)
+ */
+class KlvChecksum {
+
+public:
+    KlvChecksum() : even(0), odd(0), size(0) {}
+
+    void reset() {
+        this->even = 0;
+        this->odd = 0;
+        this->size = 0;
+    }
+
+    void update(const uint8_t* data, size_t size);
+
+    uint16_t value() const { return (uint16_t) ((this->even << 8) + this->odd); }
+    size_t getSize() const { return this->size; }
+
+    static uint16_t compute(const uint8_t* data, size_t size);
+    static uint16_t computeScalar(const uint8_t* data, size_t size);
+    static uint16_t computeWord(const uint8_t* data, size_t size);
+    static uint16_t computeSse2(const uint8_t* data, size_t size);
+
+    static bool verify(const uint8_t* packet, size_t size);
+
+private:
+    static void sumWord(const uint8_t* data, size_t size, uint32_t& even, uint32_t& odd);
+    static void sumSse2(const uint8_t* data, size_t size, uint32_t& even, uint32_t& odd);
+
+    uint32_t             even;            /// sum of the bytes at even offsets
+    uint32_t             odd;             /// sum of the bytes at odd offsets
+    size_t               size;            /// number of bytes summed so far
+};
+
+#endif /* KlvChecksum_hpp */
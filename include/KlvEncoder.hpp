@@ -0,0 +1,84 @@
+//
+//  KlvEncoder.hpp
+//  libklv
+//
+
+#ifndef KlvEncoder_hpp
+#define KlvEncoder_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Klv.h"
+
+/**
+ * @brief Destination for encoded bytes.
+ */
+class KlvSink {
+public:
+    virtual ~KlvSink() {}
+    virtual void write(const uint8_t* data, size_t size) = 0;
+};
+
+/**
+ * @brief KlvSink that appends to a byte vector.
+ */
+class KlvVectorSink : public KlvSink {
+public:
+    explicit KlvVectorSink(std::vector<uint8_t>& buffer) : buffer(buffer) {}
+
+    void write(const uint8_t* data, size_t size) {
+        buffer.insert(buffer.end(), data, data + size);
+    }
+
+private:
+    std::vector<uint8_t>& buffer;
+};
+
+/**
+ * @brief Serializes KLV trees.
+ *
+ * A KLV with (decoded) children is encoded from its children, and a KLV without
+ * children from its value field, so trees built by hand and trees with edited
+ * leaves both come out right. The one exception is a parsed set whose parser
+ * left some of its value out of the children (a truncated last item, or items
+ * skipped by a filter, see KLV::hasDroppedItems()): it is written from its
+ * value, so no parsed bytes are lost, and edits to its children are not.
+ * Lengths are BER encoded in short form below 128 bytes and in the shortest
+ * long form otherwise. A KLV whose length field already holds the right length
+ * keeps it as is, so re-encoding a parsed tree gives back the exact bytes that
+ * were parsed. Lazily parsed KLVs that were never decoded are written from
+ * their raw value without decoding them.
+ *
+ * Encoding takes two passes over the tree. The first computes the size of every
+ * nested set bottom-up; the second writes key, length, and value of each node
+ * straight into the output. The sizes are kept in a buffer owned by the encoder
+ * and reused across calls, so a long-lived encoder does not allocate per node or
+ * per packet.
+ */
+class KlvEncoder {
+
+public:
+    static size_t berLengthSize(unsigned long len);
+    static size_t encodeBerLength(unsigned long len, uint8_t* out);
+    static std::vector<uint8_t> encodeBerLength(unsigned long len);
+
+    size_t measure(const KLV& klv);
+    size_t encode(const KLV& klv, uint8_t* out, size_t capacity);
+    size_t encode(const KLV& klv, KlvSink& sink);
+
+private:
+    struct Sizes {
+        unsigned long    value_size;      /// size of the value field
+        size_t           len_size;        /// size of the BER length field
+        bool             keep_len;        /// true to write the KLV's own length field
+    };
+
+    size_t measureNode(const KLV& klv);
+    void writeNode(const KLV& klv, size_t& index, uint8_t*& out);
+    void writeNode(const KLV& klv, size_t& index, KlvSink& sink);
+
+    std::vector<Sizes>   sizes;           /// sizes of each node in depth first order, from measure()
+};
+
+#endif /* KlvEncoder_hpp */
@@ -0,0 +1,102 @@
+//
+//  KlvFile.hpp
+//  libklv
+//
+
+#ifndef KlvFile_hpp
+#define KlvFile_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "KlvMappedFile.hpp"
+#include "KlvParser.hpp"
+#include "KlvTree.hpp"
+#include "KlvView.hpp"
+
+/**
+ * @brief Index record of one top level KLV in a capture file.
+ */
+struct KlvFileEntry {
+    uint64_t             offset;          /// offset of the first key byte in the file
+    uint64_t             timestamp;       /// ST 0601 Precision Time Stamp (tag 2), microseconds since the epoch
+    uint64_t             value_size;      /// decoded length of the value field
+    uint8_t              key_size;        /// size of the key field
+    uint8_t              len_size;        /// size of the BER-encoded length field
+    uint8_t              has_timestamp;   /// 1 if timestamp was found in the packet, else 0
+    uint8_t              reserved[5];     /// always 0
+
+    uint64_t end() const { return offset + key_size + len_size + value_size; }
+};
+
+/**
+ * @brief Random access reader for KLV capture files.
+ *
+ * The file is memory mapped and indexed once: the index holds the location of
+ * every top level KLV (found exactly as KlvParser would find them) and its
+ * Precision Time Stamp if it has one. Packets are then handed out as views
+ * straight into the mapping, by position or by time, without parsing the file
+ * up to that point.
+ *
+ * Indexing a large file still means reading all of it once, so the index can
+ * be kept in a sidecar file next to the capture (the capture's path plus
+ * ".idx"). The sidecar records the size and modification time of the capture
+ * and is ignored, and rebuilt, if either no longer matches.
+ *
+ * Views and trees point into the mapping and are valid while the KlvFile is.
+ */
+class KlvFile {
+
+public:
+    static const size_t NONE = (size_t) -1;
+
+    /**
+     * @brief Maps and indexes a capture file. Throws std::runtime_error if the
+     *        file cannot be mapped.
+     *
+     * @param path          path of the capture file
+     * @param key_encodings key encodings, as for KlvParser. The first one must be
+     *                      KEY_ENCODING_16_BYTE; timestamps are only looked for
+     *                      if there is a second one for the local set.
+     * @param use_sidecar   true to load the index from the sidecar file when it
+     *                      is up to date, and to write it after indexing
+     */
+    explicit KlvFile(const std::string& path,
+                     std::vector<KlvParser::KeyEncoding> key_encodings = {KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID},
+                     bool use_sidecar = true);
+
+    size_t size() const { return this->entries.size(); }
+    bool empty() const { return this->entries.empty(); }
+    const KlvFileEntry& getEntry(size_t index) const { return this->entries[index]; }
+    const std::vector<KlvFileEntry>& getEntries() const { return this->entries; }
+
+    KlvView getView(size_t index) const;
+    void getTree(size_t index, KlvTree& tree);
+
+    size_t findTime(uint64_t timestamp) const;
+    std::vector<size_t> findTimeRange(uint64_t begin, uint64_t end) const;
+
+    bool loadIndex(const std::string& index_path);
+    bool saveIndex(const std::string& index_path) const;
+    bool isIndexLoaded() const { return this->index_loaded; }
+
+    const KlvMappedFile& getFile() const { return this->file; }
+
+private:
+    KlvFile(const KlvFile&);                // not copyable
+    KlvFile& operator=(const KlvFile&);
+
+    void buildIndex();
+    void sortByTime();
+
+    KlvMappedFile        file;            /// the mapped capture
+    std::vector<KlvParser::KeyEncoding> key_encodings; /// encodings of the packets
+    KlvParser            parser;          /// frames nested KLVs for getTree()
+    std::vector<KlvFileEntry> entries;    /// one record per top level KLV, in file order
+    std::vector<size_t>  time_order;      /// entries with a timestamp, sorted by it
+    uint64_t             mtime;           /// modification time of the capture, in nanoseconds
+    bool                 index_loaded;    /// true if the index came from a sidecar file
+};
+
+#endif /* KlvFile_hpp */
@@ -0,0 +1,102 @@
+//
+//  KlvFileParser.hpp
+//  libklv
+//
+
+#ifndef KlvFileParser_hpp
+#define KlvFileParser_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+#include "Klv.h"
+#include "KlvParser.hpp"
+
+/**
+ * @brief Parses large capture files on several threads.
+ *
+ * The buffer (usually a memory mapped file, see parseFile()) is cut into chunks
+ * of a fixed size. Each worker thread takes the next chunk, scans forward from
+ * its first byte to the first UL header, and parses every top level KLV that
+ * starts inside the chunk; a KLV may run on into the next chunk. Each KLV is
+ * parsed by the worker's own KlvParser, so nesting, lazy nesting, checksum
+ * checks, and limits behave exactly as with KlvParser::parse().
+ *
+ * KLVs are handed out on the calling thread in file order, as soon as all
+ * chunks in front of them are done. A UL header inside a value can make a
+ * worker start on a false packet at the edge of its chunk, so each chunk is
+ * checked against the end of the KLV before it. Where they disagree, the
+ * calling thread frames packets itself from the end of that KLV until it is
+ * back in step with the chunk's packets. The output is therefore the same as
+ * feeding the whole buffer to a single KlvParser.
+ *
+ * Only 16-byte universal keys can be found by scanning, so the top level key
+ * encoding must be KlvParser::KEY_ENCODING_16_BYTE.
+ */
+class KlvFileParser {
+
+public:
+    typedef std::function<void(KLV*)> Handler;
+
+    static const size_t DEFAULT_CHUNK_SIZE = 16 << 20;
+
+    KlvFileParser(std::vector<KlvParser::KeyEncoding> key_encodings, size_t num_threads = 0,
+                  size_t chunk_size = DEFAULT_CHUNK_SIZE);
+
+    void setLazyNesting(bool lazy) { this->lazy_nesting = lazy; }
+    void setChecksumMode(KlvParser::ChecksumMode mode) { this->checksum_mode = mode; }
+    unsigned long getNumChecksumFailures() const { return this->num_checksum_failures; }
+    void setLimits(const KlvParser::Limits& limits);
+    unsigned long getNumErrors() const { return this->num_errors; }
+
+    size_t getNumThreads() const { return this->num_threads; }
+    size_t getChunkSize() const { return this->chunk_size; }
+
+    size_t parse(const uint8_t* data, size_t size, const Handler& handler);
+    std::vector<KLV*> parse(const uint8_t* data, size_t size);
+
+    size_t parseFile(const std::string& path, const Handler& handler);
+    std::vector<KLV*> parseFile(const std::string& path);
+
+private:
+    struct Packet {
+        size_t           origin;          /// where the scan for this packet started
+        size_t           start;           /// offset of the packet's key
+        size_t           end;             /// offset one past the packet's value
+        KLV*             klv;             /// parsed packet, NULL if rejected
+        KlvStatus        status;          /// why the packet was rejected, KLV_OK if it was not
+    };
+
+    struct Chunk {
+        std::vector<Packet> packets;      /// packets starting in the chunk, in order
+        size_t           tail;            /// where the scan after the last packet started
+        bool             clean;           /// true if no further packet starts in the chunk
+        bool             ready;           /// true once a worker has filled in the chunk
+    };
+
+    enum Scan {
+        SCAN_FOUND,       /// a complete packet starts in the chunk
+        SCAN_END,         /// no packet starts in the rest of the chunk
+        SCAN_INCOMPLETE,  /// the next packet runs past the end of the buffer
+        SCAN_REJECTED     /// the next packet breaks a limit; the scan resumes after its length field
+    };
+
+    void configure(KlvParser& parser) const;
+    KLV* parsePacket(KlvParser& parser, const uint8_t* data, size_t start, size_t end, KlvStatus& status) const;
+    Scan findPacket(const uint8_t* data, size_t size, size_t pos, size_t limit, size_t& start, KlvParser::Frame& f,
+                    KlvStatus& status) const;
+    void parseChunk(KlvParser& parser, const uint8_t* data, size_t size, size_t begin, size_t limit, Chunk& chunk) const;
+
+    std::vector<KlvParser::KeyEncoding> key_encodings; /// encodings passed on to each KlvParser
+    size_t               num_threads;     /// number of worker threads
+    size_t               chunk_size;      /// bytes per chunk
+    bool                 lazy_nesting;    /// passed on to each KlvParser
+    KlvParser::ChecksumMode checksum_mode; /// passed on to each KlvParser
+    KlvParser::Limits    limits;          /// passed on to each KlvParser
+    unsigned long        num_checksum_failures; /// packets dropped for a bad checksum by the last parse
+    unsigned long        num_errors;      /// packets rejected by the last parse, including checksum failures
+};
+
+#endif /* KlvFileParser_hpp */
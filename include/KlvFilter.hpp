@@ -0,0 +1,80 @@
+//
+//  KlvFilter.hpp
+//  libklv
+//
+
+#ifndef KlvFilter_hpp
+#define KlvFilter_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+#include "KlvUniversalKey.hpp"
+
+/**
+ * @brief Set of KLVs a parser keeps on one nesting level (see
+ *        KlvParser::setFilter()).
+ *
+ * Levels with 16-byte keys are filtered by universal key, every other level by
+ * decoded tag (see KlvParser::decodeTag()). Tags 0 to 127 are looked up in a
+ * bitmap, larger tags and keys in small vectors searched linearly. A filter
+ * that nothing has been added to keeps everything:
+ *
+ *     KlvFilter items({2, 13, 14, 15});   // timestamp, sensor position
+ */
+class KlvFilter {
+
+public:
+    static const size_t NUM_DIRECT_TAGS = 128;
+
+    KlvFilter() : pass_all(true), direct() {}
+    KlvFilter(std::initializer_list<uint64_t> tags) : pass_all(true), direct() {
+        for(uint64_t tag : tags)
+            addTag(tag);
+    }
+
+    void addTag(uint64_t tag) {
+        pass_all = false;
+        if(tag < NUM_DIRECT_TAGS)
+            direct[tag / 64] |= 1ull << (tag % 64);
+        else
+            tags.push_back(tag);
+    }
+
+    void addKey(const KlvUniversalKey& key) {
+        pass_all = false;
+        keys.push_back(key);
+    }
+
+    /**
+     * @return true if nothing has been added, so every KLV is kept
+     */
+    bool passesAll() const { return this->pass_all; }
+
+    bool acceptsTag(uint64_t tag) const {
+        if(tag < NUM_DIRECT_TAGS)
+            return pass_all || (direct[tag / 64] >> (tag % 64)) & 1;
+        for(size_t i = 0; i < tags.size(); i++) {
+            if(tags[i] == tag)
+                return true;
+        }
+        return pass_all;
+    }
+
+    bool acceptsKey(const KlvUniversalKey& key) const {
+        for(size_t i = 0; i < keys.size(); i++) {
+            if(keys[i] == key)
+                return true;
+        }
+        return pass_all;
+    }
+
+private:
+    bool                 pass_all;        /// true until a tag or key is added
+    uint64_t             direct[NUM_DIRECT_TAGS / 64]; /// bit per tag 0 to 127
+    std::vector<uint64_t> tags;           /// larger tags
+    std::vector<KlvUniversalKey> keys;    /// universal keys
+};
+
+#endif /* KlvFilter_hpp */
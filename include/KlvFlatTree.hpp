@@ -0,0 +1,98 @@
+//
+//  KlvFlatTree.hpp
+//  libklv
+//
+
+#ifndef KlvFlatTree_hpp
+#define KlvFlatTree_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "KlvTagIndex.hpp"
+#include "KlvView.hpp"
+
+/**
+ * @brief One KLV in a KlvFlatTree. Plain data, all offsets are into the tree's
+ *        byte buffer and all links are indices into its node array.
+ */
+struct KlvFlatNode {
+    uint64_t             tag;             /// key as an integer (1, 2, 4 byte and BER-OID keys), 0 for 16-byte keys
+    uint32_t             key_offset;      /// offset of the key
+    uint32_t             value_offset;    /// offset of the value
+    uint32_t             value_size;      /// decoded length of the value
+    uint32_t             parent;          /// index of the parent node, KlvFlatTree::NONE on the top level
+    uint32_t             first_child;     /// index of the first child, KlvFlatTree::NONE for a leaf
+    uint32_t             next_sibling;    /// index of the next sibling, KlvFlatTree::NONE for the last one
+    uint16_t             depth;           /// nesting depth, 0 on the top level
+    uint8_t              key_size;        /// size of the key
+    uint8_t              len_size;        /// size of the BER-encoded length, which sits right before the value
+};
+
+/**
+ * @brief Contiguous representation of one parsed KLV and all of its nested KLVs.
+ *
+ * The tree holds a single copy of the packet's bytes and an array of KlvFlatNode
+ * records in depth first order: the top level KLV is node 0, and every node is
+ * followed by its children. Scanning a packet for a few tags is therefore a
+ * linear walk over one array, and child/sibling navigation equivalent to
+ * KLV::getChild()/getNext() is available through node indices.
+ *
+ * Items of the top level local set can also be looked up by tag with find().
+ *
+ * Filled by KlvParser::parseFlat(). clear() keeps the buffers' capacity, so a
+ * tree reused across packets stops allocating once it has seen the largest one.
+ */
+class KlvFlatTree {
+
+public:
+    static const uint32_t NONE;           /// "no node" index
+
+    typedef std::vector<KlvFlatNode>::const_iterator const_iterator;
+
+    KlvFlatTree() : index(NONE) {}
+
+    bool empty() const { return this->nodes.empty(); }
+    size_t size() const { return this->nodes.size(); }
+    void clear() { this->nodes.clear(); this->bytes.clear(); this->index.clear(); }
+
+    const_iterator begin() const { return this->nodes.begin(); }
+    const_iterator end() const { return this->nodes.end(); }
+    const KlvFlatNode& operator[](uint32_t index) const { return this->nodes[index]; }
+
+    uint32_t getRoot() const { return empty() ? NONE : 0; }
+    uint32_t getParent(uint32_t index) const { return this->nodes[index].parent; }
+    uint32_t getChild(uint32_t index) const { return this->nodes[index].first_child; }
+    uint32_t getNext(uint32_t index) const { return this->nodes[index].next_sibling; }
+    uint32_t getPrevious(uint32_t index) const;
+
+    /**
+     * @brief Looks up an item of the top level local set by tag in constant time.
+     *        The index is built while the packet is parsed.
+     *
+     * @param  tag tag of a child of the root node
+     * @return     index of the node, NONE if the packet has no such item
+     */
+    uint32_t find(uint64_t tag) const { return this->index.find(tag); }
+
+    KlvSpan getKey(const KlvFlatNode& node) const {
+        return KlvSpan(&this->bytes[node.key_offset], node.key_size);
+    }
+    KlvSpan getLenEncoded(const KlvFlatNode& node) const {
+        return KlvSpan(&this->bytes[node.value_offset - node.len_size], node.len_size);
+    }
+    KlvSpan getValue(const KlvFlatNode& node) const {
+        return KlvSpan(this->bytes.data() + node.value_offset, node.value_size);
+    }
+
+    const std::vector<uint8_t>& getBytes() const { return this->bytes; }
+
+private:
+    friend class KlvParser;
+
+    std::vector<KlvFlatNode> nodes;       /// nodes in depth first order
+    std::vector<uint8_t> bytes;           /// the packet, starting at the top level key
+    KlvTagIndex<uint32_t> index;          /// tags of the root's children to node indices
+};
+
+#endif /* KlvFlatTree_hpp */
@@ -2,20 +2,25 @@
 #define KLV_FORMAT_EXCEPTION_H
 
 #include <stdexcept>
-#include <cstdio>
+#include <string>
+#include "Klv.h"
 
-class KlvFormatException : public std::exception {
+/**
+ * @brief Thrown by the exception-based parsing API for a malformed or rejected
+ *        KLV. The message is owned by the exception (std::runtime_error keeps a
+ *        copy), and the status says what was wrong with the KLV.
+ */
+class KlvFormatException : public std::runtime_error {
 public:
-    KlvFormatException(char* reason) {
-        this->reason = reason;
-    }
+    explicit KlvFormatException(KlvStatus status)
+        : std::runtime_error(klvStatusString(status)), status(status) {}
+    KlvFormatException(KlvStatus status, const std::string& reason)
+        : std::runtime_error(reason), status(status) {}
 
-    virtual const char* what() const throw() {
-        return reason;
-    }
+    KlvStatus getStatus() const { return this->status; }
 
 private:
-    char* reason;
+    KlvStatus status;           /// what was wrong with the KLV
 };
 
 #endif // KLV_FORMAT_EXCEPTION_H
@@ -0,0 +1,84 @@
+//
+//  KlvIngestLoop.hpp
+//  libklv
+//
+
+#ifndef KlvIngestLoop_hpp
+#define KlvIngestLoop_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "KlvByteRing.hpp"
+#include "KlvParser.hpp"
+#include "KlvSpscRing.hpp"
+#include "KlvTree.hpp"
+
+/**
+ * @brief Parse loop between a reader thread and a consumer thread.
+ *
+ * The reader pushes the bytes it receives, in any chunking, into the loop's
+ * input ring (a KlvByteRing). The parse thread runs run(), which takes the
+ * spans in batches, feeds them to KlvParser::parseTree(), and publishes each
+ * completed packet on an output ring. The consumer takes packets with poll()
+ * and gives each tree back with recycle() when it is done with it:
+ *
+ *     KlvIngestLoop loop(parser);
+ *     std::thread parse_thread([&]() { loop.run(); });
+ *
+ *     // reader thread
+ *     loop.getInput().push(datagram, size, arrival_time);
+ *
+ *     // consumer thread
+ *     KlvIngestLoop::Packet packet;
+ *     if(loop.poll(packet)) {
+ *         handle(packet.tree->getRoot());
+ *         loop.recycle(packet.tree);
+ *     }
+ *
+ *     loop.close();
+ *     parse_thread.join();
+ *
+ * The trees come from a fixed pool, so once each tree has held the largest
+ * packet, nothing is allocated per packet. When every tree is out with the
+ * consumer, the parse thread waits for one to be recycled, and the input ring
+ * fills up behind it.
+ */
+class KlvIngestLoop {
+
+public:
+    /**
+     * A completed packet
+     */
+    struct Packet {
+        KlvTree*         tree;            /// the packet, to be given back with recycle()
+        uint64_t         tag;             /// tag of the input span that completed it
+    };
+
+    static const size_t DEFAULT_RING_SIZE = 1 << 20;
+    static const size_t DEFAULT_NUM_TREES = 64;
+
+    KlvIngestLoop(KlvParser& parser, size_t ring_size = DEFAULT_RING_SIZE, size_t num_trees = DEFAULT_NUM_TREES);
+    ~KlvIngestLoop();
+
+    KlvByteRing& getInput() { return this->input; }
+
+    void run();
+    void close();
+
+    bool poll(Packet& packet);
+    size_t poll(Packet* packets, size_t max);
+    void recycle(KlvTree* tree);
+
+private:
+    KlvIngestLoop(const KlvIngestLoop&);    // not copyable
+    KlvIngestLoop& operator=(const KlvIngestLoop&);
+
+    KlvParser&           parser;          /// parser fed by run()
+    KlvByteRing          input;           /// bytes from the reader
+    KlvSpscRing<Packet>  output;          /// packets for the consumer
+    KlvSpscRing<KlvTree*> free_trees;     /// trees given back by the consumer
+    std::vector<KlvTree*> trees;          /// every tree of the pool
+};
+
+#endif /* KlvIngestLoop_hpp */
@@ -0,0 +1,110 @@
+//
+//  KlvKeyRegistry.hpp
+//  libklv
+//
+
+#ifndef KlvKeyRegistry_hpp
+#define KlvKeyRegistry_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "KlvFilter.hpp"
+#include "KlvParser.hpp"
+#include "KlvUniversalKey.hpp"
+#include "KlvVisitor.hpp"
+
+/**
+ * @brief Decoding rules for top level universal sets, looked up by their
+ *        16-byte key (see KlvParser::setKeyRegistry()).
+ *
+ * Without a registry a parser decodes every top level KLV with the key
+ * encodings it was constructed with. With one, each universal set is decoded by
+ * the rule registered for its key, so a stream mixing e.g. ST 0601 packets
+ * and ST 0102 security sets parses each by its own standard, and sets with no
+ * rule are skipped by their length:
+ *
+ *     KlvKeyRegistry registry;
+ *     registry.add(KlvUniversalKey(st0601_ul), KlvKeyRegistry::Rule({KlvParser::KEY_ENCODING_BER_OID}, KlvKeyRegistry::CHECKSUM_ST0601));
+ *     registry.add(KlvUniversalKey(st0102_ul), KlvKeyRegistry::Rule({KlvParser::KEY_ENCODING_BER_OID}));
+ *     parser.setKeyRegistry(registry);
+ *
+ * A parser's top level filter still picks which sets are read, but its filters
+ * for the nested levels are written for one standard and are not applied to
+ * the sets of a rule; each rule carries its own (Rule::filters).
+ *
+ * Keys are hashed into a fixed open addressing table that is rebuilt on add(),
+ * so a lookup is a hash of two 64-bit words and, for a registered key, one
+ * 16-byte compare.
+ */
+class KlvKeyRegistry {
+
+public:
+    static const size_t NOT_FOUND = (size_t) -1;
+
+    /**
+     * Checksum carried by the sets of a rule
+     */
+    enum ChecksumType {
+        CHECKSUM_NONE,    /// no checksum, the parser's checksum mode does not apply
+        CHECKSUM_ST0601   /// ST 0601 checksum item, checked as set by KlvParser::setChecksumMode()
+    };
+
+    /**
+     * How the sets with one universal key are decoded
+     */
+    struct Rule {
+        bool                 descend;         /// false to keep the value raw
+        std::vector<KlvParser::KeyEncoding> key_encodings; /// key encodings of the nested levels, the set's items first
+        ChecksumType         checksum;        /// checksum the sets carry
+        KlvVisitor*          handler;         /// receives the events of these sets in KlvParser::parse(const uint8_t*, size_t, KlvVisitor&) instead of the visitor passed there, NULL for that visitor. Not owned.
+        std::vector<KlvFilter> filters;       /// filter per nested level, the set's items first; the parser's own filters below the top level do not apply to these sets
+
+        Rule() : descend(false), checksum(CHECKSUM_NONE), handler(NULL) {}
+        Rule(std::vector<KlvParser::KeyEncoding> key_encodings, ChecksumType checksum = CHECKSUM_NONE, KlvVisitor* handler = NULL,
+             std::vector<KlvFilter> filters = std::vector<KlvFilter>())
+            : descend(!key_encodings.empty()), key_encodings(key_encodings), checksum(checksum), handler(handler), filters(filters) {}
+    };
+
+    KlvKeyRegistry() : mask(0) {}
+
+    /**
+     * Registers the rule for a universal key, replacing any rule registered
+     * for it before.
+     *
+     * @param key  universal key of the sets
+     * @param rule how to decode them
+     */
+    void add(const KlvUniversalKey& key, const Rule& rule);
+
+    /**
+     * @param  key universal key to look up
+     * @return     index of its rule, NOT_FOUND if none is registered
+     */
+    size_t find(const KlvUniversalKey& key) const {
+        if(this->keys.empty())
+            return NOT_FOUND;
+        for(size_t slot = key.hash() & this->mask; this->slots[slot] != EMPTY; slot = (slot + 1) & this->mask) {
+            if(this->keys[this->slots[slot]] == key)
+                return this->slots[slot];
+        }
+        return NOT_FOUND;
+    }
+
+    size_t size() const { return this->keys.size(); }
+    bool empty() const { return this->keys.empty(); }
+    const KlvUniversalKey& getKey(size_t index) const { return this->keys[index]; }
+    const Rule& getRule(size_t index) const { return this->rules[index]; }
+
+private:
+    static const uint32_t EMPTY = 0xFFFFFFFF;
+
+    void rebuild();
+
+    std::vector<KlvUniversalKey> keys;    /// registered keys, in the order they were added
+    std::vector<Rule>    rules;           /// rule for each key
+    std::vector<uint32_t> slots;          /// key index per hash slot, EMPTY if free; at least half free
+    size_t               mask;            /// number of slots minus one
+};
+
+#endif /* KlvKeyRegistry_hpp */
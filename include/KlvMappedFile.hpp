@@ -0,0 +1,38 @@
+//
+//  KlvMappedFile.hpp
+//  libklv
+//
+
+#ifndef KlvMappedFile_hpp
+#define KlvMappedFile_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/**
+ * @brief Read-only memory mapping of a whole capture file.
+ *
+ * The mapping lives as long as the object, so views, frames, and spans into
+ * data() stay valid until it is destroyed. Throws std::runtime_error if the
+ * file cannot be opened or mapped. An empty file maps to a NULL pointer and a
+ * size of 0.
+ */
+class KlvMappedFile {
+
+public:
+    explicit KlvMappedFile(const std::string& path);
+    ~KlvMappedFile();
+
+    const uint8_t* data() const { return this->bytes; }
+    size_t size() const { return this->length; }
+
+private:
+    KlvMappedFile(const KlvMappedFile&);    // not copyable
+    KlvMappedFile& operator=(const KlvMappedFile&);
+
+    const uint8_t*       bytes;           /// start of the mapping, NULL for an empty file
+    size_t               length;          /// size of the file in bytes
+};
+
+#endif /* KlvMappedFile_hpp */
@@ -10,8 +10,20 @@
 #define KlvParser_hpp
 
 #include <cstdint>
+#include <cstddef>
+#include <memory>
 #include <vector>
 #include "Klv.h"
+#include "KlvArena.hpp"
+#include "KlvChecksum.hpp"
+#include "KlvFilter.hpp"
+#include "KlvFlatTree.hpp"
+#include "KlvParserStats.hpp"
+#include "KlvTree.hpp"
+#include "KlvView.hpp"
+#include "KlvVisitor.hpp"
+
+class KlvKeyRegistry;
 
 /**
  * KLV Parser
@@ -31,6 +43,30 @@ public:
         KEY_ENCODING_BER_OID
     };
 
+    /**
+     * What the parser does with the ST 0601 checksum of each top level KLV
+     */
+    enum ChecksumMode {
+        CHECKSUM_OFF,     /// checksum is not checked
+        CHECKSUM_MARK,    /// every KLV is returned, marked valid or invalid
+        CHECKSUM_DROP,    /// KLVs with a bad checksum are dropped and counted
+        CHECKSUM_THROW    /// KLVs with a bad checksum are dropped and KlvFormatException is thrown
+    };
+
+    /**
+     * Limits on the KLVs the parser accepts. A KLV whose length field breaks a
+     * limit is rejected as soon as the length field has been read, without
+     * reading (or allocating for) its value, and the parser scans for the next
+     * key from the byte after the length field. See getNumErrors().
+     */
+    struct Limits {
+        unsigned long max_value_size; /// longest accepted value field, MAX_KLV_VALUE_SIZE by default
+        size_t        max_ber_bytes;  /// most length bytes after the first byte of a long form length, sizeof(unsigned long) by default
+        size_t        max_depth;      /// number of nested levels decoded below the top level, 16 by default. Deeper KLVs keep their raw value.
+
+        Limits();
+    };
+
 
     /**
      * Constructs a new KLV parser. Since keys can be encoded using different methods, 
@@ -59,8 +95,317 @@ public:
      */
     virtual KLV* parseByte(uint8_t byte);
 
+    /**
+     * Discards a partially parsed KLV, e.g. after bytes of the stream were lost.
+     * The parser then scans for the next key as if it had just been created.
+     */
+    void reset() { resetFields(); }
+
+    /**
+     * Turns lazy nesting on or off (off by default). With lazy nesting, a KLV is
+     * returned by parse()/parseByte() as soon as its value field is framed, and
+     * its embedded KLVs are only parsed (once) when KLV::getChild() or
+     * KLV::indexToMap() first needs them. Has no effect on parseViews(),
+     * parseTree(), or parseFlat().
+     *
+     * @param lazy true to decode nested KLVs on first access
+     */
+    void setLazyNesting(bool lazy);
+    bool isLazyNesting() const { return this->lazy_nesting; }
+
+    /**
+     * Sets how parse() and parseByte() check the ST 0601 checksum (off by
+     * default). The checksum is summed as the bytes of each top level KLV stream
+     * through the parser, so checking it takes no extra pass over the packet. A
+     * KLV passes if its last item is a checksum item (tag 1, length 2) holding
+     * the checksum of every byte in front of its value. Checked KLVs carry the
+     * result in KLV::getChecksumStatus().
+     *
+     * In CHECKSUM_THROW mode, parseByte() and parse() throw KlvFormatException on
+     * a bad packet. parse() goes through the rest of the buffer first and frees
+     * the KLVs it completed from it. The parser is left ready for the next
+     * packet. The status-returning parse() never throws.
+     *
+     * Has no effect on parseViews(), parseTree(), or parseFlat(); use
+     * KlvChecksum::verify() on the bytes of those packets.
+     *
+     * @param mode checksum mode
+     */
+    void setChecksumMode(ChecksumMode mode) { this->checksum_mode = mode; }
+    ChecksumMode getChecksumMode() const { return this->checksum_mode; }
+
+    /**
+     * @return number of KLVs dropped by CHECKSUM_DROP or CHECKSUM_THROW mode
+     */
+    unsigned long getNumChecksumFailures() const { return this->num_checksum_failures; }
+
+    /**
+     * Sets the limits on accepted KLVs. They also apply to nested KLVs, with
+     * max_depth counted down one per level.
+     *
+     * @param limits new limits
+     * @throws std::invalid_argument if max_ber_bytes is more than an unsigned
+     *         long can hold
+     */
+    void setLimits(const Limits& limits);
+    const Limits& getLimits() const { return this->limits; }
+
+    /**
+     * Keeps only the KLVs that pass filter on one nesting level. The others
+     * are skipped by their length field: their value is neither copied nor
+     * parsed for nested KLVs, and nothing is built for them. On the top level
+     * this drops whole packets; on a nested level it leaves those items out of
+     * their parent's children, while the parent's value keeps all of its
+     * bytes. Applies to every parse method, lazily decoded children included.
+     * Skipped KLVs are not errors.
+     *
+     *     parser.setFilter(0, ul_filter);                  // only these universal sets
+     *     parser.setFilter(1, KlvFilter({2, 13, 14, 15})); // and these items of them
+     *
+     * @param depth  nesting depth, 0 for the top level
+     * @param filter KLVs to keep, see KlvFilter
+     */
+    void setFilter(size_t depth, const KlvFilter& filter);
+    void clearFilters();
+
+    /**
+     * Decodes each top level universal set by the rule registered for its key
+     * instead of by the key encodings the parser was constructed with: the
+     * rule's key encodings are used for its nested levels (or the value is
+     * kept raw), its checksum type says whether the checksum mode applies, and
+     * its handler receives its events in the visitor parse(), and its filters
+     * take the place of the parser's own below the top level. Sets whose key
+     * has no rule are skipped by their length and counted as filtered. Applies
+     * to every parse method. The registry is copied.
+     *
+     * @param registry rules per universal key, see KlvKeyRegistry
+     * @throws std::invalid_argument if the top level keys are not 16-byte
+     *         universal keys
+     */
+    void setKeyRegistry(const KlvKeyRegistry& registry);
+    void clearKeyRegistry();
+
+    /**
+     * @return number of top level KLVs rejected so far, for breaking a limit or
+     *         (in CHECKSUM_DROP and CHECKSUM_THROW mode) for a bad checksum
+     */
+    unsigned long getNumErrors() const { return this->num_errors; }
+
+    /**
+     * @return status of the last rejected KLV, KLV_OK if none was rejected
+     */
+    KlvStatus getLastError() const { return this->last_error; }
+
+    /**
+     * Running statistics of everything this parser has read: bytes read and
+     * discarded while resyncing, top level KLVs per universal key, rejected
+     * KLVs by reason, the deepest nesting level decoded, and a histogram of
+     * value sizes. Another thread may take a KlvParserStats::snapshot() while
+     * the parser runs. Nested levels decoded lazily are not counted.
+     *
+     * @return the statistics, updated as the parser goes
+     */
+    const KlvParserStats& getStats() const { return this->stats; }
+
+    /**
+     * Parses a buffer of bytes and returns every complete KLV found in it. Partial
+     * KLV at the end of the buffer is kept in the parser state, exactly as with
+     * parseByte(), so a stream may be fed in chunks of any size. Feeding the same
+     * bytes one at a time through parseByte() produces the same KLVs.
+     *
+     * @param  data pointer to the bytes to parse
+     * @param  size number of bytes to parse
+     * @return      the KLVs completed by this buffer, in stream order. Ownership of
+     *              each KLV is transfered to the caller.
+     */
+    std::vector<KLV*> parse(const uint8_t* data, size_t size);
+    std::vector<KLV*> parse(const std::vector<uint8_t>& data);
+
+    /**
+     * Parses a buffer of bytes like parse(), but reports rejected KLVs through
+     * the return value instead of throwing, in every checksum mode. A rejected
+     * KLV costs no more than reading its key and length field (plus its value
+     * for a bad checksum), and the parser carries on with the rest of the
+     * buffer.
+     *
+     * @param  data pointer to the bytes to parse
+     * @param  size number of bytes to parse
+     * @param  klvs the KLVs completed by this buffer are appended, in stream
+     *              order. Ownership of each KLV is transfered to the caller.
+     * @return      KLV_OK, or the status of the last KLV rejected in this buffer
+     */
+    KlvStatus parse(const uint8_t* data, size_t size, std::vector<KLV*>& klvs);
+
+    /**
+     * Parses a buffer of bytes like parse(), but returns zero-copy views instead
+     * of KLV objects. Nested KLVs are available as child views.
+     *
+     * A KLV that lies entirely inside data is viewed in place, so the caller must
+     * keep data alive for as long as the views are used. A KLV that was started by
+     * an earlier call is viewed in the parser's own copy of its bytes. Either way,
+     * the returned views (and their children) are only valid until the next call
+     * to parseViews(). Use KlvView::toOwned() to keep a KLV longer than that.
+     *
+     * @param  data pointer to the bytes to parse
+     * @param  size number of bytes to parse
+     * @return      views of the KLVs completed by this buffer, in stream order
+     */
+    std::vector<const KlvView*> parseViews(const uint8_t* data, size_t size);
+
+    /**
+     * Parses a buffer of bytes and reports every complete KLV found in it to a
+     * visitor, nested levels included, without building anything for it:
+     *
+     *     struct Timestamps : KlvVisitor {
+     *         void onItem(size_t depth, uint64_t tag, const KlvSpan& key, const KlvSpan& len, const KlvSpan& value) {
+     *             if(depth == 1 && tag == 2)
+     *                 handle(value);
+     *         }
+     *     } visitor;
+     *     parser.parse(data, size, visitor);
+     *
+     * Each packet is walked as soon as it is complete: in place if it lies
+     * entirely inside data, or in the parser's own copy if it was split
+     * across calls. Nothing is allocated per packet. Rejected KLVs and the
+     * checksum modes work as for the status-returning parse(); in
+     * CHECKSUM_MARK mode a bad checksum shows up in KlvVisitor::onSetEnd().
+     * Lazy nesting has no effect.
+     *
+     * @param  data    pointer to the bytes to parse
+     * @param  size    number of bytes to parse
+     * @param  visitor receives the events, in stream order
+     * @return         KLV_OK, or the status of the last KLV rejected in this
+     *                 buffer
+     */
+    KlvStatus parse(const uint8_t* data, size_t size, KlvVisitor& visitor);
+
+    /**
+     * Parses bytes until one KLV has been completed and stores it in tree. All
+     * nodes of the tree (and, with copy_values, the bytes they point to) come from
+     * the tree's arena, so the whole packet is freed in one go when the tree is
+     * destroyed. The tree is cleared at the start of each call, which recycles its
+     * memory for the next packet:
+     *
+     *     KlvTree tree;
+     *     size_t offset = 0;
+     *     while(offset < size) {
+     *         offset += parser.parseTree(data + offset, size - offset, tree);
+     *         if(!tree.empty())
+     *             handle(tree.getRoot());
+     *     }
+     *
+     * @param  data        pointer to the bytes to parse
+     * @param  size        number of bytes to parse
+     * @param  tree        receives the KLV, left empty if data ends first
+     * @param  copy_values true to copy the KLV's bytes into the tree, false to
+     *                     point into data (which must then outlive the tree)
+     * @return             number of bytes consumed from data
+     */
+    size_t parseTree(const uint8_t* data, size_t size, KlvTree& tree, bool copy_values = true);
+
+    /**
+     * Parses bytes until one KLV has been completed and stores it in a flat tree:
+     * one copy of the packet's bytes plus an array of small node records in depth
+     * first order. Used like parseTree(); the tree is cleared at the start of each
+     * call and its buffers are reused.
+     *
+     * @param  data pointer to the bytes to parse
+     * @param  size number of bytes to parse
+     * @param  tree receives the KLV, left empty if data ends first
+     * @return      number of bytes consumed from data
+     */
+    size_t parseFlat(const uint8_t* data, size_t size, KlvFlatTree& tree);
+
+    /**
+     * Location of one KLV triplet inside a contiguous buffer, relative to the start
+     * of that buffer. The length field follows the key, and the value follows the
+     * length field.
+     */
+    struct Frame {
+        size_t        key_offset;   /// offset of the first key byte
+        size_t        key_size;     /// size of the key field
+        size_t        len_size;     /// size of the BER-encoded length field
+        unsigned long value_size;   /// decoded length of the value field
+
+        size_t lenOffset() const { return key_offset + key_size; }
+        size_t valueOffset() const { return lenOffset() + len_size; }
+        size_t end() const { return valueOffset() + value_size; }
+    };
+
+    /**
+     * Locates the first complete KLV in a contiguous buffer without copying it.
+     * Bytes in front of the key are skipped the same way the parser state machine
+     * skips them.
+     *
+     * @param  data         pointer to the buffer
+     * @param  size         size of the buffer
+     * @param  key_encoding encoding of the key
+     * @param  frame        filled in with the location of the KLV
+     * @return              true if a complete KLV was found, false if the buffer
+     *                      ends before one is complete
+     */
+    static bool frame(const uint8_t* data, size_t size, KeyEncoding key_encoding, Frame& frame);
+
+    /**
+     * Locates the first complete KLV in a contiguous buffer, checking its length
+     * field against limits. A KLV that breaks a limit is reported as soon as
+     * its length field is there, and frame.valueOffset() is then where the
+     * parser state machine would resume scanning.
+     *
+     * @param  data         pointer to the buffer
+     * @param  size         size of the buffer
+     * @param  key_encoding encoding of the key
+     * @param  limits       limits to check
+     * @param  frame        filled in with the location of the KLV
+     * @return              KLV_OK if a complete KLV was found, KLV_INCOMPLETE if
+     *                      the buffer ends first, or the limit that was broken
+     */
+    static KlvStatus frame(const uint8_t* data, size_t size, KeyEncoding key_encoding, const Limits& limits, Frame& frame);
+
+    /**
+     * Second half of frame(): reads the BER length field that follows a key
+     * the caller has located, for parsers that find keys their own way.
+     *
+     * @param  data   pointer to the buffer
+     * @param  size   size of the buffer
+     * @param  limits limits to check
+     * @param  frame  key_offset and key_size must be set; len_size and
+     *                value_size are filled in
+     * @return        KLV_OK, KLV_INCOMPLETE, or the limit that was broken
+     */
+    static KlvStatus frameLength(const uint8_t* data, size_t size, const Limits& limits, Frame& frame);
+
+    /**
+     * Decodes a key into an integer tag. 1, 2, and 4 byte keys are big endian
+     * integers, and BER-OID keys carry 7 bits per byte (so ST 0601 tags come out
+     * as 1 to 127 for single byte keys). 16-byte universal keys do not fit and
+     * decode to 0.
+     *
+     * @param  key          pointer to the key
+     * @param  size         size of the key
+     * @param  key_encoding encoding of the key
+     * @return              the tag
+     */
+    static uint64_t decodeTag(const uint8_t* key, size_t size, KeyEncoding key_encoding);
+
 protected:
-    bool checkIfContainsKlvKey(std::vector<uint8_t> data);
+    size_t parseSpan(const uint8_t* data, size_t size);
+    KLV* buildKlv();
+    KLV* finishKlv();
+    KlvChecksumStatus checkChecksum() const;
+    void reject(KlvStatus status);
+    size_t frameNext(const uint8_t* data, size_t size, const uint8_t** klv_data, Frame& f);
+    KlvView* buildView(KlvArena& arena, const uint8_t* data, const Frame& frame);
+    void buildChildViews(KlvArena& arena, KlvView* parent, size_t depth);
+    bool visitKlv(KlvVisitor& visitor, const uint8_t* data, const Frame& frame, size_t depth, bool checksum_ok);
+    uint32_t addFlatNode(KlvFlatTree& tree, const Frame& klv_frame, size_t offset, size_t depth, uint32_t parent);
+    bool accepts(size_t depth, const uint8_t* key, size_t key_size) const;
+    bool admit(const uint8_t* key, size_t key_size);
+    size_t decodeChildren(KLV* klv, const std::vector<uint8_t>& value);
+    void configureSetParsers();
+    void startValue();
+    bool checkIfContainsKlvKey(const std::vector<uint8_t>& data);
+    size_t scanForKey(const uint8_t* data, size_t size);
     void resetFields();
 
     /**
@@ -71,7 +416,8 @@ protected:
         STATE_KEY,        /// read KLV 16-byte universal key
         STATE_LEN_HEADER, /// read first byte in BER-encoded length field
         STATE_LEN,        /// read entire BER-encoded length field
-        STATE_VALUE       /// read value field
+        STATE_VALUE,      /// read value field
+        STATE_SKIP        /// skip the value of a KLV the filter does not keep
     };
 
     long                 ctr;             /// counter for bytes read by this parser
@@ -85,11 +431,40 @@ protected:
     unsigned long        ber_len;         /// length of BER-encoded length field in bytes
     unsigned long        num_ber_len_bytes_read; /// number of bytes read for BER length field
     unsigned long        val_len;         /// length of value field in bytes
+    unsigned long        num_skip_bytes;  /// bytes left to skip in STATE_SKIP
     
     KLV*                 parent;          /// parent KLV node, NULL if on top level branch
     KLV*                 child;           /// first child in branch, NULL if leave node
     KLV*                 previous_sibling;/// previous KLV node on branch, NULL if none. Typically if first node in branch, this will be NULL
     KLV*                 next_sibling;    /// next KLV node on branch, NULL if none
+
+    bool                 lazy_nesting;    /// true to decode nested KLVs on first access
+    std::shared_ptr<const KlvLazyDecoder> lazy_decoder; /// installed on each KLV in lazy nesting mode
+    std::unique_ptr<KlvParser> sub_parser; /// parses the values of this level into children, kept for the next KLV
+    std::vector<KLV*>    sub_klvs;        /// children of the KLV being built, reused for the next KLV
+
+    ChecksumMode         checksum_mode;   /// what to do with the ST 0601 checksum
+    KlvChecksum          checksum;        /// running checksum of the KLV being parsed
+    unsigned long        num_checksum_failures; /// KLVs dropped for a bad checksum
+
+    std::vector<KlvFilter> filters;       /// filter per nesting level, none for levels past the end
+
+    std::unique_ptr<KlvKeyRegistry> registry; /// rules per top level universal key, NULL to decode every key alike
+    std::vector<std::unique_ptr<KlvParser> > set_parsers; /// decode the nested levels of each rule, in registry order
+    KlvParser*           set_parser;      /// decodes the nested levels of the KLV being parsed: this, or one of set_parsers
+    bool                 set_checksum;    /// false if the KLV being parsed has no checksum for the checksum mode to check
+    KlvVisitor*          set_handler;     /// handler of its rule, NULL if none
+    Limits               limits;          /// limits on accepted KLVs
+    unsigned long        num_errors;      /// KLVs rejected
+    KlvStatus            last_error;      /// status of the last rejected KLV
+    KlvParserStats       stats;           /// running statistics
+
+    std::vector<uint8_t> carry;           /// bytes of the last KLV completed through the state machine by frameNext()
+    KlvArena             view_arena;      /// storage for the views returned by parseViews()
+
+private:
+    KlvParser(const KlvParser&);            // not copyable
+    KlvParser& operator=(const KlvParser&);
 };
 
 
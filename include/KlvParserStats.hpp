@@ -0,0 +1,199 @@
+//
+//  KlvParserStats.hpp
+//  libklv
+//
+
+#ifndef KlvParserStats_hpp
+#define KlvParserStats_hpp
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+#include "Klv.h"
+#include "KlvUniversalKey.hpp"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <x86intrin.h>
+#define KLV_CYCLES_RDTSC
+#else
+#include <chrono>
+#endif
+
+/**
+ * @brief Counter with a single writer that any thread may read.
+ *
+ * The writer adds with a plain load and store instead of a locked
+ * read-modify-write, so counting costs the same as for an ordinary integer,
+ * while readers on other threads never see a torn value.
+ */
+class KlvCounter {
+
+public:
+    KlvCounter() : value(0) {}
+
+    void add(uint64_t n) {
+        value.store(value.load(std::memory_order_relaxed) + n, std::memory_order_relaxed);
+    }
+
+    void raise(uint64_t n) {
+        if(n > value.load(std::memory_order_relaxed))
+            value.store(n, std::memory_order_relaxed);
+    }
+
+    uint64_t get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+    KlvCounter(const KlvCounter&);          // not copyable
+    KlvCounter& operator=(const KlvCounter&);
+
+    std::atomic<uint64_t> value;
+};
+
+/**
+ * @brief Running statistics of a KlvParser (see KlvParser::getStats()).
+ *
+ * Only the parsing thread updates the counters; any other thread may take a
+ * snapshot() at any time without stopping it, e.g. for a metrics exporter:
+ *
+ *     KlvParserStats::Snapshot s = parser.getStats().snapshot();
+ *     export("klv_bytes_read_total", s.bytes_read);
+ *
+ * Each counter is read on its own, so a snapshot taken while the parser runs
+ * may be a few KLVs ahead in one counter compared to another.
+ *
+ * The cycles spent in each state of the byte-wise state machine are only
+ * counted if the library is built with KLV_ENABLE_STATE_TIMING defined
+ * (cmake -Dstate_timing=ON), and stay zero otherwise.
+ */
+class KlvParserStats {
+
+public:
+    static const size_t MAX_KEYS = 16;          /// universal keys counted one by one
+    static const size_t NUM_SIZE_BUCKETS = 32;  /// value size histogram buckets
+    static const size_t NUM_STATES = 6;         /// states of KlvParser's state machine
+
+    /**
+     * Values of the counters at one point in time
+     */
+    struct Snapshot {
+        uint64_t bytes_read;          /// bytes handed to the parser
+        uint64_t bytes_discarded;     /// garbage skipped while looking for a key, and key and length bytes of rejected KLVs
+        uint64_t num_klvs;            /// top level KLVs read to the end of their value, checksum failures included
+        uint64_t num_filtered;        /// top level KLVs skipped by a filter
+        uint64_t num_ber_length_errors; /// KLVs rejected for a malformed length field
+        uint64_t num_value_size_errors; /// KLVs rejected for a value longer than the limit
+        uint64_t num_checksum_failures; /// KLVs dropped for a bad checksum
+        uint64_t max_depth;           /// deepest nesting level decoded, 0 if only top level KLVs were
+        uint64_t value_sizes[NUM_SIZE_BUCKETS]; /// number of values of size 0 in [0], of size 2^(i-1) to 2^i-1 in [i], the last bucket open ended
+        std::vector<std::pair<KlvUniversalKey, uint64_t> > keys; /// KLVs per universal key, for the first MAX_KEYS keys seen
+        uint64_t num_other_keys;      /// KLVs with a universal key seen after the first MAX_KEYS
+        uint64_t state_cycles[NUM_STATES];  /// cycles spent in each state, indexed by KlvParser::State
+        uint64_t state_entries[NUM_STATES]; /// times each state was entered
+    };
+
+    KlvParserStats() : num_keys(0), last_key(0) {}
+
+    /**
+     * @brief Reads every counter. Safe to call from any thread.
+     */
+    Snapshot snapshot() const;
+
+    /**
+     * @return deepest nesting level decoded so far. For the parsing thread.
+     */
+    uint64_t getMaxDepth() const { return this->max_depth.get(); }
+
+    // updates, only ever made by the parsing thread
+
+    void addBytesRead(uint64_t n) { this->bytes_read.add(n); }
+    void addBytesDiscarded(uint64_t n) { this->bytes_discarded.add(n); }
+    void countFiltered() { this->num_filtered.add(1); }
+    void raiseDepth(uint64_t depth) { this->max_depth.raise(depth); }
+    void countKlv(const uint8_t* key, size_t key_size, unsigned long value_size);
+    void countError(KlvStatus status);
+
+    void addStateCycles(int state, uint64_t cycles) { this->state_cycles[state].add(cycles); }
+    void countStateEntry(int state) { this->state_entries[state].add(1); }
+
+    /**
+     * @return the CPU's time stamp counter where there is one, nanoseconds
+     *         from a steady clock elsewhere
+     */
+    static uint64_t cycles() {
+#ifdef KLV_CYCLES_RDTSC
+        return __rdtsc();
+#else
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+    }
+
+private:
+    KlvParserStats(const KlvParserStats&);  // not copyable
+    KlvParserStats& operator=(const KlvParserStats&);
+
+    static size_t sizeBucket(unsigned long value_size);
+    void countKey(const KlvUniversalKey& key);
+
+    KlvCounter           bytes_read;
+    KlvCounter           bytes_discarded;
+    KlvCounter           num_klvs;
+    KlvCounter           num_filtered;
+    KlvCounter           num_ber_length_errors;
+    KlvCounter           num_value_size_errors;
+    KlvCounter           num_checksum_failures;
+    KlvCounter           max_depth;
+    KlvCounter           value_sizes[NUM_SIZE_BUCKETS];
+
+    KlvUniversalKey      keys[MAX_KEYS];  /// written once, before num_keys is raised past them
+    KlvCounter           key_counts[MAX_KEYS];
+    std::atomic<size_t>  num_keys;        /// keys in use, published with release order
+    size_t               last_key;        /// index of the last key counted, checked first
+    KlvCounter           num_other_keys;
+
+    KlvCounter           state_cycles[NUM_STATES];
+    KlvCounter           state_entries[NUM_STATES];
+};
+
+/**
+ * @brief Charges the cycles between state changes to the state the parser was
+ *        in. Used through the KLV_STATE_TIMER() macros, which expand to nothing
+ *        unless KLV_ENABLE_STATE_TIMING is defined.
+ */
+class KlvStateTimer {
+
+public:
+    KlvStateTimer(KlvParserStats& stats, int state)
+        : stats(stats), state(state), start(KlvParserStats::cycles()) {}
+
+    ~KlvStateTimer() {
+        stats.addStateCycles(state, KlvParserStats::cycles() - start);
+    }
+
+    void update(int state) {
+        if(state == this->state)
+            return;
+        uint64_t now = KlvParserStats::cycles();
+        stats.addStateCycles(this->state, now - start);
+        stats.countStateEntry(state);
+        this->state = state;
+        start = now;
+    }
+
+private:
+    KlvParserStats&      stats;
+    int                  state;           /// state being timed
+    uint64_t             start;           /// cycles when it was entered
+};
+
+#ifdef KLV_ENABLE_STATE_TIMING
+#define KLV_STATE_TIMER(stats, state) KlvStateTimer klv_state_timer(stats, state)
+#define KLV_STATE_TIMER_UPDATE(state) klv_state_timer.update(state)
+#else
+#define KLV_STATE_TIMER(stats, state) do { } while(0)
+#define KLV_STATE_TIMER_UPDATE(state) do { } while(0)
+#endif
+
+#endif /* KlvParserStats_hpp */
@@ -0,0 +1,35 @@
+//
+//  KlvScan.hpp
+//  libklv
+//
+
+#ifndef KlvScan_hpp
+#define KlvScan_hpp
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * @brief Fast search for the SMPTE universal label header (06 0E 2B 34).
+ *
+ * Used to resynchronize on the next 16-byte universal key after garbage or
+ * packet loss. findUlHeader() picks the fastest implementation the CPU supports
+ * at run time: AVX2 or SSE2 on x86, and memchr() based scalar code elsewhere.
+ * All implementations return the same result.
+ */
+class KlvScan {
+
+public:
+    static size_t findUlHeader(const uint8_t* data, size_t size);
+
+    static size_t findUlHeaderScalar(const uint8_t* data, size_t size);
+    static size_t findUlHeaderSse2(const uint8_t* data, size_t size);
+    static size_t findUlHeaderAvx2(const uint8_t* data, size_t size);
+
+    static bool hasSse2();
+    static bool hasAvx2();
+
+    static size_t ulHeaderPrefixSuffix(const uint8_t* data, size_t size);
+};
+
+#endif /* KlvScan_hpp */
@@ -0,0 +1,125 @@
+//
+//  KlvSpscRing.hpp
+//  libklv
+//
+
+#ifndef KlvSpscRing_hpp
+#define KlvSpscRing_hpp
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+/**
+ * @brief Bounded lock-free queue between exactly one producer thread and one
+ *        consumer thread.
+ *
+ * The producer only writes head and the consumer only writes tail, and each
+ * index sits on its own cache line along with the side's cached copy of the
+ * other index. A side only reads the other side's line when its cached copy
+ * says the ring is full (or empty), so a busy queue costs about one cache
+ * line transfer per batch rather than per item.
+ *
+ * Neither side ever waits; tryPush() and tryPop() return at once and the
+ * caller decides whether to spin, yield, or do something else.
+ *
+ * The indices are kept apart with alignas(64), which plain new does not
+ * honour before C++17; allocate queues that live on the heap with
+ * posix_memalign() and placement new rather than with new.
+ *
+ * @tparam T item type, copied in and out of the ring
+ */
+template<typename T>
+class KlvSpscRing {
+
+public:
+    /**
+     * @param capacity number of items, rounded up to a power of two
+     */
+    explicit KlvSpscRing(size_t capacity) : head(0), cached_tail(0), tail(0), cached_head(0) {
+        size_t n = 1;
+        while(n < capacity)
+            n <<= 1;
+        this->slots.resize(n);
+        this->mask = n - 1;
+    }
+
+    size_t capacity() const { return this->slots.size(); }
+
+    /**
+     * @brief Number of items in the ring. Exact on either side when the other
+     *        side is idle, a snapshot otherwise.
+     */
+    size_t size() const {
+        // tail first: it never passes head, so a head read after it is never behind
+        size_t t = this->tail.load(std::memory_order_acquire);
+        size_t h = this->head.load(std::memory_order_acquire);
+        return h - t;
+    }
+
+    bool empty() const { return size() == 0; }
+
+    /**
+     * @brief Appends an item. Producer only.
+     *
+     * @param  item item to append
+     * @return      false if the ring is full
+     */
+    bool tryPush(const T& item) {
+        size_t h = this->head.load(std::memory_order_relaxed);
+        if(h - this->cached_tail == this->slots.size()) {
+            this->cached_tail = this->tail.load(std::memory_order_acquire);
+            if(h - this->cached_tail == this->slots.size())
+                return false;
+        }
+        this->slots[h & this->mask] = item;
+        this->head.store(h + 1, std::memory_order_release);
+        return true;
+    }
+
+    /**
+     * @brief Takes the oldest item. Consumer only.
+     *
+     * @param  item receives the item
+     * @return      false if the ring is empty
+     */
+    bool tryPop(T& item) {
+        return tryPop(&item, 1) == 1;
+    }
+
+    /**
+     * @brief Takes up to max of the oldest items in one go, releasing their
+     *        slots to the producer with a single store. Consumer only.
+     *
+     * @param  items receives the items, in order
+     * @param  max   size of items
+     * @return       number of items taken
+     */
+    size_t tryPop(T* items, size_t max) {
+        size_t t = this->tail.load(std::memory_order_relaxed);
+        if(this->cached_head - t < max)
+            this->cached_head = this->head.load(std::memory_order_acquire);
+
+        size_t n = this->cached_head - t;
+        if(n > max)
+            n = max;
+        for(size_t i = 0; i < n; i++)
+            items[i] = this->slots[(t + i) & this->mask];
+        if(n > 0)
+            this->tail.store(t + n, std::memory_order_release);
+        return n;
+    }
+
+private:
+    KlvSpscRing(const KlvSpscRing&);        // not copyable
+    KlvSpscRing& operator=(const KlvSpscRing&);
+
+    alignas(64) std::atomic<size_t> head; /// items pushed, written by the producer
+    size_t               cached_tail;     /// producer's copy of tail
+    alignas(64) std::atomic<size_t> tail; /// items popped, written by the consumer
+    size_t               cached_head;     /// consumer's copy of head
+    alignas(64) std::vector<T> slots;     /// the items, a power of two of them
+    size_t               mask;            /// slots.size() - 1
+};
+
+#endif /* KlvSpscRing_hpp */
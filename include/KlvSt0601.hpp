@@ -0,0 +1,306 @@
+//
+//  KlvSt0601.hpp
+//  libklv
+//
+
+#ifndef KlvSt0601_hpp
+#define KlvSt0601_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <limits>
+#include "Klv.h"
+#include "KlvFlatTree.hpp"
+#include "KlvTree.hpp"
+#include "KlvView.hpp"
+
+/**
+ * @brief Typed decoding of ST 0601 (UAS Datalink Local Set) items.
+ *
+ * Every supported tag is a traits type (St0601::SensorLatitude, ...) generated
+ * from the KLV_ST0601_TAGS table below. The traits carry the tag number, the
+ * value length, how the integer is mapped to engineering units, and the units
+ * themselves, all as compile-time constants, so the decode of one item is a
+ * fixed-size big endian load and one multiply-add:
+ *
+ *     double lat = St0601::get<St0601::SensorLatitude>(packet);
+ *
+ * get() works on a parsed KLV, a KlvView, a KlvTree, or a KlvFlatTree, never
+ * allocates, and returns T::none() (NaN for mapped values) if the item is
+ * missing, has the wrong length, or holds the ST 0601 "out of range" value.
+ *
+ * To decode every known tag of a packet at once, use St0601::decode(), which
+ * walks the local set once and fills a St0601::Values struct.
+ *
+ * References:
+ *   ST 0601.8          -   UAS Datalink Local Metadata Set
+ */
+namespace St0601 {
+
+/**
+ * @brief How the stored integer maps to the item's value.
+ */
+enum Mapping {
+    MAPPING_RAW,        /// unsigned integer as is
+    MAPPING_UNSIGNED,   /// min + raw * (max - min) / (2^(8*len) - 1)
+    MAPPING_SIGNED      /// raw * (max - min) / (2^(8*len) - 2), -2^(8*len-1) is "out of range"
+};
+
+/**
+ * @brief Table of supported tags. Each row is
+ *        X(traits type, Values field, tag, length, mapping, min, max, units).
+ *
+ *        min and max are ignored for MAPPING_RAW.
+ */
+#define KLV_ST0601_TAGS(X) \
+    X(PrecisionTimeStamp,          precision_time_stamp,           2, 8, MAPPING_RAW,      0.0,       0.0,       "us")   \
+    X(PlatformHeadingAngle,        platform_heading_angle,         5, 2, MAPPING_UNSIGNED, 0.0,       360.0,     "deg")  \
+    X(PlatformPitchAngle,          platform_pitch_angle,           6, 2, MAPPING_SIGNED,   -20.0,     20.0,      "deg")  \
+    X(PlatformRollAngle,           platform_roll_angle,            7, 2, MAPPING_SIGNED,   -50.0,     50.0,      "deg")  \
+    X(PlatformTrueAirspeed,        platform_true_airspeed,         8, 1, MAPPING_UNSIGNED, 0.0,       255.0,     "m/s")  \
+    X(PlatformIndicatedAirspeed,   platform_indicated_airspeed,    9, 1, MAPPING_UNSIGNED, 0.0,       255.0,     "m/s")  \
+    X(SensorLatitude,              sensor_latitude,               13, 4, MAPPING_SIGNED,   -90.0,     90.0,      "deg")  \
+    X(SensorLongitude,             sensor_longitude,              14, 4, MAPPING_SIGNED,   -180.0,    180.0,     "deg")  \
+    X(SensorTrueAltitude,          sensor_true_altitude,          15, 2, MAPPING_UNSIGNED, -900.0,    19000.0,   "m")    \
+    X(SensorHorizontalFov,         sensor_horizontal_fov,         16, 2, MAPPING_UNSIGNED, 0.0,       180.0,     "deg")  \
+    X(SensorVerticalFov,           sensor_vertical_fov,           17, 2, MAPPING_UNSIGNED, 0.0,       180.0,     "deg")  \
+    X(SensorRelativeAzimuthAngle,  sensor_relative_azimuth_angle, 18, 4, MAPPING_UNSIGNED, 0.0,       360.0,     "deg")  \
+    X(SensorRelativeElevationAngle,sensor_relative_elevation_angle,19,4, MAPPING_SIGNED,   -180.0,    180.0,     "deg")  \
+    X(SensorRelativeRollAngle,     sensor_relative_roll_angle,    20, 4, MAPPING_UNSIGNED, 0.0,       360.0,     "deg")  \
+    X(SlantRange,                  slant_range,                   21, 4, MAPPING_UNSIGNED, 0.0,       5000000.0, "m")    \
+    X(TargetWidth,                 target_width,                  22, 2, MAPPING_UNSIGNED, 0.0,       10000.0,   "m")    \
+    X(FrameCenterLatitude,         frame_center_latitude,         23, 4, MAPPING_SIGNED,   -90.0,     90.0,      "deg")  \
+    X(FrameCenterLongitude,        frame_center_longitude,        24, 4, MAPPING_SIGNED,   -180.0,    180.0,     "deg")  \
+    X(FrameCenterElevation,        frame_center_elevation,        25, 2, MAPPING_UNSIGNED, -900.0,    19000.0,   "m")    \
+    X(OffsetCornerLatitudePoint1,  offset_corner_latitude_point_1, 26, 2, MAPPING_SIGNED,  -0.075,    0.075,     "deg")  \
+    X(OffsetCornerLongitudePoint1, offset_corner_longitude_point_1,27, 2, MAPPING_SIGNED,  -0.075,    0.075,     "deg")  \
+    X(OffsetCornerLatitudePoint2,  offset_corner_latitude_point_2, 28, 2, MAPPING_SIGNED,  -0.075,    0.075,     "deg")  \
+    X(OffsetCornerLongitudePoint2, offset_corner_longitude_point_2,29, 2, MAPPING_SIGNED,  -0.075,    0.075,     "deg")  \
+    X(OffsetCornerLatitudePoint3,  offset_corner_latitude_point_3, 30, 2, MAPPING_SIGNED,  -0.075,    0.075,     "deg")  \
+    X(OffsetCornerLongitudePoint3, offset_corner_longitude_point_3,31, 2, MAPPING_SIGNED,  -0.075,    0.075,     "deg")  \
+    X(OffsetCornerLatitudePoint4,  offset_corner_latitude_point_4, 32, 2, MAPPING_SIGNED,  -0.075,    0.075,     "deg")  \
+    X(OffsetCornerLongitudePoint4, offset_corner_longitude_point_4,33, 2, MAPPING_SIGNED,  -0.075,    0.075,     "deg")  \
+    X(TargetLocationLatitude,      target_location_latitude,      40, 4, MAPPING_SIGNED,   -90.0,     90.0,      "deg")  \
+    X(TargetLocationLongitude,     target_location_longitude,     41, 4, MAPPING_SIGNED,   -180.0,    180.0,     "deg")  \
+    X(TargetLocationElevation,     target_location_elevation,     42, 2, MAPPING_UNSIGNED, -900.0,    19000.0,   "m")    \
+    X(PlatformGroundSpeed,         platform_ground_speed,         56, 1, MAPPING_UNSIGNED, 0.0,       255.0,     "m/s")  \
+    X(GroundRange,                 ground_range,                  57, 4, MAPPING_UNSIGNED, 0.0,       5000000.0, "m")    \
+    X(UasLdsVersionNumber,         uas_lds_version_number,        65, 1, MAPPING_RAW,      0.0,       0.0,       "")
+
+/**
+ * @brief Position of each tag in the table, used as its bit in Values::present.
+ */
+enum Field {
+#define KLV_ST0601_FIELD(type, field, tag, len, mapping, min, max, units) FIELD_##field,
+    KLV_ST0601_TAGS(KLV_ST0601_FIELD)
+#undef KLV_ST0601_FIELD
+    NUM_FIELDS
+};
+
+static_assert(NUM_FIELDS <= 64, "Values::present has one bit per field");
+
+/**
+ * @brief Reads an N byte big endian unsigned integer. N is a compile-time
+ *        constant, so this unrolls into N loads and shifts.
+ */
+template<size_t N>
+inline uint64_t readUnsigned(const uint8_t* data) {
+    return (readUnsigned<N - 1>(data) << 8) | data[N - 1];
+}
+
+template<>
+inline uint64_t readUnsigned<0>(const uint8_t*) {
+    return 0;
+}
+
+/**
+ * @brief Decoding of one (length, mapping) combination.
+ */
+template<size_t N, Mapping M>
+struct Decoder;
+
+template<size_t N>
+struct Decoder<N, MAPPING_RAW> {
+    typedef uint64_t value_type;
+
+    static value_type none() { return 0; }
+    static value_type decode(const uint8_t* data, double, double) {
+        return readUnsigned<N>(data);
+    }
+};
+
+template<size_t N>
+struct Decoder<N, MAPPING_UNSIGNED> {
+    typedef double value_type;
+    static_assert(N >= 1 && N <= 4, "mapped items are 1 to 4 bytes");
+
+    static value_type none() { return std::numeric_limits<double>::quiet_NaN(); }
+    static value_type decode(const uint8_t* data, double min, double max) {
+        return min + (double) readUnsigned<N>(data) * ((max - min) / (double) ((1ull << (8 * N)) - 1));
+    }
+};
+
+template<size_t N>
+struct Decoder<N, MAPPING_SIGNED> {
+    typedef double value_type;
+    static_assert(N >= 1 && N <= 4, "mapped items are 1 to 4 bytes");
+
+    static value_type none() { return std::numeric_limits<double>::quiet_NaN(); }
+    static value_type decode(const uint8_t* data, double min, double max) {
+        // sign extend by moving the value to the top of an int64_t and shifting back
+        int64_t raw = (int64_t) (readUnsigned<N>(data) << (64 - 8 * N)) >> (64 - 8 * N);
+        if(raw == -(int64_t) (1ull << (8 * N - 1)))
+            return none();
+        return (double) raw * ((max - min) / (double) ((1ull << (8 * N)) - 2));
+    }
+};
+
+/**
+ * Traits type of each tag:
+ *   TAG, LENGTH, MAPPING   tag number, value length in bytes, and mapping
+ *   value_type             uint64_t for raw items, double for mapped ones
+ *   min(), max(), units()  range and units of the mapped value
+ *   none()                 value returned for a missing or invalid item
+ *   decode(data)           value of LENGTH bytes at data
+ */
+#define KLV_ST0601_TRAITS(type, field, tag, len, mapping, min_value, max_value, unit) \
+    struct type { \
+        typedef Decoder<len, mapping> decoder; \
+        typedef decoder::value_type value_type; \
+        static const uint8_t TAG = tag; \
+        static const size_t LENGTH = len; \
+        static const Mapping MAPPING = mapping; \
+        static const Field FIELD = FIELD_##field; \
+        static constexpr double min() { return min_value; } \
+        static constexpr double max() { return max_value; } \
+        static const char* units() { return unit; } \
+        static value_type none() { return decoder::none(); } \
+        static value_type decode(const uint8_t* data) { return decoder::decode(data, min_value, max_value); } \
+    };
+KLV_ST0601_TAGS(KLV_ST0601_TRAITS)
+#undef KLV_ST0601_TRAITS
+
+/**
+ * @brief Decodes the value field of one item.
+ *
+ * @param  data  value field
+ * @param  size  size of the value field
+ * @param  value set to the decoded value if the item is valid
+ * @return       true if the size matches and the value is not "out of range"
+ */
+template<typename T>
+inline bool decodeValue(const uint8_t* data, size_t size, typename T::value_type& value) {
+    if(size != T::LENGTH)
+        return false;
+    value = T::decode(data);
+    return value == value;  // false for NaN
+}
+
+/**
+ * @brief True if a local set key is the tag T. The supported tags are all below
+ *        128, so their BER-OID key is the single byte T::TAG.
+ */
+template<typename T>
+inline bool isTag(const uint8_t* key, size_t key_size) {
+    return key_size == 1 && key[0] == T::TAG;
+}
+
+/**
+ * @brief Decodes the item T of an ST 0601 packet. If the tag appears more than
+ *        once, the last item wins, as with KLV::indexToMap().
+ *
+ * @param  packet top level KLV (the local set) or its tree
+ * @param  value  set to the decoded value if the packet has a valid item T
+ * @return        true if value was set
+ */
+template<typename T>
+inline bool get(const KLV& packet, typename T::value_type& value) {
+    const KLV* found = NULL;
+    for(const KLV* item = packet.getChild(); item != NULL; item = item->getNext()) {
+        if(isTag<T>(item->getKey().data(), item->getKey().size()))
+            found = item;
+    }
+    return found != NULL && decodeValue<T>(found->getValue().data(), found->getValue().size(), value);
+}
+
+template<typename T>
+inline bool get(const KlvView& packet, typename T::value_type& value) {
+    const KlvView* found = NULL;
+    for(const KlvView* item = packet.getChild(); item != NULL; item = item->getNext()) {
+        if(isTag<T>(item->getKey().data, item->getKey().size))
+            found = item;
+    }
+    return found != NULL && decodeValue<T>(found->getValue().data, found->getValue().size, value);
+}
+
+template<typename T>
+inline bool get(const KlvTree& packet, typename T::value_type& value) {
+    const KlvView* item = packet.find(T::TAG);
+    return item != NULL && decodeValue<T>(item->getValue().data, item->getValue().size, value);
+}
+
+template<typename T>
+inline bool get(const KlvFlatTree& packet, typename T::value_type& value) {
+    uint32_t index = packet.find(T::TAG);
+    if(index == KlvFlatTree::NONE)
+        return false;
+    KlvSpan item = packet.getValue(packet[index]);
+    return decodeValue<T>(item.data, item.size, value);
+}
+
+/**
+ * @brief Decodes the item T of an ST 0601 packet.
+ *
+ * @param  packet top level KLV (the local set) or its tree
+ * @return        the decoded value, T::none() if the packet has no valid item T
+ */
+template<typename T, typename Packet>
+inline typename T::value_type get(const Packet& packet) {
+    typename T::value_type value;
+    if(!get<T>(packet, value))
+        return T::none();
+    return value;
+}
+
+/**
+ * @brief Run-time description of one supported tag, for code that picks tags at
+ *        run time (see St0601::Batch). Same contents as the traits types.
+ */
+struct TagInfo {
+    uint8_t              tag;             /// tag number
+    size_t               length;          /// value length in bytes
+    Mapping              mapping;         /// how the integer maps to the value
+    double               min;             /// value of the smallest integer (mapped items)
+    double               max;             /// value of the largest integer (mapped items)
+    const char*          units;           /// units of the value
+    Field                field;           /// position in the table
+};
+
+const TagInfo* findTag(uint64_t tag);
+
+/**
+ * @brief Every supported item of one packet, filled by decode(). Fields of
+ *        items the packet did not have (or had with a bad length or an "out of
+ *        range" value) hold their type's none().
+ */
+struct Values {
+#define KLV_ST0601_VALUE(type, field, tag, len, mapping, min, max, units) type::value_type field;
+    KLV_ST0601_TAGS(KLV_ST0601_VALUE)
+#undef KLV_ST0601_VALUE
+    uint64_t             present;         /// bit (1 << T::FIELD) set for each valid item
+
+    Values() { clear(); }
+    void clear();
+
+    template<typename T>
+    bool has() const { return (this->present & (1ull << T::FIELD)) != 0; }
+};
+
+void decode(const KLV& packet, Values& values);
+void decode(const KlvView& packet, Values& values);
+void decode(const KlvTree& packet, Values& values);
+void decode(const KlvFlatTree& packet, Values& values);
+
+} // namespace St0601
+
+#endif /* KlvSt0601_hpp */
@@ -0,0 +1,99 @@
+//
+//  KlvSt0601Batch.hpp
+//  libklv
+//
+
+#ifndef KlvSt0601Batch_hpp
+#define KlvSt0601Batch_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "KlvParser.hpp"
+#include "KlvSt0601.hpp"
+
+namespace St0601 {
+
+/**
+ * @brief Columnar decode of a few ST 0601 tags from many packets.
+ *
+ * A batch is created for a fixed list of tags, and every packet added to it
+ * becomes one row. Each tag gets a column of contiguous arrays indexed by
+ * row:
+ *
+ *     raw integers    getRaw(tag)       the stored value, sign extended (0 if absent)
+ *     mapped values   getValues(tag)    engineering units, NaN if absent
+ *     presence        getPresence(tag)  bit (row % 64) of word (row / 64)
+ *
+ * so numeric code can take the arrays as they are. A row's item is absent if
+ * the packet does not have it, has it with the wrong length, or holds the
+ * "out of range" value. As with St0601::decode(), the last item of a tag wins.
+ *
+ * add() only gathers the integers, which is one pass over each packet's items
+ * with a table lookup per tag. The integer to double mapping runs when a value
+ * column is first read, over all rows added since, with the fastest kernel the
+ * CPU supports: AVX2 or SSE2 on x86, and a scalar loop elsewhere. All kernels
+ * give the same doubles as St0601::get().
+ *
+ * clear() drops the rows but keeps the memory, so a batch reused for the next
+ * block of packets stops allocating once it has seen the largest one.
+ */
+class Batch {
+
+public:
+    explicit Batch(const std::vector<uint64_t>& tags);
+
+    void reserve(size_t num_rows);
+    void clear();
+
+    void add(const KLV& packet);
+    void add(const KlvView& packet);
+    void add(const KlvTree& packet);
+    void add(const KlvFlatTree& packet);
+    void add(const std::vector<KLV*>& packets);
+    size_t add(KlvParser& parser, const uint8_t* data, size_t size);
+
+    size_t size() const { return this->num_rows; }
+    const std::vector<uint64_t>& getTags() const { return this->tags; }
+
+    const uint64_t* getRaw(uint64_t tag) const;
+    const double* getValues(uint64_t tag);
+    const uint64_t* getPresence(uint64_t tag) const;
+    bool isPresent(uint64_t tag, size_t row) const;
+
+    static void map(const uint64_t* raw, size_t n, double scale, double offset, double* out);
+    static void mapScalar(const uint64_t* raw, size_t n, double scale, double offset, double* out);
+    static void mapSse2(const uint64_t* raw, size_t n, double scale, double offset, double* out);
+    static void mapAvx2(const uint64_t* raw, size_t n, double scale, double offset, double* out);
+
+private:
+    Batch(const Batch&);                    // not copyable
+    Batch& operator=(const Batch&);
+
+    static const uint8_t NO_COLUMN = 0xFF;
+
+    struct Column {
+        const TagInfo*       info;            /// tag of the column
+        double               scale;           /// value = raw * scale + offset
+        double               offset;
+        std::vector<uint64_t> raw;            /// stored integer per row
+        std::vector<double>  values;          /// mapped value per row, valid below num_mapped
+        std::vector<uint64_t> presence;       /// one bit per row
+        size_t               num_mapped;      /// number of rows in values
+    };
+
+    void beginRow();
+    void addItem(const uint8_t* key, size_t key_size, const uint8_t* value, size_t value_size);
+    const Column* findColumn(uint64_t tag) const;
+    Column* findColumn(uint64_t tag);
+
+    std::vector<uint64_t> tags;           /// tags in column order
+    std::vector<Column>  columns;         /// one per tag
+    uint8_t              column_of[KlvTagIndex<uint8_t>::NUM_DIRECT_TAGS]; /// tag to column, NO_COLUMN if not in the batch
+    size_t               num_rows;        /// number of packets added
+    KlvTree              tree;            /// packet being added by add(parser, data, size)
+};
+
+} // namespace St0601
+
+#endif /* KlvSt0601Batch_hpp */
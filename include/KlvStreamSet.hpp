@@ -0,0 +1,109 @@
+//
+//  KlvStreamSet.hpp
+//  libklv
+//
+
+#ifndef KlvStreamSet_hpp
+#define KlvStreamSet_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <unordered_map>
+#include <vector>
+#include "Klv.h"
+#include "KlvParser.hpp"
+
+/**
+ * @brief Parses many concurrent KLV streams (e.g. one per UAS feed) on a fixed
+ *        pool of worker threads.
+ *
+ * Every stream has its own KlvParser and is tied to one worker when it is
+ * added, so its bytes are always parsed in the order they were submitted, by
+ * the same thread, and a packet split across submissions is put back
+ * together as with KlvParser::parse(). Streams are spread over the workers
+ * in the order they are added.
+ *
+ * Bytes are copied into a KlvByteRing per worker by submit(), which one
+ * thread (the reader) calls with the bytes of any stream, in any order, so
+ * no lock is taken while data flows. A worker with nothing to do sleeps until
+ * the reader next hands it bytes.
+ *
+ * Parsed packets go to the stream's handler, which is called on its worker
+ * thread, or, for streams added without a handler, to an output queue per
+ * worker that one consumer thread drains with poll(). Packets of one stream
+ * come out in stream order either way.
+ *
+ *     KlvStreamSet streams({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+ *     streams.addStream(7);
+ *     streams.submit(7, data, size);
+ *     KlvStreamSet::Output out;
+ *     while(streams.poll(out))
+ *         handle(out.stream_id, out.klv);
+ */
+class KlvStreamSet {
+
+public:
+    typedef uint32_t StreamId;
+
+    /**
+     * Called on a worker thread with each packet of a stream. Ownership of the
+     * KLV is transfered to the handler. Must not throw.
+     */
+    typedef std::function<void(StreamId, KLV*)> Handler;
+
+    /**
+     * A packet taken off the output queue by poll()
+     */
+    struct Output {
+        StreamId         stream_id;       /// stream the packet came from
+        KLV*             klv;             /// the packet, owned by the caller
+    };
+
+    static const size_t DEFAULT_RING_SIZE = 1 << 20;
+    static const size_t DEFAULT_QUEUE_SIZE = 1 << 12;
+
+    KlvStreamSet(std::vector<KlvParser::KeyEncoding> key_encodings, size_t num_workers = 0,
+                 size_t ring_size = DEFAULT_RING_SIZE, size_t queue_size = DEFAULT_QUEUE_SIZE);
+    ~KlvStreamSet();
+
+    void setLazyNesting(bool lazy) { this->lazy_nesting = lazy; }
+    void setChecksumMode(KlvParser::ChecksumMode mode) { this->checksum_mode = mode; }
+    void setLimits(const KlvParser::Limits& limits);
+
+    void addStream(StreamId id, const Handler& handler = Handler());
+    void removeStream(StreamId id);
+    bool hasStream(StreamId id) const { return this->streams.count(id) != 0; }
+    size_t getNumStreams() const { return this->streams.size(); }
+    size_t getNumWorkers() const { return this->workers.size(); }
+
+    void submit(StreamId id, const uint8_t* data, size_t size);
+    bool trySubmit(StreamId id, const uint8_t* data, size_t size);
+    void flush();
+
+    bool poll(Output& out);
+
+private:
+    KlvStreamSet(const KlvStreamSet&);      // not copyable
+    KlvStreamSet& operator=(const KlvStreamSet&);
+
+    struct Stream;
+    struct Worker;
+
+    Stream* findStream(StreamId id) const;
+    void stopWorkers();
+    void run(Worker& worker);
+    void deliver(Worker& worker, Stream& stream, KLV* klv);
+
+    std::vector<KlvParser::KeyEncoding> key_encodings; /// encodings passed on to each KlvParser
+    bool                 lazy_nesting;    /// passed on to parsers of streams added later
+    KlvParser::ChecksumMode checksum_mode; /// passed on to parsers of streams added later
+    KlvParser::Limits    limits;          /// passed on to parsers of streams added later
+
+    std::vector<Worker*> workers;         /// the pool
+    std::unordered_map<StreamId, Stream*> streams; /// streams by id, used by the reader only
+    size_t               next_worker;     /// worker the next stream is tied to
+    size_t               next_poll;       /// output queue poll() looks at first
+};
+
+#endif /* KlvStreamSet_hpp */
@@ -0,0 +1,74 @@
+//
+//  KlvTagIndex.hpp
+//  libklv
+//
+
+#ifndef KlvTagIndex_hpp
+#define KlvTagIndex_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+/**
+ * @brief Tag to node lookup table for the items of a local data set.
+ *
+ * Local set tags are BER-OID encoded and nearly always fit in one byte, so tags
+ * 0 to 127 go straight into a direct-mapped array. Larger tags fall back to a
+ * small vector that is searched linearly. Lookups return whatever reference type
+ * the owner stores (a node index or a view pointer), never a copy of the KLV.
+ *
+ * If a tag appears more than once the last item wins, as with KLV::indexToMap().
+ *
+ * @tparam Ref reference to a node, e.g. uint32_t or const KlvView*
+ */
+template<typename Ref>
+class KlvTagIndex {
+
+public:
+    static const size_t NUM_DIRECT_TAGS = 128;
+
+    explicit KlvTagIndex(Ref none) : none(none) {
+        clear();
+    }
+
+    void clear() {
+        for(size_t i = 0; i < NUM_DIRECT_TAGS; i++)
+            direct[i] = none;
+        overflow.clear();
+    }
+
+    void insert(uint64_t tag, Ref ref) {
+        if(tag < NUM_DIRECT_TAGS) {
+            direct[tag] = ref;
+            return;
+        }
+        for(size_t i = 0; i < overflow.size(); i++) {
+            if(overflow[i].first == tag) {
+                overflow[i].second = ref;
+                return;
+            }
+        }
+        overflow.push_back(std::make_pair(tag, ref));
+    }
+
+    Ref find(uint64_t tag) const {
+        if(tag < NUM_DIRECT_TAGS)
+            return direct[tag];
+        for(size_t i = 0; i < overflow.size(); i++) {
+            if(overflow[i].first == tag)
+                return overflow[i].second;
+        }
+        return none;
+    }
+
+    bool contains(uint64_t tag) const { return find(tag) != none; }
+
+private:
+    Ref                  direct[NUM_DIRECT_TAGS]; /// tags 0 to 127
+    std::vector<std::pair<uint64_t, Ref> > overflow; /// larger tags
+    Ref                  none;            /// value returned for a missing tag
+};
+
+#endif /* KlvTagIndex_hpp */
@@ -0,0 +1,57 @@
+//
+//  KlvTrace.hpp
+//  libklv
+//
+
+#ifndef KlvTrace_hpp
+#define KlvTrace_hpp
+
+/**
+ * Trace levels, from least to most verbose
+ */
+enum KlvTraceLevel {
+    KLV_TRACE_NONE,     /// nothing is traced
+    KLV_TRACE_ERROR,    /// malformed input
+    KLV_TRACE_INFO,     /// completed KLVs
+    KLV_TRACE_DEBUG,    /// parser state transitions
+    KLV_TRACE_BYTE      /// every byte handed to the parser
+};
+
+/**
+ * @brief Tracing for the parser internals.
+ *
+ * Trace statements are written with the KLV_TRACE() macro. Unless the library is
+ * built with KLV_ENABLE_TRACE defined (cmake -Dtrace=ON), the macro expands to
+ * nothing and its arguments are never evaluated, so release builds pay nothing.
+ *
+ * When compiled in, a message is only formatted if its level is at or below the
+ * run-time level set with setLevel(). It is then handed to the callback set with
+ * setCallback(), or to log4cpp (category "klv") if the library was built against
+ * it, or written to stderr otherwise.
+ */
+class KlvTrace {
+
+public:
+    typedef void (*Callback)(KlvTraceLevel level, const char* message, void* user_data);
+
+    static void setLevel(KlvTraceLevel level);
+    static KlvTraceLevel getLevel();
+    static bool isEnabled(KlvTraceLevel level);
+
+    static void setCallback(Callback callback, void* user_data);
+
+    static void write(KlvTraceLevel level, const char* format, ...)
+#if defined(__GNUC__)
+        __attribute__((format(printf, 2, 3)))
+#endif
+        ;
+};
+
+#ifdef KLV_ENABLE_TRACE
+#define KLV_TRACE(level, ...) \
+    do { if(KlvTrace::isEnabled(level)) KlvTrace::write(level, __VA_ARGS__); } while(0)
+#else
+#define KLV_TRACE(level, ...) do { } while(0)
+#endif
+
+#endif /* KlvTrace_hpp */
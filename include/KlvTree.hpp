@@ -0,0 +1,62 @@
+//
+//  KlvTree.hpp
+//  libklv
+//
+
+#ifndef KlvTree_hpp
+#define KlvTree_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include "KlvArena.hpp"
+#include "KlvTagIndex.hpp"
+#include "KlvView.hpp"
+
+/**
+ * @brief Owning handle for one parsed KLV and all of its nested KLVs.
+ *
+ * Every node of the tree is a KlvView allocated from the tree's arena. If the
+ * tree was filled with copy_values set (see KlvParser::parseTree()), the bytes
+ * the views point to live in the same arena, so the tree is self-contained.
+ * Otherwise they point into the parsed buffer.
+ *
+ * The whole tree is released in one operation when the handle is destroyed, or
+ * recycled with clear() so the next packet reuses the same memory.
+ */
+class KlvTree {
+
+public:
+    explicit KlvTree(size_t block_size = 4096) : arena(block_size), root(NULL), index(NULL) {}
+
+    const KlvView* getRoot() const { return this->root; }
+    bool empty() const { return this->root == NULL; }
+
+    /**
+     * @brief Looks up an item of the top level local set by tag in constant time.
+     *        The index is built while the packet is parsed.
+     *
+     * @param  tag tag of a child of the root
+     * @return     view of the item, NULL if the packet has no such item
+     */
+    const KlvView* find(uint64_t tag) const { return this->index.find(tag); }
+
+    void clear() {
+        this->root = NULL;
+        this->index.clear();
+        this->arena.reset();
+    }
+
+    const KlvArena& getArena() const { return this->arena; }
+
+private:
+    KlvTree(const KlvTree&);                // not copyable
+    KlvTree& operator=(const KlvTree&);
+
+    friend class KlvParser;
+
+    KlvArena             arena;           /// storage for the nodes (and optionally the bytes)
+    const KlvView*       root;            /// top level KLV, NULL if empty
+    KlvTagIndex<const KlvView*> index;    /// tags of the root's children to views
+};
+
+#endif /* KlvTree_hpp */
@@ -0,0 +1,105 @@
+//
+//  KlvTsDemuxer.hpp
+//  libklv
+//
+
+#ifndef KlvTsDemuxer_hpp
+#define KlvTsDemuxer_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Klv.h"
+#include "KlvParser.hpp"
+
+/**
+ * @brief Pulls the KLV metadata stream out of an MPEG-2 transport stream and
+ *        feeds it to a KlvParser.
+ *
+ * The demuxer follows the PAT to each PMT and picks the first metadata stream it
+ * finds:
+ *  - stream_type 0x15, synchronous metadata carried in metadata access unit
+ *    cells (MISB ST 1402), or
+ *  - stream_type 0x06 with a "KLVA" registration descriptor, asynchronous KLV
+ *    carried directly in the PES payload.
+ * setKlvPid() skips the search for streams that do not describe themselves.
+ *
+ * The KLV bytes in each TS payload are handed to the parser in place; the
+ * parser already carries a KLV across calls, so PES packets are never
+ * reassembled into a separate buffer. Only a TS packet cut in two by the end of
+ * a push() call, a PES header, or a cell header split over TS packets is
+ * copied. Sync bytes are checked for every packet and, once lost, found again
+ * by looking for two 0x47 bytes 188 bytes apart.
+ *
+ * PSI sections are expected to fit in one TS packet, as PATs and PMTs
+ * carrying a handful of streams do; section CRCs are not checked.
+ *
+ * References:
+ *   ISO/IEC 13818-1    -   MPEG-2 Systems
+ *   MISB ST 1402       -   MPEG-2 Transport of Compressed Motion Imagery and Metadata
+ */
+class KlvTsDemuxer {
+
+public:
+    static const size_t TS_PACKET_SIZE = 188;
+    static const uint8_t TS_SYNC_BYTE = 0x47;
+    static const uint16_t NO_PID = 0x1FFF;
+
+    explicit KlvTsDemuxer(KlvParser& parser);
+
+    /**
+     * Demultiplexes a span of transport stream, which may start and end anywhere
+     * within a TS packet.
+     *
+     * @param  data pointer to the transport stream bytes
+     * @param  size number of bytes
+     * @return      the KLVs completed by these bytes, in stream order. Ownership
+     *              of each KLV is transfered to the caller.
+     */
+    std::vector<KLV*> push(const uint8_t* data, size_t size);
+
+    void setKlvPid(uint16_t pid, uint8_t stream_type = 0x06);
+    uint16_t getKlvPid() const { return this->klv_pid; }
+    uint8_t getKlvStreamType() const { return this->klv_stream_type; }
+
+    /**
+     * @return PTS (90 kHz) of the PES packet the last KLV bytes came from, -1 if
+     *         it had none
+     */
+    int64_t getPts() const { return this->pts; }
+
+    unsigned long getNumTsPackets() const { return this->num_ts_packets; }
+    unsigned long getNumSyncLosses() const { return this->num_sync_losses; }
+    unsigned long getNumContinuityErrors() const { return this->num_continuity_errors; }
+
+private:
+    size_t findSync(const uint8_t* data, size_t size) const;
+    void processPacket(const uint8_t* pkt, std::vector<KLV*>& klvs);
+    void parsePat(const uint8_t* payload, size_t size);
+    void parsePmt(const uint8_t* payload, size_t size);
+    void processKlvPayload(const uint8_t* payload, size_t size, bool pusi, std::vector<KLV*>& klvs);
+    void processCells(const uint8_t* data, size_t size, std::vector<KLV*>& klvs);
+    void feed(const uint8_t* data, size_t size, std::vector<KLV*>& klvs);
+
+    KlvParser&           parser;          /// receives the KLV bytes
+    std::vector<uint8_t> partial;         /// start of a TS packet cut off by the end of the last push()
+    bool                 partial_in_sync; /// true if partial started right after a good TS packet
+    bool                 ts_in_sync;      /// true if the last TS packet was processed without losing sync
+    std::vector<uint16_t> pmt_pids;       /// PMT PIDs listed in the PAT
+    uint16_t             klv_pid;         /// PID of the metadata stream, NO_PID until found
+    uint8_t              klv_stream_type; /// stream_type of the metadata stream
+    bool                 klv_pid_fixed;   /// true if set with setKlvPid()
+    int                  last_cc;         /// continuity counter of the last KLV TS packet, -1 if none
+    bool                 in_sync;         /// false after a KLV discontinuity until the next PES starts
+    std::vector<uint8_t> pes_header;      /// PES header bytes collected so far
+    bool                 in_pes_header;   /// true while the PES header is incomplete
+    uint8_t              cell_header[5];  /// metadata AU cell header collected so far
+    size_t               cell_header_size;/// bytes in cell_header
+    size_t               cell_remaining;  /// bytes of the current cell not yet fed to the parser
+    int64_t              pts;             /// PTS of the current PES packet, -1 if none
+    unsigned long        num_ts_packets;  /// TS packets processed
+    unsigned long        num_sync_losses; /// times the sync byte was lost
+    unsigned long        num_continuity_errors; /// KLV TS packets lost
+};
+
+#endif /* KlvTsDemuxer_hpp */
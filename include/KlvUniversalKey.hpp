@@ -0,0 +1,75 @@
+//
+//  KlvUniversalKey.hpp
+//  libklv
+//
+
+#ifndef KlvUniversalKey_hpp
+#define KlvUniversalKey_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <vector>
+#include "Klv.h"
+#include "KlvView.hpp"
+
+/**
+ * @brief 16-byte SMPTE universal key held by value.
+ *
+ * Unlike a std::vector<uint8_t> key this needs no heap allocation, compares as
+ * two 64-bit words and has a 64-bit hash, which makes it a cheap key for hash
+ * maps of universal sets.
+ */
+class KlvUniversalKey {
+
+public:
+    KlvUniversalKey() : words() {}
+    explicit KlvUniversalKey(const uint8_t* bytes) { memcpy(words, bytes, KLV_KEY_SIZE); }
+
+    /**
+     * @brief Constructs a key from a span, which must be KLV_KEY_SIZE bytes long.
+     */
+    explicit KlvUniversalKey(KlvSpan span) { memcpy(words, span.data, KLV_KEY_SIZE); }
+
+    const uint8_t* data() const { return (const uint8_t*) words; }
+    size_t size() const { return KLV_KEY_SIZE; }
+    uint8_t operator[](size_t i) const { return data()[i]; }
+    std::vector<uint8_t> toVector() const { return std::vector<uint8_t>(data(), data() + KLV_KEY_SIZE); }
+
+    bool operator==(const KlvUniversalKey& other) const {
+        return words[0] == other.words[0] && words[1] == other.words[1];
+    }
+    bool operator!=(const KlvUniversalKey& other) const { return !(*this == other); }
+    bool operator<(const KlvUniversalKey& other) const { return memcmp(words, other.words, KLV_KEY_SIZE) < 0; }
+
+    /**
+     * @brief 64-bit hash of the key. Both halves are multiplied by odd constants
+     *        and combined, then put through the murmur3 finalizer so that keys
+     *        differing only in the last few bytes still spread over all bits.
+     */
+    uint64_t hash() const {
+        uint64_t h = words[0] * 0x9E3779B97F4A7C15ull;
+        h ^= (words[1] * 0xC2B2AE3D27D4EB4Full) + (h << 6) + (h >> 2);
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDull;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ull;
+        h ^= h >> 33;
+        return h;
+    }
+
+private:
+    uint64_t             words[2];        /// the 16 key bytes, in stream order
+};
+
+namespace std {
+    template <>
+    struct hash<KlvUniversalKey> {
+        std::size_t operator()(const KlvUniversalKey& k) const {
+            return (std::size_t) k.hash();
+        }
+    };
+}
+
+#endif /* KlvUniversalKey_hpp */
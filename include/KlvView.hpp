@@ -0,0 +1,83 @@
+//
+//  KlvView.hpp
+//  libklv
+//
+
+#ifndef KlvView_hpp
+#define KlvView_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Klv.h"
+
+/**
+ * @brief Non-owning, read-only range of bytes (pointer + length).
+ *
+ * A span never owns the bytes it points to. Whoever hands out a span documents
+ * how long the underlying buffer stays valid.
+ */
+struct KlvSpan {
+    const uint8_t* data;    /// first byte, NULL if empty
+    size_t         size;    /// number of bytes
+
+    KlvSpan() : data(NULL), size(0) {}
+    KlvSpan(const uint8_t* data, size_t size) : data(data), size(size) {}
+
+    const uint8_t* begin() const { return data; }
+    const uint8_t* end() const { return data + size; }
+    bool empty() const { return size == 0; }
+    uint8_t operator[](size_t i) const { return data[i]; }
+
+    std::vector<uint8_t> toVector() const { return std::vector<uint8_t>(begin(), end()); }
+};
+
+/**
+ * @brief Zero-copy counterpart of KLV.
+ *
+ * A KlvView does not copy the key, length, or value fields. Each field is a
+ * KlvSpan into the buffer that was parsed, so the buffer must outlive the view.
+ * Nested KLVs are linked as a tree the same way KLV does it (parent, first child,
+ * previous and next sibling), with the child views themselves pointing into the
+ * value field of their parent.
+ *
+ * Views are handed out by KlvParser::parseViews(). Use toOwned() to turn a view
+ * (and its children) into a KLV that no longer depends on the parsed buffer.
+ */
+class KlvView {
+
+public:
+    KlvView();
+    KlvView(KlvSpan key, KlvSpan len, KlvSpan val, unsigned long decoded_len);
+
+    KlvSpan getKey() const { return this->key; }
+    KlvSpan getLenEncoded() const { return this->len_encoded; }
+    KlvSpan getValue() const { return this->value; }
+    unsigned long getLen() const { return this->len; }
+    unsigned long getBerLen() const { return this->ber_len; }
+
+    const KlvView* getParent() const { return this->parent; }
+    const KlvView* getChild() const { return this->child; }
+    const KlvView* getPrevious() const { return this->previous_sibling; }
+    const KlvView* getNext() const { return this->next_sibling; }
+
+    void setParent(const KlvView* parent) { this->parent = parent; }
+    void setChild(const KlvView* child) { this->child = child; }
+    void setPreviousSibling(const KlvView* previous) { this->previous_sibling = previous; }
+    void setNextSibling(const KlvView* next) { this->next_sibling = next; }
+
+    KLV* toOwned() const;
+
+private:
+    KlvSpan              key;             /// Key (1,2,4, or 16 bytes in length)
+    KlvSpan              len_encoded;     /// Data length (BER) (short & long form)
+    KlvSpan              value;           /// Value (variable-length)
+    unsigned long        len;             /// Data length in human-readable format
+    unsigned long        ber_len;         /// Length of BER len field
+    const KlvView*       parent;          /// parent view, NULL if on top level branch
+    const KlvView*       child;           /// first child in branch, NULL if leaf node
+    const KlvView*       previous_sibling;/// previous view on branch, NULL if none
+    const KlvView*       next_sibling;    /// next view on branch, NULL if none
+};
+
+#endif /* KlvView_hpp */
@@ -0,0 +1,108 @@
+//
+//  KlvVisitor.hpp
+//  libklv
+//
+
+#ifndef KlvVisitor_hpp
+#define KlvVisitor_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Klv.h"
+#include "KlvView.hpp"
+
+/**
+ * @brief Receives the KLVs of a stream as events, see
+ *        KlvParser::parse(const uint8_t*, size_t, KlvVisitor&).
+ *
+ * A KLV whose value is parsed for nested KLVs (a top level packet, or an item
+ * on a level that has a key encoding below it) is a set: it is reported by
+ * onSetBegin(), followed by its items in stream order, and closed by
+ * onSetEnd(). Every other KLV is reported by onItem(). For an ST 0601 parser
+ * (16-byte keys, then BER-OID) a packet comes out as
+ *
+ *     onSetBegin(0, ul, len, value)
+ *     onItem(1, 2, key, len, timestamp)
+ *     ...
+ *     onItem(1, 1, key, len, checksum)
+ *     onSetEnd(0, true)
+ *
+ * The spans point into the buffer passed to the parser, or into the parser's
+ * copy of a packet that was split across calls, and are only valid during the
+ * callback. Nothing is allocated for the events. The default callbacks do
+ * nothing, so a visitor only overrides what it needs.
+ */
+class KlvVisitor {
+
+public:
+    virtual ~KlvVisitor() {}
+
+    /**
+     * A set begins. Its value holds the items that follow.
+     *
+     * @param depth nesting depth, 0 for the top level
+     * @param key   key field
+     * @param len   BER-encoded length field
+     * @param value value field
+     */
+    virtual void onSetBegin(size_t /*depth*/, const KlvSpan& /*key*/, const KlvSpan& /*len*/, const KlvSpan& /*value*/) {}
+
+    /**
+     * An item that is not a set.
+     *
+     * @param depth nesting depth, 0 for the top level
+     * @param tag   key decoded with KlvParser::decodeTag(), 0 for 16-byte keys
+     * @param key   key field
+     * @param len   BER-encoded length field
+     * @param value value field
+     */
+    virtual void onItem(size_t /*depth*/, uint64_t /*tag*/, const KlvSpan& /*key*/, const KlvSpan& /*len*/, const KlvSpan& /*value*/) {}
+
+    /**
+     * The set opened by the last unmatched onSetBegin() ends.
+     *
+     * @param depth nesting depth, the same as for onSetBegin()
+     * @param ok    false if its value, or that of a set nested in it, did
+     *              not frame cleanly into items (a rejected or truncated item
+     *              was skipped), or if it is a
+     *              top level set whose ST 0601 checksum was checked and does
+     *              not match (CHECKSUM_MARK mode)
+     */
+    virtual void onSetEnd(size_t /*depth*/, bool /*ok*/) {}
+};
+
+/**
+ * @brief Visitor that builds KLV trees from the events, the same trees
+ *        KlvParser::parse() returns (without a checksum status, which the
+ *        events do not carry).
+ */
+class KlvBuilder : public KlvVisitor {
+
+public:
+    /**
+     * @param klvs receives each completed top level KLV. Ownership is
+     *             transfered to the owner of klvs.
+     */
+    explicit KlvBuilder(std::vector<KLV*>& klvs) : klvs(klvs) {}
+
+    void onSetBegin(size_t depth, const KlvSpan& key, const KlvSpan& len, const KlvSpan& value);
+    void onItem(size_t depth, uint64_t tag, const KlvSpan& key, const KlvSpan& len, const KlvSpan& value);
+    void onSetEnd(size_t depth, bool ok);
+
+private:
+    void add(KLV* klv);
+
+    /**
+     * A set begun and not ended yet
+     */
+    struct OpenSet {
+        KLV*             klv;             /// the set
+        KLV*             last_child;      /// its last child so far, NULL if none
+    };
+
+    std::vector<KLV*>&   klvs;            /// completed top level KLVs
+    std::vector<OpenSet> open_sets;       /// innermost last
+};
+
+#endif /* KlvVisitor_hpp */
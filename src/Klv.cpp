@@ -1,6 +1,8 @@
 #include "Klv.h"
+#include "KlvEncoder.hpp"
 #include <iostream>
 #include <algorithm>
+#include <stdexcept>
 #include <string>
 
 /**
@@ -10,16 +12,18 @@
  * @param key 16-byte global unique identifier
  * @param val data buffer
  */
-KLV::KLV(const std::vector<uint8_t> key, const std::vector<uint8_t> val) {
+KLV::KLV(const std::vector<uint8_t>& key, const std::vector<uint8_t>& val) {
     this->key = key;
     this->value = val;
-
-    // TODO: calc BER encoded length and store it in lenEncoded field
-
-
-
-    // TODO: figure out BER length
-    // TODO: figure out human-readable len
+    this->len = val.size();
+    this->len_encoded = KlvEncoder::encodeBerLength(this->len);
+    this->ber_len = this->len_encoded.size() - 1;
+    this->parent = NULL;
+    this->child = NULL;
+    this->next_sibling = NULL;
+    this->previous_sibling = NULL;
+    this->checksum_status = KLV_CHECKSUM_UNCHECKED;
+    this->dropped_items = false;
 }
 
 /**
@@ -29,14 +33,30 @@ KLV::KLV(const std::vector<uint8_t> key, const std::vector<uint8_t> val) {
  * @param len BER-encoded length
  * @param val data buffer
  */
-KLV::KLV(const std::vector<uint8_t> key, const std::vector<uint8_t> len, const std::vector<uint8_t> val) {
-    this->key = key;
-    this->len_encoded = len;
-    this->value = val;
+KLV::KLV(const std::vector<uint8_t>& key, const std::vector<uint8_t>& len, const std::vector<uint8_t>& val)
+    : KLV(key.data(), key.size(), len.data(), len.size(), val.data(), val.size()) {
+}
+
+/**
+ * @brief Constructs a KLV object from key, length, and value fields held
+ *        anywhere in memory, e.g. framed in place in a received buffer. The
+ *        fields are copied.
+ *
+ * @param key      key field
+ * @param key_size size of the key field
+ * @param len      BER-encoded length
+ * @param len_size size of the length field
+ * @param val      value field
+ * @param val_size size of the value field
+ */
+KLV::KLV(const uint8_t* key, size_t key_size, const uint8_t* len, size_t len_size, const uint8_t* val, size_t val_size)
+    : key(key, key + key_size), len_encoded(len, len + len_size), value(val, val + val_size) {
     this->parent = NULL;
     this->child = NULL;
     this->next_sibling = NULL;
     this->previous_sibling = NULL;
+    this->checksum_status = KLV_CHECKSUM_UNCHECKED;
+    this->dropped_items = false;
 
     // BER encoding has a short form and long form
     // Most significant bit (bit 7) is the short/long form flag
@@ -64,25 +84,26 @@ KLV::KLV(const std::vector<uint8_t> key, const std::vector<uint8_t> len, const s
     // number of bytes in the packet.
     // Long form BER encoding is for value fields more than 128 bytes in length
 
-    if(len.size() > 1) {
+    if(len_size > 1) {
         // BER long form
 
         // get the length of the BER field in bytes
         this->ber_len = len[0] & 0b01111111;
 
-        if(ber_len != len.size() - 1) {
-            throw std::invalid_argument("len argument encoded length " + std::to_string(ber_len) + " did not match actual length " + std::to_string(len.size() - 1));
+        if(ber_len != len_size - 1) {
+            throw std::invalid_argument("len argument: number of length bytes in the first byte does not match the field");
         }
 
         // iterate through the len vector for that many bytes
         this->len = len[1];
         for(int i = 1; i < ber_len; i++) {
             this->len <<= 8;
-            this->len |= len[2+i];
+            this->len |= len[1+i];
         }
 
     } else {
         // BER short form
+        this->ber_len = 0;
         this->len = len[0];
     }
 }
@@ -95,22 +116,70 @@ KLV::~KLV() {
     // the external owner of this class must handle that
 }
 
+void KLV::deleteTree(KLV* klv) {
+    if(klv == NULL)
+        return;
+
+    // children that were never decoded lazily do not exist yet
+    KLV* child = klv->child;
+    while(child != NULL) {
+        KLV* next = child->next_sibling;
+        deleteTree(child);
+        child = next;
+    }
+    delete klv;
+}
+
 /**
- * @brief Returns fully encoded raw data of this KLV.
+ * @brief Returns fully encoded raw data of this KLV. If this KLV has children,
+ *        the value is encoded from them (see KlvEncoder).
  *
- * @return Vector of encoded bytes. Empty vector if key, len, or value field has not been set.
+ * @return Vector of encoded bytes. Empty vector if the key has not been set.
  */
 std::vector<uint8_t> KLV::toBytes() {
     std::vector<uint8_t> buffer;
-    if(key.size() > 0 && len_encoded.size() > 0 && value.size() > 0) {
-        // append Key, Len, and Value to buffer
-        buffer.insert(buffer.end(), key.begin(), key.end());
-        buffer.insert(buffer.end(), len_encoded.begin(), len_encoded.end());
-        buffer.insert(buffer.end(), value.begin(), value.end());
+    if(key.size() > 0) {
+        KlvEncoder encoder;
+        buffer.resize(encoder.measure(*this));
+        encoder.encode(*this, buffer.data(), buffer.size());
     }
     return buffer;
 }
 
+/**
+ * @brief Compares the parsed size of the children with the value. Freshly
+ *        parsed children are copies of the items framed in the value, so any
+ *        shortfall is bytes the parser did not turn into items.
+ */
+void KLV::markDroppedItems() {
+    size_t size = 0;
+    for(const KLV* node = this->child; node != NULL; node = node->next_sibling)
+        size += node->key.size() + node->len_encoded.size() + node->value.size();
+    this->dropped_items = size < this->value.size();
+}
+
+/**
+ * @brief Adds a KLV as the last child of this one and links it to its parent
+ *        and siblings.
+ *
+ * @param child KLV to add. The tree does not take ownership.
+ */
+void KLV::appendChild(KLV* child) {
+    child->setParent(this);
+    child->setNextSibling(NULL);
+
+    KLV* last = getChild();
+    if(last == NULL) {
+        this->child = child;
+        child->setPreviousSibling(NULL);
+        return;
+    }
+    while(last->getNext() != NULL)
+        last = last->getNext();
+    last->setNextSibling(child);
+    child->setPreviousSibling(last);
+}
+
 std::unordered_map<std::vector<uint8_t>, KLV> KLV::indexToMap() {
     std::unordered_map<std::vector<uint8_t>, KLV> map;
 
@@ -132,12 +201,54 @@ std::unordered_map<std::vector<uint8_t>, KLV> KLV::indexToMap() {
 }
 
 void KLV::addToMap(std::unordered_map<std::vector<uint8_t>, KLV> &map) {
+    // recursive depth-first add to map (decodes lazy children first, so the
+    // copy in the map shares them)
+    KLV* node = getChild();
     map[getKey()] = *this;
 
-    // recursive depth-first add to map
-    KLV* node = child;
     while(node != NULL) {
         node->addToMap(map);
         node = node->getNext();
     }
+}
+
+/**
+ * @brief Runs the lazy decoder installed on this KLV and links the resulting
+ *        KLVs in as its children. The decoder is dropped afterwards, so this
+ *        happens at most once.
+ */
+void KLV::decodeChildren() const {
+    std::shared_ptr<const KlvLazyDecoder> decoder;
+    decoder.swap(lazy_decoder);
+
+    std::vector<KLV*> children = decoder->decode(*this);
+    KLV* self = const_cast<KLV*>(this);
+    for(size_t i = 0; i < children.size(); i++) {
+        if(i > 0)
+            children[i]->setPreviousSibling(children[i-1]);
+        if(i + 1 < children.size())
+            children[i]->setNextSibling(children[i+1]);
+        children[i]->setParent(self);
+    }
+    if(!children.empty())
+        child = children[0];
+    self->markDroppedItems();
+}
+
+/**
+ * @brief Describes a status code. The strings are static, so reporting an error
+ *        does not allocate.
+ *
+ * @param  status status code
+ * @return        short description of the status
+ */
+const char* klvStatusString(KlvStatus status) {
+    switch(status) {
+    case KLV_OK:               return "no error";
+    case KLV_INCOMPLETE:       return "KLV is incomplete";
+    case KLV_ERROR_BER_LENGTH: return "BER length field has no length bytes or too many";
+    case KLV_ERROR_VALUE_SIZE: return "KLV value is longer than the limit";
+    case KLV_ERROR_CHECKSUM:   return "KLV failed ST 0601 checksum";
+    }
+    return "unknown status";
 }
\ No newline at end of file
@@ -0,0 +1,100 @@
+//
+//  KlvArena.cpp
+//  libklv
+//
+
+#include "KlvArena.hpp"
+#include <cstdlib>
+#include <cstring>
+
+/**
+ * @brief Constructs an empty arena. No memory is allocated until first use.
+ *
+ * @param block_size minimum size of each block allocated from the system
+ */
+KlvArena::KlvArena(size_t block_size) {
+    this->offset = 0;
+    this->block_size = block_size;
+    this->bytes_used = 0;
+    this->capacity = 0;
+}
+
+KlvArena::~KlvArena() {
+    release();
+}
+
+/**
+ * @brief Allocates memory from the arena. The memory stays valid until reset()
+ *        or release() is called, or the arena is destroyed.
+ *
+ * @param  size      number of bytes
+ * @param  alignment required alignment, must be a power of two
+ * @return           pointer to the memory
+ */
+void* KlvArena::allocate(size_t size, size_t alignment) {
+    size_t start = 0;
+    if(!blocks.empty())
+        start = (offset + alignment - 1) & ~(alignment - 1);
+
+    if(blocks.empty() || start + size > blocks.back().size) {
+        addBlock(size);
+        start = 0;
+    }
+
+    uint8_t* ptr = blocks.back().data + start;
+    offset = start + size;
+    bytes_used += size;
+    return ptr;
+}
+
+/**
+ * @brief Copies bytes into the arena.
+ *
+ * @param  data bytes to copy
+ * @param  size number of bytes
+ * @return      pointer to the copy
+ */
+uint8_t* KlvArena::copy(const uint8_t* data, size_t size) {
+    uint8_t* ptr = (uint8_t*) allocate(size, 1);
+    if(size > 0)
+        memcpy(ptr, data, size);
+    return ptr;
+}
+
+/**
+ * @brief Makes all memory in the arena available again. Everything previously
+ *        allocated from it becomes invalid.
+ */
+void KlvArena::reset() {
+    if(blocks.size() > 1) {
+        // coalesce into one block that fits everything the last round needed
+        size_t total = capacity;
+        release();
+        addBlock(total);
+    }
+    offset = 0;
+    bytes_used = 0;
+}
+
+/**
+ * @brief Returns all memory to the system.
+ */
+void KlvArena::release() {
+    for(size_t i = 0; i < blocks.size(); i++)
+        free(blocks[i].data);
+    blocks.clear();
+    offset = 0;
+    bytes_used = 0;
+    capacity = 0;
+}
+
+void KlvArena::addBlock(size_t min_size) {
+    Block block;
+    block.size = min_size > block_size ? min_size : block_size;
+    block.data = (uint8_t*) malloc(block.size);
+    if(block.data == NULL)
+        throw std::bad_alloc();
+    blocks.push_back(block);
+    offset = 0;
+    capacity += block.size;
+}
@@ -0,0 +1,183 @@
+//
+//  KlvByteRing.cpp
+//  libklv
+//
+
+#include "KlvByteRing.hpp"
+#include <algorithm>
+#include <cstring>
+#include <stdexcept>
+#include <thread>
+
+/**
+ * @brief Constructs an empty ring.
+ *
+ * @param capacity bytes in the ring, headers included, rounded up to a power
+ *                 of two of at least 4096
+ */
+KlvByteRing::KlvByteRing(size_t capacity) : head(0), cached_tail(0), tail(0), read(0), sleeping(false), closed(false) {
+    size_t n = 4096;
+    while(n < capacity)
+        n <<= 1;
+    ring.resize(n);
+}
+
+/**
+ * @return largest span tryPush() takes, a quarter of the ring minus its header.
+ *         push() splits larger spans.
+ */
+size_t KlvByteRing::getMaxSpan() const {
+    return ring.size() / 4 - sizeof(Header);
+}
+
+/**
+ * @brief Ring bytes taken by a span: the header and the bytes, rounded up so
+ *        that the next header starts on a multiple of sizeof(Header).
+ */
+size_t KlvByteRing::recordSize(size_t size) {
+    return sizeof(Header) + (size + sizeof(Header) - 1) / sizeof(Header) * sizeof(Header);
+}
+
+/**
+ * @brief Copies a span into the ring if there is room, and wakes the consumer
+ *        if it waits in pop(). A span that does not fit in front of the end
+ *        of the ring goes to its start, behind a filler. Producer only.
+ *
+ * @param  data bytes to copy
+ * @param  size number of bytes, at most getMaxSpan()
+ * @param  tag  passed on to the consumer with the span
+ * @return      false if the ring is too full
+ * @throws std::invalid_argument if size is more than getMaxSpan()
+ */
+bool KlvByteRing::tryPush(const uint8_t* data, size_t size, uint64_t tag) {
+    if(size > getMaxSpan())
+        throw std::invalid_argument("span is larger than a quarter of the ring");
+
+    const size_t capacity = ring.size();
+    const size_t record_size = recordSize(size);
+    size_t h = head.load(std::memory_order_relaxed);
+    size_t offset = h & (capacity - 1);
+    size_t pad = capacity - offset < record_size ? capacity - offset : 0;
+    if(h + pad + record_size - cached_tail > capacity) {
+        cached_tail = tail.load(std::memory_order_acquire);
+        if(h + pad + record_size - cached_tail > capacity)
+            return false;
+    }
+
+    if(pad > 0) {
+        Header filler = {0, 0, 1};
+        memcpy(&ring[offset], &filler, sizeof(filler));
+        h += pad;
+        offset = 0;
+    }
+    Header header = {tag, (uint32_t) size, 0};
+    memcpy(&ring[offset], &header, sizeof(header));
+    if(size > 0)
+        memcpy(&ring[offset + sizeof(header)], data, size);
+
+    // publish the span, then check whether the consumer went to sleep before it
+    // could see it (both sequentially consistent, so one of the two sides sees
+    // the other's store)
+    head.store(h + record_size, std::memory_order_seq_cst);
+    if(sleeping.load(std::memory_order_seq_cst)) {
+        std::lock_guard<std::mutex> lock(mutex);
+        cond.notify_one();
+    }
+    return true;
+}
+
+/**
+ * @brief Copies a span into the ring, waiting for room as needed. Spans larger
+ *        than getMaxSpan() are split into several with the same tag; an empty
+ *        span is pushed as one. Producer only.
+ *
+ * @param data bytes to copy
+ * @param size number of bytes
+ * @param tag  passed on to the consumer with each span
+ */
+void KlvByteRing::push(const uint8_t* data, size_t size, uint64_t tag) {
+    const size_t max_span = getMaxSpan();
+    do {
+        size_t n = std::min(size, max_span);
+        while(!tryPush(data, n, tag))
+            std::this_thread::yield();
+        data += n;
+        size -= n;
+    } while(size > 0);
+}
+
+/**
+ * @brief Takes up to max of the next spans without waiting. Consumer only.
+ *
+ * @param  spans receives the spans, in order. They point into the ring and
+ *               stay valid until release().
+ * @param  max   size of spans
+ * @return       number of spans taken
+ */
+size_t KlvByteRing::tryPop(Span* spans, size_t max) {
+    const size_t capacity = ring.size();
+    size_t h = head.load(std::memory_order_acquire);
+    size_t n = 0;
+    while(n < max && read != h) {
+        size_t offset = read & (capacity - 1);
+        Header header;
+        memcpy(&header, &ring[offset], sizeof(header));
+        if(header.pad) {
+            read += capacity - offset;
+            continue;
+        }
+        spans[n].data = &ring[offset + sizeof(header)];
+        spans[n].size = header.size;
+        spans[n].tag = header.tag;
+        n++;
+        read += recordSize(header.size);
+    }
+    return n;
+}
+
+/**
+ * @brief Takes up to max of the next spans, waiting for at least one unless
+ *        the ring is closed. Consumer only.
+ *
+ * @param  spans receives the spans, valid until release()
+ * @param  max   size of spans
+ * @return       number of spans taken, 0 once the ring is closed
+ */
+size_t KlvByteRing::pop(Span* spans, size_t max) {
+    for(;;) {
+        if(closed.load(std::memory_order_relaxed))
+            return 0;
+        size_t n = tryPop(spans, max);
+        if(n > 0)
+            return n;
+
+        // nothing there: announce that we sleep, look once more, then wait
+        sleeping.store(true, std::memory_order_seq_cst);
+        if(head.load(std::memory_order_seq_cst) == read) {
+            std::unique_lock<std::mutex> lock(mutex);
+            cond.wait(lock, [&]() { return closed.load() || head.load() != read; });
+        }
+        sleeping.store(false, std::memory_order_relaxed);
+    }
+}
+
+/**
+ * @brief Hands the room of every span popped so far back to the producer.
+ *        Consumer only.
+ */
+void KlvByteRing::release() {
+    tail.store(read, std::memory_order_release);
+}
+
+/**
+ * @brief Closes the ring: a consumer waiting in pop() returns, and pop()
+ *        returns 0 from now on. Spans not popped yet stay in the ring, where
+ *        tryPop() still finds them. May be called from any thread.
+ */
+void KlvByteRing::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        closed.store(true);
+    }
+    cond.notify_all();
+}
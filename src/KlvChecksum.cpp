@@ -0,0 +1,176 @@
+//
+//  KlvChecksum.cpp
+//  libklv
+//
+
+#include "KlvChecksum.hpp"
+#include "KlvScan.hpp"
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KLV_CHECKSUM_X86 1
+#include <immintrin.h>
+#endif
+
+/**
+ * @brief Adds a span of packet bytes to the checksum. The span continues where
+ *        the previous one ended, so its parity follows from getSize().
+ *
+ * @param data pointer to the bytes
+ * @param size number of bytes
+ */
+void KlvChecksum::update(const uint8_t* data, size_t size) {
+    static const bool sse2 = KlvScan::hasSse2();
+
+    uint32_t e = 0, o = 0;
+    if(sse2)
+        sumSse2(data, size, e, o);
+    else
+        sumWord(data, size, e, o);
+
+    // a span starting at an odd offset has its parities swapped
+    if(this->size & 1) {
+        this->even += o;
+        this->odd += e;
+    } else {
+        this->even += e;
+        this->odd += o;
+    }
+    this->size += size;
+}
+
+/**
+ * @brief Computes the checksum of a span of bytes in one go.
+ *
+ * @param  data pointer to the bytes, the first byte counts as an even offset
+ * @param  size number of bytes
+ * @return      the 16-bit checksum
+ */
+uint16_t KlvChecksum::compute(const uint8_t* data, size_t size) {
+    KlvChecksum checksum;
+    checksum.update(data, size);
+    return checksum.value();
+}
+
+/**
+ * @brief Reference implementation of compute(), one byte at a time exactly as
+ *        given in ST 0601.
+ */
+uint16_t KlvChecksum::computeScalar(const uint8_t* data, size_t size) {
+    uint16_t bcc = 0;
+    for(size_t i = 0; i < size; i++)
+        bcc += data[i] << (8 * ((i + 1) % 2));
+    return bcc;
+}
+
+/**
+ * @brief Portable version of compute(), summing 8 bytes per step.
+ */
+uint16_t KlvChecksum::computeWord(const uint8_t* data, size_t size) {
+    uint32_t even = 0, odd = 0;
+    sumWord(data, size, even, odd);
+    return (uint16_t) ((even << 8) + odd);
+}
+
+/**
+ * @brief SSE2 version of compute(), summing 16 bytes per step.
+ */
+uint16_t KlvChecksum::computeSse2(const uint8_t* data, size_t size) {
+    uint32_t even = 0, odd = 0;
+    sumSse2(data, size, even, odd);
+    return (uint16_t) ((even << 8) + odd);
+}
+
+/**
+ * @brief Checks the checksum of a complete ST 0601 packet. The checksum item
+ *        must be the last item of the packet.
+ *
+ * @param  packet pointer to the first byte of the packet's key
+ * @param  size   size of the whole packet
+ * @return        true if the packet ends in a checksum item holding the
+ *                checksum of the bytes in front of it
+ */
+bool KlvChecksum::verify(const uint8_t* packet, size_t size) {
+    if(size < 4 || packet[size - 4] != 0x01 || packet[size - 3] != 0x02)
+        return false;
+    uint16_t expected = (uint16_t) ((packet[size - 2] << 8) | packet[size - 1]);
+    return compute(packet, size - 2) == expected;
+}
+
+/**
+ * @brief Sums the even and odd offset bytes of a span, 8 bytes at a time. Each
+ *        word is split into its even and odd bytes, which are added into four
+ *        16-bit lanes per parity. The lanes are folded into the totals before
+ *        they can overflow.
+ */
+void KlvChecksum::sumWord(const uint8_t* data, size_t size, uint32_t& even, uint32_t& odd) {
+    const uint64_t mask = 0x00FF00FF00FF00FFull;
+    const size_t max_steps = 256;  // 256 * 255 still fits a 16-bit lane
+
+    size_t i = 0;
+    while(i + 8 <= size) {
+        uint64_t lo = 0, hi = 0;
+        for(size_t steps = 0; steps < max_steps && i + 8 <= size; steps++, i += 8) {
+            uint64_t w;
+            memcpy(&w, data + i, sizeof(w));
+            lo += w & mask;
+            hi += (w >> 8) & mask;
+        }
+
+        uint32_t lo_sum = (uint32_t) ((lo & 0xFFFF) + ((lo >> 16) & 0xFFFF) + ((lo >> 32) & 0xFFFF) + (lo >> 48));
+        uint32_t hi_sum = (uint32_t) ((hi & 0xFFFF) + ((hi >> 16) & 0xFFFF) + ((hi >> 32) & 0xFFFF) + (hi >> 48));
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_BIG_ENDIAN__
+        // the first byte of the word is the most significant one
+        even += hi_sum;
+        odd += lo_sum;
+#else
+        even += lo_sum;
+        odd += hi_sum;
+#endif
+    }
+
+    for(; i < size; i++) {
+        if(i & 1)
+            odd += data[i];
+        else
+            even += data[i];
+    }
+}
+
+#ifdef KLV_CHECKSUM_X86
+
+/**
+ * @brief Sums the even and odd offset bytes of a span, 16 bytes at a time. The
+ *        even bytes are masked out of each block and the odd bytes shifted down,
+ *        and _mm_sad_epu8() adds up each half into a 64-bit lane.
+ */
+__attribute__((target("sse2")))
+void KlvChecksum::sumSse2(const uint8_t* data, size_t size, uint32_t& even, uint32_t& odd) {
+    const __m128i mask = _mm_set1_epi16(0x00FF);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i even_acc = _mm_setzero_si128();
+    __m128i odd_acc = _mm_setzero_si128();
+
+    size_t i = 0;
+    for(; i + 16 <= size; i += 16) {
+        __m128i v = _mm_loadu_si128((const __m128i*) (data + i));
+        even_acc = _mm_add_epi64(even_acc, _mm_sad_epu8(_mm_and_si128(v, mask), zero));
+        odd_acc = _mm_add_epi64(odd_acc, _mm_sad_epu8(_mm_srli_epi16(v, 8), zero));
+    }
+
+    even_acc = _mm_add_epi64(even_acc, _mm_srli_si128(even_acc, 8));
+    odd_acc = _mm_add_epi64(odd_acc, _mm_srli_si128(odd_acc, 8));
+    even += (uint32_t) _mm_cvtsi128_si32(even_acc);
+    odd += (uint32_t) _mm_cvtsi128_si32(odd_acc);
+
+    // 16 is even, so the tail keeps its parity
+    sumWord(data + i, size - i, even, odd);
+}
+
+#else
+
+void KlvChecksum::sumSse2(const uint8_t* data, size_t size, uint32_t& even, uint32_t& odd) {
+    sumWord(data, size, even, odd);
+}
+
+#endif // KLV_CHECKSUM_X86
@@ -0,0 +1,171 @@
+//
+//  KlvEncoder.cpp
+//  libklv
+//
+
+#include "KlvEncoder.hpp"
+#include <cstring>
+
+namespace {
+    /**
+     * True if a KLV is to be encoded from its children rather than its value.
+     * Lazily parsed KLVs that were never decoded keep their raw value, and so
+     * do sets whose parser dropped some of the value.
+     */
+    bool hasChildren(const KLV& klv) {
+        return klv.isDecoded() && !klv.hasDroppedItems() && klv.getChild() != NULL;
+    }
+}
+
+/**
+ * @brief Computes the size of the BER encoding of a length.
+ *
+ * @param  len length of the value field
+ * @return     1 for short form, 1 + number of length bytes for long form
+ */
+size_t KlvEncoder::berLengthSize(unsigned long len) {
+    if(len < 128)
+        return 1;
+
+    size_t n = 0;
+    while(len != 0) {
+        n++;
+        len >>= 8;
+    }
+    return 1 + n;
+}
+
+/**
+ * @brief BER encodes a length.
+ *
+ * @param  len length of the value field
+ * @param  out buffer of at least berLengthSize(len) bytes
+ * @return     number of bytes written
+ */
+size_t KlvEncoder::encodeBerLength(unsigned long len, uint8_t* out) {
+    size_t size = berLengthSize(len);
+    if(size == 1) {
+        // short form: the length itself, bit 8 cleared
+        out[0] = (uint8_t) len;
+        return 1;
+    }
+
+    // long form: number of length bytes with bit 8 set, then the length big endian
+    out[0] = (uint8_t) (0b10000000 | (size - 1));
+    for(size_t i = size - 1; i > 0; i--) {
+        out[i] = (uint8_t) (len & 0xFF);
+        len >>= 8;
+    }
+    return size;
+}
+
+std::vector<uint8_t> KlvEncoder::encodeBerLength(unsigned long len) {
+    std::vector<uint8_t> encoded(berLengthSize(len));
+    encodeBerLength(len, encoded.data());
+    return encoded;
+}
+
+/**
+ * @brief Computes the encoded size of a KLV tree, sizing each nested set from
+ *        its children.
+ *
+ * @param  klv root of the tree
+ * @return     number of bytes encode() will write
+ */
+size_t KlvEncoder::measure(const KLV& klv) {
+    sizes.clear();
+    return measureNode(klv);
+}
+
+/**
+ * @brief Encodes a KLV tree into a caller supplied buffer.
+ *
+ * @param  klv      root of the tree
+ * @param  out      output buffer
+ * @param  capacity size of the output buffer
+ * @return          number of bytes written, 0 if the buffer is too small
+ */
+size_t KlvEncoder::encode(const KLV& klv, uint8_t* out, size_t capacity) {
+    size_t size = measure(klv);
+    if(size > capacity)
+        return 0;
+
+    size_t index = 0;
+    writeNode(klv, index, out);
+    return size;
+}
+
+/**
+ * @brief Encodes a KLV tree into a sink.
+ *
+ * @param  klv  root of the tree
+ * @param  sink destination for the encoded bytes
+ * @return      number of bytes written
+ */
+size_t KlvEncoder::encode(const KLV& klv, KlvSink& sink) {
+    size_t size = measure(klv);
+    size_t index = 0;
+    writeNode(klv, index, sink);
+    return size;
+}
+
+size_t KlvEncoder::measureNode(const KLV& klv) {
+    // reserve this node's slot first so the slots end up in depth first order
+    size_t index = sizes.size();
+    sizes.push_back(Sizes());
+
+    unsigned long value_size = 0;
+    if(hasChildren(klv)) {
+        for(const KLV* node = klv.getChild(); node != NULL; node = node->getNext())
+            value_size += measureNode(*node);
+    } else {
+        value_size = klv.getValue().size();
+    }
+
+    Sizes& s = sizes[index];
+    s.value_size = value_size;
+    s.keep_len = !klv.getLenEncoded().empty() && klv.getLen() == value_size;
+    s.len_size = s.keep_len ? klv.getLenEncoded().size() : berLengthSize(value_size);
+    return klv.getKey().size() + s.len_size + value_size;
+}
+
+void KlvEncoder::writeNode(const KLV& klv, size_t& index, uint8_t*& out) {
+    const Sizes& s = sizes[index++];
+
+    memcpy(out, klv.getKey().data(), klv.getKey().size());
+    out += klv.getKey().size();
+
+    if(s.keep_len)
+        memcpy(out, klv.getLenEncoded().data(), s.len_size);
+    else
+        encodeBerLength(s.value_size, out);
+    out += s.len_size;
+
+    if(hasChildren(klv)) {
+        for(const KLV* node = klv.getChild(); node != NULL; node = node->getNext())
+            writeNode(*node, index, out);
+    } else if(s.value_size > 0) {
+        memcpy(out, klv.getValue().data(), s.value_size);
+        out += s.value_size;
+    }
+}
+
+void KlvEncoder::writeNode(const KLV& klv, size_t& index, KlvSink& sink) {
+    const Sizes& s = sizes[index++];
+
+    sink.write(klv.getKey().data(), klv.getKey().size());
+
+    if(s.keep_len) {
+        sink.write(klv.getLenEncoded().data(), s.len_size);
+    } else {
+        uint8_t len[1 + sizeof(unsigned long)];
+        sink.write(len, encodeBerLength(s.value_size, len));
+    }
+
+    if(hasChildren(klv)) {
+        for(const KLV* node = klv.getChild(); node != NULL; node = node->getNext())
+            writeNode(*node, index, sink);
+    } else if(s.value_size > 0) {
+        sink.write(klv.getValue().data(), s.value_size);
+    }
+}
@@ -0,0 +1,258 @@
+//
+//  KlvFile.cpp
+//  libklv
+//
+
+#include "KlvFile.hpp"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <stdexcept>
+#include <sys/stat.h>
+
+const size_t KlvFile::NONE;
+
+namespace {
+    const char INDEX_MAGIC[8] = {'K', 'L', 'V', 'I', 'D', 'X', '0', '1'};
+
+    /**
+     * Sidecar file header, followed by num_entries KlvFileEntry records. Both are
+     * written in host byte order; a sidecar from a machine of the other byte
+     * order fails the magic check and is rebuilt.
+     */
+    struct IndexHeader {
+        char         magic[8];        /// INDEX_MAGIC
+        uint32_t     entry_size;      /// sizeof(KlvFileEntry)
+        uint32_t     byte_order;      /// 0x01020304 as written by this machine
+        uint64_t     file_size;       /// size of the capture when it was indexed
+        uint64_t     file_mtime;      /// modification time of the capture, in nanoseconds
+        uint64_t     num_entries;     /// number of records that follow
+    };
+
+    uint64_t modificationTime(const std::string& path) {
+        struct stat st;
+        if(stat(path.c_str(), &st) != 0)
+            return 0;
+        return (uint64_t) st.st_mtim.tv_sec * 1000000000ull + (uint64_t) st.st_mtim.tv_nsec;
+    }
+}
+
+KlvFile::KlvFile(const std::string& path, std::vector<KlvParser::KeyEncoding> key_encodings, bool use_sidecar)
+    : file(path), key_encodings(key_encodings), parser(key_encodings), mtime(modificationTime(path)), index_loaded(false) {
+    if(key_encodings.empty() || key_encodings[0] != KlvParser::KEY_ENCODING_16_BYTE)
+        throw std::invalid_argument("KlvFile needs 16-byte universal keys at the top level");
+
+    std::string index_path = path + ".idx";
+    if(use_sidecar && loadIndex(index_path))
+        return;
+
+    buildIndex();
+    if(use_sidecar)
+        saveIndex(index_path);
+}
+
+/**
+ * @brief Returns a view of a top level KLV, pointing into the mapped file. The
+ *        view has no children; use getTree() for the nested KLVs.
+ *
+ * @param  index position of the KLV in the file, below size()
+ * @return       the view
+ */
+KlvView KlvFile::getView(size_t index) const {
+    const KlvFileEntry& e = entries[index];
+    const uint8_t* p = file.data() + e.offset;
+    return KlvView(KlvSpan(p, e.key_size),
+                   KlvSpan(p + e.key_size, e.len_size),
+                   KlvSpan(p + e.key_size + e.len_size, e.value_size),
+                   e.value_size);
+}
+
+/**
+ * @brief Fills a tree with a top level KLV and its nested KLVs. The nodes live in
+ *        the tree's arena and point into the mapped file, nothing is copied.
+ *
+ * @param index position of the KLV in the file, below size()
+ * @param tree  receives the KLV
+ */
+void KlvFile::getTree(size_t index, KlvTree& tree) {
+    const KlvFileEntry& e = entries[index];
+    parser.parseTree(file.data() + e.offset, (size_t) (e.end() - e.offset), tree, false);
+}
+
+/**
+ * @brief Finds the packet in effect at a point in time: the one with the latest
+ *        timestamp at or before it.
+ *
+ * @param  timestamp time in microseconds since the epoch
+ * @return           position of the packet, NONE if every packet is later or
+ *                   none has a timestamp
+ */
+size_t KlvFile::findTime(uint64_t timestamp) const {
+    std::vector<size_t>::const_iterator it = std::upper_bound(time_order.begin(), time_order.end(), timestamp,
+            [this](uint64_t t, size_t i) { return t < entries[i].timestamp; });
+    if(it == time_order.begin())
+        return NONE;
+    return *(it - 1);
+}
+
+/**
+ * @brief Finds the packets with a timestamp in [begin, end).
+ *
+ * @param  begin first time of the range, in microseconds since the epoch
+ * @param  end   time just past the range
+ * @return       positions of the packets, in file order
+ */
+std::vector<size_t> KlvFile::findTimeRange(uint64_t begin, uint64_t end) const {
+    std::vector<size_t>::const_iterator first = std::lower_bound(time_order.begin(), time_order.end(), begin,
+            [this](size_t i, uint64_t t) { return entries[i].timestamp < t; });
+    std::vector<size_t>::const_iterator last = std::lower_bound(first, time_order.end(), end,
+            [this](size_t i, uint64_t t) { return entries[i].timestamp < t; });
+
+    std::vector<size_t> result(first, last);
+    std::sort(result.begin(), result.end());
+    return result;
+}
+
+/**
+ * @brief Loads the index from a sidecar file written by saveIndex().
+ *
+ * @param  index_path path of the sidecar file
+ * @return            true if the sidecar matched the capture and was loaded
+ */
+bool KlvFile::loadIndex(const std::string& index_path) {
+    FILE* f = fopen(index_path.c_str(), "rb");
+    if(f == NULL)
+        return false;
+
+    IndexHeader header;
+    bool ok = fread(&header, sizeof(header), 1, f) == 1
+        && memcmp(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) == 0
+        && header.entry_size == sizeof(KlvFileEntry)
+        && header.byte_order == 0x01020304
+        && header.file_size == file.size()
+        && header.file_mtime == mtime
+        && header.num_entries <= file.size();
+
+    std::vector<KlvFileEntry> loaded;
+    if(ok) {
+        loaded.resize((size_t) header.num_entries);
+        ok = loaded.empty() || fread(loaded.data(), sizeof(KlvFileEntry), loaded.size(), f) == loaded.size();
+    }
+    fclose(f);
+
+    // never trust an entry that points outside the file
+    for(size_t i = 0; ok && i < loaded.size(); i++)
+        ok = loaded[i].end() <= file.size();
+    if(!ok)
+        return false;
+
+    entries.swap(loaded);
+    sortByTime();
+    index_loaded = true;
+    return true;
+}
+
+/**
+ * @brief Writes the index to a sidecar file.
+ *
+ * @param  index_path path of the sidecar file
+ * @return            true if it was written
+ */
+bool KlvFile::saveIndex(const std::string& index_path) const {
+    IndexHeader header;
+    memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    header.entry_size = sizeof(KlvFileEntry);
+    header.byte_order = 0x01020304;
+    header.file_size = file.size();
+    header.file_mtime = mtime;
+    header.num_entries = entries.size();
+
+    // write to a temporary file first so a reader never sees half an index
+    std::string tmp_path = index_path + ".tmp";
+    FILE* f = fopen(tmp_path.c_str(), "wb");
+    if(f == NULL)
+        return false;
+    bool ok = fwrite(&header, sizeof(header), 1, f) == 1
+        && (entries.empty() || fwrite(entries.data(), sizeof(KlvFileEntry), entries.size(), f) == entries.size());
+    ok = fclose(f) == 0 && ok;
+    if(ok)
+        ok = rename(tmp_path.c_str(), index_path.c_str()) == 0;
+    if(!ok)
+        remove(tmp_path.c_str());
+    return ok;
+}
+
+/**
+ * @brief Frames every top level KLV in the file, the same way KlvParser would
+ *        find them, and picks the timestamp out of each local set. A KLV
+ *        rejected by the parser's limits is skipped from the end of its length
+ *        field, as KlvFileParser does, so one bad packet does not end the index.
+ */
+void KlvFile::buildIndex() {
+    entries.clear();
+
+    const uint8_t* data = file.data();
+    size_t size = file.size();
+    const KlvParser::Limits& limits = parser.getLimits();
+    size_t pos = 0;
+    KlvParser::Frame f;
+    while(pos < size) {
+        KlvStatus status = KlvParser::frame(data + pos, size - pos, key_encodings[0], limits, f);
+        if(status == KLV_INCOMPLETE)
+            break;
+        if(status != KLV_OK) {
+            pos += f.valueOffset();
+            continue;
+        }
+
+        KlvFileEntry e;
+        e.offset = pos + f.key_offset;
+        e.key_size = (uint8_t) f.key_size;
+        e.len_size = (uint8_t) f.len_size;
+        e.value_size = f.value_size;
+        e.timestamp = 0;
+        e.has_timestamp = 0;
+        memset(e.reserved, 0, sizeof(e.reserved));
+
+        if(key_encodings.size() > 1) {
+            // Precision Time Stamp is tag 2, normally the first item
+            const uint8_t* value = data + pos + f.valueOffset();
+            size_t offset = 0;
+            KlvParser::Frame item;
+            while(offset < f.value_size) {
+                status = KlvParser::frame(value + offset, f.value_size - offset, key_encodings[1], limits, item);
+                if(status == KLV_INCOMPLETE)
+                    break;
+                if(status != KLV_OK) {
+                    offset += item.valueOffset();
+                    continue;
+                }
+                if(KlvParser::decodeTag(value + offset + item.key_offset, item.key_size, key_encodings[1]) == 2
+                        && item.value_size == 8) {
+                    for(size_t i = 0; i < 8; i++)
+                        e.timestamp = (e.timestamp << 8) | value[offset + item.valueOffset() + i];
+                    e.has_timestamp = 1;
+                    break;
+                }
+                offset += item.end();
+            }
+        }
+
+        entries.push_back(e);
+        pos += f.end();
+    }
+
+    sortByTime();
+}
+
+void KlvFile::sortByTime() {
+    time_order.clear();
+    for(size_t i = 0; i < entries.size(); i++) {
+        if(entries[i].has_timestamp)
+            time_order.push_back(i);
+    }
+
+    // captures are nearly always in time order already
+    std::stable_sort(time_order.begin(), time_order.end(),
+            [this](size_t a, size_t b) { return entries[a].timestamp < entries[b].timestamp; });
+}
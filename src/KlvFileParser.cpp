@@ -0,0 +1,365 @@
+//
+//  KlvFileParser.cpp
+//  libklv
+//
+
+#include "KlvFileParser.hpp"
+#include "KlvFormatException.hpp"
+#include "KlvMappedFile.hpp"
+#include "KlvScan.hpp"
+#include <algorithm>
+#include <condition_variable>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+
+const size_t KlvFileParser::DEFAULT_CHUNK_SIZE;
+
+/**
+ * @brief Constructs a file parser.
+ *
+ * @param key_encodings key encodings, as for KlvParser. The first one must be
+ *                      KEY_ENCODING_16_BYTE.
+ * @param num_threads   number of worker threads, 0 for one per core
+ * @param chunk_size    bytes per chunk
+ */
+KlvFileParser::KlvFileParser(std::vector<KlvParser::KeyEncoding> key_encodings, size_t num_threads, size_t chunk_size) {
+    if(key_encodings.empty() || key_encodings[0] != KlvParser::KEY_ENCODING_16_BYTE)
+        throw std::invalid_argument("KlvFileParser needs 16-byte universal keys at the top level");
+    if(chunk_size == 0)
+        throw std::invalid_argument("chunk_size must not be 0");
+
+    if(num_threads == 0)
+        num_threads = std::max(1u, std::thread::hardware_concurrency());
+
+    this->key_encodings = key_encodings;
+    this->num_threads = num_threads;
+    this->chunk_size = chunk_size;
+    this->lazy_nesting = false;
+    this->checksum_mode = KlvParser::CHECKSUM_OFF;
+    this->num_checksum_failures = 0;
+    this->num_errors = 0;
+}
+
+/**
+ * @brief Sets the limits on accepted packets, see KlvParser::setLimits().
+ *
+ * @throws std::invalid_argument if max_ber_bytes is more than an unsigned long
+ *         can hold
+ */
+void KlvFileParser::setLimits(const KlvParser::Limits& limits) {
+    // checked here so that the workers cannot throw for it
+    if(limits.max_ber_bytes > sizeof(unsigned long))
+        throw std::invalid_argument("max_ber_bytes is larger than an unsigned long");
+    this->limits = limits;
+}
+
+/**
+ * @brief Parses a buffer on the worker threads and hands every complete top
+ *        level KLV to handler, in buffer order, on the calling thread.
+ *
+ * In CHECKSUM_THROW mode the first bad packet stops the workers and throws
+ * KlvFormatException; the KLVs handed out before it stay with the handler.
+ *
+ * @param  data    pointer to the buffer, which must stay alive during the call
+ * @param  size    size of the buffer
+ * @param  handler called with each KLV. Ownership is transfered to the handler.
+ * @return         number of KLVs handed out
+ */
+size_t KlvFileParser::parse(const uint8_t* data, size_t size, const Handler& handler) {
+    num_checksum_failures = 0;
+    num_errors = 0;
+
+    const size_t num_chunks = (size + chunk_size - 1) / chunk_size;
+    const size_t max_ahead = 2 * num_threads;   // bounds the parsed but not yet handed out chunks
+    std::vector<Chunk> chunks(num_chunks);
+    for(size_t i = 0; i < num_chunks; i++)
+        chunks[i].ready = false;
+
+    std::mutex mutex;
+    std::condition_variable cond;
+    size_t next_chunk = 0;
+    size_t merged = 0;
+    bool stop = false;
+
+    auto worker = [&]() {
+        KlvParser parser(key_encodings);
+        configure(parser);
+        for(;;) {
+            size_t i;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                cond.wait(lock, [&]() { return stop || next_chunk >= num_chunks || next_chunk < merged + max_ahead; });
+                if(stop || next_chunk >= num_chunks)
+                    return;
+                i = next_chunk++;
+            }
+
+            Chunk chunk;
+            size_t limit = std::min((i + 1) * chunk_size, size);
+            parseChunk(parser, data, size, i * chunk_size, limit, chunk);
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                chunks[i].packets.swap(chunk.packets);
+                chunks[i].tail = chunk.tail;
+                chunks[i].clean = chunk.clean;
+                chunks[i].ready = true;
+            }
+            cond.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+
+    // stops the workers and frees whatever was not handed out, on the way out
+    // of the function or when the handler or a checksum failure throws
+    struct Cleanup {
+        std::mutex& mutex;
+        std::condition_variable& cond;
+        bool& stop;
+        std::vector<std::thread>& threads;
+        std::vector<Chunk>& chunks;
+
+        ~Cleanup() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stop = true;
+            }
+            cond.notify_all();
+            for(size_t t = 0; t < threads.size(); t++)
+                threads[t].join();
+            for(size_t i = 0; i < chunks.size(); i++) {
+                for(size_t k = 0; k < chunks[i].packets.size(); k++)
+                    KLV::deleteTree(chunks[i].packets[k].klv);
+            }
+        }
+    } cleanup = {mutex, cond, stop, threads, chunks};
+
+    // started only once cleanup is in place, which joins them if starting the
+    // next one throws; reserved so that adding one never moves the others
+    threads.reserve(std::min(num_threads, num_chunks));
+    for(size_t t = 0; t < std::min(num_threads, num_chunks); t++)
+        threads.push_back(std::thread(worker));
+
+    KlvParser parser(key_encodings);
+    configure(parser);
+    size_t count = 0;
+
+    auto emit = [&](KLV* klv, KlvStatus status) {
+        if(klv == NULL) {
+            num_errors++;
+            if(status != KLV_ERROR_CHECKSUM)
+                return;
+            num_checksum_failures++;
+            if(checksum_mode == KlvParser::CHECKSUM_THROW)
+                throw KlvFormatException(KLV_ERROR_CHECKSUM);
+            return;
+        }
+        count++;
+        handler(klv);
+    };
+
+    size_t pos = 0;     // where a single parser would scan for the next packet
+    bool done = false;  // a single parser would be stuck in an incomplete packet
+    for(size_t i = 0; i < num_chunks; i++) {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            cond.wait(lock, [&]() { return chunks[i].ready; });
+        }
+
+        Chunk& chunk = chunks[i];
+        size_t limit = std::min((i + 1) * chunk_size, size);
+        size_t k = 0;
+        while(!done && pos < limit) {
+            // the chunk's packets are the right ones once one of them was scanned
+            // for from at or before pos, with no UL header in between
+            while(k < chunk.packets.size() && chunk.packets[k].start < pos)
+                k++;
+            if(k < chunk.packets.size() && chunk.packets[k].origin <= pos) {
+                for(; k < chunk.packets.size(); k++) {
+                    KLV* klv = chunk.packets[k].klv;
+                    chunk.packets[k].klv = NULL;
+                    emit(klv, chunk.packets[k].status);
+                }
+                pos = chunk.tail;
+                if(chunk.clean)
+                    pos = std::max(pos, limit);
+                else
+                    done = true;
+                break;
+            }
+            if(k == chunk.packets.size() && chunk.clean && chunk.tail <= pos) {
+                pos = limit;
+                break;
+            }
+
+            // out of step with the chunk, frame the next packet here
+            KlvParser::Frame f;
+            size_t start;
+            KlvStatus status;
+            switch(findPacket(data, size, pos, limit, start, f, status)) {
+            case SCAN_FOUND: {
+                KLV* klv = parsePacket(parser, data, start, start + f.end(), status);
+                emit(klv, status);
+                pos = start + f.end();
+                break;
+            }
+            case SCAN_REJECTED:
+                emit(NULL, status);
+                pos = start + f.valueOffset();
+                break;
+            case SCAN_END:
+                pos = limit;
+                break;
+            case SCAN_INCOMPLETE:
+                done = true;
+                break;
+            }
+        }
+
+        for(size_t k = 0; k < chunk.packets.size(); k++)
+            KLV::deleteTree(chunk.packets[k].klv);
+        std::vector<Packet>().swap(chunk.packets);
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            merged = i + 1;
+        }
+        cond.notify_all();
+    }
+
+    return count;
+}
+
+/**
+ * @brief Parses a buffer on the worker threads and returns every complete top
+ *        level KLV in buffer order. See parse(const uint8_t*, size_t, const Handler&).
+ *
+ * @param  data pointer to the buffer
+ * @param  size size of the buffer
+ * @return      the KLVs. Ownership of each KLV is transfered to the caller.
+ */
+std::vector<KLV*> KlvFileParser::parse(const uint8_t* data, size_t size) {
+    std::vector<KLV*> klvs;
+    try {
+        parse(data, size, [&klvs](KLV* klv) { klvs.push_back(klv); });
+    } catch(...) {
+        for(size_t i = 0; i < klvs.size(); i++)
+            KLV::deleteTree(klvs[i]);
+        throw;
+    }
+    return klvs;
+}
+
+/**
+ * @brief Maps a capture file into memory and parses it. The mapping is released
+ *        before returning; the KLVs own copies of their bytes.
+ *
+ * @param  path    path of the capture file
+ * @param  handler called with each KLV, in file order
+ * @return         number of KLVs handed out
+ */
+size_t KlvFileParser::parseFile(const std::string& path, const Handler& handler) {
+    KlvMappedFile file(path);
+    return parse(file.data(), file.size(), handler);
+}
+
+std::vector<KLV*> KlvFileParser::parseFile(const std::string& path) {
+    KlvMappedFile file(path);
+    return parse(file.data(), file.size());
+}
+
+void KlvFileParser::configure(KlvParser& parser) const {
+    parser.setLimits(limits);
+    parser.setLazyNesting(lazy_nesting);
+
+    // bad packets are turned into exceptions on the calling thread, in order
+    parser.setChecksumMode(checksum_mode == KlvParser::CHECKSUM_THROW ? KlvParser::CHECKSUM_DROP : checksum_mode);
+}
+
+/**
+ * @brief Runs one framed packet through a parser.
+ *
+ * @param  status set to KLV_OK, or to the reason the parser dropped the packet
+ * @return        the KLV, NULL if the parser dropped it
+ */
+KLV* KlvFileParser::parsePacket(KlvParser& parser, const uint8_t* data, size_t start, size_t end, KlvStatus& status) const {
+    std::vector<KLV*> klvs;
+    status = parser.parse(data + start, end - start, klvs);
+    return klvs.empty() ? NULL : klvs[0];
+}
+
+/**
+ * @brief Scans for the next packet the way KlvParser does: from pos to the next
+ *        UL header, which starts the packet. Only headers starting before limit
+ *        are looked for, so scanning garbage stops at the end of the chunk.
+ *
+ * @param  data   pointer to the buffer
+ * @param  size   size of the buffer
+ * @param  pos    where to start scanning
+ * @param  limit  end of the chunk
+ * @param  start  set to the offset of the packet
+ * @param  f      filled in with the packet's frame, relative to start
+ * @param  status set to the limit the packet breaks for SCAN_REJECTED
+ * @return        whether a packet was found. For SCAN_REJECTED, start +
+ *                f.valueOffset() is where the scan resumes.
+ */
+KlvFileParser::Scan KlvFileParser::findPacket(const uint8_t* data, size_t size, size_t pos, size_t limit,
+                                              size_t& start, KlvParser::Frame& f, KlvStatus& status) const {
+    size_t scan_end = std::min(size, limit + SMPTE_KLV_UL_HEADER_LEN - 1);
+    if(pos >= scan_end) {
+        // the last packet ran past the end of the chunk
+        start = pos;
+        return SCAN_END;
+    }
+    start = pos + KlvScan::findUlHeader(data + pos, scan_end - pos);
+    if(start >= limit)
+        return SCAN_END;
+    status = KlvParser::frame(data + start, size - start, key_encodings[0], limits, f);
+    switch(status) {
+    case KLV_OK:
+        return SCAN_FOUND;
+    case KLV_INCOMPLETE:
+        return SCAN_INCOMPLETE;
+    default:
+        return SCAN_REJECTED;
+    }
+}
+
+/**
+ * @brief Parses the packets that start in one chunk.
+ *
+ * @param parser parser for the packets
+ * @param data   pointer to the buffer
+ * @param size   size of the buffer
+ * @param begin  first byte of the chunk
+ * @param limit  end of the chunk
+ * @param chunk  receives the packets
+ */
+void KlvFileParser::parseChunk(KlvParser& parser, const uint8_t* data, size_t size, size_t begin, size_t limit, Chunk& chunk) const {
+    size_t pos = begin;
+    for(;;) {
+        KlvParser::Frame f;
+        size_t start;
+        KlvStatus status;
+        Scan scan = findPacket(data, size, pos, limit, start, f, status);
+        if(scan == SCAN_END || scan == SCAN_INCOMPLETE) {
+            chunk.clean = scan == SCAN_END;
+            break;
+        }
+
+        Packet packet;
+        packet.origin = pos;
+        packet.start = start;
+        if(scan == SCAN_REJECTED) {
+            packet.end = start + f.valueOffset();
+            packet.klv = NULL;
+            packet.status = status;
+        } else {
+            packet.end = start + f.end();
+            packet.klv = parsePacket(parser, data, start, packet.end, packet.status);
+        }
+        chunk.packets.push_back(packet);
+        pos = packet.end;
+    }
+    chunk.tail = pos;
+}
@@ -0,0 +1,26 @@
+//
+//  KlvFlatTree.cpp
+//  libklv
+//
+
+#include "KlvFlatTree.hpp"
+
+const uint32_t KlvFlatTree::NONE = 0xFFFFFFFF;
+
+/**
+ * @brief Finds the previous sibling of a node. Siblings are only linked forward,
+ *        so this walks the parent's children.
+ *
+ * @param  index index of the node
+ * @return       index of the previous sibling, NONE if it is the first child
+ */
+uint32_t KlvFlatTree::getPrevious(uint32_t index) const {
+    uint32_t parent = nodes[index].parent;
+    if(parent == NONE)
+        return NONE;
+
+    uint32_t previous = NONE;
+    for(uint32_t node = nodes[parent].first_child; node != index; node = nodes[node].next_sibling)
+        previous = node;
+    return previous;
+}
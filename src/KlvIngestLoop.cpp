@@ -0,0 +1,108 @@
+//
+//  KlvIngestLoop.cpp
+//  libklv
+//
+
+#include "KlvIngestLoop.hpp"
+#include <stdexcept>
+#include <thread>
+
+const size_t KlvIngestLoop::DEFAULT_RING_SIZE;
+const size_t KlvIngestLoop::DEFAULT_NUM_TREES;
+
+/**
+ * @brief Constructs a parse loop.
+ *
+ * @param parser    parser to feed, only used by run() from then on
+ * @param ring_size bytes in the input ring, see KlvByteRing
+ * @param num_trees trees in the pool, the most packets that can be waiting
+ *                  for or held by the consumer
+ */
+KlvIngestLoop::KlvIngestLoop(KlvParser& parser, size_t ring_size, size_t num_trees)
+    : parser(parser), input(ring_size), output(num_trees), free_trees(num_trees) {
+    if(num_trees == 0)
+        throw std::invalid_argument("num_trees must not be 0");
+
+    for(size_t i = 0; i < num_trees; i++) {
+        trees.push_back(new KlvTree());
+        free_trees.tryPush(trees.back());
+    }
+}
+
+KlvIngestLoop::~KlvIngestLoop() {
+    for(size_t i = 0; i < trees.size(); i++)
+        delete trees[i];
+}
+
+/**
+ * @brief Parses the input until close() is called. Run it on the parse thread.
+ *
+ * Each batch of spans is parsed with KlvParser::parseTree(), copying the
+ * packet bytes into the tree, so the spans can be released as soon as the
+ * batch is done. A packet split across spans is carried over by the parser.
+ * Packets are tagged with the tag of the span their last byte came in.
+ */
+void KlvIngestLoop::run() {
+    KlvByteRing::Span spans[64];
+    KlvTree* tree = NULL;
+    size_t n;
+    while((n = input.pop(spans, 64)) > 0) {
+        for(size_t i = 0; i < n; i++) {
+            size_t offset = 0;
+            while(offset < spans[i].size) {
+                while(tree == NULL && !free_trees.tryPop(tree)) {
+                    // every tree is with the consumer
+                    if(input.isClosed())
+                        return;
+                    std::this_thread::yield();
+                }
+
+                offset += parser.parseTree(spans[i].data + offset, spans[i].size - offset, *tree);
+                if(!tree->empty()) {
+                    Packet packet = {tree, spans[i].tag};
+                    output.tryPush(packet);     // never full, it has a slot per tree
+                    tree = NULL;
+                }
+            }
+        }
+        input.release();
+    }
+}
+
+/**
+ * @brief Stops run(), which returns without parsing what is left in the input
+ *        ring. May be called from any thread.
+ */
+void KlvIngestLoop::close() {
+    input.close();
+}
+
+/**
+ * @brief Takes the next completed packet. Consumer only.
+ *
+ * @param  packet receives the packet
+ * @return        false if there is none
+ */
+bool KlvIngestLoop::poll(Packet& packet) {
+    return output.tryPop(packet);
+}
+
+/**
+ * @brief Takes up to max completed packets in one go. Consumer only.
+ *
+ * @param  packets receives the packets, in stream order
+ * @param  max     size of packets
+ * @return         number of packets taken
+ */
+size_t KlvIngestLoop::poll(Packet* packets, size_t max) {
+    return output.tryPop(packets, max);
+}
+
+/**
+ * @brief Gives a tree from poll() back to the pool. Consumer only.
+ *
+ * @param tree the tree, which must not be used afterwards
+ */
+void KlvIngestLoop::recycle(KlvTree* tree) {
+    free_trees.tryPush(tree);
+}
@@ -0,0 +1,40 @@
+//
+//  KlvKeyRegistry.cpp
+//  libklv
+//
+
+#include "KlvKeyRegistry.hpp"
+
+const size_t KlvKeyRegistry::NOT_FOUND;
+const uint32_t KlvKeyRegistry::EMPTY;
+
+void KlvKeyRegistry::add(const KlvUniversalKey& key, const Rule& rule) {
+    size_t index = find(key);
+    if(index != NOT_FOUND) {
+        rules[index] = rule;
+        return;
+    }
+
+    keys.push_back(key);
+    rules.push_back(rule);
+    rebuild();
+}
+
+/**
+ * Rehashes every key into a table at least twice as large as the number of
+ * keys, so that probing always ends at a free slot.
+ */
+void KlvKeyRegistry::rebuild() {
+    size_t num_slots = 4;
+    while(num_slots < 2 * keys.size())
+        num_slots *= 2;
+
+    slots.assign(num_slots, EMPTY);
+    mask = num_slots - 1;
+    for(size_t i = 0; i < keys.size(); i++) {
+        size_t slot = keys[i].hash() & mask;
+        while(slots[slot] != EMPTY)
+            slot = (slot + 1) & mask;
+        slots[slot] = (uint32_t) i;
+    }
+}
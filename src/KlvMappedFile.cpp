@@ -0,0 +1,52 @@
+//
+//  KlvMappedFile.cpp
+//  libklv
+//
+
+#include "KlvMappedFile.hpp"
+#include <cerrno>
+#include <cstring>
+#include <stdexcept>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+/**
+ * @brief Maps a file into memory, read only.
+ *
+ * @param path path of the file
+ */
+KlvMappedFile::KlvMappedFile(const std::string& path) : bytes(NULL), length(0) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if(fd < 0)
+        throw std::runtime_error("cannot open " + path + ": " + strerror(errno));
+
+    struct stat st;
+    if(fstat(fd, &st) != 0) {
+        int err = errno;
+        close(fd);
+        throw std::runtime_error("cannot stat " + path + ": " + strerror(err));
+    }
+
+    length = (size_t) st.st_size;
+    if(length > 0) {
+        void* p = mmap(NULL, length, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(p == MAP_FAILED) {
+            int err = errno;
+            close(fd);
+            throw std::runtime_error("cannot map " + path + ": " + strerror(err));
+        }
+        // captures are read front to back, let the kernel read ahead
+        madvise(p, length, MADV_SEQUENTIAL);
+        bytes = (const uint8_t*) p;
+    }
+
+    // the mapping keeps its own reference to the file
+    close(fd);
+}
+
+KlvMappedFile::~KlvMappedFile() {
+    if(bytes != NULL)
+        munmap((void*) bytes, length);
+}
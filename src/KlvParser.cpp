@@ -7,8 +7,14 @@
 //
 
 #include "KlvParser.hpp"
+#include "KlvFormatException.hpp"
+#include "KlvKeyRegistry.hpp"
+#include "KlvScan.hpp"
+#include "KlvTrace.hpp"
 #include <algorithm>
-#include <stdio.h>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
 
 /**
  * Constructs a new KLV parser. Since keys can be encoded using different methods, 
@@ -25,6 +31,172 @@ KlvParser::KlvParser(std::vector<KeyEncoding> key_encodings) {
     ctr = 0;
     resetFields();
     this->key_encodings = key_encodings;
+    this->lazy_nesting = false;
+    this->checksum_mode = CHECKSUM_OFF;
+    this->num_checksum_failures = 0;
+    this->num_errors = 0;
+    this->last_error = KLV_OK;
+    this->set_parser = this;
+    this->set_checksum = true;
+    this->set_handler = NULL;
+}
+
+KlvParser::Limits::Limits() {
+    max_value_size = (unsigned long) std::min<unsigned long long>(MAX_KLV_VALUE_SIZE, std::numeric_limits<unsigned long>::max());
+    max_ber_bytes = sizeof(unsigned long);
+    max_depth = 16;
+}
+
+namespace {
+    /**
+     * Lazy decoder installed on KLVs by a parser in lazy nesting mode. Parses the
+     * value field with the remaining key encodings and filters, leaving any
+     * deeper levels lazy as well.
+     */
+    class NestedKlvDecoder : public KlvLazyDecoder {
+    public:
+        NestedKlvDecoder(const std::vector<KlvParser::KeyEncoding>& key_encodings, const KlvParser::Limits& limits,
+                         const std::vector<KlvFilter>& filters)
+            : key_encodings(key_encodings), limits(limits), filters(filters) {}
+
+        std::vector<KLV*> decode(const KLV& parent) const {
+            KlvParser parser(key_encodings);
+            parser.setLimits(limits);
+            for(size_t i = 0; i < filters.size(); i++)
+                parser.setFilter(i, filters[i]);
+            parser.setLazyNesting(true);
+            std::vector<KLV*> klvs;
+            parser.parse(parent.getValue().data(), parent.getValue().size(), klvs);
+            return klvs;
+        }
+
+    private:
+        std::vector<KlvParser::KeyEncoding> key_encodings;
+        KlvParser::Limits limits;   /// limits for the children, max_depth already counted down
+        std::vector<KlvFilter> filters; /// filters from the children's level down
+    };
+
+    std::vector<KlvFilter> filtersBelow(const std::vector<KlvFilter>& filters) {
+        return filters.empty() ? filters : std::vector<KlvFilter>(filters.begin() + 1, filters.end());
+    }
+}
+
+/**
+ * Turns lazy nesting on or off. With lazy nesting, KLVs returned by parse() and
+ * parseByte() are complete as soon as their value has been read, and their
+ * embedded KLVs are only parsed the first time KLV::getChild() or
+ * KLV::indexToMap() needs them. Consumers that only look at the top level key
+ * and raw value never pay for nested decoding.
+ *
+ * @param lazy true to decode nested KLVs on first access
+ */
+void KlvParser::setLazyNesting(bool lazy) {
+    lazy_nesting = lazy;
+    lazy_decoder.reset();
+    if(lazy && key_encodings.size() > 1 && limits.max_depth > 0) {
+        Limits child_limits = limits;
+        child_limits.max_depth--;
+        lazy_decoder.reset(new NestedKlvDecoder(std::vector<KeyEncoding>(key_encodings.begin()+1, key_encodings.end()),
+                                                child_limits, filtersBelow(filters)));
+    }
+    configureSetParsers();
+}
+
+/**
+ * Sets the limits on accepted KLVs.
+ *
+ * @param limits new limits
+ * @throws std::invalid_argument if max_ber_bytes is more than an unsigned long
+ *         can hold
+ */
+void KlvParser::setLimits(const Limits& limits) {
+    if(limits.max_ber_bytes > sizeof(unsigned long))
+        throw std::invalid_argument("max_ber_bytes is larger than an unsigned long");
+    this->limits = limits;
+
+    // the lazy decoder and the parser for the children carry the limits for them
+    setLazyNesting(lazy_nesting);
+    sub_parser.reset();
+}
+
+/**
+ * Keeps only the KLVs that pass filter on one nesting level.
+ *
+ * @param depth  nesting depth, 0 for the top level
+ * @param filter KLVs to keep
+ */
+void KlvParser::setFilter(size_t depth, const KlvFilter& filter) {
+    if(filters.size() <= depth)
+        filters.resize(depth + 1);
+    filters[depth] = filter;
+
+    // the lazy decoder and the parser for the children carry the filters below this level
+    setLazyNesting(lazy_nesting);
+    sub_parser.reset();
+}
+
+/**
+ * Keeps every KLV on every level again.
+ */
+void KlvParser::clearFilters() {
+    filters.clear();
+    setLazyNesting(lazy_nesting);
+    sub_parser.reset();
+}
+
+/**
+ * Decodes each top level universal set by the rule registered for its key.
+ *
+ * @param registry rules per universal key
+ * @throws std::invalid_argument if the top level keys are not 16-byte
+ *         universal keys
+ */
+void KlvParser::setKeyRegistry(const KlvKeyRegistry& registry) {
+    if(key_encodings.empty() || key_encodings[0] != KEY_ENCODING_16_BYTE)
+        throw std::invalid_argument("a key registry needs 16-byte top level keys");
+    this->registry.reset(new KlvKeyRegistry(registry));
+    configureSetParsers();
+}
+
+/**
+ * Decodes every top level KLV with the parser's own key encodings again.
+ */
+void KlvParser::clearKeyRegistry() {
+    registry.reset();
+    configureSetParsers();
+}
+
+/**
+ * Creates the parser for the nested levels of each rule in the registry, with
+ * the limits and lazy nesting of this parser. Of this parser's filters only
+ * the top level one is passed on, since the nested levels of each standard
+ * are numbered by their own tags; the rule's filters take their place.
+ * Called whenever one of those changes.
+ */
+void KlvParser::configureSetParsers() {
+    set_parsers.clear();
+    set_parser = this;
+    set_checksum = true;
+    set_handler = NULL;
+    if(!registry)
+        return;
+
+    for(size_t i = 0; i < registry->size(); i++) {
+        const KlvKeyRegistry::Rule& rule = registry->getRule(i);
+        std::vector<KeyEncoding> encodings(1, KEY_ENCODING_16_BYTE);
+        if(rule.descend)
+            encodings.insert(encodings.end(), rule.key_encodings.begin(), rule.key_encodings.end());
+
+        KlvParser* parser = new KlvParser(encodings);
+        set_parsers.push_back(std::unique_ptr<KlvParser>(parser));
+        if(!filters.empty() || !rule.filters.empty()) {
+            // the rule's filters start at the set's items, depth 1 of its parser
+            parser->filters.push_back(filters.empty() ? KlvFilter() : filters[0]);
+            parser->filters.insert(parser->filters.end(), rule.filters.begin(), rule.filters.end());
+        }
+        parser->setLimits(limits);
+        parser->setLazyNesting(lazy_nesting);
+    }
 }
 
 KlvParser::~KlvParser() {
@@ -43,204 +215,991 @@ KlvParser::~KlvParser() {
  *               parsed or error occured. Ownership is transfered to the caller.
  */
 KLV* KlvParser::parseByte(uint8_t byte) {
-    ctr++;
-    printf("PARSING BYTE %ld : %x\n", ctr, byte);
-    switch(state) {
-    case STATE_INIT: {       // init state
-        // keep parsing until last 16 bytes match with KLV universal key
-        // keep parsing until first 4 bytes of the 16-byte KLV universal key is detected
-        // store last 16 bytes in key
-        // keep parsing until first 4 bytes of the 16-byte key match the 4-byte KLV unversal key header
-        key.push_back(byte);
-
-        // handle looking for KEY depending on how its encoded
-        switch(key_encodings[0]) {
-        case KEY_ENCODING_1_BYTE: {
-            state = STATE_KEY;
-            printf("KlvParser transitioning to STATE_KEY\n");
+    KLV_TRACE(KLV_TRACE_BYTE, "PARSING BYTE %ld : %x", ctr + 1, byte);
+    KLV* klv = NULL;
+    parseSpan(&byte, 1);
+    if(state == STATE_VALUE) {
+        unsigned long failures = num_checksum_failures;
+        klv = finishKlv();
+        if(checksum_mode == CHECKSUM_THROW && num_checksum_failures != failures)
+            throw KlvFormatException(KLV_ERROR_CHECKSUM);
+    }
+    return klv;
+}
+
+/**
+ * Parses a buffer of bytes and returns every complete KLV found in it. Any
+ * trailing partial KLV is kept in the parser state and completed by the next
+ * call to parse() or parseByte().
+ *
+ * @param  data pointer to the bytes to parse
+ * @param  size number of bytes to parse
+ * @return      the KLVs completed by this buffer, in stream order. Ownership of
+ *              each KLV is transfered to the caller.
+ */
+std::vector<KLV*> KlvParser::parse(const uint8_t* data, size_t size) {
+    std::vector<KLV*> klvs;
+    unsigned long failures = num_checksum_failures;
+    parse(data, size, klvs);
+    if(checksum_mode == CHECKSUM_THROW && num_checksum_failures != failures) {
+        for(size_t i = 0; i < klvs.size(); i++)
+            KLV::deleteTree(klvs[i]);
+        throw KlvFormatException(KLV_ERROR_CHECKSUM);
+    }
+    return klvs;
+}
+
+/**
+ * Parses a vector of bytes. See parse(const uint8_t*, size_t).
+ *
+ * @param  data bytes to parse
+ * @return      the KLVs completed by this buffer, in stream order
+ */
+std::vector<KLV*> KlvParser::parse(const std::vector<uint8_t>& data) {
+    return parse(data.data(), data.size());
+}
+
+/**
+ * Parses a buffer of bytes and appends every complete KLV found in it to klvs.
+ * Rejected KLVs are skipped and reported through the return value; this never
+ * throws KlvFormatException.
+ *
+ * @param  data pointer to the bytes to parse
+ * @param  size number of bytes to parse
+ * @param  klvs receives the KLVs completed by this buffer, in stream order
+ * @return      KLV_OK, or the status of the last KLV rejected in this buffer
+ */
+KlvStatus KlvParser::parse(const uint8_t* data, size_t size, std::vector<KLV*>& klvs) {
+    unsigned long errors = num_errors;
+    size_t offset = 0;
+    while(offset < size) {
+        offset += parseSpan(data + offset, size - offset);
+        if(state != STATE_VALUE)
+            continue;
+
+        KLV* klv = finishKlv();
+        if(klv != NULL)
+            klvs.push_back(klv);
+    }
+    return num_errors != errors ? last_error : KLV_OK;
+}
+
+/**
+ * Parses a buffer of bytes and returns zero-copy views of every complete KLV
+ * found in it. Views are only valid until the next call to parseViews(), and
+ * only while data is alive.
+ *
+ * @param  data pointer to the bytes to parse
+ * @param  size number of bytes to parse
+ * @return      views of the KLVs completed by this buffer, in stream order
+ */
+std::vector<const KlvView*> KlvParser::parseViews(const uint8_t* data, size_t size) {
+    std::vector<const KlvView*> result;
+    view_arena.reset();
+
+    size_t offset = 0;
+    while(offset < size) {
+        const uint8_t* klv_data = NULL;
+        Frame f;
+        offset += frameNext(data + offset, size - offset, &klv_data, f);
+        if(klv_data == NULL)
+            continue;
+
+        if(klv_data == carry.data()) {
+            // started by an earlier call, keep the parser's copy until the next call
+            klv_data = view_arena.copy(carry.data(), carry.size());
+        }
+        result.push_back(buildView(view_arena, klv_data, f));
+    }
+
+    return result;
+}
+
+/**
+ * Parses a buffer of bytes and reports every complete KLV found in it, with its
+ * nested KLVs, to visitor. Each KLV is framed with frameNext(), the same as for
+ * parseTree(), and then walked where it lies.
+ *
+ * @param  data    pointer to the bytes to parse
+ * @param  size    number of bytes to parse
+ * @param  visitor receives the events, in stream order
+ * @return         KLV_OK, or the status of the last KLV rejected in this buffer
+ */
+KlvStatus KlvParser::parse(const uint8_t* data, size_t size, KlvVisitor& visitor) {
+    unsigned long errors = num_errors;
+    size_t offset = 0;
+    while(offset < size) {
+        const uint8_t* klv_data = NULL;
+        Frame f;
+        offset += frameNext(data + offset, size - offset, &klv_data, f);
+        if(klv_data == NULL)
+            continue;
+
+        bool checksum_ok = true;
+        if(checksum_mode != CHECKSUM_OFF && set_checksum) {
+            checksum_ok = f.value_size >= 4 && KlvChecksum::verify(klv_data + f.key_offset, f.end() - f.key_offset);
+            if(!checksum_ok && checksum_mode != CHECKSUM_MARK) {
+                num_checksum_failures++;
+                reject(KLV_ERROR_CHECKSUM);
+                continue;
+            }
+        }
+        set_parser->visitKlv(set_handler != NULL ? *set_handler : visitor, klv_data, f, 0, checksum_ok);
+        if(set_parser != this)
+            stats.raiseDepth(set_parser->stats.getMaxDepth());
+    }
+    return num_errors != errors ? last_error : KLV_OK;
+}
+
+/**
+ * Reports a framed KLV to a visitor: as a set, followed by the KLVs framed in
+ * its value, if there is a key encoding and depth left below it, and as an
+ * item otherwise. Items that break a limit are skipped the way the state
+ * machine skips them, and a truncated last item is dropped, so the events match
+ * the tree parse() builds.
+ *
+ * @param  visitor     receives the events
+ * @param  data        buffer the frame is relative to
+ * @param  frame       location of the KLV in data
+ * @param  depth       nesting depth of the KLV, 0 for the top level
+ * @param  checksum_ok false to report the set as not ok
+ * @return             false if the value of a set did not frame cleanly
+ */
+bool KlvParser::visitKlv(KlvVisitor& visitor, const uint8_t* data, const Frame& frame, size_t depth, bool checksum_ok) {
+    KlvSpan key(data + frame.key_offset, frame.key_size);
+    KlvSpan len(data + frame.lenOffset(), frame.len_size);
+    KlvSpan value(data + frame.valueOffset(), frame.value_size);
+    if(depth + 1 >= key_encodings.size() || depth >= limits.max_depth) {
+        visitor.onItem(depth, decodeTag(key.data, key.size, key_encodings[depth]), key, len, value);
+        return true;
+    }
+
+    visitor.onSetBegin(depth, key, len, value);
+    bool ok = checksum_ok;
+    size_t offset = 0;
+    size_t num_children = 0;
+    Frame f;
+    while(offset < value.size) {
+        KlvStatus status = KlvParser::frame(value.data + offset, value.size - offset, key_encodings[depth + 1], limits, f);
+        if(status == KLV_INCOMPLETE) {
+            ok = false;
             break;
         }
-        case KEY_ENCODING_2_BYTE: {
-            if(key.size() == 2) {
+        if(status != KLV_OK || f.key_offset != 0)
+            ok = false;
+        if(status == KLV_OK && accepts(depth + 1, value.data + offset + f.key_offset, f.key_size)) {
+            num_children++;
+            if(!visitKlv(visitor, value.data + offset, f, depth + 1, true))
+                ok = false;
+        }
+        offset += status == KLV_OK ? f.end() : f.valueOffset();
+    }
+    if(num_children > 0)
+        stats.raiseDepth(depth + 1);
+    visitor.onSetEnd(depth, ok);
+    return ok;
+}
+
+/**
+ * Parses bytes until one KLV has been completed and stores it (with all of its
+ * nested KLVs) in an arena-backed tree. The tree is cleared first, so its memory
+ * is recycled from the previous packet.
+ *
+ * @param  data        pointer to the bytes to parse
+ * @param  size        number of bytes to parse
+ * @param  tree        receives the KLV. Left empty if data ends before a KLV
+ *                     is complete.
+ * @param  copy_values true to copy the bytes of the KLV into the tree's arena,
+ *                     false to point into data (which must then outlive tree)
+ * @return             number of bytes consumed from data
+ */
+size_t KlvParser::parseTree(const uint8_t* data, size_t size, KlvTree& tree, bool copy_values) {
+    tree.clear();
+
+    const uint8_t* klv_data = NULL;
+    Frame f;
+    size_t consumed = frameNext(data, size, &klv_data, f);
+    if(klv_data == NULL)
+        return consumed;
+
+    if(copy_values || klv_data == carry.data()) {
+        klv_data = tree.arena.copy(klv_data + f.key_offset, f.end() - f.key_offset);
+        f.key_offset = 0;
+    }
+    tree.root = buildView(tree.arena, klv_data, f);
+
+    const std::vector<KeyEncoding>& encodings = set_parser->key_encodings;
+    if(encodings.size() > 1) {
+        for(const KlvView* item = tree.root->getChild(); item != NULL; item = item->getNext())
+            tree.index.insert(decodeTag(item->getKey().data, item->getKey().size, encodings[1]), item);
+    }
+
+    return consumed;
+}
+
+/**
+ * Parses bytes until one KLV has been completed and stores it (with all of its
+ * nested KLVs) in a flat tree. The tree is cleared first, so its memory is
+ * recycled from the previous packet.
+ *
+ * @param  data pointer to the bytes to parse
+ * @param  size number of bytes to parse
+ * @param  tree receives the KLV. Left empty if data ends before a KLV is
+ *              complete.
+ * @return      number of bytes consumed from data
+ */
+size_t KlvParser::parseFlat(const uint8_t* data, size_t size, KlvFlatTree& tree) {
+    tree.clear();
+
+    const uint8_t* klv_data = NULL;
+    Frame f;
+    size_t consumed = frameNext(data, size, &klv_data, f);
+    if(klv_data == NULL)
+        return consumed;
+
+    tree.bytes.assign(klv_data + f.key_offset, klv_data + f.end());
+    f.key_offset = 0;
+    set_parser->addFlatNode(tree, f, 0, 0, KlvFlatTree::NONE);
+    if(set_parser != this)
+        stats.raiseDepth(set_parser->stats.getMaxDepth());
+
+    return consumed;
+}
+
+/**
+ * Advances the parser to the end of the next complete KLV without building
+ * anything for it. A KLV that lies entirely inside data is framed in place. One
+ * that was started by an earlier call (or runs past the end of data) goes
+ * through the state machine, and once complete its bytes are staged in carry,
+ * where they stay until the next call.
+ *
+ * @param  data     pointer to the bytes to parse
+ * @param  size     number of bytes to parse
+ * @param  klv_data set to the buffer the completed KLV's frame is relative to
+ *                  (either data or carry.data()), or NULL if no KLV was
+ *                  completed
+ * @param  f        filled in with the location of the completed KLV
+ * @return          number of bytes consumed from data
+ */
+size_t KlvParser::frameNext(const uint8_t* data, size_t size, const uint8_t** klv_data, Frame& f) {
+    *klv_data = NULL;
+
+    if(state == STATE_INIT && key.empty() && frame(data, size, key_encodings[0], limits, f) == KLV_OK) {
+        // the whole KLV is in the caller's buffer, and is skipped right there
+        // if the filter does not keep it
+        ctr += f.end();
+        stats.addBytesRead(f.end());
+        stats.addBytesDiscarded(f.key_offset);
+        if(admit(data + f.key_offset, f.key_size)) {
+            stats.countKlv(data + f.key_offset, f.key_size, f.value_size);
+            *klv_data = data;
+        } else {
+            stats.countFiltered();
+        }
+        return f.end();
+    }
+
+    // the KLV runs past the end of the buffer (or was started by an earlier
+    // call), so fall back to copying it into the parser
+    size_t consumed = parseSpan(data, size);
+    if(state == STATE_VALUE) {
+        stats.countKlv(key.data(), key.size(), val_len);
+        carry.assign(key.begin(), key.end());
+        carry.insert(carry.end(), len.begin(), len.end());
+        carry.insert(carry.end(), val.begin(), val.end());
+
+        f.key_offset = 0;
+        f.key_size = key.size();
+        f.len_size = len.size();
+        f.value_size = val_len;
+        *klv_data = carry.data();
+        resetFields();
+    }
+    return consumed;
+}
+
+/**
+ * Locates the first complete KLV in a contiguous buffer without copying it.
+ *
+ * @param  data         pointer to the buffer
+ * @param  size         size of the buffer
+ * @param  key_encoding encoding of the key
+ * @param  frame        filled in with the location of the KLV
+ * @return              true if a complete KLV was found
+ */
+bool KlvParser::frame(const uint8_t* data, size_t size, KeyEncoding key_encoding, Frame& frame) {
+    static const Limits defaults;
+    return KlvParser::frame(data, size, key_encoding, defaults, frame) == KLV_OK;
+}
+
+/**
+ * Locates the first complete KLV in a contiguous buffer, checking its length
+ * field against limits.
+ *
+ * @param  data         pointer to the buffer
+ * @param  size         size of the buffer
+ * @param  key_encoding encoding of the key
+ * @param  limits       limits to check
+ * @param  frame        filled in with the location of the KLV. For a rejected
+ *                      KLV, valueOffset() is the first byte after its length
+ *                      field as far as the parser reads it.
+ * @return              KLV_OK, KLV_INCOMPLETE, or the limit that was broken
+ */
+KlvStatus KlvParser::frame(const uint8_t* data, size_t size, KeyEncoding key_encoding, const Limits& limits, Frame& frame) {
+    size_t i = 0;
+
+    // find the key
+    switch(key_encoding) {
+    case KEY_ENCODING_1_BYTE:
+    case KEY_ENCODING_2_BYTE:
+    case KEY_ENCODING_4_BYTE: {
+        frame.key_offset = 0;
+        frame.key_size = key_encoding == KEY_ENCODING_1_BYTE ? 1 : (key_encoding == KEY_ENCODING_2_BYTE ? 2 : 4);
+        break;
+    }
+    case KEY_ENCODING_16_BYTE: {
+        // first position where the UL header starts a key
+        frame.key_offset = KlvScan::findUlHeader(data, size);
+        frame.key_size = KLV_KEY_SIZE;
+        break;
+    }
+    case KEY_ENCODING_BER_OID: {
+        // last byte of the BER-OID key has bit 8 cleared
+        while(i < size && (data[i] & 0b10000000))
+            i++;
+        frame.key_offset = 0;
+        frame.key_size = i + 1;
+        break;
+    }
+    default:
+        return KLV_INCOMPLETE;
+    }
+
+    return frameLength(data, size, limits, frame);
+}
+
+/**
+ * @brief Reads the length field of a KLV whose key has been located, checking
+ *        it against limits.
+ *
+ * @param  data   pointer to the buffer
+ * @param  size   size of the buffer
+ * @param  limits limits to check
+ * @param  frame  key_offset and key_size set by the caller; len_size and
+ *                value_size are filled in
+ * @return        KLV_OK, KLV_INCOMPLETE, or the limit that was broken
+ */
+KlvStatus KlvParser::frameLength(const uint8_t* data, size_t size, const Limits& limits, Frame& frame) {
+    // read the BER length
+    size_t i = frame.lenOffset();
+    if(i >= size)
+        return KLV_INCOMPLETE;
+
+    if(data[i] & 0b10000000) {
+        size_t ber_len = data[i] & 0b01111111;
+        if(ber_len == 0 || ber_len > limits.max_ber_bytes) {
+            // rejected on the first length byte, like the state machine does
+            frame.len_size = 1;
+            frame.value_size = 0;
+            return KLV_ERROR_BER_LENGTH;
+        }
+        if(i + 1 + ber_len > size)
+            return KLV_INCOMPLETE;
+        frame.len_size = 1 + ber_len;
+        frame.value_size = 0;
+        for(size_t j = 1; j <= ber_len; j++) {
+            frame.value_size <<= 8;
+            frame.value_size |= data[i+j];
+        }
+    } else {
+        frame.len_size = 1;
+        frame.value_size = data[i];
+    }
+
+    if(frame.value_size > limits.max_value_size)
+        return KLV_ERROR_VALUE_SIZE;
+
+    // make sure the value is all there
+    return frame.value_size <= size - frame.valueOffset() ? KLV_OK : KLV_INCOMPLETE;
+}
+
+/**
+ * Decodes a key into an integer tag.
+ *
+ * @param  key          pointer to the key
+ * @param  size         size of the key
+ * @param  key_encoding encoding of the key
+ * @return              the tag, 0 for 16-byte universal keys
+ */
+uint64_t KlvParser::decodeTag(const uint8_t* key, size_t size, KeyEncoding key_encoding) {
+    uint64_t tag = 0;
+    switch(key_encoding) {
+    case KEY_ENCODING_1_BYTE:
+    case KEY_ENCODING_2_BYTE:
+    case KEY_ENCODING_4_BYTE:
+        for(size_t i = 0; i < size; i++)
+            tag = (tag << 8) | key[i];
+        break;
+    case KEY_ENCODING_BER_OID:
+        // 7 bits per byte, most significant group first
+        for(size_t i = 0; i < size; i++)
+            tag = (tag << 7) | (key[i] & 0b01111111);
+        break;
+    default:
+        break;
+    }
+    return tag;
+}
+
+/**
+ * Creates a view for a framed KLV, along with its child views if there are more
+ * key encodings than the top level one.
+ *
+ * @param  arena arena to allocate the views from
+ * @param  data  buffer the frame is relative to
+ * @param  frame location of the KLV in data
+ * @return       the new view, owned by arena
+ */
+KlvView* KlvParser::buildView(KlvArena& arena, const uint8_t* data, const Frame& frame) {
+    KlvView* view = arena.create<KlvView>(KlvSpan(data + frame.key_offset, frame.key_size),
+                                          KlvSpan(data + frame.lenOffset(), frame.len_size),
+                                          KlvSpan(data + frame.valueOffset(), frame.value_size),
+                                          frame.value_size);
+    set_parser->buildChildViews(arena, view, 1);
+    if(set_parser != this)
+        stats.raiseDepth(set_parser->stats.getMaxDepth());
+    return view;
+}
+
+/**
+ * Frames the embedded KLVs in the value of a view and links them in as its
+ * children, recursing for as many levels as there are key encodings.
+ *
+ * @param arena  arena to allocate the views from
+ * @param parent view whose value is to be parsed
+ * @param depth  index of the key encoding used by the children
+ */
+void KlvParser::buildChildViews(KlvArena& arena, KlvView* parent, size_t depth) {
+    if(depth >= key_encodings.size() || depth > limits.max_depth)
+        return;
+
+    KlvSpan value = parent->getValue();
+    KlvView* previous = NULL;
+    size_t offset = 0;
+    Frame f;
+    while(offset < value.size && frame(value.data + offset, value.size - offset, key_encodings[depth], limits, f) == KLV_OK) {
+        if(!accepts(depth, value.data + offset + f.key_offset, f.key_size)) {
+            offset += f.end();
+            continue;
+        }
+        KlvView* view = arena.create<KlvView>(KlvSpan(value.data + offset + f.key_offset, f.key_size),
+                                              KlvSpan(value.data + offset + f.lenOffset(), f.len_size),
+                                              KlvSpan(value.data + offset + f.valueOffset(), f.value_size),
+                                              f.value_size);
+        view->setParent(parent);
+        if(previous == NULL) {
+            parent->setChild(view);
+        } else {
+            previous->setNextSibling(view);
+            view->setPreviousSibling(previous);
+        }
+        buildChildViews(arena, view, depth + 1);
+
+        previous = view;
+        offset += f.end();
+    }
+    if(previous != NULL)
+        stats.raiseDepth(depth);
+}
+
+/**
+ * Appends a framed KLV to a flat tree, followed (depth first) by its nested
+ * KLVs if there are key encodings left for them.
+ *
+ * @param  tree      tree to append to
+ * @param  klv_frame location of the KLV, relative to offset
+ * @param  offset    offset in tree.bytes that klv_frame is relative to
+ * @param  depth     nesting depth of the KLV, 0 for the top level
+ * @param  parent    index of the parent node, KlvFlatTree::NONE for the top level
+ * @return           index of the new node
+ */
+uint32_t KlvParser::addFlatNode(KlvFlatTree& tree, const Frame& klv_frame, size_t offset, size_t depth, uint32_t parent) {
+    KlvFlatNode node;
+    node.key_offset = (uint32_t) (offset + klv_frame.key_offset);
+    node.key_size = (uint8_t) klv_frame.key_size;
+    node.len_size = (uint8_t) klv_frame.len_size;
+    node.depth = (uint16_t) depth;
+    node.value_offset = (uint32_t) (offset + klv_frame.valueOffset());
+    node.value_size = (uint32_t) klv_frame.value_size;
+    node.tag = decodeTag(&tree.bytes[node.key_offset], klv_frame.key_size, key_encodings[depth]);
+    node.parent = parent;
+    node.first_child = KlvFlatTree::NONE;
+    node.next_sibling = KlvFlatTree::NONE;
+
+    uint32_t index = (uint32_t) tree.nodes.size();
+    tree.nodes.push_back(node);
+
+    if(depth + 1 >= key_encodings.size() || depth + 1 > limits.max_depth)
+        return index;
+
+    // frame the nested KLVs in the value
+    size_t value_offset = node.value_offset;
+    size_t value_end = value_offset + node.value_size;
+    uint32_t previous = KlvFlatTree::NONE;
+    Frame f;
+    while(value_offset < value_end
+            && frame(&tree.bytes[value_offset], value_end - value_offset, key_encodings[depth + 1], limits, f) == KLV_OK) {
+        if(!accepts(depth + 1, &tree.bytes[value_offset + f.key_offset], f.key_size)) {
+            value_offset += f.end();
+            continue;
+        }
+        uint32_t child = addFlatNode(tree, f, value_offset, depth + 1, index);
+        if(depth == 0)
+            tree.index.insert(tree.nodes[child].tag, child);
+        if(previous == KlvFlatTree::NONE)
+            tree.nodes[index].first_child = child;
+        else
+            tree.nodes[previous].next_sibling = child;
+
+        previous = child;
+        value_offset += f.end();
+    }
+    if(previous != KlvFlatTree::NONE)
+        stats.raiseDepth(depth + 1);
+
+    return index;
+}
+
+/**
+ * Runs the parser state machine over a span of bytes until either the span is
+ * exhausted or a KLV has been completed, whichever comes first. The value field
+ * is copied as one contiguous span once its length is known. When a KLV has been
+ * completed the parser is left in STATE_VALUE with key, len, and val filled in;
+ * the caller consumes them and then calls resetFields().
+ *
+ * @param  data pointer to the bytes to parse
+ * @param  size number of bytes available
+ * @return      number of bytes consumed from data
+ */
+size_t KlvParser::parseSpan(const uint8_t* data, size_t size) {
+    static_assert(KlvParserStats::NUM_STATES == STATE_SKIP + 1, "one timer per state");
+    KLV_STATE_TIMER(stats, state);
+
+    size_t i = 0;
+    while(i < size) {
+        switch(state) {
+        case STATE_INIT: {       // init state
+            if(key_encodings[0] == KEY_ENCODING_16_BYTE) {
+                // skip ahead to the next 16-byte universal key
+                i += scanForKey(data + i, size - i);
+                break;
+            }
+
+            uint8_t byte = data[i++];
+            key.push_back(byte);
+
+            // handle looking for KEY depending on how its encoded
+            switch(key_encodings[0]) {
+            case KEY_ENCODING_1_BYTE: {
                 state = STATE_KEY;
-                printf("KlvParser transitioning to STATE_KEY\n");
+                KLV_TRACE(KLV_TRACE_DEBUG, "KlvParser transitioning to STATE_KEY");
+                break;
+            }
+            case KEY_ENCODING_2_BYTE: {
+                if(key.size() == 2) {
+                    state = STATE_KEY;
+                    KLV_TRACE(KLV_TRACE_DEBUG, "KlvParser transitioning to STATE_KEY");
+                }
+                break;
+            }
+            case KEY_ENCODING_4_BYTE: {
+                if(key.size() == 4) {
+                    state = STATE_KEY;
+                    KLV_TRACE(KLV_TRACE_DEBUG, "KlvParser transitioning to STATE_KEY");
+                }
+                break;
+            }
+            case KEY_ENCODING_BER_OID: {
+                // keep parsing until we read a byte where bit 8 is 0 (indicating we've read the LSB of the BER-OID key)
+                // TODO: the KLV class actually should have a human-readable tag due to this encoding technique
+                if(!(byte & 0b10000000)) {
+                    state = STATE_KEY;
+                    KLV_TRACE(KLV_TRACE_DEBUG, "KlvParser transitioning to STATE_KEY");
+                }
+                break;
+            }
+            default:
+                // not supposed to be here :-)
+                break;
             }
+
             break;
         }
-        case KEY_ENCODING_4_BYTE: {
-            if(key.size() == 4) { 
-                state = STATE_KEY;
-                printf("KlvParser transitioning to STATE_KEY\n");
+
+        case STATE_KEY: {       // read KLV 16-byte universal key
+            // read byte, and figure out if long or short BER form
+            uint8_t byte = data[i++];
+            len.push_back(byte);
+            ber_long_form = (bool) (byte & 0b10000000);
+
+            if(ber_long_form) {
+                ber_len = byte & 0b01111111;
+                if(ber_len == 0 || ber_len > limits.max_ber_bytes) {
+                    // indefinite form (no length bytes) or more than we can hold
+                    reject(KLV_ERROR_BER_LENGTH);
+                    break;
+                }
+                state = STATE_LEN_HEADER;
+                val_len = 0;
+                KLV_TRACE(KLV_TRACE_DEBUG, "BER-Len field is long-form, BER len: %lu", ber_len);
+                KLV_TRACE(KLV_TRACE_DEBUG, "KlvParser transitioning to STATE_LEN_HEADER");
+            } else {
+                val_len = byte & 0b01111111;
+                if(val_len > limits.max_value_size) {
+                    reject(KLV_ERROR_VALUE_SIZE);
+                    break;
+                }
+                KLV_TRACE(KLV_TRACE_DEBUG, "BER-Len field is short-form, value length: %lu", val_len);
+                startValue();
             }
             break;
         }
-        case KEY_ENCODING_16_BYTE: {
-            if(key.size() > 16)
-                key.erase(key.begin());
 
-            if(checkIfContainsKlvKey(key)) {
-                // found the 4-byte KLV universal key header at beginning
-                state = STATE_KEY;
-                printf("KlvParser transitioning to STATE_KEY\n");
+        case STATE_LEN_HEADER: { // read first byte in BER-encoded length field
+            // keep parsing for ber_len bytes and store into val_len
+            uint8_t byte = data[i++];
+            len.push_back(byte);
+            val_len <<= 8;
+            val_len |= byte;
+            num_ber_len_bytes_read++;
+            if(num_ber_len_bytes_read == ber_len) {
+                if(val_len > limits.max_value_size) {
+                    // rejected before any of the value is read
+                    reject(KLV_ERROR_VALUE_SIZE);
+                    break;
+                }
+                KLV_TRACE(KLV_TRACE_DEBUG, "Value length: %lu", val_len);
+                startValue();
             }
             break;
         }
-        case KEY_ENCODING_BER_OID: {
-            // keep parsing until we read a byte where bit 8 is 0 (indicating we've read the LSB of the BER-OID key)
-            // TODO: the KLV class actually should have a human-readable tag due to this encoding technique
-            if(!(byte & 0b10000000)) {
-                state = STATE_KEY;
-                printf("KlvParser transitioning to STATE_KEY\n");
+
+        case STATE_LEN: {       // read entire BER-encoded length field
+            // copy as much of the value field as is available in one go
+            size_t needed = val_len - val.size();
+            size_t available = size - i;
+            size_t n = needed < available ? needed : available;
+            if(checksum_mode != CHECKSUM_OFF && set_checksum) {
+                // the checksum covers everything but the last two bytes of the value
+                if(val.empty()) {
+                    checksum.update(key.data(), key.size());
+                    checksum.update(len.data(), len.size());
+                }
+                size_t covered = val_len >= 2 ? val_len - 2 : 0;
+                if(val.size() < covered)
+                    checksum.update(data + i, std::min(n, covered - val.size()));
             }
+            val.insert(val.end(), data + i, data + i + n);
+            i += n;
             break;
         }
+
+        case STATE_SKIP: {      // skip the value of a filtered KLV
+            size_t n = std::min((size_t) num_skip_bytes, size - i);
+            i += n;
+            num_skip_bytes -= n;
+            if(num_skip_bytes == 0)
+                resetFields();
+            break;
+        }
+
         default:
-            // not supposed to be here :-)
+            // not supposed to be here :)
+            break;
+        } // end switch(state)
+
+        // a zero-length value completes as soon as its length field has been read
+        if(state == STATE_LEN && val.size() == val_len) {
+            state = STATE_VALUE;
+            KLV_TRACE(KLV_TRACE_DEBUG, "KlvParser transitioning to STATE_VALUE");
+            KLV_STATE_TIMER_UPDATE(state);
             break;
         }
+        KLV_STATE_TIMER_UPDATE(state);
+    }
 
-        break;
+    ctr += i;
+    stats.addBytesRead(i);
+    return i;
+}
+
+/**
+ * Constructs the KLV for the fully read key, length, and value fields, with the
+ * KLVs embedded in its value as children (see decodeChildren()).
+ *
+ * @return the new KLV. Ownership is transfered to the caller.
+ */
+KLV* KlvParser::buildKlv() {
+    // construct KLV object
+    // TODO: use smart pointer here and transfer ownership to caller
+    KLV *klv = new KLV(key, len, val);
+
+    KLV_TRACE(KLV_TRACE_INFO, "KLV complete, value length: %lu, key_encodings.size() : %zu", val_len, key_encodings.size());
+    size_t depth = set_parser->decodeChildren(klv, val);
+    if(depth > 0)
+        stats.raiseDepth(depth);
+    return klv;
+}
+
+/**
+ * If there are more key encodings than the one used for this level, parses a
+ * value field for embedded KLV and links the resulting sub-KLVs in as children
+ * of klv, or leaves that to a lazy decoder in lazy nesting mode.
+ *
+ * @param  klv   KLV to link the children to
+ * @param  value its value field
+ * @return       number of nested levels decoded, 0 if none
+ */
+size_t KlvParser::decodeChildren(KLV* klv, const std::vector<uint8_t>& value) {
+    if(lazy_decoder) {
+        // children are parsed on first access
+        klv->setLazyDecoder(lazy_decoder);
+        return 0;
     }
+    if(key_encodings.size() <= 1 || limits.max_depth == 0)
+        return 0;
 
-    case STATE_KEY: {       // read KLV 16-byte universal key
-        // read byte, and figure out if long or short BER form
-        len.push_back(byte);
-        ber_long_form = (bool) (byte & 0b10000000);
+    // the value field is complete, so the parser for the next level can go
+    // through it in one pass and hand back each embedded KLV. It is created
+    // for the first nested KLV and then kept, along with its buffers (and
+    // its own parser for the level below), so steady state parsing does not
+    // allocate anything but the KLVs it returns.
+    if(!sub_parser) {
+        KLV_TRACE(KLV_TRACE_DEBUG, "Creating sub_klv_parser...");
+        sub_parser.reset(new KlvParser(std::vector<KeyEncoding>(key_encodings.begin()+1, key_encodings.end())));
+        Limits sub_limits = limits;
+        sub_limits.max_depth--;
+        sub_parser->setLimits(sub_limits);
+        for(size_t i = 1; i < filters.size(); i++)
+            sub_parser->setFilter(i - 1, filters[i]);
+    }
+    sub_klvs.clear();
+    sub_parser->parse(value.data(), value.size(), sub_klvs);
 
-        if(ber_long_form) {
-            state = STATE_LEN_HEADER;
-            ber_len = byte & 0b01111111;
-            val_len = 0;
-            printf("BER-Len field is long-form\n");
-            printf("BER len: %ld\n", ber_len);
-            printf("KlvParser transitioning to STATE_LEN_HEADER\n");
-        } else {
-            state = STATE_LEN;
-            val_len = byte & 0b01111111;
-            printf("BER-Len field is short-form\n");
-            printf("Value length: %ld\n", val_len);
-            printf("KlvParser transitioning to STATE_LEN\n");
-        }
-        break;
+    // a truncated last item belongs to this value only
+    sub_parser->reset();
+    if(sub_klvs.empty()) {
+        klv->markDroppedItems();
+        return 0;
     }
 
-    case STATE_LEN_HEADER: { // read first byte in BER-encoded length field
-        // keep parsing for ber_len bytes and store into val_len
-        len.push_back(byte);
-        val_len <<= 8;
-        val_len |= byte;
-        num_ber_len_bytes_read++;
-        if(num_ber_len_bytes_read == ber_len) {
-            state = STATE_LEN;
-            printf("Value length: %ld\n", val_len);
-            printf("KlvParser transitioning to STATE_LEN\n");
-        }
-        break;
+    // assign child of THIS klv to the first child in the vector
+    klv->setChild(sub_klvs[0]);
+
+    // assign the next and previous sibling fields and the parent field in each of the sub_klvs
+    for(size_t i = 0; i < sub_klvs.size(); i++) {
+        if(i > 0)
+            sub_klvs[i]->setPreviousSibling(sub_klvs[i-1]);
+        if(i + 1 < sub_klvs.size())
+            sub_klvs[i]->setNextSibling(sub_klvs[i+1]);
+        sub_klvs[i]->setParent(klv);
     }
+    klv->markDroppedItems();
+    return sub_parser->stats.getMaxDepth() + 1;
+}
 
-    case STATE_LEN: {       // read entire BER-encoded length field
-        // keep parsing for val_len bytes and store into val
-        val.push_back(byte);
-        if(val.size() == val_len) {
-            state = STATE_VALUE;
-            printf("KlvParser transitioning to STATE_VALUE\n");
-        } else {
-            break;
-        }
+/**
+ * Checks the checksum of the completed KLV, then builds it unless the checksum
+ * mode says to drop it. Resets the state machine for the next KLV either way.
+ * Does not throw for a bad checksum; the callers that do check for it.
+ *
+ * @return the new KLV, or NULL if it was dropped. Ownership is transfered to
+ *         the caller.
+ */
+KLV* KlvParser::finishKlv() {
+    stats.countKlv(key.data(), key.size(), val_len);
+    KlvChecksumStatus status = checkChecksum();
+    if(status == KLV_CHECKSUM_INVALID && checksum_mode != CHECKSUM_MARK) {
+        KLV_TRACE(KLV_TRACE_ERROR, "KLV dropped, bad checksum %04x", checksum.value());
+        num_checksum_failures++;
+        reject(KLV_ERROR_CHECKSUM);
+        return NULL;
     }
 
-    case STATE_VALUE: {      // read value field
-        // construct KLV object
-        // TODO: use smart pointer here and transfer ownership to caller
-        KLV *klv = new KLV(key, len, val);
-
-
-        // for right now this will only construct the "root" part of the incoming KLV
-        // ...and not recurse into the tree if there is embedded KLV
-        // might have to do setters for KLV
-
-        // TODO: implement embedded KLV parsing
-        // could do this by declaring a KlvParser on the stack as a local variable, then going through all of the bytes
-        // in the value field. If we get a KLV back, then we know to add it to
-        // the tree of the KLV. this will require KLV to have setters for the tree fields
-        // by doing this, we "reset" the parser state variables by using a completely different parser...makes sense
-        // so this class also will construct the tree...which means we'll need some fields to temp hold that info
-        
-        // iterate through each byte in the value field
-        // store into local vector
-        // check if last 16 bytes are KLV key
-        // if so then create a sub_klv_parser and then start parsing using those 16 bytes then the next bytes coming in
-
-        printf("key_encodings.size() : %ld\n", key_encodings.size());
-        // key_encodings.erase(key_encodings.begin());
-        if(key_encodings.size() > 1) {
-            printf("Creating sub_klv_parser...\n");
-            KlvParser sub_klv_parser(std::vector<KeyEncoding>(key_encodings.begin()+1, key_encodings.end()));
-            std::vector<KLV*> sub_klvs;
-            KLV* sub_klv = NULL;
-            int i = 0;
-
-            // parse the sub-KLVs
-            for(i = 0; i < val.size(); i++) {
-                sub_klv = sub_klv_parser.parseByte(val[i]);
-                if(sub_klv != NULL) {
-                    printf("new sub KLV\n");
-                    sub_klvs.push_back(sub_klv);
-                    sub_klv = NULL;
-                }
-            }
+    KLV* klv = buildKlv();
+    klv->setChecksumStatus(status);
+    resetFields();
+    return klv;
+}
 
-            // assign child of THIS klv to the first child in the vector
-            klv->setChild(sub_klvs[0]);
-
-            // assign the next and previous sibling fields and the parent field in each of the sub_klvs
-            for(i = 0; i < sub_klvs.size(); i++) {
-                if(sub_klvs.size() > 1) {
-                    if(i == 0) {
-                        // beginning
-                        sub_klvs[i]->setNextSibling(sub_klvs[i+1]);
-                    } else if(i == sub_klvs.size()) {
-                        // end
-                        sub_klvs[i]->setPreviousSibling(sub_klvs[i-1]);
-                    } else {
-                        sub_klvs[i]->setNextSibling(sub_klvs[i+1]);
-                        sub_klvs[i]->setPreviousSibling(sub_klvs[i-1]);
-                    }
-                }
-                sub_klvs[i]->setParent(klv);
-            }
+/**
+ * Drops the KLV being parsed, records why, and resets the state machine so that
+ * it scans for the next key from the following byte. Takes constant time.
+ *
+ * @param status reason the KLV was rejected
+ */
+void KlvParser::reject(KlvStatus status) {
+    KLV_TRACE(KLV_TRACE_ERROR, "KLV rejected: %s", klvStatusString(status));
+    num_errors++;
+    last_error = status;
+    stats.countError(status);
+    if(status != KLV_ERROR_CHECKSUM)
+        stats.addBytesDiscarded(key.size() + len.size());
+    resetFields();
+}
+
+/**
+ * Compares the running checksum of the completed KLV against its checksum item,
+ * which must be the last item of the value (tag 1, length 2).
+ *
+ * @return the checksum status, KLV_CHECKSUM_UNCHECKED if checking is off
+ */
+KlvChecksumStatus KlvParser::checkChecksum() const {
+    if(checksum_mode == CHECKSUM_OFF || !set_checksum)
+        return KLV_CHECKSUM_UNCHECKED;
+
+    size_t n = val.size();
+    if(n < 4 || val[n-4] != 0x01 || val[n-3] != 0x02)
+        return KLV_CHECKSUM_INVALID;
+
+    uint16_t expected = (uint16_t) ((val[n-2] << 8) | val[n-1]);
+    return checksum.value() == expected ? KLV_CHECKSUM_VALID : KLV_CHECKSUM_INVALID;
+}
+
+/**
+ * Looks for a 16-byte universal key (a key starting with the SMPTE UL header)
+ * and collects it into key. Garbage in front of it is skipped with a vectorized
+ * scan for the header. Bytes at the end of data that could be the start of a
+ * key are kept in key, and the next call continues from there.
+ *
+ * @param  data pointer to the bytes to parse
+ * @param  size number of bytes available
+ * @return      number of bytes consumed. The parser moves to STATE_KEY once a
+ *              full key has been read.
+ */
+size_t KlvParser::scanForKey(const uint8_t* data, size_t size) {
+    size_t i = 0;
+
+    // continue a key started by an earlier call, one byte at a time
+    while(!key.empty() && i < size) {
+        key.push_back(data[i++]);
+
+        // drop leading bytes that can no longer be the start of a UL header
+        while(!key.empty() && memcmp(key.data(), SMPTE_KLV_UL_HEADER,
+                std::min(key.size(), (size_t) SMPTE_KLV_UL_HEADER_LEN)) != 0) {
+            key.erase(key.begin());
+            stats.addBytesDiscarded(1);
+        }
+
+        if(checkIfContainsKlvKey(key)) {
+            state = STATE_KEY;
+            KLV_TRACE(KLV_TRACE_DEBUG, "KlvParser transitioning to STATE_KEY");
+            return i;
         }
-        
-        // reset state machine back to STATE_INIT and return parsed KLV
-        resetFields();
-        return klv;
     }
+    if(i == size)
+        return i;
 
-    default:
-        // not supposed to be here :)
-        break;
-    } // end switch(state)
+    size_t offset = KlvScan::findUlHeader(data + i, size - i);
+    if(offset == size - i) {
+        // no header, but the last few bytes may be the start of one
+        size_t keep = KlvScan::ulHeaderPrefixSuffix(data + i, size - i);
+        key.assign(data + size - keep, data + size);
+        stats.addBytesDiscarded(size - i - keep);
+        return size;
+    }
+
+    // jump to the header and take as much of the key as there is
+    stats.addBytesDiscarded(offset);
+    i += offset;
+    size_t n = std::min((size_t) KLV_KEY_SIZE, size - i);
+    key.assign(data + i, data + i + n);
+    i += n;
+    if(key.size() == KLV_KEY_SIZE) {
+        state = STATE_KEY;
+        KLV_TRACE(KLV_TRACE_DEBUG, "KlvParser transitioning to STATE_KEY");
+    }
+    return i;
+}
+
+/**
+ * Moves the state machine on once the length field of a KLV has been read:
+ * to reading its value, or to skipping it if the filter or the key registry
+ * does not keep the KLV.
+ */
+void KlvParser::startValue() {
+    if(admit(key.data(), key.size())) {
+        state = STATE_LEN;
+        KLV_TRACE(KLV_TRACE_DEBUG, "KlvParser transitioning to STATE_LEN");
+        return;
+    }
+
+    KLV_TRACE(KLV_TRACE_DEBUG, "KLV filtered, skipping %lu bytes", val_len);
+    stats.countFiltered();
+    state = STATE_SKIP;
+    num_skip_bytes = val_len;
+    if(num_skip_bytes == 0)
+        resetFields();
+}
+
+/**
+ * Checks a key against the filter of its level.
+ *
+ * @param  depth    nesting depth of the KLV
+ * @param  key      pointer to the key
+ * @param  key_size size of the key
+ * @return          true if the KLV is kept
+ */
+bool KlvParser::accepts(size_t depth, const uint8_t* key, size_t key_size) const {
+    if(depth >= filters.size() || filters[depth].passesAll())
+        return true;
+    if(key_encodings[depth] == KEY_ENCODING_16_BYTE)
+        return filters[depth].acceptsKey(KlvUniversalKey(key));
+    return filters[depth].acceptsTag(decodeTag(key, key_size, key_encodings[depth]));
+}
+
+/**
+ * Decides whether a top level KLV is kept, and if so which parser decodes its
+ * nested levels.
+ *
+ * @param  key      pointer to the key
+ * @param  key_size size of the key
+ * @return          false if the filter does not keep the KLV, or the key
+ *                  registry has no rule for its key
+ */
+bool KlvParser::admit(const uint8_t* key, size_t key_size) {
+    if(!accepts(0, key, key_size))
+        return false;
+    if(!registry)
+        return true;
 
-    return NULL;
+    size_t index = registry->find(KlvUniversalKey(key));
+    if(index == KlvKeyRegistry::NOT_FOUND)
+        return false;
+    const KlvKeyRegistry::Rule& rule = registry->getRule(index);
+    set_parser = set_parsers[index].get();
+    set_checksum = rule.checksum == KlvKeyRegistry::CHECKSUM_ST0601;
+    set_handler = rule.handler;
+    return true;
 }
 
-bool KlvParser::checkIfContainsKlvKey(std::vector<uint8_t> data) {
-    // TODO: come up with faster optimized method
-    return ((std::search(data.begin(), data.end(), 
-            SMPTE_KLV_UL_HEADER, SMPTE_KLV_UL_HEADER+SMPTE_KLV_UL_HEADER_LEN)) == data.begin() 
-            && data.size() == 16);
+bool KlvParser::checkIfContainsKlvKey(const std::vector<uint8_t>& data) {
+    return data.size() == KLV_KEY_SIZE
+        && memcmp(data.data(), SMPTE_KLV_UL_HEADER, SMPTE_KLV_UL_HEADER_LEN) == 0;
 }
 
 void KlvParser::resetFields() {
     state = STATE_INIT;
     ber_len = 0;
     val_len = 0;
+    num_skip_bytes = 0;
     num_ber_len_bytes_read = 0;
     ber_long_form = false;
 
     key.clear();
     len.clear();
     val.clear();
+    checksum.reset();
 
     child = NULL;
     parent = NULL;
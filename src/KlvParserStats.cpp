@@ -0,0 +1,110 @@
+//
+//  KlvParserStats.cpp
+//  libklv
+//
+
+#include "KlvParserStats.hpp"
+
+const size_t KlvParserStats::MAX_KEYS;
+const size_t KlvParserStats::NUM_SIZE_BUCKETS;
+const size_t KlvParserStats::NUM_STATES;
+
+KlvParserStats::Snapshot KlvParserStats::snapshot() const {
+    Snapshot s;
+    s.bytes_read = bytes_read.get();
+    s.bytes_discarded = bytes_discarded.get();
+    s.num_klvs = num_klvs.get();
+    s.num_filtered = num_filtered.get();
+    s.num_ber_length_errors = num_ber_length_errors.get();
+    s.num_value_size_errors = num_value_size_errors.get();
+    s.num_checksum_failures = num_checksum_failures.get();
+    s.max_depth = max_depth.get();
+    for(size_t i = 0; i < NUM_SIZE_BUCKETS; i++)
+        s.value_sizes[i] = value_sizes[i].get();
+
+    // keys below num_keys are never written again
+    size_t n = num_keys.load(std::memory_order_acquire);
+    for(size_t i = 0; i < n; i++)
+        s.keys.push_back(std::make_pair(keys[i], key_counts[i].get()));
+    s.num_other_keys = num_other_keys.get();
+
+    for(size_t i = 0; i < NUM_STATES; i++) {
+        s.state_cycles[i] = state_cycles[i].get();
+        s.state_entries[i] = state_entries[i].get();
+    }
+    return s;
+}
+
+/**
+ * Counts a KLV that has been read to the end of its value.
+ *
+ * @param key        pointer to the key
+ * @param key_size   size of the key, KLV_KEY_SIZE for the KLV to be counted
+ *                   under its universal key
+ * @param value_size size of the value field
+ */
+void KlvParserStats::countKlv(const uint8_t* key, size_t key_size, unsigned long value_size) {
+    num_klvs.add(1);
+    value_sizes[sizeBucket(value_size)].add(1);
+    if(key_size == KLV_KEY_SIZE)
+        countKey(KlvUniversalKey(key));
+}
+
+/**
+ * Counts a rejected KLV under the reason it was rejected for.
+ *
+ * @param status reason the KLV was rejected
+ */
+void KlvParserStats::countError(KlvStatus status) {
+    switch(status) {
+    case KLV_ERROR_BER_LENGTH:
+        num_ber_length_errors.add(1);
+        break;
+    case KLV_ERROR_VALUE_SIZE:
+        num_value_size_errors.add(1);
+        break;
+    case KLV_ERROR_CHECKSUM:
+        num_checksum_failures.add(1);
+        break;
+    default:
+        break;
+    }
+}
+
+size_t KlvParserStats::sizeBucket(unsigned long value_size) {
+    size_t bucket = 0;
+    while(value_size != 0 && bucket < NUM_SIZE_BUCKETS - 1) {
+        value_size >>= 1;
+        bucket++;
+    }
+    return bucket;
+}
+
+/**
+ * Counts a KLV under its universal key. A stream rarely carries more than a
+ * couple of universal sets, so the last key counted is checked first and the
+ * rest are searched linearly.
+ */
+void KlvParserStats::countKey(const KlvUniversalKey& key) {
+    size_t n = num_keys.load(std::memory_order_relaxed);
+    if(last_key < n && keys[last_key] == key) {
+        key_counts[last_key].add(1);
+        return;
+    }
+    for(size_t i = 0; i < n; i++) {
+        if(keys[i] == key) {
+            last_key = i;
+            key_counts[i].add(1);
+            return;
+        }
+    }
+
+    if(n == MAX_KEYS) {
+        num_other_keys.add(1);
+        return;
+    }
+    keys[n] = key;
+    key_counts[n].add(1);
+    last_key = n;
+    num_keys.store(n + 1, std::memory_order_release);
+}
@@ -0,0 +1,150 @@
+//
+//  KlvScan.cpp
+//  libklv
+//
+
+#include "KlvScan.hpp"
+#include "Klv.h"
+#include <cstring>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KLV_SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+/**
+ * @brief Finds the first complete UL header in a buffer.
+ *
+ * @param  data pointer to the buffer
+ * @param  size size of the buffer
+ * @return      offset of the first byte of the header, or size if the buffer
+ *              holds no complete header
+ */
+size_t KlvScan::findUlHeader(const uint8_t* data, size_t size) {
+    static const bool avx2 = hasAvx2();
+    static const bool sse2 = hasSse2();
+
+    if(avx2)
+        return findUlHeaderAvx2(data, size);
+    if(sse2)
+        return findUlHeaderSse2(data, size);
+    return findUlHeaderScalar(data, size);
+}
+
+/**
+ * @brief Portable version of findUlHeader(). memchr() skips to each 0x06, and
+ *        the remaining three bytes are compared there.
+ */
+size_t KlvScan::findUlHeaderScalar(const uint8_t* data, size_t size) {
+    if(size < SMPTE_KLV_UL_HEADER_LEN)
+        return size;
+
+    const uint8_t* p = data;
+    const uint8_t* last = data + size - SMPTE_KLV_UL_HEADER_LEN;
+    while(p <= last) {
+        p = (const uint8_t*) memchr(p, SMPTE_KLV_UL_HEADER[0], last - p + 1);
+        if(p == NULL)
+            break;
+        if(p[1] == SMPTE_KLV_UL_HEADER[1] && p[2] == SMPTE_KLV_UL_HEADER[2] && p[3] == SMPTE_KLV_UL_HEADER[3])
+            return p - data;
+        p++;
+    }
+    return size;
+}
+
+#ifdef KLV_SCAN_X86
+
+/**
+ * @brief SSE2 version of findUlHeader(). Compares 16 candidate positions at a
+ *        time: the block is loaded at offsets 0 to 3, each load is compared
+ *        against the matching header byte, and the results are ANDed together.
+ */
+__attribute__((target("sse2")))
+size_t KlvScan::findUlHeaderSse2(const uint8_t* data, size_t size) {
+    const __m128i h0 = _mm_set1_epi8((char) SMPTE_KLV_UL_HEADER[0]);
+    const __m128i h1 = _mm_set1_epi8((char) SMPTE_KLV_UL_HEADER[1]);
+    const __m128i h2 = _mm_set1_epi8((char) SMPTE_KLV_UL_HEADER[2]);
+    const __m128i h3 = _mm_set1_epi8((char) SMPTE_KLV_UL_HEADER[3]);
+
+    size_t i = 0;
+    for(; i + 16 + SMPTE_KLV_UL_HEADER_LEN - 1 <= size; i += 16) {
+        __m128i m = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) (data + i)), h0);
+        m = _mm_and_si128(m, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) (data + i + 1)), h1));
+        m = _mm_and_si128(m, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) (data + i + 2)), h2));
+        m = _mm_and_si128(m, _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) (data + i + 3)), h3));
+        int mask = _mm_movemask_epi8(m);
+        if(mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+
+    return i + findUlHeaderScalar(data + i, size - i);
+}
+
+/**
+ * @brief AVX2 version of findUlHeader(), 32 candidate positions at a time.
+ */
+__attribute__((target("avx2")))
+size_t KlvScan::findUlHeaderAvx2(const uint8_t* data, size_t size) {
+    const __m256i h0 = _mm256_set1_epi8((char) SMPTE_KLV_UL_HEADER[0]);
+    const __m256i h1 = _mm256_set1_epi8((char) SMPTE_KLV_UL_HEADER[1]);
+    const __m256i h2 = _mm256_set1_epi8((char) SMPTE_KLV_UL_HEADER[2]);
+    const __m256i h3 = _mm256_set1_epi8((char) SMPTE_KLV_UL_HEADER[3]);
+
+    size_t i = 0;
+    for(; i + 32 + SMPTE_KLV_UL_HEADER_LEN - 1 <= size; i += 32) {
+        __m256i m = _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*) (data + i)), h0);
+        m = _mm256_and_si256(m, _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*) (data + i + 1)), h1));
+        m = _mm256_and_si256(m, _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*) (data + i + 2)), h2));
+        m = _mm256_and_si256(m, _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*) (data + i + 3)), h3));
+        unsigned int mask = (unsigned int) _mm256_movemask_epi8(m);
+        if(mask != 0)
+            return i + __builtin_ctz(mask);
+    }
+
+    return i + findUlHeaderSse2(data + i, size - i);
+}
+
+bool KlvScan::hasSse2() {
+    return __builtin_cpu_supports("sse2");
+}
+
+bool KlvScan::hasAvx2() {
+    return __builtin_cpu_supports("avx2");
+}
+
+#else
+
+size_t KlvScan::findUlHeaderSse2(const uint8_t* data, size_t size) {
+    return findUlHeaderScalar(data, size);
+}
+
+size_t KlvScan::findUlHeaderAvx2(const uint8_t* data, size_t size) {
+    return findUlHeaderScalar(data, size);
+}
+
+bool KlvScan::hasSse2() {
+    return false;
+}
+
+bool KlvScan::hasAvx2() {
+    return false;
+}
+
+#endif // KLV_SCAN_X86
+
+/**
+ * @brief Finds how many bytes at the end of a buffer could be the start of a
+ *        UL header that continues in the next buffer.
+ *
+ * @param  data pointer to the buffer
+ * @param  size size of the buffer
+ * @return      length of the longest suffix of data that is a proper prefix of
+ *              the header (0 to 3)
+ */
+size_t KlvScan::ulHeaderPrefixSuffix(const uint8_t* data, size_t size) {
+    for(size_t n = SMPTE_KLV_UL_HEADER_LEN - 1; n > 0; n--) {
+        if(n <= size && memcmp(data + size - n, SMPTE_KLV_UL_HEADER, n) == 0)
+            return n;
+    }
+    return 0;
+}
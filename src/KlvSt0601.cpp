@@ -0,0 +1,123 @@
+//
+//  KlvSt0601.cpp
+//  libklv
+//
+
+#include "KlvSt0601.hpp"
+
+namespace St0601 {
+
+#define KLV_ST0601_DEFINE(type, field, tag, len, mapping, min, max, units) \
+    const uint8_t type::TAG; \
+    const size_t type::LENGTH; \
+    const Mapping type::MAPPING; \
+    const Field type::FIELD;
+KLV_ST0601_TAGS(KLV_ST0601_DEFINE)
+#undef KLV_ST0601_DEFINE
+
+namespace {
+    const TagInfo TAGS[] = {
+#define KLV_ST0601_INFO(type, field, tag, len, mapping, min, max, units) {tag, len, mapping, min, max, units, FIELD_##field},
+        KLV_ST0601_TAGS(KLV_ST0601_INFO)
+#undef KLV_ST0601_INFO
+    };
+}
+
+/**
+ * @brief Looks up a supported tag.
+ *
+ * @param  tag tag number
+ * @return     description of the tag, NULL if it is not in KLV_ST0601_TAGS
+ */
+const TagInfo* findTag(uint64_t tag) {
+    for(size_t i = 0; i < NUM_FIELDS; i++) {
+        if(TAGS[i].tag == tag)
+            return &TAGS[i];
+    }
+    return NULL;
+}
+
+void Values::clear() {
+#define KLV_ST0601_CLEAR(type, field, tag, len, mapping, min, max, units) this->field = type::none();
+    KLV_ST0601_TAGS(KLV_ST0601_CLEAR)
+#undef KLV_ST0601_CLEAR
+    this->present = 0;
+}
+
+namespace {
+    /**
+     * @brief Decodes one item into its field of values. The switch is generated
+     *        from the tag table, so each case is the fixed-size decode of that
+     *        tag; unknown tags fall through.
+     *
+     * @param  tag    tag of the item
+     * @param  data   value field
+     * @param  size   size of the value field
+     * @param  values struct to fill
+     */
+    inline void decodeItem(uint64_t tag, const uint8_t* data, size_t size, Values& values) {
+        switch(tag) {
+#define KLV_ST0601_CASE(type, field, tag, len, mapping, min, max, units) \
+        case tag: \
+            if(decodeValue<type>(data, size, values.field)) \
+                values.present |= 1ull << type::FIELD; \
+            else { \
+                values.field = type::none(); \
+                values.present &= ~(1ull << type::FIELD); \
+            } \
+            break;
+        KLV_ST0601_TAGS(KLV_ST0601_CASE)
+#undef KLV_ST0601_CASE
+        default:
+            break;
+        }
+    }
+
+    /**
+     * @brief Tag of a local set item, or 0 (not a valid ST 0601 tag) for keys
+     *        longer than one byte, which none of the supported tags have.
+     */
+    inline uint64_t shortTag(const uint8_t* key, size_t key_size) {
+        return key_size == 1 ? key[0] : 0;
+    }
+}
+
+/**
+ * @brief Decodes every supported item of an ST 0601 packet in one pass over
+ *        the local set. If a tag appears more than once, the last item wins.
+ *
+ * @param  packet top level KLV (the local set) or its tree
+ * @param  values cleared, then filled with the items found
+ */
+void decode(const KLV& packet, Values& values) {
+    values.clear();
+    for(const KLV* item = packet.getChild(); item != NULL; item = item->getNext())
+        decodeItem(shortTag(item->getKey().data(), item->getKey().size()), item->getValue().data(), item->getValue().size(), values);
+}
+
+void decode(const KlvView& packet, Values& values) {
+    values.clear();
+    for(const KlvView* item = packet.getChild(); item != NULL; item = item->getNext())
+        decodeItem(shortTag(item->getKey().data, item->getKey().size), item->getValue().data, item->getValue().size, values);
+}
+
+void decode(const KlvTree& packet, Values& values) {
+    if(packet.empty()) {
+        values.clear();
+        return;
+    }
+    decode(*packet.getRoot(), values);
+}
+
+void decode(const KlvFlatTree& packet, Values& values) {
+    values.clear();
+    if(packet.empty())
+        return;
+    for(uint32_t i = packet.getChild(packet.getRoot()); i != KlvFlatTree::NONE; i = packet.getNext(i)) {
+        const KlvFlatNode& item = packet[i];
+        if(item.key_size == 1)
+            decodeItem(item.tag, packet.getValue(item).data, item.value_size, values);
+    }
+}
+
+} // namespace St0601
@@ -0,0 +1,374 @@
+//
+//  KlvSt0601Batch.cpp
+//  libklv
+//
+
+#include "KlvSt0601Batch.hpp"
+#include "KlvScan.hpp"
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define KLV_BATCH_X86 1
+#include <immintrin.h>
+#endif
+
+namespace St0601 {
+
+const uint8_t Batch::NO_COLUMN;
+
+namespace {
+    // bit pattern of 1.5 * 2^52. Adding an integer below 2^51 in magnitude to it
+    // gives the bit pattern of 1.5 * 2^52 + that integer as a double.
+    const uint64_t MAGIC_BITS = 0x4338000000000000ull;
+    const double MAGIC = 6755399441055744.0;
+
+    /**
+     * @brief Reads the stored integer of an item, sign extended for signed
+     *        mappings.
+     */
+    inline uint64_t readRaw(const uint8_t* data, size_t size, Mapping mapping) {
+        uint64_t raw;
+        switch(size) {
+        case 1:  raw = readUnsigned<1>(data); break;
+        case 2:  raw = readUnsigned<2>(data); break;
+        case 4:  raw = readUnsigned<4>(data); break;
+        default: raw = readUnsigned<8>(data); break;
+        }
+        if(mapping == MAPPING_SIGNED && size < 8)
+            raw = (uint64_t) ((int64_t) (raw << (64 - 8 * size)) >> (64 - 8 * size));
+        return raw;
+    }
+}
+
+/**
+ * @brief Creates a batch with one column per tag.
+ *
+ * @param tags tags to decode, in column order. Each one must be in
+ *             KLV_ST0601_TAGS, and may be listed only once.
+ * @throws std::invalid_argument for an unsupported or repeated tag
+ */
+Batch::Batch(const std::vector<uint64_t>& tags) : tags(tags), num_rows(0) {
+    memset(this->column_of, NO_COLUMN, sizeof(this->column_of));
+
+    this->columns.resize(tags.size());
+    for(size_t i = 0; i < tags.size(); i++) {
+        const TagInfo* info = findTag(tags[i]);
+        if(info == NULL)
+            throw std::invalid_argument("St0601::Batch: unsupported tag");
+        if(this->column_of[info->tag] != NO_COLUMN)
+            throw std::invalid_argument("St0601::Batch: tag listed twice");
+        this->column_of[info->tag] = (uint8_t) i;
+
+        // same constants as Decoder<N, M>::decode(), so the results match St0601::get()
+        Column& column = this->columns[i];
+        column.info = info;
+        column.num_mapped = 0;
+        switch(info->mapping) {
+        case MAPPING_RAW:
+            column.scale = 1.0;
+            column.offset = 0.0;
+            break;
+        case MAPPING_UNSIGNED:
+            column.scale = (info->max - info->min) / (double) ((1ull << (8 * info->length)) - 1);
+            column.offset = info->min;
+            break;
+        case MAPPING_SIGNED:
+            column.scale = (info->max - info->min) / (double) ((1ull << (8 * info->length)) - 2);
+            column.offset = 0.0;
+            break;
+        }
+    }
+}
+
+/**
+ * @brief Allocates room for num_rows rows in every column.
+ */
+void Batch::reserve(size_t num_rows) {
+    for(size_t i = 0; i < this->columns.size(); i++) {
+        Column& column = this->columns[i];
+        column.raw.reserve(num_rows);
+        column.values.reserve(num_rows);
+        column.presence.reserve((num_rows + 63) / 64);
+    }
+}
+
+/**
+ * @brief Removes all rows. The columns keep their capacity.
+ */
+void Batch::clear() {
+    for(size_t i = 0; i < this->columns.size(); i++) {
+        Column& column = this->columns[i];
+        column.raw.clear();
+        column.values.clear();
+        column.presence.clear();
+        column.num_mapped = 0;
+    }
+    this->num_rows = 0;
+}
+
+/**
+ * @brief Adds one packet as a new row.
+ *
+ * @param packet top level KLV (the local set) or its tree
+ */
+void Batch::add(const KLV& packet) {
+    beginRow();
+    for(const KLV* item = packet.getChild(); item != NULL; item = item->getNext())
+        addItem(item->getKey().data(), item->getKey().size(), item->getValue().data(), item->getValue().size());
+}
+
+void Batch::add(const KlvView& packet) {
+    beginRow();
+    for(const KlvView* item = packet.getChild(); item != NULL; item = item->getNext())
+        addItem(item->getKey().data, item->getKey().size, item->getValue().data, item->getValue().size);
+}
+
+void Batch::add(const KlvTree& packet) {
+    if(packet.empty()) {
+        beginRow();
+        return;
+    }
+    add(*packet.getRoot());
+}
+
+void Batch::add(const KlvFlatTree& packet) {
+    beginRow();
+    if(packet.empty())
+        return;
+    for(uint32_t i = packet.getChild(packet.getRoot()); i != KlvFlatTree::NONE; i = packet.getNext(i)) {
+        const KlvFlatNode& item = packet[i];
+        addItem(packet.getKey(item).data, item.key_size, packet.getValue(item).data, item.value_size);
+    }
+}
+
+/**
+ * @brief Adds each packet as a new row, in order.
+ */
+void Batch::add(const std::vector<KLV*>& packets) {
+    reserve(this->num_rows + packets.size());
+    for(size_t i = 0; i < packets.size(); i++)
+        add(*packets[i]);
+}
+
+/**
+ * @brief Parses raw bytes and adds every packet completed by them. A packet
+ *        that is cut off at the end of data stays in the parser and is added by
+ *        the call that completes it.
+ *
+ * @param  parser parser to use; it must decode BER-OID keys below the top level
+ * @param  data   pointer to the bytes to parse
+ * @param  size   number of bytes to parse
+ * @return        number of rows added
+ */
+size_t Batch::add(KlvParser& parser, const uint8_t* data, size_t size) {
+    size_t rows_before = this->num_rows;
+    size_t offset = 0;
+    while(offset < size) {
+        // the tree is consumed before the next call, so it can point into data
+        offset += parser.parseTree(data + offset, size - offset, this->tree, false);
+        if(!this->tree.empty())
+            add(this->tree);
+    }
+    this->tree.clear();
+    return this->num_rows - rows_before;
+}
+
+void Batch::beginRow() {
+    size_t row = this->num_rows++;
+    for(size_t i = 0; i < this->columns.size(); i++) {
+        Column& column = this->columns[i];
+        column.raw.push_back(0);
+        if(row % 64 == 0)
+            column.presence.push_back(0);
+    }
+}
+
+void Batch::addItem(const uint8_t* key, size_t key_size, const uint8_t* value, size_t value_size) {
+    // supported tags are all below 128, so their keys are one byte
+    if(key_size != 1 || key[0] >= KlvTagIndex<uint8_t>::NUM_DIRECT_TAGS || this->column_of[key[0]] == NO_COLUMN)
+        return;
+
+    Column& column = this->columns[this->column_of[key[0]]];
+    const TagInfo& info = *column.info;
+    size_t row = this->num_rows - 1;
+    uint64_t bit = 1ull << (row % 64);
+
+    uint64_t raw = value_size == info.length ? readRaw(value, value_size, info.mapping) : 0;
+    bool valid = value_size == info.length
+        && !(info.mapping == MAPPING_SIGNED && raw == (uint64_t) -(int64_t) (1ull << (8 * info.length - 1)));
+    if(valid) {
+        column.raw[row] = raw;
+        column.presence[row / 64] |= bit;
+    } else {
+        column.raw[row] = 0;
+        column.presence[row / 64] &= ~bit;
+    }
+}
+
+const Batch::Column* Batch::findColumn(uint64_t tag) const {
+    if(tag >= KlvTagIndex<uint8_t>::NUM_DIRECT_TAGS || this->column_of[tag] == NO_COLUMN)
+        return NULL;
+    return &this->columns[this->column_of[tag]];
+}
+
+Batch::Column* Batch::findColumn(uint64_t tag) {
+    return const_cast<Column*>(static_cast<const Batch*>(this)->findColumn(tag));
+}
+
+/**
+ * @brief Stored integers of a column, one per row. Signed items are sign
+ *        extended, so cast to int64_t to read them. Absent items are 0.
+ *
+ * @param  tag tag of the column
+ * @return     size() integers, NULL if the tag is not in the batch
+ */
+const uint64_t* Batch::getRaw(uint64_t tag) const {
+    const Column* column = findColumn(tag);
+    return column != NULL ? column->raw.data() : NULL;
+}
+
+/**
+ * @brief Values of a column in engineering units, one per row, NaN where the
+ *        item is absent. Maps the rows added since the last call first.
+ *
+ * For MAPPING_RAW tags the integer is converted to a double as is; use getRaw()
+ * for the exact value of large ones such as the Precision Time Stamp.
+ *
+ * @param  tag tag of the column
+ * @return     size() doubles, NULL if the tag is not in the batch. Valid until
+ *             the next add() or clear().
+ */
+const double* Batch::getValues(uint64_t tag) {
+    Column* column = findColumn(tag);
+    if(column == NULL)
+        return NULL;
+
+    size_t begin = column->num_mapped;
+    if(begin < this->num_rows) {
+        column->values.resize(this->num_rows);
+        if(column->info->mapping == MAPPING_RAW)
+            mapScalar(&column->raw[begin], this->num_rows - begin, column->scale, column->offset, &column->values[begin]);
+        else
+            map(&column->raw[begin], this->num_rows - begin, column->scale, column->offset, &column->values[begin]);
+
+        // absent items are NaN; only words with a cleared bit need looking at
+        const double none = std::numeric_limits<double>::quiet_NaN();
+        for(size_t word = begin / 64; word * 64 < this->num_rows; word++) {
+            uint64_t missing = ~column->presence[word];
+            while(missing != 0) {
+                size_t row = word * 64 + __builtin_ctzll(missing);
+                if(row >= this->num_rows)
+                    break;
+                if(row >= begin)
+                    column->values[row] = none;
+                missing &= missing - 1;
+            }
+        }
+        column->num_mapped = this->num_rows;
+    }
+    return column->values.data();
+}
+
+/**
+ * @brief Presence bitmap of a column: bit (row % 64) of word (row / 64) is set
+ *        if the row has a valid item.
+ *
+ * @param  tag tag of the column
+ * @return     (size() + 63) / 64 words, NULL if the tag is not in the batch
+ */
+const uint64_t* Batch::getPresence(uint64_t tag) const {
+    const Column* column = findColumn(tag);
+    return column != NULL ? column->presence.data() : NULL;
+}
+
+bool Batch::isPresent(uint64_t tag, size_t row) const {
+    const Column* column = findColumn(tag);
+    return column != NULL && row < this->num_rows && (column->presence[row / 64] >> (row % 64) & 1) != 0;
+}
+
+/**
+ * @brief Maps stored integers to values: out[i] = (int64_t) raw[i] * scale +
+ *        offset. The integers must be below 2^51 in magnitude, which holds for
+ *        all mapped ST 0601 items (4 bytes at most).
+ */
+void Batch::map(const uint64_t* raw, size_t n, double scale, double offset, double* out) {
+    static const bool avx2 = KlvScan::hasAvx2();
+    static const bool sse2 = KlvScan::hasSse2();
+
+    if(avx2)
+        mapAvx2(raw, n, scale, offset, out);
+    else if(sse2)
+        mapSse2(raw, n, scale, offset, out);
+    else
+        mapScalar(raw, n, scale, offset, out);
+}
+
+/**
+ * @brief Portable version of map().
+ */
+void Batch::mapScalar(const uint64_t* raw, size_t n, double scale, double offset, double* out) {
+    for(size_t i = 0; i < n; i++)
+        out[i] = (double) (int64_t) raw[i] * scale + offset;
+}
+
+#ifdef KLV_BATCH_X86
+
+/**
+ * @brief SSE2 version of map(), 2 rows at a time. SSE2 has no 64-bit integer to
+ *        double conversion, so each integer is added to the bit pattern of
+ *        1.5 * 2^52 and the double 1.5 * 2^52 is subtracted again, which is
+ *        exact in that range. Multiply and add stay separate (no FMA), so the
+ *        rounding matches the scalar code.
+ */
+__attribute__((target("sse2")))
+void Batch::mapSse2(const uint64_t* raw, size_t n, double scale, double offset, double* out) {
+    const __m128i magic_bits = _mm_set1_epi64x((long long) MAGIC_BITS);
+    const __m128d magic = _mm_set1_pd(MAGIC);
+    const __m128d s = _mm_set1_pd(scale);
+    const __m128d o = _mm_set1_pd(offset);
+
+    size_t i = 0;
+    for(; i + 2 <= n; i += 2) {
+        __m128i r = _mm_loadu_si128((const __m128i*) (raw + i));
+        __m128d d = _mm_sub_pd(_mm_castsi128_pd(_mm_add_epi64(r, magic_bits)), magic);
+        _mm_storeu_pd(out + i, _mm_add_pd(_mm_mul_pd(d, s), o));
+    }
+
+    mapScalar(raw + i, n - i, scale, offset, out + i);
+}
+
+/**
+ * @brief AVX2 version of map(), 4 rows at a time.
+ */
+__attribute__((target("avx2")))
+void Batch::mapAvx2(const uint64_t* raw, size_t n, double scale, double offset, double* out) {
+    const __m256i magic_bits = _mm256_set1_epi64x((long long) MAGIC_BITS);
+    const __m256d magic = _mm256_set1_pd(MAGIC);
+    const __m256d s = _mm256_set1_pd(scale);
+    const __m256d o = _mm256_set1_pd(offset);
+
+    size_t i = 0;
+    for(; i + 4 <= n; i += 4) {
+        __m256i r = _mm256_loadu_si256((const __m256i*) (raw + i));
+        __m256d d = _mm256_sub_pd(_mm256_castsi256_pd(_mm256_add_epi64(r, magic_bits)), magic);
+        _mm256_storeu_pd(out + i, _mm256_add_pd(_mm256_mul_pd(d, s), o));
+    }
+
+    mapSse2(raw + i, n - i, scale, offset, out + i);
+}
+
+#else
+
+void Batch::mapSse2(const uint64_t* raw, size_t n, double scale, double offset, double* out) {
+    mapScalar(raw, n, scale, offset, out);
+}
+
+void Batch::mapAvx2(const uint64_t* raw, size_t n, double scale, double offset, double* out) {
+    mapScalar(raw, n, scale, offset, out);
+}
+
+#endif // KLV_BATCH_X86
+
+} // namespace St0601
@@ -0,0 +1,315 @@
+//
+//  KlvStreamSet.cpp
+//  libklv
+//
+
+#include "KlvStreamSet.hpp"
+#include "KlvByteRing.hpp"
+#include "KlvSpscRing.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+#include <stdexcept>
+#include <thread>
+
+const size_t KlvStreamSet::DEFAULT_RING_SIZE;
+const size_t KlvStreamSet::DEFAULT_QUEUE_SIZE;
+
+/**
+ * @brief Parser state of one stream. Only its worker touches the parser and
+ *        the handler once the stream has been added.
+ */
+struct KlvStreamSet::Stream {
+    StreamId             id;              /// id the stream was added with
+    Worker*              worker;          /// worker the stream is tied to
+    KlvParser            parser;          /// parser state of the stream
+    Handler              handler;         /// receives the packets, empty to queue them for poll()
+
+    Stream(StreamId id, Worker* worker, const std::vector<KlvParser::KeyEncoding>& key_encodings, const Handler& handler)
+        : id(id), worker(worker), parser(key_encodings), handler(handler) {}
+};
+
+/**
+ * @brief A worker thread with its input ring and output queue. Spans in the
+ *        input ring are tagged with their Stream; an empty span removes the
+ *        stream.
+ */
+struct KlvStreamSet::Worker {
+    KlvByteRing          input;           /// bytes from the reader
+    KlvSpscRing<Output>  output;          /// packets for poll()
+    std::vector<KLV*>    klvs;            /// packets completed by the current span
+    std::thread          thread;
+
+    Worker(size_t ring_size, size_t queue_size) : input(ring_size), output(queue_size) {}
+
+    /**
+     * @brief Allocates a worker on a 64-byte boundary. The rings keep their
+     *        indices on separate cache lines with alignas(64), which plain new
+     *        does not honour before C++17.
+     */
+    static Worker* create(size_t ring_size, size_t queue_size) {
+        void* memory = NULL;
+        if(posix_memalign(&memory, alignof(Worker), sizeof(Worker)) != 0)
+            throw std::bad_alloc();
+        try {
+            return new(memory) Worker(ring_size, queue_size);
+        } catch(...) {
+            free(memory);
+            throw;
+        }
+    }
+
+    /**
+     * @brief Frees a worker made by create().
+     */
+    static void destroy(Worker* worker) {
+        worker->~Worker();
+        free(worker);
+    }
+};
+
+/**
+ * @brief Constructs a stream set and starts its workers.
+ *
+ * @param key_encodings key encodings, as for KlvParser
+ * @param num_workers   number of worker threads, 0 for one per core
+ * @param ring_size     bytes in each worker's input ring, see KlvByteRing
+ * @param queue_size    packets in each worker's output queue, rounded up to a
+ *                      power of two
+ */
+KlvStreamSet::KlvStreamSet(std::vector<KlvParser::KeyEncoding> key_encodings, size_t num_workers,
+                           size_t ring_size, size_t queue_size) {
+    if(key_encodings.empty())
+        throw std::invalid_argument("KlvStreamSet needs at least one key encoding");
+    if(num_workers == 0)
+        num_workers = std::max(1u, std::thread::hardware_concurrency());
+
+    this->key_encodings = key_encodings;
+    this->lazy_nesting = false;
+    this->checksum_mode = KlvParser::CHECKSUM_OFF;
+    this->next_worker = 0;
+    this->next_poll = 0;
+
+    // a worker or thread that cannot be created takes down the ones made so far
+    try {
+        workers.reserve(num_workers);
+        for(size_t i = 0; i < num_workers; i++)
+            workers.push_back(Worker::create(ring_size, queue_size));
+        for(size_t i = 0; i < num_workers; i++)
+            workers[i]->thread = std::thread(&KlvStreamSet::run, this, std::ref(*workers[i]));
+    } catch(...) {
+        stopWorkers();
+        throw;
+    }
+}
+
+/**
+ * @brief Stops the workers, dropping bytes they have not parsed yet, and frees
+ *        every stream and every packet left in the output queues.
+ */
+KlvStreamSet::~KlvStreamSet() {
+    stopWorkers();
+
+    for(std::unordered_map<StreamId, Stream*>::iterator it = streams.begin(); it != streams.end(); ++it)
+        delete it->second;
+}
+
+/**
+ * @brief Closes the input rings, joins the worker threads that were started,
+ *        and frees the workers along with the streams and packets they still
+ *        hold.
+ */
+void KlvStreamSet::stopWorkers() {
+    for(size_t i = 0; i < workers.size(); i++)
+        workers[i]->input.close();
+
+    for(size_t i = 0; i < workers.size(); i++) {
+        Worker& worker = *workers[i];
+        if(worker.thread.joinable())
+            worker.thread.join();
+
+        // streams removed after the worker stopped are only referenced from the ring
+        KlvByteRing::Span span;
+        while(worker.input.tryPop(&span, 1) == 1) {
+            if(span.size == 0)
+                delete (Stream*) (uintptr_t) span.tag;
+        }
+
+        Output out;
+        while(worker.output.tryPop(out))
+            KLV::deleteTree(out.klv);
+        Worker::destroy(workers[i]);
+    }
+    workers.clear();
+}
+
+/**
+ * @brief Sets the limits for streams added from now on, see
+ *        KlvParser::setLimits().
+ *
+ * @throws std::invalid_argument if max_ber_bytes is more than an unsigned long
+ *         can hold
+ */
+void KlvStreamSet::setLimits(const KlvParser::Limits& limits) {
+    if(limits.max_ber_bytes > sizeof(unsigned long))
+        throw std::invalid_argument("max_ber_bytes is larger than an unsigned long");
+    this->limits = limits;
+}
+
+/**
+ * @brief Adds a stream and ties it to the next worker. The stream's parser
+ *        takes the lazy nesting, checksum, and limit settings of the set at
+ *        this point. Call from the thread that calls submit().
+ *
+ * @param  id      id of the stream
+ * @param  handler called on the stream's worker with each packet, or empty to
+ *                 queue the packets for poll()
+ * @throws std::invalid_argument if a stream with this id exists
+ */
+void KlvStreamSet::addStream(StreamId id, const Handler& handler) {
+    if(streams.count(id) != 0)
+        throw std::invalid_argument("stream already exists");
+
+    Worker* worker = workers[next_worker];
+    next_worker = (next_worker + 1) % workers.size();
+
+    Stream* stream = new Stream(id, worker, key_encodings, handler);
+    stream->parser.setLazyNesting(lazy_nesting);
+    stream->parser.setChecksumMode(checksum_mode);
+    stream->parser.setLimits(limits);
+    streams[id] = stream;
+}
+
+/**
+ * @brief Removes a stream. Bytes already submitted for it are still parsed,
+ *        then its worker frees it along with any partial packet. Call from the
+ *        thread that calls submit().
+ *
+ * @param  id id of the stream
+ * @throws std::invalid_argument if there is no stream with this id
+ */
+void KlvStreamSet::removeStream(StreamId id) {
+    Stream* stream = findStream(id);
+    streams.erase(id);
+    stream->worker->input.push(NULL, 0, (uintptr_t) stream);
+}
+
+/**
+ * @brief Hands bytes of a stream to its worker, waiting for room in the
+ *        worker's ring if it is full. Only one thread may submit.
+ *
+ * A thread that also calls poll() should use trySubmit() instead: a worker
+ * whose output queue is full stops taking bytes until the queue is drained.
+ *
+ * @param  id   id of the stream
+ * @param  data bytes to parse, copied before the call returns
+ * @param  size number of bytes
+ * @throws std::invalid_argument if there is no stream with this id
+ */
+void KlvStreamSet::submit(StreamId id, const uint8_t* data, size_t size) {
+    Stream* stream = findStream(id);
+    if(size > 0)
+        stream->worker->input.push(data, size, (uintptr_t) stream);
+}
+
+/**
+ * @brief Hands bytes of a stream to its worker if there is room for all of
+ *        them in the worker's ring. Only one thread may submit.
+ *
+ * @param  id   id of the stream
+ * @param  data bytes to parse, copied if the call succeeds
+ * @param  size number of bytes, at most KlvByteRing::getMaxSpan() (a quarter
+ *              of the ring size)
+ * @return      true if the bytes were taken, false if the ring is too full
+ * @throws std::invalid_argument if there is no stream with this id, or size
+ *         is too large
+ */
+bool KlvStreamSet::trySubmit(StreamId id, const uint8_t* data, size_t size) {
+    Stream* stream = findStream(id);
+    return size == 0 || stream->worker->input.tryPush(data, size, (uintptr_t) stream);
+}
+
+/**
+ * @brief Waits until the workers have parsed every byte submitted so far, so
+ *        that every handler call for them has returned. Call from the thread
+ *        that calls submit().
+ */
+void KlvStreamSet::flush() {
+    for(size_t i = 0; i < workers.size(); i++) {
+        while(!workers[i]->input.empty())
+            std::this_thread::yield();
+    }
+}
+
+/**
+ * @brief Takes the next packet off the output queues. Packets of one stream
+ *        come out in stream order; the queues of different workers are
+ *        taken in turn. Only one thread may poll.
+ *
+ * @param  out receives the packet, owned by the caller
+ * @return     true if there was a packet
+ */
+bool KlvStreamSet::poll(Output& out) {
+    for(size_t n = 0; n < workers.size(); n++) {
+        if(workers[next_poll]->output.tryPop(out))
+            return true;
+        next_poll = (next_poll + 1) % workers.size();
+    }
+    return false;
+}
+
+KlvStreamSet::Stream* KlvStreamSet::findStream(StreamId id) const {
+    std::unordered_map<StreamId, Stream*>::const_iterator it = streams.find(id);
+    if(it == streams.end())
+        throw std::invalid_argument("no such stream");
+    return it->second;
+}
+
+/**
+ * @brief Worker thread: parses the spans of its ring in order until the set
+ *        is destroyed.
+ *
+ * @param worker the worker
+ */
+void KlvStreamSet::run(Worker& worker) {
+    KlvByteRing::Span spans[64];
+    size_t n;
+    while((n = worker.input.pop(spans, 64)) > 0) {
+        for(size_t i = 0; i < n; i++) {
+            Stream* stream = (Stream*) (uintptr_t) spans[i].tag;
+            if(spans[i].size == 0) {
+                delete stream;
+                continue;
+            }
+
+            worker.klvs.clear();
+            stream->parser.parse(spans[i].data, spans[i].size, worker.klvs);
+            for(size_t k = 0; k < worker.klvs.size(); k++)
+                deliver(worker, *stream, worker.klvs[k]);
+        }
+
+        // the spans' bytes may be reused now
+        worker.input.release();
+    }
+}
+
+/**
+ * @brief Hands a packet to its stream's handler, or queues it for poll(),
+ *        waiting for room if the queue is full. Dropped if the set is being
+ *        destroyed.
+ */
+void KlvStreamSet::deliver(Worker& worker, Stream& stream, KLV* klv) {
+    if(stream.handler) {
+        stream.handler(stream.id, klv);
+        return;
+    }
+
+    Output out = {stream.id, klv};
+    while(!worker.output.tryPush(out)) {
+        if(worker.input.isClosed()) {
+            KLV::deleteTree(klv);
+            return;
+        }
+        std::this_thread::yield();
+    }
+}
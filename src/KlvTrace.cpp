@@ -0,0 +1,90 @@
+//
+//  KlvTrace.cpp
+//  libklv
+//
+
+#include "KlvTrace.hpp"
+#include <atomic>
+#include <cstdarg>
+#include <cstdio>
+
+#ifdef KLV_HAVE_LOG4CPP
+#include <log4cpp/Category.hh>
+#include <log4cpp/Priority.hh>
+#include <string>
+#endif
+
+namespace {
+    std::atomic<int>        trace_level(KLV_TRACE_ERROR);   // run-time level
+    KlvTrace::Callback      trace_callback = NULL;          // user sink, NULL if none
+    void*                   trace_user_data = NULL;         // passed back to trace_callback
+}
+
+/**
+ * @brief Sets the most verbose level that is traced. Has no effect unless the
+ *        library was built with KLV_ENABLE_TRACE.
+ *
+ * @param level new trace level
+ */
+void KlvTrace::setLevel(KlvTraceLevel level) {
+    trace_level.store(level, std::memory_order_relaxed);
+}
+
+KlvTraceLevel KlvTrace::getLevel() {
+    return (KlvTraceLevel) trace_level.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Checks if messages of a level are currently traced.
+ *
+ * @param  level level of the message
+ * @return       true if the message would be written
+ */
+bool KlvTrace::isEnabled(KlvTraceLevel level) {
+    return level != KLV_TRACE_NONE && level <= trace_level.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Installs a callback that receives every traced message instead of
+ *        log4cpp/stderr. Pass NULL to remove it. Not thread safe with respect to
+ *        concurrent tracing; install the callback before parsing.
+ *
+ * @param callback  function to call with each message
+ * @param user_data opaque pointer handed back to the callback
+ */
+void KlvTrace::setCallback(Callback callback, void* user_data) {
+    trace_callback = callback;
+    trace_user_data = user_data;
+}
+
+/**
+ * @brief Formats a message and hands it to the installed sink. Normally called
+ *        through KLV_TRACE() rather than directly.
+ *
+ * @param level  level of the message
+ * @param format printf-style format string
+ */
+void KlvTrace::write(KlvTraceLevel level, const char* format, ...) {
+    char message[256];
+    va_list args;
+    va_start(args, format);
+    vsnprintf(message, sizeof(message), format, args);
+    va_end(args);
+
+    if(trace_callback != NULL) {
+        trace_callback(level, message, trace_user_data);
+        return;
+    }
+
+#ifdef KLV_HAVE_LOG4CPP
+    log4cpp::Priority::Value priority = log4cpp::Priority::DEBUG;
+    if(level == KLV_TRACE_ERROR)
+        priority = log4cpp::Priority::ERROR;
+    else if(level == KLV_TRACE_INFO)
+        priority = log4cpp::Priority::INFO;
+    // the message is formatted already, so it must not go through the variadic overload
+    log4cpp::Category::getInstance("klv").log(priority, std::string(message));
+#else
+    fprintf(stderr, "%s\n", message);
+#endif
+}
@@ -0,0 +1,344 @@
+//
+//  KlvTsDemuxer.cpp
+//  libklv
+//
+
+#include "KlvTsDemuxer.hpp"
+#include "KlvFormatException.hpp"
+#include "KlvTrace.hpp"
+#include <algorithm>
+#include <cstring>
+
+const size_t KlvTsDemuxer::TS_PACKET_SIZE;
+const uint8_t KlvTsDemuxer::TS_SYNC_BYTE;
+const uint16_t KlvTsDemuxer::NO_PID;
+
+namespace {
+    const uint16_t PAT_PID = 0x0000;
+    const uint8_t PAT_TABLE_ID = 0x00;
+    const uint8_t PMT_TABLE_ID = 0x02;
+    const uint8_t STREAM_TYPE_PRIVATE_PES = 0x06;
+    const uint8_t STREAM_TYPE_METADATA_PES = 0x15;
+    const uint8_t REGISTRATION_DESCRIPTOR = 0x05;
+    const size_t PES_HEADER_MIN_SIZE = 9;
+    const size_t CELL_HEADER_SIZE = 5;
+
+    /**
+     * Finds the section in a PSI payload (after the pointer field) and checks
+     * its table id.
+     *
+     * @return size of the section up to, not including, the CRC, 0 if unusable
+     */
+    size_t sectionSize(const uint8_t*& section, const uint8_t* payload, size_t size, uint8_t table_id) {
+        if(size < 1 || 1 + (size_t) payload[0] + 3 > size)
+            return 0;
+        section = payload + 1 + payload[0];
+        size -= 1 + payload[0];
+        if(section[0] != table_id)
+            return 0;
+        size_t section_length = ((section[1] & 0x0F) << 8) | section[2];
+        if(section_length < 4 || 3 + section_length > size)
+            return 0;
+        return 3 + section_length - 4;
+    }
+}
+
+KlvTsDemuxer::KlvTsDemuxer(KlvParser& parser) : parser(parser) {
+    partial_in_sync = false;
+    ts_in_sync = false;
+    klv_pid = NO_PID;
+    klv_stream_type = 0;
+    klv_pid_fixed = false;
+    last_cc = -1;
+    in_sync = false;
+    in_pes_header = false;
+    cell_header_size = 0;
+    cell_remaining = 0;
+    pts = -1;
+    num_ts_packets = 0;
+    num_sync_losses = 0;
+    num_continuity_errors = 0;
+}
+
+/**
+ * @brief Uses a fixed PID for the KLV stream instead of looking it up in the PMT.
+ *
+ * @param pid         PID of the metadata stream
+ * @param stream_type 0x15 for metadata AU cells, anything else for KLV directly
+ *                    in the PES payload
+ */
+void KlvTsDemuxer::setKlvPid(uint16_t pid, uint8_t stream_type) {
+    klv_pid = pid;
+    klv_stream_type = stream_type;
+    klv_pid_fixed = true;
+    last_cc = -1;
+    in_sync = false;
+}
+
+std::vector<KLV*> KlvTsDemuxer::push(const uint8_t* data, size_t size) {
+    std::vector<KLV*> klvs;
+    try {
+        size_t i = 0;
+
+        // finish the TS packet cut off by the end of the last call, and make sure
+        // the next one starts where it should before trusting it
+        while(!partial.empty() && i < size) {
+            size_t n = std::min(TS_PACKET_SIZE + (partial_in_sync ? 0 : 1) - partial.size(), size - i);
+            partial.insert(partial.end(), data + i, data + i + n);
+            i += n;
+            if(partial.size() < TS_PACKET_SIZE)
+                break;
+
+            if(partial_in_sync) {
+                // started right after a good packet, no need to wait for the next one
+                processPacket(partial.data(), klvs);
+                partial.clear();
+                break;
+            }
+            if(partial.size() == TS_PACKET_SIZE)
+                break;
+
+            if(partial[TS_PACKET_SIZE] == TS_SYNC_BYTE) {
+                processPacket(partial.data(), klvs);
+                partial.clear();
+                i--;    // the sync byte of the next packet
+                break;
+            }
+
+            // it was not a packet start after all, try the next candidate
+            ts_in_sync = false;
+            num_sync_losses++;
+            size_t k = 1 + findSync(partial.data() + 1, partial.size() - 1);
+            partial.erase(partial.begin(), partial.begin() + k);
+        }
+
+        // whole TS packets straight from the caller's buffer
+        while(i + TS_PACKET_SIZE <= size) {
+            if(data[i] != TS_SYNC_BYTE) {
+                ts_in_sync = false;
+                num_sync_losses++;
+                KLV_TRACE(KLV_TRACE_ERROR, "TS sync lost after %lu packets", num_ts_packets);
+                i += findSync(data + i, size - i);
+                continue;
+            }
+            processPacket(data + i, klvs);
+            i += TS_PACKET_SIZE;
+        }
+
+        // keep the start of the next packet for the next call
+        if(i < size) {
+            if(data[i] != TS_SYNC_BYTE) {
+                ts_in_sync = false;
+                num_sync_losses++;
+                i += findSync(data + i, size - i);
+            }
+            partial_in_sync = ts_in_sync;
+            partial.assign(data + i, data + size);
+        }
+    } catch(...) {
+        for(size_t k = 0; k < klvs.size(); k++)
+            KLV::deleteTree(klvs[k]);
+        throw;
+    }
+    return klvs;
+}
+
+/**
+ * @brief Finds the next position that looks like the start of a TS packet: a
+ *        sync byte followed by another one a packet later, or by the end of the
+ *        data.
+ *
+ * @return offset of the sync byte, size if there is none
+ */
+size_t KlvTsDemuxer::findSync(const uint8_t* data, size_t size) const {
+    const uint8_t* p = data;
+    const uint8_t* end = data + size;
+    while(p < end) {
+        p = (const uint8_t*) memchr(p, TS_SYNC_BYTE, end - p);
+        if(p == NULL)
+            return size;
+        if(p + TS_PACKET_SIZE >= end || p[TS_PACKET_SIZE] == TS_SYNC_BYTE)
+            return p - data;
+        p++;
+    }
+    return size;
+}
+
+void KlvTsDemuxer::processPacket(const uint8_t* pkt, std::vector<KLV*>& klvs) {
+    num_ts_packets++;
+    ts_in_sync = true;
+
+    bool tei = pkt[1] & 0x80;
+    bool pusi = pkt[1] & 0x40;
+    uint16_t pid = (uint16_t) (((pkt[1] & 0x1F) << 8) | pkt[2]);
+    uint8_t afc = (pkt[3] >> 4) & 0x03;
+    uint8_t cc = pkt[3] & 0x0F;
+    if(tei)
+        return;
+
+    size_t offset = 4;
+    if(afc & 0x02)
+        offset += 1 + pkt[4];
+    bool has_payload = (afc & 0x01) && offset < TS_PACKET_SIZE;
+
+    if(pid == klv_pid) {
+        // a repeated packet is sent twice on purpose, a gap means lost data
+        if(has_payload && last_cc >= 0) {
+            if(cc == last_cc)
+                return;
+            if(cc != ((last_cc + 1) & 0x0F)) {
+                num_continuity_errors++;
+                KLV_TRACE(KLV_TRACE_ERROR, "KLV PID %u continuity error, %d -> %u", pid, last_cc, cc);
+                in_sync = false;
+                parser.reset();
+            }
+        }
+        if(has_payload)
+            last_cc = cc;
+    }
+
+    if(!has_payload)
+        return;
+
+    const uint8_t* payload = pkt + offset;
+    size_t size = TS_PACKET_SIZE - offset;
+    if(pid == klv_pid) {
+        processKlvPayload(payload, size, pusi, klvs);
+    } else if(pid == PAT_PID) {
+        if(pusi)
+            parsePat(payload, size);
+    } else if(pusi && std::find(pmt_pids.begin(), pmt_pids.end(), pid) != pmt_pids.end()) {
+        parsePmt(payload, size);
+    }
+}
+
+void KlvTsDemuxer::parsePat(const uint8_t* payload, size_t size) {
+    const uint8_t* section = NULL;
+    size_t n = sectionSize(section, payload, size, PAT_TABLE_ID);
+    if(n == 0)
+        return;
+
+    // program loop after the 8 byte section header, 4 bytes per program
+    for(size_t i = 8; i + 4 <= n; i += 4) {
+        uint16_t program_number = (uint16_t) ((section[i] << 8) | section[i+1]);
+        uint16_t pid = (uint16_t) (((section[i+2] & 0x1F) << 8) | section[i+3]);
+        if(program_number != 0 && std::find(pmt_pids.begin(), pmt_pids.end(), pid) == pmt_pids.end())
+            pmt_pids.push_back(pid);
+    }
+}
+
+void KlvTsDemuxer::parsePmt(const uint8_t* payload, size_t size) {
+    if(klv_pid != NO_PID)
+        return;
+
+    const uint8_t* section = NULL;
+    size_t n = sectionSize(section, payload, size, PMT_TABLE_ID);
+    if(n < 12)
+        return;
+
+    // elementary stream loop after the program info descriptors
+    size_t program_info_length = ((section[10] & 0x0F) << 8) | section[11];
+    for(size_t i = 12 + program_info_length; i + 5 <= n; ) {
+        uint8_t stream_type = section[i];
+        uint16_t pid = (uint16_t) (((section[i+1] & 0x1F) << 8) | section[i+2]);
+        size_t es_info_length = ((section[i+3] & 0x0F) << 8) | section[i+4];
+        const uint8_t* descriptors = section + i + 5;
+        size_t descriptors_end = std::min(i + 5 + es_info_length, n) - (i + 5);
+        i += 5 + es_info_length;
+
+        bool is_klv = stream_type == STREAM_TYPE_METADATA_PES;
+        for(size_t d = 0; stream_type == STREAM_TYPE_PRIVATE_PES && d + 2 <= descriptors_end; d += 2 + descriptors[d+1]) {
+            if(descriptors[d] == REGISTRATION_DESCRIPTOR && descriptors[d+1] >= 4 && d + 6 <= descriptors_end
+                    && memcmp(descriptors + d + 2, "KLVA", 4) == 0)
+                is_klv = true;
+        }
+
+        if(is_klv) {
+            KLV_TRACE(KLV_TRACE_INFO, "KLV stream on PID %u, stream_type 0x%02x", pid, stream_type);
+            klv_pid = pid;
+            klv_stream_type = stream_type;
+            last_cc = -1;
+            in_sync = false;
+            return;
+        }
+    }
+}
+
+void KlvTsDemuxer::processKlvPayload(const uint8_t* payload, size_t size, bool pusi, std::vector<KLV*>& klvs) {
+    if(pusi) {
+        in_sync = true;
+        in_pes_header = true;
+        pes_header.clear();
+        cell_header_size = 0;
+        cell_remaining = 0;
+    }
+    if(!in_sync)
+        return;
+
+    // collect the PES header, which is nearly always inside the first TS packet
+    while(in_pes_header && size > 0) {
+        size_t needed = pes_header.size() < PES_HEADER_MIN_SIZE ? PES_HEADER_MIN_SIZE : PES_HEADER_MIN_SIZE + pes_header[8];
+        size_t n = std::min(needed - pes_header.size(), size);
+        pes_header.insert(pes_header.end(), payload, payload + n);
+        payload += n;
+        size -= n;
+        if(pes_header.size() < needed)
+            return;
+
+        if(pes_header[0] != 0x00 || pes_header[1] != 0x00 || pes_header[2] != 0x01) {
+            KLV_TRACE(KLV_TRACE_ERROR, "bad PES start code on KLV PID %u", klv_pid);
+            in_sync = false;
+            return;
+        }
+        if(pes_header.size() == PES_HEADER_MIN_SIZE + pes_header[8]) {
+            in_pes_header = false;
+            pts = -1;
+            if((pes_header[7] & 0x80) && pes_header[8] >= 5) {
+                const uint8_t* p = &pes_header[9];
+                pts = ((int64_t) (p[0] & 0x0E) << 29) | ((int64_t) p[1] << 22) | ((int64_t) (p[2] & 0xFE) << 14)
+                    | ((int64_t) p[3] << 7) | (p[4] >> 1);
+            }
+        }
+    }
+
+    if(klv_stream_type == STREAM_TYPE_METADATA_PES)
+        processCells(payload, size, klvs);
+    else
+        feed(payload, size, klvs);
+}
+
+/**
+ * @brief Strips the 5-byte metadata AU cell headers and feeds the cell data.
+ */
+void KlvTsDemuxer::processCells(const uint8_t* data, size_t size, std::vector<KLV*>& klvs) {
+    while(size > 0) {
+        if(cell_remaining == 0) {
+            size_t n = std::min(CELL_HEADER_SIZE - cell_header_size, size);
+            memcpy(cell_header + cell_header_size, data, n);
+            cell_header_size += n;
+            data += n;
+            size -= n;
+            if(cell_header_size == CELL_HEADER_SIZE) {
+                cell_remaining = (cell_header[3] << 8) | cell_header[4];
+                cell_header_size = 0;
+            }
+            continue;
+        }
+
+        size_t n = std::min(cell_remaining, size);
+        feed(data, n, klvs);
+        data += n;
+        size -= n;
+        cell_remaining -= n;
+    }
+}
+
+void KlvTsDemuxer::feed(const uint8_t* data, size_t size, std::vector<KLV*>& klvs) {
+    if(size == 0)
+        return;
+    // parsed straight into klvs; if this throws, the caller frees them
+    unsigned long failures = parser.getNumChecksumFailures();
+    parser.parse(data, size, klvs);
+    if(parser.getChecksumMode() == KlvParser::CHECKSUM_THROW && parser.getNumChecksumFailures() != failures)
+        throw KlvFormatException(KLV_ERROR_CHECKSUM);
+}
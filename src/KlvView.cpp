@@ -0,0 +1,62 @@
+//
+//  KlvView.cpp
+//  libklv
+//
+
+#include "KlvView.hpp"
+
+KlvView::KlvView() {
+    this->len = 0;
+    this->ber_len = 0;
+    this->parent = NULL;
+    this->child = NULL;
+    this->previous_sibling = NULL;
+    this->next_sibling = NULL;
+}
+
+/**
+ * @brief Constructs a view over an already framed KLV triplet.
+ *
+ * @param key         span of the key field
+ * @param len         span of the BER-encoded length field
+ * @param val         span of the value field
+ * @param decoded_len decoded value of the length field
+ */
+KlvView::KlvView(KlvSpan key, KlvSpan len, KlvSpan val, unsigned long decoded_len) {
+    this->key = key;
+    this->len_encoded = len;
+    this->value = val;
+    this->len = decoded_len;
+    this->ber_len = len.size > 1 ? len.size - 1 : 0;
+    this->parent = NULL;
+    this->child = NULL;
+    this->previous_sibling = NULL;
+    this->next_sibling = NULL;
+}
+
+/**
+ * @brief Copies this view and all of its children into a new KLV tree.
+ *
+ * @return the new root KLV. Ownership is transfered to the caller, as with
+ *         KlvParser::parseByte().
+ */
+KLV* KlvView::toOwned() const {
+    KLV* klv = new KLV(key.toVector(), len_encoded.toVector(), value.toVector());
+
+    KLV* previous = NULL;
+    for(const KlvView* node = child; node != NULL; node = node->getNext()) {
+        KLV* sub_klv = node->toOwned();
+        sub_klv->setParent(klv);
+        if(previous == NULL) {
+            klv->setChild(sub_klv);
+        } else {
+            previous->setNextSibling(sub_klv);
+            sub_klv->setPreviousSibling(previous);
+        }
+        previous = sub_klv;
+    }
+    if(child != NULL)
+        klv->markDroppedItems();
+
+    return klv;
+}
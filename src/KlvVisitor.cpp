@@ -0,0 +1,60 @@
+//
+//  KlvVisitor.cpp
+//  libklv
+//
+
+#include "KlvVisitor.hpp"
+
+/**
+ * @brief Builds the KLV of a set and makes it the parent of the KLVs that
+ *        follow until its onSetEnd().
+ */
+void KlvBuilder::onSetBegin(size_t /*depth*/, const KlvSpan& key, const KlvSpan& len, const KlvSpan& value) {
+    KLV* klv = new KLV(key.data, key.size, len.data, len.size, value.data, value.size);
+    add(klv);
+    OpenSet set = {klv, NULL};
+    open_sets.push_back(set);
+}
+
+/**
+ * @brief Builds the KLV of an item, a child of the innermost open set or a
+ *        top level KLV of its own.
+ */
+void KlvBuilder::onItem(size_t /*depth*/, uint64_t /*tag*/, const KlvSpan& key, const KlvSpan& len, const KlvSpan& value) {
+    KLV* klv = new KLV(key.data, key.size, len.data, len.size, value.data, value.size);
+    if(open_sets.empty())
+        klvs.push_back(klv);
+    else
+        add(klv);
+}
+
+/**
+ * @brief Closes the innermost open set, handing it out if it is a top level
+ *        KLV.
+ */
+void KlvBuilder::onSetEnd(size_t /*depth*/, bool /*ok*/) {
+    KLV* klv = open_sets.back().klv;
+    klv->markDroppedItems();
+    open_sets.pop_back();
+    if(open_sets.empty())
+        klvs.push_back(klv);
+}
+
+/**
+ * @brief Links a new KLV in as the last child of the innermost open set, if
+ *        there is one.
+ */
+void KlvBuilder::add(KLV* klv) {
+    if(open_sets.empty())
+        return;
+
+    OpenSet& set = open_sets.back();
+    klv->setParent(set.klv);
+    if(set.last_child == NULL) {
+        set.klv->setChild(klv);
+    } else {
+        set.last_child->setNextSibling(klv);
+        klv->setPreviousSibling(set.last_child);
+    }
+    set.last_child = klv;
+}
@@ -0,0 +1,261 @@
+#include <algorithm>
+#include <stdint.h>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include "KlvAllocCounter.hpp"
+#include "BasicKlvParser.hpp"
+#include "KlvFormatException.hpp"
+#include "KlvParser.hpp"
+
+
+class BasicKlvParserTest : public ::testing::Test {
+protected:
+    BasicKlvParserTest() {
+    }
+
+    virtual ~BasicKlvParserTest() {
+    }
+
+    virtual void SetUp() {
+        // key: 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x0B, 0x01, 0x01, 0x0E, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00
+        // len: 0x81, 0x90 (144 bytes)
+        // val: the rest
+        test_pkt = { 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x0B, 0x01, 0x01, 0x0E, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00, 0x81, 0x90, 0x02, 0x08, 0x00, 0x04, 0x6C, 0xAE, 0x70, 0xF9, 0x80, 0xCF, 0x41, 0x01, 0x01, 0x05, 0x02, 0xE1, 0x91, 0x06, 0x02, 0x06, 0x0D, 0x07, 0x02, 0x0A, 0xE1, 0x0B, 0x02, 0x49, 0x52, 0x0C, 0x0E, 0x47, 0x65, 0x6F, 0x64, 0x65, 0x74, 0x69, 0x63, 0x20, 0x57, 0x47, 0x53, 0x38, 0x34, 0x0D, 0x04, 0x4D, 0xCC, 0x41, 0x90, 0x0E, 0x04, 0xB1, 0xD0, 0x3D, 0x96, 0x0F, 0x02, 0x1B, 0x2E, 0x10, 0x02, 0x00, 0x84, 0x11, 0x02, 0x00, 0x4A, 0x12, 0x04, 0xE7, 0x23, 0x0B, 0x61, 0x13, 0x04, 0xFD, 0xE8, 0x63, 0x8E, 0x14, 0x04, 0x03, 0x0B, 0xC7, 0x1C, 0x15, 0x04, 0x00, 0x9F, 0xB9, 0x38, 0x16, 0x04, 0x00, 0x00, 0x01, 0xF8, 0x17, 0x04, 0x4D, 0xEC, 0xDA, 0xF4, 0x18, 0x04, 0xB1, 0xBC, 0x81, 0x74, 0x19, 0x02, 0x0B, 0x8A, 0x28, 0x04, 0x4D, 0xEC, 0xDA, 0xF4, 0x29, 0x04, 0xB1, 0xBC, 0x81, 0x74, 0x2A, 0x02, 0x0B, 0x8A, 0x38, 0x01, 0x31, 0x39, 0x04, 0x00, 0x9F, 0x85, 0x4D, 0x01, 0x02, 0xB7, 0xEB };
+    }
+
+    virtual void TearDown() {
+
+    }
+
+    // objects delclared here can be used by all tests in the test case for BasicKlvParser
+    std::vector<uint8_t> test_pkt;
+
+};
+
+static void deleteTrees(const std::vector<KLV*>& klvs) {
+    for(size_t i = 0; i < klvs.size(); i++)
+        KLV::deleteTree(klvs[i]);
+}
+
+// same fields, checksum status, and children, all the way down
+static void expectSameTree(const KLV* expected, const KLV* actual) {
+    ASSERT_TRUE(actual != NULL);
+    EXPECT_EQ(expected->getKey(), actual->getKey());
+    EXPECT_EQ(expected->getLenEncoded(), actual->getLenEncoded());
+    EXPECT_EQ(expected->getValue(), actual->getValue());
+    EXPECT_EQ(expected->getChecksumStatus(), actual->getChecksumStatus());
+
+    const KLV* a = actual->getChild();
+    for(const KLV* e = expected->getChild(); e != NULL; e = e->getNext()) {
+        ASSERT_TRUE(a != NULL);
+        EXPECT_EQ(actual, a->getParent());
+        expectSameTree(e, a);
+        a = a->getNext();
+    }
+    EXPECT_TRUE(a == NULL);
+}
+
+static void expectSameKlvs(const std::vector<KLV*>& expected, const std::vector<KLV*>& actual) {
+    ASSERT_EQ(expected.size(), actual.size());
+    for(size_t i = 0; i < expected.size(); i++)
+        expectSameTree(expected[i], actual[i]);
+}
+
+// feeds buf in chunks of chunk_size bytes
+template<typename Parser>
+static std::vector<KLV*> parseInChunks(Parser& parser, const std::vector<uint8_t>& buf, size_t chunk_size) {
+    std::vector<KLV*> klvs;
+    for(size_t offset = 0; offset < buf.size(); offset += chunk_size)
+        parser.parse(buf.data() + offset, std::min(chunk_size, buf.size() - offset), klvs);
+    return klvs;
+}
+
+// short form KLV with the given key and value
+static std::vector<uint8_t> makeKlv(const std::vector<uint8_t>& key, const std::vector<uint8_t>& value) {
+    std::vector<uint8_t> klv(key);
+    klv.push_back((uint8_t) value.size());
+    klv.insert(klv.end(), value.begin(), value.end());
+    return klv;
+}
+
+TEST_F(BasicKlvParserTest, TestParsePkt) {
+    KlvSt0601Parser parser;
+    std::vector<KLV*> klvs = parser.parse(test_pkt);
+    ASSERT_EQ(1, klvs.size());
+    EXPECT_EQ(144, klvs[0]->getLen());
+    EXPECT_THAT(klvs[0]->getValue(), ::testing::ElementsAreArray(test_pkt.data() + 18, 144));
+
+    // first item is the timestamp
+    KLV* child = klvs[0]->getChild();
+    ASSERT_TRUE(child != NULL);
+    EXPECT_THAT(child->getKey(), ::testing::ElementsAre(0x02));
+    EXPECT_THAT(child->getValue(), ::testing::ElementsAreArray(test_pkt.data() + 20, 8));
+    EXPECT_TRUE(child->getPrevious() == NULL);
+
+    KlvParser runtime({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    std::vector<KLV*> expected = runtime.parse(test_pkt);
+    expectSameKlvs(expected, klvs);
+
+    deleteTrees(klvs);
+    deleteTrees(expected);
+}
+
+TEST_F(BasicKlvParserTest, TestMatchesKlvParser) {
+    // garbage, a good packet, a packet with a bad checksum, a partial UL header,
+    // a packet with an over long length field, and a good packet
+    std::vector<uint8_t> bad(test_pkt);
+    bad[40] ^= 0x01;
+    std::vector<uint8_t> buf = {0x00, 0x06, 0x0E, 0xFF, 0x12};
+    buf.insert(buf.end(), test_pkt.begin(), test_pkt.end());
+    buf.insert(buf.end(), bad.begin(), bad.end());
+    buf.insert(buf.end(), {0x06, 0x0E, 0x2B});
+    buf.insert(buf.end(), test_pkt.begin(), test_pkt.begin() + 16);
+    buf.insert(buf.end(), {0x89, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10});
+    buf.insert(buf.end(), test_pkt.begin(), test_pkt.end());
+
+    const KlvParser::ChecksumMode modes[] = {KlvParser::CHECKSUM_OFF, KlvParser::CHECKSUM_MARK, KlvParser::CHECKSUM_DROP};
+    const size_t chunk_sizes[] = {1, 7, 100, 161, 162, 163, buf.size()};
+    for(KlvParser::ChecksumMode mode : modes) {
+        for(size_t chunk_size : chunk_sizes) {
+            KlvParser runtime({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+            runtime.setChecksumMode(mode);
+            KlvSt0601Parser parser;
+            parser.setChecksumMode(mode);
+
+            std::vector<KLV*> expected = parseInChunks(runtime, buf, chunk_size);
+            std::vector<KLV*> klvs = parseInChunks(parser, buf, chunk_size);
+            expectSameKlvs(expected, klvs);
+            EXPECT_EQ(runtime.getNumErrors(), parser.getNumErrors());
+            EXPECT_EQ(runtime.getLastError(), parser.getLastError());
+            EXPECT_EQ(runtime.getNumChecksumFailures(), parser.getNumChecksumFailures());
+            deleteTrees(expected);
+            deleteTrees(klvs);
+        }
+    }
+
+    // byte at a time through parseByte()
+    KlvParser runtime({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    KlvSt0601Parser parser;
+    std::vector<KLV*> expected;
+    std::vector<KLV*> klvs;
+    for(uint8_t b : buf) {
+        KLV* klv = runtime.parseByte(b);
+        if(klv != NULL)
+            expected.push_back(klv);
+        klv = parser.parseByte(b);
+        if(klv != NULL)
+            klvs.push_back(klv);
+    }
+    EXPECT_EQ(3, klvs.size());
+    expectSameKlvs(expected, klvs);
+    deleteTrees(expected);
+    deleteTrees(klvs);
+}
+
+TEST_F(BasicKlvParserTest, TestOtherEncodings) {
+    // 1-byte keys outside, 2-byte keys inside, 4-byte keys below that, with a
+    // truncated last item on the middle level
+    std::vector<uint8_t> inner = makeKlv({0x00, 0x00, 0x00, 0x07}, {0xAA, 0xBB});
+    std::vector<uint8_t> middle = makeKlv({0x01, 0x02}, inner);
+    std::vector<uint8_t> second = makeKlv({0x01, 0x03}, {0x01});
+    middle.insert(middle.end(), second.begin(), second.end());
+    middle.insert(middle.end(), {0x01, 0x04, 0x05, 0x00});
+    std::vector<uint8_t> buf = makeKlv({0x2A}, middle);
+    std::vector<uint8_t> empty = makeKlv({0x2B}, {});
+    buf.insert(buf.end(), empty.begin(), empty.end());
+
+    KlvParser runtime({KlvParser::KEY_ENCODING_1_BYTE, KlvParser::KEY_ENCODING_2_BYTE, KlvParser::KEY_ENCODING_4_BYTE});
+    BasicKlvParser<KlvParser::KEY_ENCODING_1_BYTE, KlvParser::KEY_ENCODING_2_BYTE, KlvParser::KEY_ENCODING_4_BYTE> parser;
+    std::vector<KLV*> expected = runtime.parse(buf);
+    std::vector<KLV*> klvs = parser.parse(buf);
+    ASSERT_EQ(2, klvs.size());
+    expectSameKlvs(expected, klvs);
+
+    // two items on the middle level, the first with one item below it
+    KLV* child = klvs[0]->getChild();
+    ASSERT_TRUE(child != NULL);
+    ASSERT_TRUE(child->getNext() != NULL);
+    EXPECT_TRUE(child->getNext()->getNext() == NULL);
+    ASSERT_TRUE(child->getChild() != NULL);
+    EXPECT_THAT(child->getChild()->getValue(), ::testing::ElementsAre(0xAA, 0xBB));
+    EXPECT_TRUE(klvs[1]->getValue().empty());
+    deleteTrees(expected);
+    deleteTrees(klvs);
+
+    // BER-OID keys on both levels, with a multi-byte key
+    std::vector<uint8_t> local = makeKlv({0x81, 0x01}, {0x10});
+    std::vector<uint8_t> set = makeKlv({0x48}, local);
+    KlvParser runtime_oid({KlvParser::KEY_ENCODING_BER_OID, KlvParser::KEY_ENCODING_BER_OID});
+    BasicKlvParser<KlvParser::KEY_ENCODING_BER_OID, KlvParser::KEY_ENCODING_BER_OID> oid_parser;
+    expected = runtime_oid.parse(set);
+    klvs = oid_parser.parse(set);
+    ASSERT_EQ(1, klvs.size());
+    expectSameKlvs(expected, klvs);
+    EXPECT_EQ(129, KlvKeyFormat<KlvParser::KEY_ENCODING_BER_OID>::decodeTag(klvs[0]->getChild()->getKey().data(), 2));
+    deleteTrees(expected);
+    deleteTrees(klvs);
+}
+
+TEST_F(BasicKlvParserTest, TestLimits) {
+    // a value size limit below the packet size rejects the packet
+    KlvSt0601Parser parser;
+    KlvParser::Limits limits;
+    limits.max_value_size = 100;
+    parser.setLimits(limits);
+    std::vector<KLV*> klvs;
+    EXPECT_EQ(KLV_ERROR_VALUE_SIZE, parser.parse(test_pkt.data(), test_pkt.size(), klvs));
+    EXPECT_EQ(0, klvs.size());
+    EXPECT_EQ(1, parser.getNumErrors());
+
+    // nested items are left in the value
+    limits = KlvParser::Limits();
+    limits.max_depth = 0;
+    parser.setLimits(limits);
+    klvs = parser.parse(test_pkt);
+    ASSERT_EQ(1, klvs.size());
+    EXPECT_TRUE(klvs[0]->getChild() == NULL);
+    delete klvs[0];
+
+    limits.max_ber_bytes = sizeof(unsigned long) + 1;
+    EXPECT_THROW(parser.setLimits(limits), std::invalid_argument);
+}
+
+TEST_F(BasicKlvParserTest, TestChecksumThrow) {
+    std::vector<uint8_t> bad(test_pkt);
+    bad[bad.size() - 1] ^= 0xFF;
+
+    // thrown, and the parser carries on with the next packet
+    KlvSt0601Parser parser;
+    parser.setChecksumMode(KlvParser::CHECKSUM_THROW);
+    EXPECT_THROW(parser.parse(bad), KlvFormatException);
+    bool thrown = false;
+    for(uint8_t b : bad) {
+        try {
+            EXPECT_TRUE(parser.parseByte(b) == NULL);
+        } catch(const KlvFormatException& e) {
+            EXPECT_EQ(KLV_ERROR_CHECKSUM, e.getStatus());
+            thrown = true;
+        }
+    }
+    EXPECT_TRUE(thrown);
+
+    std::vector<KLV*> next = parser.parse(test_pkt);
+    ASSERT_EQ(1, next.size());
+    EXPECT_EQ(KLV_CHECKSUM_VALID, next[0]->getChecksumStatus());
+    EXPECT_EQ(2, parser.getNumChecksumFailures());
+
+    // status API reports it instead
+    std::vector<KLV*> klvs;
+    EXPECT_EQ(KLV_ERROR_CHECKSUM, parser.parse(bad.data(), bad.size(), klvs));
+    EXPECT_TRUE(klvs.empty());
+    deleteTrees(next);
+
+    // the good packets parsed along with a bad one are freed, items and all
+    std::vector<uint8_t> both(test_pkt);
+    both.insert(both.end(), bad.begin(), bad.end());
+    KlvAllocCounter allocs;
+    EXPECT_THROW(parser.parse(both), KlvFormatException);
+    EXPECT_EQ(allocs.allocations(), allocs.deallocations());
+}
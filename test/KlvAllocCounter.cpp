@@ -0,0 +1,63 @@
+//
+//  KlvAllocCounter.cpp
+//  libklv
+//
+
+#include "KlvAllocCounter.hpp"
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+namespace {
+    std::atomic<size_t> num_allocations(0);
+    std::atomic<size_t> num_deallocations(0);
+
+    void release(void* p) {
+        if(p == NULL)
+            return;
+        num_deallocations.fetch_add(1, std::memory_order_relaxed);
+        free(p);
+    }
+}
+
+// count every allocation made by the library and the tests
+void* operator new(size_t size) {
+    num_allocations.fetch_add(1, std::memory_order_relaxed);
+    void* p = malloc(size == 0 ? 1 : size);
+    if(p == NULL)
+        throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept {
+    release(p);
+}
+
+void operator delete[](void* p) noexcept {
+    release(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    release(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    release(p);
+}
+
+void KlvAllocCounter::restart() {
+    this->num_allocations = ::num_allocations.load(std::memory_order_relaxed);
+    this->num_deallocations = ::num_deallocations.load(std::memory_order_relaxed);
+}
+
+size_t KlvAllocCounter::allocations() const {
+    return ::num_allocations.load(std::memory_order_relaxed) - this->num_allocations;
+}
+
+size_t KlvAllocCounter::deallocations() const {
+    return ::num_deallocations.load(std::memory_order_relaxed) - this->num_deallocations;
+}
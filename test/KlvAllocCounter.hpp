@@ -0,0 +1,47 @@
+//
+//  KlvAllocCounter.hpp
+//  libklv
+//
+
+#ifndef KlvAllocCounter_hpp
+#define KlvAllocCounter_hpp
+
+#include <cstddef>
+
+/**
+ * @brief Test hook that counts heap allocations. The unit test binary replaces
+ *        the global allocation functions, so every operator new and operator
+ *        delete made by the library and the tests is counted. Counts are taken
+ *        over the whole process; measure single threaded code with them.
+ *
+ *     KlvAllocCounter allocs;
+ *     parser.parseTree(data, size, tree);
+ *     EXPECT_EQ(0, allocs.allocations());
+ */
+class KlvAllocCounter {
+
+public:
+    KlvAllocCounter() { restart(); }
+
+    /**
+     * @brief Starts counting again from now.
+     */
+    void restart();
+
+    /**
+     * @return number of calls to operator new since the counter was started
+     */
+    size_t allocations() const;
+
+    /**
+     * @return number of calls to operator delete (with a non-NULL pointer)
+     *         since the counter was started
+     */
+    size_t deallocations() const;
+
+private:
+    size_t num_allocations;         /// global count when the counter was started
+    size_t num_deallocations;
+};
+
+#endif /* KlvAllocCounter_hpp */
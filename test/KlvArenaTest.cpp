@@ -0,0 +1,104 @@
+#include <stdint.h>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include "KlvArena.hpp"
+#include "KlvParser.hpp"
+#include "KlvTree.hpp"
+
+class KlvArenaTest : public ::testing::Test {
+protected:
+    KlvArenaTest() {
+
+    }
+
+    virtual ~KlvArenaTest() {
+
+    }
+
+    virtual void SetUp() {
+        // key: 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x0B, 0x01, 0x01, 0x0E, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00
+        // len: 0x81, 0x90 (144 bytes)
+        // val: the rest
+        test_pkt = { 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x0B, 0x01, 0x01, 0x0E, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00, 0x81, 0x90, 0x02, 0x08, 0x00, 0x04, 0x6C, 0xAE, 0x70, 0xF9, 0x80, 0xCF, 0x41, 0x01, 0x01, 0x05, 0x02, 0xE1, 0x91, 0x06, 0x02, 0x06, 0x0D, 0x07, 0x02, 0x0A, 0xE1, 0x0B, 0x02, 0x49, 0x52, 0x0C, 0x0E, 0x47, 0x65, 0x6F, 0x64, 0x65, 0x74, 0x69, 0x63, 0x20, 0x57, 0x47, 0x53, 0x38, 0x34, 0x0D, 0x04, 0x4D, 0xCC, 0x41, 0x90, 0x0E, 0x04, 0xB1, 0xD0, 0x3D, 0x96, 0x0F, 0x02, 0x1B, 0x2E, 0x10, 0x02, 0x00, 0x84, 0x11, 0x02, 0x00, 0x4A, 0x12, 0x04, 0xE7, 0x23, 0x0B, 0x61, 0x13, 0x04, 0xFD, 0xE8, 0x63, 0x8E, 0x14, 0x04, 0x03, 0x0B, 0xC7, 0x1C, 0x15, 0x04, 0x00, 0x9F, 0xB9, 0x38, 0x16, 0x04, 0x00, 0x00, 0x01, 0xF8, 0x17, 0x04, 0x4D, 0xEC, 0xDA, 0xF4, 0x18, 0x04, 0xB1, 0xBC, 0x81, 0x74, 0x19, 0x02, 0x0B, 0x8A, 0x28, 0x04, 0x4D, 0xEC, 0xDA, 0xF4, 0x29, 0x04, 0xB1, 0xBC, 0x81, 0x74, 0x2A, 0x02, 0x0B, 0x8A, 0x38, 0x01, 0x31, 0x39, 0x04, 0x00, 0x9F, 0x85, 0x4D, 0x01, 0x02, 0xB7, 0xEB };
+    }
+
+    virtual void TearDown() {
+
+    }
+
+    // objects delclared here can be used by all tests in the test case for KlvArenaTest
+    std::vector<uint8_t> test_pkt;
+};
+
+TEST_F(KlvArenaTest, TestAllocateAndReset) {
+    KlvArena arena(64);
+
+    uint8_t* a = (uint8_t*) arena.allocate(3, 1);
+    uint64_t* b = (uint64_t*) arena.allocate(sizeof(uint64_t), alignof(uint64_t));
+    EXPECT_EQ(0, ((uintptr_t) b) % alignof(uint64_t));
+    EXPECT_NE((void*) a, (void*) b);
+
+    // overflow into more blocks, including one bigger than the block size
+    arena.allocate(60, 1);
+    arena.allocate(200, 1);
+    EXPECT_EQ(3, arena.getNumBlocks());
+    size_t capacity = arena.getCapacity();
+
+    // reset merges everything into one block
+    arena.reset();
+    EXPECT_EQ(1, arena.getNumBlocks());
+    EXPECT_EQ(capacity, arena.getCapacity());
+    EXPECT_EQ(0, arena.getBytesUsed());
+
+    arena.release();
+    EXPECT_EQ(0, arena.getNumBlocks());
+}
+
+TEST_F(KlvArenaTest, TestParseTreeCopiesValues) {
+    // the tree does not depend on the parsed buffer when values are copied
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    std::vector<uint8_t> buf = test_pkt;
+    KlvTree tree;
+
+    size_t consumed = parser.parseTree(buf.data(), buf.size(), tree);
+    EXPECT_EQ(buf.size(), consumed);
+    ASSERT_FALSE(tree.empty());
+
+    std::fill(buf.begin(), buf.end(), 0);
+    const KlvView* root = tree.getRoot();
+    std::vector<uint8_t> test_val(test_pkt.begin() + 18, test_pkt.end());
+    EXPECT_THAT(root->getValue().toVector(), ::testing::ContainerEq(test_val));
+
+    int num_children = 0;
+    for(const KlvView* node = root->getChild(); node != NULL; node = node->getNext())
+        num_children++;
+    EXPECT_EQ(26, num_children);
+}
+
+TEST_F(KlvArenaTest, TestParseTreeRecycles) {
+    // a stream of packets, some split across calls, settles on one arena block
+    std::vector<uint8_t> buf;
+    for(int i = 0; i < 50; i++)
+        buf.insert(buf.end(), test_pkt.begin(), test_pkt.end());
+
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    KlvTree tree(256);
+    int num_pkts = 0;
+    size_t chunk = 100;
+    for(size_t start = 0; start < buf.size(); start += chunk) {
+        size_t end = std::min(start + chunk, buf.size());
+        size_t offset = start;
+        while(offset < end) {
+            offset += parser.parseTree(buf.data() + offset, end - offset, tree);
+            if(!tree.empty()) {
+                EXPECT_EQ(144, tree.getRoot()->getLen());
+                num_pkts++;
+            }
+        }
+    }
+
+    EXPECT_EQ(50, num_pkts);
+    EXPECT_EQ(1, tree.getArena().getNumBlocks());
+}
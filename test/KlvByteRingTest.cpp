@@ -0,0 +1,123 @@
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include "KlvByteRing.hpp"
+#include "KlvSpscRing.hpp"
+
+class KlvByteRingTest : public ::testing::Test {
+protected:
+    KlvByteRingTest() {
+
+    }
+
+    virtual ~KlvByteRingTest() {
+
+    }
+
+    virtual void SetUp() {
+
+    }
+
+    virtual void TearDown() {
+
+    }
+};
+
+TEST_F(KlvByteRingTest, TestSpscRing) {
+    KlvSpscRing<int> ring(5);
+    EXPECT_EQ(8, ring.capacity());
+    for(int i = 0; i < 8; i++)
+        EXPECT_TRUE(ring.tryPush(i));
+    EXPECT_FALSE(ring.tryPush(8));
+    EXPECT_EQ(8, ring.size());
+
+    int items[3];
+    ASSERT_EQ(3, ring.tryPop(items, 3));
+    EXPECT_EQ(0, items[0]);
+    EXPECT_EQ(2, items[2]);
+    EXPECT_TRUE(ring.tryPush(8));
+
+    // the batch stops at what is there
+    int rest[16];
+    ASSERT_EQ(6, ring.tryPop(rest, 16));
+    EXPECT_EQ(3, rest[0]);
+    EXPECT_EQ(8, rest[5]);
+    EXPECT_TRUE(ring.empty());
+    EXPECT_FALSE(ring.tryPop(items[0]));
+}
+
+TEST_F(KlvByteRingTest, TestSpans) {
+    KlvByteRing ring(4096);
+    EXPECT_EQ(4096, ring.capacity());
+    EXPECT_EQ(1024 - 16, ring.getMaxSpan());
+
+    std::vector<uint8_t> bytes(3100);
+    for(size_t i = 0; i < bytes.size(); i++)
+        bytes[i] = (uint8_t) i;
+
+    // a large span is split, an empty one kept
+    ring.push(bytes.data(), bytes.size(), 7);
+    ring.push(NULL, 0, 8);
+    EXPECT_FALSE(ring.empty());
+
+    KlvByteRing::Span spans[8];
+    size_t n = ring.tryPop(spans, 8);
+    ASSERT_EQ(5, n);
+    std::vector<uint8_t> joined;
+    for(size_t i = 0; i < 4; i++) {
+        EXPECT_EQ(7, spans[i].tag);
+        joined.insert(joined.end(), spans[i].data, spans[i].data + spans[i].size);
+    }
+    EXPECT_THAT(joined, ::testing::ContainerEq(bytes));
+    EXPECT_EQ(0, spans[4].size);
+    EXPECT_EQ(8, spans[4].tag);
+
+    // popped spans hold their room until released
+    EXPECT_FALSE(ring.tryPush(bytes.data(), 1000));
+    ring.release();
+    EXPECT_TRUE(ring.empty());
+    EXPECT_TRUE(ring.tryPush(bytes.data(), 1000));
+    EXPECT_THROW(ring.tryPush(bytes.data(), 2000), std::invalid_argument);
+}
+
+TEST_F(KlvByteRingTest, TestThreads) {
+    // spans of every size through a small ring, so that it wraps and both sides wait
+    KlvByteRing ring(4096);
+    const size_t num_spans = 5000;
+
+    std::vector<uint8_t> received;
+    std::vector<uint64_t> tags;
+    std::thread consumer([&]() {
+        KlvByteRing::Span spans[16];
+        size_t n;
+        while((n = ring.pop(spans, 16)) > 0) {
+            for(size_t i = 0; i < n; i++) {
+                received.insert(received.end(), spans[i].data, spans[i].data + spans[i].size);
+                tags.push_back(spans[i].tag);
+            }
+            ring.release();
+        }
+    });
+
+    std::vector<uint8_t> sent;
+    uint8_t buf[700];
+    for(size_t i = 0; i < num_spans; i++) {
+        size_t size = (i * 131) % sizeof(buf) + 1;
+        for(size_t k = 0; k < size; k++)
+            buf[k] = (uint8_t) (i + k);
+        ring.push(buf, size, i);
+        sent.insert(sent.end(), buf, buf + size);
+    }
+    while(!ring.empty())
+        std::this_thread::yield();
+    ring.close();
+    consumer.join();
+
+    EXPECT_TRUE(received == sent);
+    ASSERT_EQ(num_spans, tags.size());
+    for(size_t i = 0; i < num_spans; i++)
+        ASSERT_EQ(i, tags[i]);
+}
@@ -0,0 +1,92 @@
+#include <stdint.h>
+#include <cstdlib>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include "KlvChecksum.hpp"
+
+class KlvChecksumTest : public ::testing::Test {
+protected:
+    KlvChecksumTest() {
+
+    }
+
+    virtual ~KlvChecksumTest() {
+
+    }
+
+    virtual void SetUp() {
+        // random bytes, so any mix up of even and odd offsets shows
+        srand(1234);
+        buf.resize(4096 + 64);
+        for(size_t i = 0; i < buf.size(); i++)
+            buf[i] = (uint8_t) rand();
+    }
+
+    virtual void TearDown() {
+
+    }
+
+    // objects delclared here can be used by all tests in the test case for KlvChecksumTest
+    std::vector<uint8_t> buf;
+};
+
+TEST_F(KlvChecksumTest, TestKernelsMatchReference) {
+    // every length around the block sizes, at even and odd start addresses
+    for(size_t offset = 0; offset < 3; offset++) {
+        for(size_t size = 0; size < 300; size++) {
+            uint16_t expected = KlvChecksum::computeScalar(buf.data() + offset, size);
+            EXPECT_EQ(expected, KlvChecksum::computeWord(buf.data() + offset, size)) << size;
+            EXPECT_EQ(expected, KlvChecksum::computeSse2(buf.data() + offset, size)) << size;
+            EXPECT_EQ(expected, KlvChecksum::compute(buf.data() + offset, size)) << size;
+        }
+    }
+
+    // long enough for the word kernel to fold its lanes more than once
+    std::vector<uint8_t> ff(4096, 0xFF);
+    EXPECT_EQ(KlvChecksum::computeScalar(ff.data(), ff.size()), KlvChecksum::computeWord(ff.data(), ff.size()));
+    EXPECT_EQ(KlvChecksum::computeScalar(buf.data(), buf.size()), KlvChecksum::computeSse2(buf.data(), buf.size()));
+}
+
+TEST_F(KlvChecksumTest, TestIncremental) {
+    // splitting the input anywhere, including at odd offsets, gives the same checksum
+    uint16_t expected = KlvChecksum::computeScalar(buf.data(), 1000);
+    size_t splits[] = {1, 2, 3, 17, 64, 333, 999};
+    for(size_t split : splits) {
+        KlvChecksum checksum;
+        checksum.update(buf.data(), split);
+        checksum.update(buf.data() + split, 0);
+        checksum.update(buf.data() + split, 1000 - split);
+        EXPECT_EQ(expected, checksum.value()) << split;
+        EXPECT_EQ(1000, checksum.getSize());
+    }
+
+    KlvChecksum checksum;
+    for(size_t i = 0; i < 1000; i++)
+        checksum.update(&buf[i], 1);
+    EXPECT_EQ(expected, checksum.value());
+
+    checksum.reset();
+    EXPECT_EQ(0, checksum.value());
+    EXPECT_EQ(0, checksum.getSize());
+}
+
+TEST_F(KlvChecksumTest, TestVerify) {
+    // key, short length, one item, and a checksum item
+    std::vector<uint8_t> pkt = {0x06, 0x0E, 0x2B, 0x34, 0x02, 0x0B, 0x01, 0x01, 0x0E, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00,
+                                0x08, 0x05, 0x02, 0xE1, 0x91, 0x01, 0x02, 0x00, 0x00};
+    uint16_t bcc = KlvChecksum::computeScalar(pkt.data(), pkt.size() - 2);
+    pkt[pkt.size() - 2] = (uint8_t) (bcc >> 8);
+    pkt[pkt.size() - 1] = (uint8_t) bcc;
+    EXPECT_TRUE(KlvChecksum::verify(pkt.data(), pkt.size()));
+
+    pkt[18] ^= 0x10;
+    EXPECT_FALSE(KlvChecksum::verify(pkt.data(), pkt.size()));
+    pkt[18] ^= 0x10;
+
+    // no checksum item at the end
+    pkt[pkt.size() - 4] = 0x02;
+    EXPECT_FALSE(KlvChecksum::verify(pkt.data(), pkt.size()));
+    EXPECT_FALSE(KlvChecksum::verify(pkt.data(), 3));
+}
@@ -0,0 +1,202 @@
+#include <algorithm>
+#include <stdint.h>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include "BasicKlvParser.hpp"
+#include "KlvEncoder.hpp"
+#include "KlvParser.hpp"
+
+class KlvEncoderTest : public ::testing::Test {
+protected:
+    KlvEncoderTest() {
+
+    }
+
+    virtual ~KlvEncoderTest() {
+
+    }
+
+    virtual void SetUp() {
+        // key: 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x0B, 0x01, 0x01, 0x0E, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00
+        // len: 0x81, 0x90 (144 bytes)
+        // val: the rest
+        test_pkt = { 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x0B, 0x01, 0x01, 0x0E, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00, 0x81, 0x90, 0x02, 0x08, 0x00, 0x04, 0x6C, 0xAE, 0x70, 0xF9, 0x80, 0xCF, 0x41, 0x01, 0x01, 0x05, 0x02, 0xE1, 0x91, 0x06, 0x02, 0x06, 0x0D, 0x07, 0x02, 0x0A, 0xE1, 0x0B, 0x02, 0x49, 0x52, 0x0C, 0x0E, 0x47, 0x65, 0x6F, 0x64, 0x65, 0x74, 0x69, 0x63, 0x20, 0x57, 0x47, 0x53, 0x38, 0x34, 0x0D, 0x04, 0x4D, 0xCC, 0x41, 0x90, 0x0E, 0x04, 0xB1, 0xD0, 0x3D, 0x96, 0x0F, 0x02, 0x1B, 0x2E, 0x10, 0x02, 0x00, 0x84, 0x11, 0x02, 0x00, 0x4A, 0x12, 0x04, 0xE7, 0x23, 0x0B, 0x61, 0x13, 0x04, 0xFD, 0xE8, 0x63, 0x8E, 0x14, 0x04, 0x03, 0x0B, 0xC7, 0x1C, 0x15, 0x04, 0x00, 0x9F, 0xB9, 0x38, 0x16, 0x04, 0x00, 0x00, 0x01, 0xF8, 0x17, 0x04, 0x4D, 0xEC, 0xDA, 0xF4, 0x18, 0x04, 0xB1, 0xBC, 0x81, 0x74, 0x19, 0x02, 0x0B, 0x8A, 0x28, 0x04, 0x4D, 0xEC, 0xDA, 0xF4, 0x29, 0x04, 0xB1, 0xBC, 0x81, 0x74, 0x2A, 0x02, 0x0B, 0x8A, 0x38, 0x01, 0x31, 0x39, 0x04, 0x00, 0x9F, 0x85, 0x4D, 0x01, 0x02, 0xB7, 0xEB };
+    }
+
+    virtual void TearDown() {
+
+    }
+
+    // objects delclared here can be used by all tests in the test case for KlvEncoderTest
+    std::vector<uint8_t> test_pkt;
+};
+
+TEST_F(KlvEncoderTest, TestBerLength) {
+    EXPECT_THAT(KlvEncoder::encodeBerLength(0), ::testing::ElementsAre(0x00));
+    EXPECT_THAT(KlvEncoder::encodeBerLength(127), ::testing::ElementsAre(0x7F));
+    EXPECT_THAT(KlvEncoder::encodeBerLength(128), ::testing::ElementsAre(0x81, 0x80));
+    EXPECT_THAT(KlvEncoder::encodeBerLength(144), ::testing::ElementsAre(0x81, 0x90));
+    EXPECT_THAT(KlvEncoder::encodeBerLength(256), ::testing::ElementsAre(0x82, 0x01, 0x00));
+    EXPECT_THAT(KlvEncoder::encodeBerLength(0x123456), ::testing::ElementsAre(0x83, 0x12, 0x34, 0x56));
+
+    // the KLV constructor agrees with the encoder, and the decoding side agrees with both
+    std::vector<uint8_t> key = {0x02};
+    KLV klv(key, std::vector<uint8_t>(300));
+    EXPECT_THAT(klv.getLenEncoded(), ::testing::ElementsAre(0x82, 0x01, 0x2C));
+    EXPECT_EQ(300, klv.getLen());
+    EXPECT_EQ(2, klv.getBerLen());
+    KLV decoded(key, klv.getLenEncoded(), klv.getValue());
+    EXPECT_EQ(300, decoded.getLen());
+}
+
+TEST_F(KlvEncoderTest, TestReencodeParsedTree) {
+    // eagerly and lazily parsed trees encode back to the exact input bytes
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    std::vector<KLV*> klvs = parser.parse(test_pkt);
+    ASSERT_EQ(1, klvs.size());
+    EXPECT_THAT(klvs[0]->toBytes(), ::testing::ContainerEq(test_pkt));
+
+    KlvParser lazy_parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    lazy_parser.setLazyNesting(true);
+    std::vector<KLV*> lazy_klvs = lazy_parser.parse(test_pkt);
+    ASSERT_EQ(1, lazy_klvs.size());
+    EXPECT_THAT(lazy_klvs[0]->toBytes(), ::testing::ContainerEq(test_pkt));
+    EXPECT_FALSE(lazy_klvs[0]->isDecoded());
+
+    // into a caller supplied buffer, and through a sink
+    KlvEncoder encoder;
+    std::vector<uint8_t> out(test_pkt.size());
+    EXPECT_EQ(0, encoder.encode(*klvs[0], out.data(), out.size() - 1));
+    EXPECT_EQ(test_pkt.size(), encoder.encode(*klvs[0], out.data(), out.size()));
+    EXPECT_THAT(out, ::testing::ContainerEq(test_pkt));
+
+    std::vector<uint8_t> sunk;
+    KlvVectorSink sink(sunk);
+    EXPECT_EQ(test_pkt.size(), encoder.encode(*klvs[0], sink));
+    EXPECT_THAT(sunk, ::testing::ContainerEq(test_pkt));
+
+    delete klvs[0];
+    delete lazy_klvs[0];
+}
+
+TEST_F(KlvEncoderTest, TestEncodeBuiltTree) {
+    // a local set built from scratch is sized from its children
+    std::vector<uint8_t> uas_key(test_pkt.begin(), test_pkt.begin() + 16);
+    KLV root(uas_key, std::vector<uint8_t>());
+    KLV heading({0x05}, {0xE1, 0x91});
+    KLV empty({0x03}, {});
+    KLV big({0x41}, std::vector<uint8_t>(200, 0xAB));
+    root.appendChild(&heading);
+    root.appendChild(&empty);
+    root.appendChild(&big);
+    EXPECT_EQ(&heading, root.getChild());
+    EXPECT_EQ(&empty, heading.getNext());
+    EXPECT_EQ(&heading, empty.getPrevious());
+    EXPECT_EQ(&root, big.getParent());
+
+    std::vector<uint8_t> bytes = root.toBytes();
+
+    // 4 + 2 + 203 = 209 byte value, long form length
+    ASSERT_EQ(16 + 2 + 209, bytes.size());
+    EXPECT_EQ(0x81, bytes[16]);
+    EXPECT_EQ(209, bytes[17]);
+    EXPECT_THAT(std::vector<uint8_t>(bytes.begin() + 18, bytes.begin() + 24),
+                ::testing::ElementsAre(0x05, 0x02, 0xE1, 0x91, 0x03, 0x00));
+    EXPECT_THAT(std::vector<uint8_t>(bytes.begin() + 24, bytes.begin() + 28),
+                ::testing::ElementsAre(0x41, 0x81, 0xC8, 0xAB));
+
+    // and it parses back into the same items
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    KlvFlatTree tree;
+    parser.parseFlat(bytes.data(), bytes.size(), tree);
+    ASSERT_EQ(4, tree.size());
+    EXPECT_EQ(0, tree[tree.find(3)].value_size);
+    EXPECT_EQ(200, tree[tree.find(0x41)].value_size);
+}
+
+TEST_F(KlvEncoderTest, TestReencodeLostItems) {
+    // a last item whose length runs past the end of the set is dropped by the
+    // parser, but its bytes are still written
+    std::vector<uint8_t> truncated(test_pkt.begin(), test_pkt.begin() + 16);
+    truncated.insert(truncated.end(), {0x05, 0x41, 0x01, 0x01, 0x05, 0x04});
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    std::vector<KLV*> klvs = parser.parse(truncated);
+    ASSERT_EQ(1, klvs.size());
+    ASSERT_TRUE(klvs[0]->getChild() != NULL);
+    EXPECT_TRUE(klvs[0]->getChild()->getNext() == NULL);
+    EXPECT_TRUE(klvs[0]->hasDroppedItems());
+    EXPECT_THAT(klvs[0]->toBytes(), ::testing::ContainerEq(truncated));
+    KLV::deleteTree(klvs[0]);
+
+    // the same for lazily decoded children, and for trees built from events
+    parser.setLazyNesting(true);
+    klvs = parser.parse(truncated);
+    ASSERT_EQ(1, klvs.size());
+    ASSERT_TRUE(klvs[0]->getChild() != NULL);
+    EXPECT_TRUE(klvs[0]->hasDroppedItems());
+    EXPECT_THAT(klvs[0]->toBytes(), ::testing::ContainerEq(truncated));
+    KLV::deleteTree(klvs[0]);
+
+    parser.setLazyNesting(false);
+    klvs.clear();
+    KlvBuilder builder(klvs);
+    parser.parse(truncated.data(), truncated.size(), builder);
+    ASSERT_EQ(1, klvs.size());
+    EXPECT_THAT(klvs[0]->toBytes(), ::testing::ContainerEq(truncated));
+    KLV::deleteTree(klvs[0]);
+
+    KlvSt0601Parser basic_parser;
+    klvs = basic_parser.parse(truncated);
+    ASSERT_EQ(1, klvs.size());
+    EXPECT_THAT(klvs[0]->toBytes(), ::testing::ContainerEq(truncated));
+    KLV::deleteTree(klvs[0]);
+
+    // and so are items skipped by a filter
+    KlvParser filter_parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    filter_parser.setFilter(1, KlvFilter({2, 13, 14}));
+    klvs = filter_parser.parse(test_pkt);
+    ASSERT_EQ(1, klvs.size());
+    EXPECT_THAT(klvs[0]->toBytes(), ::testing::ContainerEq(test_pkt));
+    KLV::deleteTree(klvs[0]);
+}
+
+TEST_F(KlvEncoderTest, TestReencodeEditedTree) {
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    std::vector<KLV*> klvs = parser.parse(test_pkt);
+    ASSERT_EQ(1, klvs.size());
+    EXPECT_FALSE(klvs[0]->hasDroppedItems());
+
+    // drop the timestamp item (the first 10 bytes of the value)
+    KLV* timestamp = klvs[0]->getChild();
+    KLV* second = timestamp->getNext();
+    klvs[0]->setChild(second);
+    second->setPreviousSibling(NULL);
+    delete timestamp;
+
+    std::vector<uint8_t> expected(test_pkt.begin(), test_pkt.begin() + 16);
+    expected.insert(expected.end(), {0x81, 0x86});
+    expected.insert(expected.end(), test_pkt.begin() + 28, test_pkt.end());
+    EXPECT_THAT(klvs[0]->toBytes(), ::testing::ContainerEq(expected));
+
+    // and shrink the heading item after the next one to a single byte
+    KLV* heading = second->getNext();
+    KLV shorter(heading->getKey(), {0x07});
+    shorter.setParent(klvs[0]);
+    shorter.setPreviousSibling(second);
+    shorter.setNextSibling(heading->getNext());
+    second->setNextSibling(&shorter);
+    heading->getNext()->setPreviousSibling(&shorter);
+
+    std::vector<uint8_t> bytes = klvs[0]->toBytes();
+    ASSERT_EQ(expected.size() - 1, bytes.size());
+    EXPECT_EQ(0x85, bytes[17]);
+    EXPECT_THAT(std::vector<uint8_t>(bytes.begin() + 18, bytes.begin() + 24),
+                ::testing::ElementsAre(0x41, 0x01, 0x01, 0x05, 0x01, 0x07));
+    EXPECT_TRUE(std::equal(expected.begin() + 25, expected.end(), bytes.begin() + 24));
+
+    second->setNextSibling(heading);
+    heading->getNext()->setPreviousSibling(heading);
+    KLV::deleteTree(klvs[0]);
+}
@@ -0,0 +1,198 @@
+#include <stdint.h>
+#include <cstdio>
+#include <cstdlib>
+#include <unistd.h>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include "KlvFileParser.hpp"
+#include "KlvFormatException.hpp"
+#include "KlvAllocCounter.hpp"
+
+class KlvFileParserTest : public ::testing::Test {
+protected:
+    KlvFileParserTest() {
+
+    }
+
+    virtual ~KlvFileParserTest() {
+
+    }
+
+    virtual void SetUp() {
+        // key: 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x0B, 0x01, 0x01, 0x0E, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00
+        // len: 0x81, 0x90 (144 bytes)
+        // val: the rest
+        test_pkt = { 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x0B, 0x01, 0x01, 0x0E, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00, 0x81, 0x90, 0x02, 0x08, 0x00, 0x04, 0x6C, 0xAE, 0x70, 0xF9, 0x80, 0xCF, 0x41, 0x01, 0x01, 0x05, 0x02, 0xE1, 0x91, 0x06, 0x02, 0x06, 0x0D, 0x07, 0x02, 0x0A, 0xE1, 0x0B, 0x02, 0x49, 0x52, 0x0C, 0x0E, 0x47, 0x65, 0x6F, 0x64, 0x65, 0x74, 0x69, 0x63, 0x20, 0x57, 0x47, 0x53, 0x38, 0x34, 0x0D, 0x04, 0x4D, 0xCC, 0x41, 0x90, 0x0E, 0x04, 0xB1, 0xD0, 0x3D, 0x96, 0x0F, 0x02, 0x1B, 0x2E, 0x10, 0x02, 0x00, 0x84, 0x11, 0x02, 0x00, 0x4A, 0x12, 0x04, 0xE7, 0x23, 0x0B, 0x61, 0x13, 0x04, 0xFD, 0xE8, 0x63, 0x8E, 0x14, 0x04, 0x03, 0x0B, 0xC7, 0x1C, 0x15, 0x04, 0x00, 0x9F, 0xB9, 0x38, 0x16, 0x04, 0x00, 0x00, 0x01, 0xF8, 0x17, 0x04, 0x4D, 0xEC, 0xDA, 0xF4, 0x18, 0x04, 0xB1, 0xBC, 0x81, 0x74, 0x19, 0x02, 0x0B, 0x8A, 0x28, 0x04, 0x4D, 0xEC, 0xDA, 0xF4, 0x29, 0x04, 0xB1, 0xBC, 0x81, 0x74, 0x2A, 0x02, 0x0B, 0x8A, 0x38, 0x01, 0x31, 0x39, 0x04, 0x00, 0x9F, 0x85, 0x4D, 0x01, 0x02, 0xB7, 0xEB };
+
+        // a packet whose value holds what looks like the start of another packet, a
+        // UL key with a length running well past the end of the outer packet
+        std::vector<uint8_t> inner(test_pkt.begin(), test_pkt.begin() + 16);
+        inner.push_back(0x81);
+        inner.push_back(0xC8);
+        inner.insert(inner.end(), 60, 0x11);
+        trap_pkt.assign(test_pkt.begin(), test_pkt.begin() + 16);
+        trap_pkt.push_back((uint8_t) (2 + inner.size()));
+        trap_pkt.push_back(0x41);
+        trap_pkt.push_back((uint8_t) inner.size());
+        trap_pkt.insert(trap_pkt.end(), inner.begin(), inner.end());
+
+        // packets, garbage, and traps, ending in a truncated packet
+        std::vector<uint8_t> garbage = {0x00, 0x06, 0x0E, 0x2B, 0xFF, 0x06};
+        for(int i = 0; i < 20; i++) {
+            stream.insert(stream.end(), test_pkt.begin(), test_pkt.end());
+            if(i % 3 == 0)
+                stream.insert(stream.end(), trap_pkt.begin(), trap_pkt.end());
+            if(i % 4 == 1)
+                stream.insert(stream.end(), garbage.begin(), garbage.end());
+        }
+        stream.insert(stream.end(), test_pkt.begin(), test_pkt.begin() + 100);
+    }
+
+    virtual void TearDown() {
+
+    }
+
+    void expectSameKlvs(const std::vector<KLV*>& expected, const std::vector<KLV*>& actual) {
+        ASSERT_EQ(expected.size(), actual.size());
+        for(size_t i = 0; i < expected.size(); i++) {
+            EXPECT_THAT(actual[i]->getKey(), ::testing::ContainerEq(expected[i]->getKey()));
+            EXPECT_THAT(actual[i]->getValue(), ::testing::ContainerEq(expected[i]->getValue()));
+            EXPECT_EQ(expected[i]->getChild() != NULL, actual[i]->getChild() != NULL);
+        }
+    }
+
+    void deleteKlvs(std::vector<KLV*>& klvs) {
+        for(size_t i = 0; i < klvs.size(); i++)
+            delete klvs[i];
+        klvs.clear();
+    }
+
+    // objects delclared here can be used by all tests in the test case for KlvFileParserTest
+    std::vector<uint8_t> test_pkt;
+    std::vector<uint8_t> trap_pkt;
+    std::vector<uint8_t> stream;
+};
+
+TEST_F(KlvFileParserTest, TestMatchesSequentialParse) {
+    std::vector<KlvParser::KeyEncoding> encodings = {KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID};
+    KlvParser parser(encodings);
+    std::vector<KLV*> expected = parser.parse(stream);
+    ASSERT_EQ(27, expected.size());
+
+    // chunk edges inside keys, lengths, values, garbage, and the traps
+    size_t chunk_sizes[] = {1, 7, 64, 100, 163, 1000, 1 << 20};
+    size_t thread_counts[] = {1, 3};
+    for(size_t threads : thread_counts) {
+        for(size_t chunk_size : chunk_sizes) {
+            SCOPED_TRACE(chunk_size);
+            KlvFileParser file_parser(encodings, threads, chunk_size);
+            std::vector<KLV*> klvs = file_parser.parse(stream.data(), stream.size());
+            expectSameKlvs(expected, klvs);
+            deleteKlvs(klvs);
+        }
+    }
+
+    deleteKlvs(expected);
+}
+
+TEST_F(KlvFileParserTest, TestHandlerOrder) {
+    KlvFileParser file_parser({KlvParser::KEY_ENCODING_16_BYTE}, 4, 50);
+    EXPECT_EQ(4, file_parser.getNumThreads());
+    EXPECT_EQ(50, file_parser.getChunkSize());
+
+    size_t count = 0;
+    size_t traps = 0;
+    size_t n = file_parser.parse(stream.data(), stream.size(), [&](KLV* klv) {
+        if(klv->getLen() == trap_pkt.size() - 17)
+            traps++;
+        count++;
+        delete klv;
+    });
+    EXPECT_EQ(27, n);
+    EXPECT_EQ(27, count);
+    EXPECT_EQ(7, traps);
+
+    EXPECT_EQ(0, file_parser.parse(NULL, 0, [](KLV* klv) { delete klv; }));
+    EXPECT_THROW(KlvFileParser({KlvParser::KEY_ENCODING_BER_OID}), std::invalid_argument);
+}
+
+TEST_F(KlvFileParserTest, TestChecksum) {
+    // the traps have no checksum, so they fail
+    KlvFileParser drop_parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID}, 2, 128);
+    drop_parser.setChecksumMode(KlvParser::CHECKSUM_DROP);
+    std::vector<KLV*> klvs = drop_parser.parse(stream.data(), stream.size());
+    EXPECT_EQ(20, klvs.size());
+    EXPECT_EQ(7, drop_parser.getNumChecksumFailures());
+    for(KLV* klv : klvs)
+        EXPECT_EQ(KLV_CHECKSUM_VALID, klv->getChecksumStatus());
+    deleteKlvs(klvs);
+
+    KlvFileParser throw_parser({KlvParser::KEY_ENCODING_16_BYTE}, 2, 128);
+    throw_parser.setChecksumMode(KlvParser::CHECKSUM_THROW);
+    size_t count = 0;
+    EXPECT_THROW(throw_parser.parse(stream.data(), stream.size(), [&](KLV* klv) { count++; delete klv; }), KlvFormatException);
+    EXPECT_EQ(1, count);
+
+    // packets parsed ahead of the failure are freed, items and all
+    KlvFileParser tree_parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID}, 2, 128);
+    tree_parser.setChecksumMode(KlvParser::CHECKSUM_THROW);
+    KlvAllocCounter allocs;
+    EXPECT_THROW(tree_parser.parse(stream.data(), stream.size()), KlvFormatException);
+    EXPECT_EQ(allocs.allocations(), allocs.deallocations());
+}
+
+TEST_F(KlvFileParserTest, TestLimits) {
+    // packets with an indefinite length among the rest
+    std::vector<uint8_t> bad_stream;
+    for(size_t i = 0; i < stream.size(); i += 500) {
+        bad_stream.insert(bad_stream.end(), stream.begin() + i, stream.begin() + std::min(i + 500, stream.size()));
+        bad_stream.insert(bad_stream.end(), test_pkt.begin(), test_pkt.begin() + 16);
+        bad_stream.push_back(0x80);
+    }
+
+    // and a value limit that rejects the test packets but not the traps
+    std::vector<KlvParser::KeyEncoding> encodings = {KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID};
+    KlvParser::Limits limits;
+    limits.max_value_size = 100;
+    KlvParser parser(encodings);
+    parser.setLimits(limits);
+    std::vector<KLV*> expected;
+    parser.parse(bad_stream.data(), bad_stream.size(), expected);
+    EXPECT_EQ(7, expected.size());
+    EXPECT_LT(20, parser.getNumErrors());
+
+    size_t chunk_sizes[] = {1, 7, 100, 163, 1 << 20};
+    for(size_t chunk_size : chunk_sizes) {
+        SCOPED_TRACE(chunk_size);
+        KlvFileParser file_parser(encodings, 2, chunk_size);
+        file_parser.setLimits(limits);
+        std::vector<KLV*> klvs = file_parser.parse(bad_stream.data(), bad_stream.size());
+        expectSameKlvs(expected, klvs);
+        EXPECT_EQ(parser.getNumErrors(), file_parser.getNumErrors());
+        deleteKlvs(klvs);
+    }
+
+    deleteKlvs(expected);
+}
+
+TEST_F(KlvFileParserTest, TestParseFile) {
+    char path[] = "/tmp/klv_file_parser_test_XXXXXX";
+    int fd = mkstemp(path);
+    ASSERT_GE(fd, 0);
+    ASSERT_EQ((ssize_t) stream.size(), write(fd, stream.data(), stream.size()));
+    close(fd);
+
+    KlvFileParser file_parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID}, 2, 256);
+    std::vector<KLV*> klvs = file_parser.parseFile(path);
+    unlink(path);
+
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    std::vector<KLV*> expected = parser.parse(stream);
+    expectSameKlvs(expected, klvs);
+    deleteKlvs(klvs);
+    deleteKlvs(expected);
+
+    EXPECT_THROW(file_parser.parseFile("/nonexistent/klv/capture"), std::runtime_error);
+}
@@ -0,0 +1,159 @@
+#include <stdint.h>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include "KlvFile.hpp"
+
+class KlvFileTest : public ::testing::Test {
+protected:
+    KlvFileTest() {
+
+    }
+
+    virtual ~KlvFileTest() {
+
+    }
+
+    virtual void SetUp() {
+        // key: 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x0B, 0x01, 0x01, 0x0E, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00
+        // len: 0x81, 0x90 (144 bytes)
+        // val: the rest, starting with the timestamp item 02 08 00 04 6C AE 70 F9 80 CF
+        test_pkt = { 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x0B, 0x01, 0x01, 0x0E, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00, 0x81, 0x90, 0x02, 0x08, 0x00, 0x04, 0x6C, 0xAE, 0x70, 0xF9, 0x80, 0xCF, 0x41, 0x01, 0x01, 0x05, 0x02, 0xE1, 0x91, 0x06, 0x02, 0x06, 0x0D, 0x07, 0x02, 0x0A, 0xE1, 0x0B, 0x02, 0x49, 0x52, 0x0C, 0x0E, 0x47, 0x65, 0x6F, 0x64, 0x65, 0x74, 0x69, 0x63, 0x20, 0x57, 0x47, 0x53, 0x38, 0x34, 0x0D, 0x04, 0x4D, 0xCC, 0x41, 0x90, 0x0E, 0x04, 0xB1, 0xD0, 0x3D, 0x96, 0x0F, 0x02, 0x1B, 0x2E, 0x10, 0x02, 0x00, 0x84, 0x11, 0x02, 0x00, 0x4A, 0x12, 0x04, 0xE7, 0x23, 0x0B, 0x61, 0x13, 0x04, 0xFD, 0xE8, 0x63, 0x8E, 0x14, 0x04, 0x03, 0x0B, 0xC7, 0x1C, 0x15, 0x04, 0x00, 0x9F, 0xB9, 0x38, 0x16, 0x04, 0x00, 0x00, 0x01, 0xF8, 0x17, 0x04, 0x4D, 0xEC, 0xDA, 0xF4, 0x18, 0x04, 0xB1, 0xBC, 0x81, 0x74, 0x19, 0x02, 0x0B, 0x8A, 0x28, 0x04, 0x4D, 0xEC, 0xDA, 0xF4, 0x29, 0x04, 0xB1, 0xBC, 0x81, 0x74, 0x2A, 0x02, 0x0B, 0x8A, 0x38, 0x01, 0x31, 0x39, 0x04, 0x00, 0x9F, 0x85, 0x4D, 0x01, 0x02, 0xB7, 0xEB };
+
+        char tmp[] = "/tmp/klv_file_test_XXXXXX";
+        int fd = mkstemp(tmp);
+        close(fd);
+        path = tmp;
+    }
+
+    virtual void TearDown() {
+        unlink(path.c_str());
+        unlink((path + ".idx").c_str());
+    }
+
+    // a copy of test_pkt with its timestamp replaced
+    std::vector<uint8_t> packetAt(uint64_t timestamp) {
+        std::vector<uint8_t> pkt(test_pkt);
+        for(size_t i = 0; i < 8; i++)
+            pkt[20 + i] = (uint8_t) (timestamp >> (56 - 8 * i));
+        return pkt;
+    }
+
+    void writeFile(const std::vector<uint8_t>& bytes) {
+        FILE* f = fopen(path.c_str(), "wb");
+        fwrite(bytes.data(), 1, bytes.size(), f);
+        fclose(f);
+    }
+
+    // objects delclared here can be used by all tests in the test case for KlvFileTest
+    std::vector<uint8_t> test_pkt;
+    std::string path;
+};
+
+TEST_F(KlvFileTest, TestIndexAndViews) {
+    // ten packets a second apart with some junk in between, and a truncated one at the end
+    std::vector<uint8_t> bytes = {0xFF, 0x00};
+    for(uint64_t i = 0; i < 10; i++) {
+        std::vector<uint8_t> pkt = packetAt(1000000000 + i * 1000000);
+        bytes.insert(bytes.end(), pkt.begin(), pkt.end());
+        if(i == 4)
+            bytes.push_back(0xAA);
+    }
+    bytes.insert(bytes.end(), test_pkt.begin(), test_pkt.begin() + 50);
+    writeFile(bytes);
+
+    KlvFile file(path);
+    EXPECT_FALSE(file.isIndexLoaded());
+    ASSERT_EQ(10, file.size());
+    EXPECT_EQ(2, file.getEntry(0).offset);
+    EXPECT_EQ(2 + 5 * test_pkt.size() + 1, file.getEntry(5).offset);
+
+    KlvView view = file.getView(3);
+    std::vector<uint8_t> key(test_pkt.begin(), test_pkt.begin() + 16);
+    EXPECT_THAT(view.getKey().toVector(), ::testing::ContainerEq(key));
+    EXPECT_EQ(144, view.getLen());
+    EXPECT_EQ(file.getFile().data() + file.getEntry(3).offset + 18, view.getValue().data);
+
+    KlvTree tree;
+    file.getTree(7, tree);
+    ASSERT_FALSE(tree.empty());
+    ASSERT_TRUE(tree.find(2) != NULL);
+    EXPECT_THAT(tree.find(2)->getValue().toVector(), ::testing::ElementsAre(0, 0, 0, 0, 0x3C, 0x05, 0x99, 0xC0));
+
+    // in effect at a time, and ranges
+    EXPECT_EQ(KlvFile::NONE, file.findTime(999999999));
+    EXPECT_EQ(0, file.findTime(1000000000));
+    EXPECT_EQ(4, file.findTime(1004500000));
+    EXPECT_EQ(9, file.findTime(2000000000));
+    EXPECT_THAT(file.findTimeRange(1002000000, 1005000000), ::testing::ElementsAre(2, 3, 4));
+    EXPECT_TRUE(file.findTimeRange(2000000000, 3000000000).empty());
+}
+
+TEST_F(KlvFileTest, TestSidecar) {
+    std::vector<uint8_t> bytes;
+    for(uint64_t i = 0; i < 5; i++) {
+        // out of time order on purpose
+        std::vector<uint8_t> pkt = packetAt(100 - i * 10);
+        bytes.insert(bytes.end(), pkt.begin(), pkt.end());
+    }
+    writeFile(bytes);
+
+    {
+        KlvFile file(path);
+        EXPECT_FALSE(file.isIndexLoaded());
+    }
+
+    KlvFile reloaded(path);
+    EXPECT_TRUE(reloaded.isIndexLoaded());
+    ASSERT_EQ(5, reloaded.size());
+    EXPECT_EQ(4 * test_pkt.size(), reloaded.getEntry(4).offset);
+    EXPECT_EQ(60, reloaded.getEntry(4).timestamp);
+    EXPECT_EQ(3, reloaded.findTime(75));
+    EXPECT_THAT(reloaded.findTimeRange(70, 95), ::testing::ElementsAre(1, 2, 3));
+
+    // a capture that changed since it was indexed is indexed again
+    bytes.insert(bytes.end(), test_pkt.begin(), test_pkt.end());
+    writeFile(bytes);
+    KlvFile changed(path);
+    EXPECT_FALSE(changed.isIndexLoaded());
+    EXPECT_EQ(6, changed.size());
+
+    // a sidecar is optional
+    KlvFile no_sidecar(path, {KlvParser::KEY_ENCODING_16_BYTE}, false);
+    EXPECT_FALSE(no_sidecar.isIndexLoaded());
+    EXPECT_EQ(6, no_sidecar.size());
+    EXPECT_FALSE(no_sidecar.getEntry(0).has_timestamp);
+    EXPECT_EQ(KlvFile::NONE, no_sidecar.findTime(100));
+}
+
+TEST_F(KlvFileTest, TestCorruptPacket) {
+    // a packet with an indefinite length in the middle of the file, and one
+    // whose first item has one
+    std::vector<uint8_t> bytes;
+    for(uint64_t i = 0; i < 6; i++) {
+        std::vector<uint8_t> pkt = packetAt(100 + i);
+        if(i == 2) {
+            bytes.insert(bytes.end(), test_pkt.begin(), test_pkt.begin() + 16);
+            bytes.insert(bytes.end(), {0x80, 0x01, 0x02, 0x03});
+        }
+        if(i == 4) {
+            pkt[17] += 2;
+            pkt.insert(pkt.begin() + 18, {0x41, 0x80});
+        }
+        bytes.insert(bytes.end(), pkt.begin(), pkt.end());
+    }
+    writeFile(bytes);
+
+    KlvFile file(path, {KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID}, false);
+    ASSERT_EQ(6, file.size());
+    EXPECT_EQ(2 * test_pkt.size() + 20, file.getEntry(2).offset);
+    for(size_t i = 0; i < 6; i++) {
+        EXPECT_TRUE(file.getEntry(i).has_timestamp);
+        EXPECT_EQ(100 + i, file.getEntry(i).timestamp);
+    }
+}
@@ -0,0 +1,224 @@
+#include <algorithm>
+#include <stdint.h>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include "KlvAllocCounter.hpp"
+#include "KlvFilter.hpp"
+#include "KlvFlatTree.hpp"
+#include "KlvParser.hpp"
+#include "KlvTestHelpers.hpp"
+#include "KlvTree.hpp"
+#include "KlvVisitor.hpp"
+
+
+class KlvFilterTest : public ::testing::Test {
+protected:
+    KlvFilterTest() {
+    }
+
+    virtual ~KlvFilterTest() {
+    }
+
+    virtual void SetUp() {
+        // key: 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x0B, 0x01, 0x01, 0x0E, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00
+        // len: 0x81, 0x90 (144 bytes)
+        // val: the rest
+        test_pkt = { 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x0B, 0x01, 0x01, 0x0E, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00, 0x81, 0x90, 0x02, 0x08, 0x00, 0x04, 0x6C, 0xAE, 0x70, 0xF9, 0x80, 0xCF, 0x41, 0x01, 0x01, 0x05, 0x02, 0xE1, 0x91, 0x06, 0x02, 0x06, 0x0D, 0x07, 0x02, 0x0A, 0xE1, 0x0B, 0x02, 0x49, 0x52, 0x0C, 0x0E, 0x47, 0x65, 0x6F, 0x64, 0x65, 0x74, 0x69, 0x63, 0x20, 0x57, 0x47, 0x53, 0x38, 0x34, 0x0D, 0x04, 0x4D, 0xCC, 0x41, 0x90, 0x0E, 0x04, 0xB1, 0xD0, 0x3D, 0x96, 0x0F, 0x02, 0x1B, 0x2E, 0x10, 0x02, 0x00, 0x84, 0x11, 0x02, 0x00, 0x4A, 0x12, 0x04, 0xE7, 0x23, 0x0B, 0x61, 0x13, 0x04, 0xFD, 0xE8, 0x63, 0x8E, 0x14, 0x04, 0x03, 0x0B, 0xC7, 0x1C, 0x15, 0x04, 0x00, 0x9F, 0xB9, 0x38, 0x16, 0x04, 0x00, 0x00, 0x01, 0xF8, 0x17, 0x04, 0x4D, 0xEC, 0xDA, 0xF4, 0x18, 0x04, 0xB1, 0xBC, 0x81, 0x74, 0x19, 0x02, 0x0B, 0x8A, 0x28, 0x04, 0x4D, 0xEC, 0xDA, 0xF4, 0x29, 0x04, 0xB1, 0xBC, 0x81, 0x74, 0x2A, 0x02, 0x0B, 0x8A, 0x38, 0x01, 0x31, 0x39, 0x04, 0x00, 0x9F, 0x85, 0x4D, 0x01, 0x02, 0xB7, 0xEB };
+    }
+
+    virtual void TearDown() {
+
+    }
+
+    // objects delclared here can be used by all tests in the test case for KlvFilter
+    std::vector<uint8_t> test_pkt;
+
+};
+
+TEST_F(KlvFilterTest, TestFilter) {
+    KlvFilter all;
+    EXPECT_TRUE(all.passesAll());
+    EXPECT_TRUE(all.acceptsTag(2));
+    EXPECT_TRUE(all.acceptsTag(1000));
+    EXPECT_TRUE(all.acceptsKey(KlvUniversalKey(test_pkt.data())));
+
+    KlvFilter items({2, 65, 1000});
+    EXPECT_FALSE(items.passesAll());
+    EXPECT_TRUE(items.acceptsTag(2));
+    EXPECT_TRUE(items.acceptsTag(65));
+    EXPECT_TRUE(items.acceptsTag(1000));
+    EXPECT_FALSE(items.acceptsTag(1));
+    EXPECT_FALSE(items.acceptsTag(64));
+    EXPECT_FALSE(items.acceptsTag(1001));
+
+    KlvFilter sets;
+    sets.addKey(KlvUniversalKey(test_pkt.data()));
+    std::vector<uint8_t> other(test_pkt.begin(), test_pkt.begin() + 16);
+    other[13] = 0x01;
+    EXPECT_TRUE(sets.acceptsKey(KlvUniversalKey(test_pkt.data())));
+    EXPECT_FALSE(sets.acceptsKey(KlvUniversalKey(other.data())));
+}
+
+TEST_F(KlvFilterTest, TestNestedFilter) {
+    // timestamp and sensor position
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    parser.setFilter(1, KlvFilter({2, 13, 14, 15}));
+
+    std::vector<KLV*> klvs = parser.parse(test_pkt);
+    ASSERT_EQ(1, klvs.size());
+    EXPECT_EQ(4, countChildren(klvs[0]));
+    EXPECT_EQ(144, klvs[0]->getValue().size());
+    EXPECT_EQ(0x02, klvs[0]->getChild()->getKey()[0]);
+    KLV::deleteTree(klvs[0]);
+
+    // byte by byte, with the checksum item filtered out
+    parser.setChecksumMode(KlvParser::CHECKSUM_DROP);
+    KLV* klv = NULL;
+    for(size_t i = 0; i < test_pkt.size(); i++) {
+        KLV* completed = parser.parseByte(test_pkt[i]);
+        if(completed != NULL)
+            klv = completed;
+    }
+    ASSERT_TRUE(klv != NULL);
+    EXPECT_EQ(4, countChildren(klv));
+    KLV::deleteTree(klv);
+
+    // lazily decoded children are filtered as well
+    parser.setLazyNesting(true);
+    klvs = parser.parse(test_pkt);
+    ASSERT_EQ(1, klvs.size());
+    EXPECT_EQ(4, countChildren(klvs[0]));
+    KLV::deleteTree(klvs[0]);
+    parser.setLazyNesting(false);
+
+    KlvTree tree;
+    EXPECT_EQ(test_pkt.size(), parser.parseTree(test_pkt.data(), test_pkt.size(), tree));
+    ASSERT_FALSE(tree.empty());
+    EXPECT_EQ(144, tree.getRoot()->getValue().size);
+    EXPECT_TRUE(tree.find(2) != NULL);
+    EXPECT_TRUE(tree.find(15) != NULL);
+    EXPECT_TRUE(tree.find(5) == NULL);
+
+    KlvFlatTree flat;
+    EXPECT_EQ(test_pkt.size(), parser.parseFlat(test_pkt.data(), test_pkt.size(), flat));
+    EXPECT_EQ(5, flat.size());
+    EXPECT_NE(KlvFlatTree::NONE, flat.find(13));
+    EXPECT_EQ(KlvFlatTree::NONE, flat.find(5));
+
+    CountingVisitor visitor;
+    EXPECT_EQ(KLV_OK, parser.parse(test_pkt.data(), test_pkt.size(), visitor));
+    EXPECT_EQ(1, visitor.num_sets);
+    EXPECT_EQ(std::vector<uint64_t>({2, 13, 14, 15}), visitor.tags);
+
+    EXPECT_EQ(0, parser.getNumErrors());
+
+    // and back to everything
+    parser.clearFilters();
+    klvs = parser.parse(test_pkt);
+    ASSERT_EQ(1, klvs.size());
+    EXPECT_EQ(26, countChildren(klvs[0]));
+    KLV::deleteTree(klvs[0]);
+}
+
+TEST_F(KlvFilterTest, TestTopLevelFilter) {
+    // a packet of another universal set on either side of the wanted one
+    std::vector<uint8_t> other(test_pkt);
+    other[13] = 0x01;
+    std::vector<uint8_t> buf(other);
+    buf.insert(buf.end(), test_pkt.begin(), test_pkt.end());
+    buf.insert(buf.end(), other.begin(), other.end());
+
+    KlvFilter sets;
+    sets.addKey(KlvUniversalKey(test_pkt.data()));
+
+    const size_t chunk_sizes[] = {1, 7, 100, 161, 162, 163, 1000};
+    for(size_t chunk_size : chunk_sizes) {
+        KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+        parser.setFilter(0, sets);
+        std::vector<KLV*> klvs;
+        for(size_t offset = 0; offset < buf.size(); offset += chunk_size)
+            parser.parse(buf.data() + offset, std::min(chunk_size, buf.size() - offset), klvs);
+        ASSERT_EQ(1, klvs.size()) << "chunk size " << chunk_size;
+        EXPECT_EQ(test_pkt, klvs[0]->toBytes());
+        EXPECT_EQ(26, countChildren(klvs[0]));
+        EXPECT_EQ(0, parser.getNumErrors());
+        KLV::deleteTree(klvs[0]);
+
+        KlvParser visit_parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+        visit_parser.setFilter(0, sets);
+        CountingVisitor visitor;
+        for(size_t offset = 0; offset < buf.size(); offset += chunk_size)
+            visit_parser.parse(buf.data() + offset, std::min(chunk_size, buf.size() - offset), visitor);
+        EXPECT_EQ(1, visitor.num_sets) << "chunk size " << chunk_size;
+        EXPECT_EQ(26, visitor.num_items);
+        EXPECT_EQ(0, visit_parser.getNumErrors());
+    }
+
+    // a filtered packet is consumed without a tree
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    parser.setFilter(0, sets);
+    KlvTree tree;
+    size_t offset = parser.parseTree(buf.data(), buf.size(), tree);
+    EXPECT_EQ(other.size(), offset);
+    EXPECT_TRUE(tree.empty());
+    offset += parser.parseTree(buf.data() + offset, buf.size() - offset, tree);
+    EXPECT_EQ(other.size() + test_pkt.size(), offset);
+    EXPECT_FALSE(tree.empty());
+}
+
+TEST_F(KlvFilterTest, TestAllocations) {
+    std::vector<uint8_t> other(test_pkt);
+    other[13] = 0x01;
+    std::vector<uint8_t> buf;
+    for(int i = 0; i < 20; i++)
+        buf.insert(buf.end(), other.begin(), other.end());
+
+    // unwanted packets are skipped without a byte copied or allocated, in one
+    // buffer or split across calls
+    KlvFilter sets;
+    sets.addKey(KlvUniversalKey(test_pkt.data()));
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    parser.setFilter(0, sets);
+    KlvTree tree;
+    std::vector<KLV*> klvs;
+    klvs.reserve(1);
+    parser.parse(buf.data(), 100, klvs);     // the parser's key buffer
+    parser.parse(buf.data() + 100, other.size() - 100, klvs);
+
+    KlvAllocCounter allocs;
+    for(size_t offset = 0; offset < buf.size(); )
+        offset += parser.parseTree(buf.data() + offset, buf.size() - offset, tree);
+    for(size_t offset = 0; offset < buf.size(); offset += 100)
+        parser.parse(buf.data() + offset, std::min((size_t) 100, buf.size() - offset), klvs);
+    EXPECT_EQ(0, allocs.allocations());
+    EXPECT_TRUE(klvs.empty());
+    EXPECT_TRUE(tree.empty());
+
+    // only the wanted items of a wanted packet are built
+    KlvParser item_parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    item_parser.setFilter(1, KlvFilter({2}));
+    std::vector<KLV*> all_klvs;
+    item_parser.parse(test_pkt.data(), test_pkt.size(), all_klvs);
+    KLV::deleteTree(all_klvs[0]);
+
+    allocs.restart();
+    klvs.clear();
+    item_parser.parse(test_pkt.data(), test_pkt.size(), klvs);
+    ASSERT_EQ(1, klvs.size());
+    EXPECT_EQ(1, countChildren(klvs[0]));
+    size_t filtered_allocations = allocs.allocations();
+    KLV::deleteTree(klvs[0]);
+    EXPECT_EQ(allocs.allocations(), allocs.deallocations());
+
+    KlvParser full_parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    full_parser.parse(test_pkt.data(), test_pkt.size(), all_klvs);
+    KLV::deleteTree(all_klvs[1]);
+    klvs.clear();
+    allocs.restart();
+    full_parser.parse(test_pkt.data(), test_pkt.size(), klvs);
+    size_t full_allocations = allocs.allocations();
+    KLV::deleteTree(klvs[0]);
+    EXPECT_LT(filtered_allocations * 10, full_allocations);
+}
@@ -0,0 +1,100 @@
+#include <stdint.h>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include "KlvFlatTree.hpp"
+#include "KlvParser.hpp"
+
+class KlvFlatTreeTest : public ::testing::Test {
+protected:
+    KlvFlatTreeTest() {
+
+    }
+
+    virtual ~KlvFlatTreeTest() {
+
+    }
+
+    virtual void SetUp() {
+        // key: 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x0B, 0x01, 0x01, 0x0E, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00
+        // len: 0x81, 0x90 (144 bytes)
+        // val: the rest
+        test_pkt = { 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x0B, 0x01, 0x01, 0x0E, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00, 0x81, 0x90, 0x02, 0x08, 0x00, 0x04, 0x6C, 0xAE, 0x70, 0xF9, 0x80, 0xCF, 0x41, 0x01, 0x01, 0x05, 0x02, 0xE1, 0x91, 0x06, 0x02, 0x06, 0x0D, 0x07, 0x02, 0x0A, 0xE1, 0x0B, 0x02, 0x49, 0x52, 0x0C, 0x0E, 0x47, 0x65, 0x6F, 0x64, 0x65, 0x74, 0x69, 0x63, 0x20, 0x57, 0x47, 0x53, 0x38, 0x34, 0x0D, 0x04, 0x4D, 0xCC, 0x41, 0x90, 0x0E, 0x04, 0xB1, 0xD0, 0x3D, 0x96, 0x0F, 0x02, 0x1B, 0x2E, 0x10, 0x02, 0x00, 0x84, 0x11, 0x02, 0x00, 0x4A, 0x12, 0x04, 0xE7, 0x23, 0x0B, 0x61, 0x13, 0x04, 0xFD, 0xE8, 0x63, 0x8E, 0x14, 0x04, 0x03, 0x0B, 0xC7, 0x1C, 0x15, 0x04, 0x00, 0x9F, 0xB9, 0x38, 0x16, 0x04, 0x00, 0x00, 0x01, 0xF8, 0x17, 0x04, 0x4D, 0xEC, 0xDA, 0xF4, 0x18, 0x04, 0xB1, 0xBC, 0x81, 0x74, 0x19, 0x02, 0x0B, 0x8A, 0x28, 0x04, 0x4D, 0xEC, 0xDA, 0xF4, 0x29, 0x04, 0xB1, 0xBC, 0x81, 0x74, 0x2A, 0x02, 0x0B, 0x8A, 0x38, 0x01, 0x31, 0x39, 0x04, 0x00, 0x9F, 0x85, 0x4D, 0x01, 0x02, 0xB7, 0xEB };
+    }
+
+    virtual void TearDown() {
+
+    }
+
+    // objects delclared here can be used by all tests in the test case for KlvFlatTreeTest
+    std::vector<uint8_t> test_pkt;
+};
+
+TEST_F(KlvFlatTreeTest, TestLayout) {
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    KlvFlatTree tree;
+
+    // junk in front is not part of the tree
+    std::vector<uint8_t> buf = {0xAA, 0xBB};
+    buf.insert(buf.end(), test_pkt.begin(), test_pkt.end());
+    EXPECT_EQ(buf.size(), parser.parseFlat(buf.data(), buf.size(), tree));
+
+    ASSERT_EQ(27, tree.size());
+    EXPECT_THAT(tree.getBytes(), ::testing::ContainerEq(test_pkt));
+
+    const KlvFlatNode& root = tree[tree.getRoot()];
+    EXPECT_EQ(0, root.depth);
+    EXPECT_EQ(0, root.tag);
+    EXPECT_EQ(144, root.value_size);
+    EXPECT_EQ(18, root.value_offset);
+    EXPECT_EQ(KlvFlatTree::NONE, root.parent);
+    EXPECT_EQ(1, root.first_child);
+    EXPECT_EQ(KlvFlatTree::NONE, root.next_sibling);
+
+    // children follow the root in stream order
+    std::vector<uint64_t> tags;
+    for(KlvFlatTree::const_iterator it = tree.begin() + 1; it != tree.end(); ++it) {
+        EXPECT_EQ(1, it->depth);
+        EXPECT_EQ(0, it->parent);
+        tags.push_back(it->tag);
+    }
+    EXPECT_EQ(2, tags.front());
+    EXPECT_EQ(0x41, tags[1]);
+    EXPECT_EQ(1, tags.back());
+
+    // tag 13 (sensor latitude) has a 4 byte value
+    const KlvFlatNode& lat = tree[8];
+    EXPECT_EQ(13, lat.tag);
+    std::vector<uint8_t> test_lat = {0x4D, 0xCC, 0x41, 0x90};
+    EXPECT_THAT(tree.getValue(lat).toVector(), ::testing::ContainerEq(test_lat));
+    EXPECT_EQ(0x0D, tree.getKey(lat)[0]);
+    EXPECT_EQ(0x04, tree.getLenEncoded(lat)[0]);
+}
+
+TEST_F(KlvFlatTreeTest, TestNavigationMatchesViews) {
+    // walking the flat tree by index visits the same nodes as walking the views
+    KlvParser view_parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    std::vector<const KlvView*> views = view_parser.parseViews(test_pkt.data(), test_pkt.size());
+    ASSERT_EQ(1, views.size());
+
+    KlvParser flat_parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    KlvFlatTree tree;
+    flat_parser.parseFlat(test_pkt.data(), 100, tree);
+    EXPECT_TRUE(tree.empty());
+    flat_parser.parseFlat(test_pkt.data() + 100, test_pkt.size() - 100, tree);
+    ASSERT_FALSE(tree.empty());
+
+    const KlvView* view = views[0]->getChild();
+    uint32_t node = tree.getChild(tree.getRoot());
+    uint32_t previous = KlvFlatTree::NONE;
+    while(view != NULL && node != KlvFlatTree::NONE) {
+        EXPECT_THAT(tree.getValue(tree[node]).toVector(), ::testing::ContainerEq(view->getValue().toVector()));
+        EXPECT_EQ(previous, tree.getPrevious(node));
+        EXPECT_EQ(tree.getRoot(), tree.getParent(node));
+        previous = node;
+        view = view->getNext();
+        node = tree.getNext(node);
+    }
+    EXPECT_TRUE(view == NULL && node == KlvFlatTree::NONE);
+}
@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include "KlvIngestLoop.hpp"
+
+class KlvIngestLoopTest : public ::testing::Test {
+protected:
+    KlvIngestLoopTest() {
+
+    }
+
+    virtual ~KlvIngestLoopTest() {
+
+    }
+
+    virtual void SetUp() {
+        // key: 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x0B, 0x01, 0x01, 0x0E, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00
+        // len: 0x81, 0x90 (144 bytes)
+        // val: the rest
+        test_pkt = { 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x0B, 0x01, 0x01, 0x0E, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00, 0x81, 0x90, 0x02, 0x08, 0x00, 0x04, 0x6C, 0xAE, 0x70, 0xF9, 0x80, 0xCF, 0x41, 0x01, 0x01, 0x05, 0x02, 0xE1, 0x91, 0x06, 0x02, 0x06, 0x0D, 0x07, 0x02, 0x0A, 0xE1, 0x0B, 0x02, 0x49, 0x52, 0x0C, 0x0E, 0x47, 0x65, 0x6F, 0x64, 0x65, 0x74, 0x69, 0x63, 0x20, 0x57, 0x47, 0x53, 0x38, 0x34, 0x0D, 0x04, 0x4D, 0xCC, 0x41, 0x90, 0x0E, 0x04, 0xB1, 0xD0, 0x3D, 0x96, 0x0F, 0x02, 0x1B, 0x2E, 0x10, 0x02, 0x00, 0x84, 0x11, 0x02, 0x00, 0x4A, 0x12, 0x04, 0xE7, 0x23, 0x0B, 0x61, 0x13, 0x04, 0xFD, 0xE8, 0x63, 0x8E, 0x14, 0x04, 0x03, 0x0B, 0xC7, 0x1C, 0x15, 0x04, 0x00, 0x9F, 0xB9, 0x38, 0x16, 0x04, 0x00, 0x00, 0x01, 0xF8, 0x17, 0x04, 0x4D, 0xEC, 0xDA, 0xF4, 0x18, 0x04, 0xB1, 0xBC, 0x81, 0x74, 0x19, 0x02, 0x0B, 0x8A, 0x28, 0x04, 0x4D, 0xEC, 0xDA, 0xF4, 0x29, 0x04, 0xB1, 0xBC, 0x81, 0x74, 0x2A, 0x02, 0x0B, 0x8A, 0x38, 0x01, 0x31, 0x39, 0x04, 0x00, 0x9F, 0x85, 0x4D, 0x01, 0x02, 0xB7, 0xEB };
+    }
+
+    virtual void TearDown() {
+
+    }
+
+    // objects delclared here can be used by all tests in the test case for KlvIngestLoop
+    std::vector<uint8_t> test_pkt;
+};
+
+TEST_F(KlvIngestLoopTest, TestLoop) {
+    // packets numbered in the last timestamp byte (value byte 9), with garbage
+    // in between, pushed in pieces that split them anywhere
+    const int num_packets = 500;
+    std::vector<uint8_t> stream;
+    for(int i = 0; i < num_packets; i++) {
+        std::vector<uint8_t> pkt(test_pkt);
+        pkt[27] = (uint8_t) i;
+        stream.insert(stream.end(), pkt.begin(), pkt.end());
+        if(i % 7 == 3)
+            stream.push_back(0xFF);
+    }
+
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    KlvIngestLoop loop(parser, 4096, 4);
+    std::thread parse_thread([&]() { loop.run(); });
+
+    std::vector<uint64_t> tags;
+    int num_received = 0;
+    std::thread consumer([&]() {
+        KlvIngestLoop::Packet packets[3];
+        while(num_received < num_packets) {
+            size_t n = loop.poll(packets, 3);
+            if(n == 0) {
+                std::this_thread::yield();
+                continue;
+            }
+            for(size_t i = 0; i < n; i++) {
+                const KlvView* root = packets[i].tree->getRoot();
+                EXPECT_EQ(144, root->getValue().size);
+                EXPECT_EQ((uint8_t) num_received, root->getValue().data[9]);
+                EXPECT_EQ(0x02, root->getChild()->getKey().data[0]);
+                tags.push_back(packets[i].tag);
+                loop.recycle(packets[i].tree);
+                num_received++;
+            }
+        }
+    });
+
+    size_t offset = 0;
+    for(uint64_t piece = 0; offset < stream.size(); piece++) {
+        size_t n = std::min((size_t) (piece * 53 % 400 + 1), stream.size() - offset);
+        loop.getInput().push(&stream[offset], n, offset + n);
+        offset += n;
+    }
+    consumer.join();
+    loop.close();
+    parse_thread.join();
+
+    // each packet is tagged with the piece its last byte came in
+    ASSERT_EQ(num_packets, tags.size());
+    for(size_t i = 1; i < tags.size(); i++)
+        EXPECT_LE(tags[i-1], tags[i]);
+    EXPECT_EQ(stream.size(), tags.back());
+}
+
+TEST_F(KlvIngestLoopTest, TestCloseWhileWaitingForTrees) {
+    // the consumer never recycles, so the parse thread runs out of trees
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE});
+    KlvIngestLoop loop(parser, 4096, 2);
+    std::thread parse_thread([&]() { loop.run(); });
+    for(int i = 0; i < 3; i++)
+        loop.getInput().push(test_pkt.data(), test_pkt.size());
+
+    KlvIngestLoop::Packet packet;
+    for(int i = 0; i < 2; i++) {
+        while(!loop.poll(packet))
+            std::this_thread::yield();
+    }
+    loop.close();
+    parse_thread.join();
+    EXPECT_FALSE(loop.poll(packet));
+}
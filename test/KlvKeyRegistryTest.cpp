@@ -0,0 +1,252 @@
+#include <algorithm>
+#include <stdexcept>
+#include <stdint.h>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include "KlvFlatTree.hpp"
+#include "KlvKeyRegistry.hpp"
+#include "KlvParser.hpp"
+#include "KlvTestHelpers.hpp"
+#include "KlvTree.hpp"
+#include "KlvVisitor.hpp"
+
+
+class KlvKeyRegistryTest : public ::testing::Test {
+protected:
+    KlvKeyRegistryTest() {
+    }
+
+    virtual ~KlvKeyRegistryTest() {
+    }
+
+    virtual void SetUp() {
+        // key: 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x0B, 0x01, 0x01, 0x0E, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00
+        // len: 0x81, 0x90 (144 bytes)
+        // val: the rest
+        test_pkt = { 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x0B, 0x01, 0x01, 0x0E, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00, 0x81, 0x90, 0x02, 0x08, 0x00, 0x04, 0x6C, 0xAE, 0x70, 0xF9, 0x80, 0xCF, 0x41, 0x01, 0x01, 0x05, 0x02, 0xE1, 0x91, 0x06, 0x02, 0x06, 0x0D, 0x07, 0x02, 0x0A, 0xE1, 0x0B, 0x02, 0x49, 0x52, 0x0C, 0x0E, 0x47, 0x65, 0x6F, 0x64, 0x65, 0x74, 0x69, 0x63, 0x20, 0x57, 0x47, 0x53, 0x38, 0x34, 0x0D, 0x04, 0x4D, 0xCC, 0x41, 0x90, 0x0E, 0x04, 0xB1, 0xD0, 0x3D, 0x96, 0x0F, 0x02, 0x1B, 0x2E, 0x10, 0x02, 0x00, 0x84, 0x11, 0x02, 0x00, 0x4A, 0x12, 0x04, 0xE7, 0x23, 0x0B, 0x61, 0x13, 0x04, 0xFD, 0xE8, 0x63, 0x8E, 0x14, 0x04, 0x03, 0x0B, 0xC7, 0x1C, 0x15, 0x04, 0x00, 0x9F, 0xB9, 0x38, 0x16, 0x04, 0x00, 0x00, 0x01, 0xF8, 0x17, 0x04, 0x4D, 0xEC, 0xDA, 0xF4, 0x18, 0x04, 0xB1, 0xBC, 0x81, 0x74, 0x19, 0x02, 0x0B, 0x8A, 0x28, 0x04, 0x4D, 0xEC, 0xDA, 0xF4, 0x29, 0x04, 0xB1, 0xBC, 0x81, 0x74, 0x2A, 0x02, 0x0B, 0x8A, 0x38, 0x01, 0x31, 0x39, 0x04, 0x00, 0x9F, 0x85, 0x4D, 0x01, 0x02, 0xB7, 0xEB };
+
+        // ST 0102 security local set: classification and coding method items, no checksum
+        security_pkt = { 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x03, 0x01, 0x01, 0x0E, 0x01, 0x03, 0x03, 0x02, 0x00, 0x00, 0x00, 0x06, 0x01, 0x01, 0x01, 0x02, 0x01, 0x01 };
+
+        // a set with 2-byte keys: one item, key 0x0005
+        two_byte_pkt = { 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x0B, 0x01, 0x01, 0x0E, 0x01, 0x03, 0x7F, 0x01, 0x00, 0x00, 0x00, 0x04, 0x00, 0x05, 0x01, 0xAA };
+
+        // a universal set nobody registered
+        unknown_pkt = { 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x0B, 0x01, 0x01, 0x0E, 0x01, 0x03, 0x7E, 0x01, 0x00, 0x00, 0x00, 0x03, 0x01, 0x01, 0x00 };
+
+        stream = unknown_pkt;
+        stream.insert(stream.end(), test_pkt.begin(), test_pkt.end());
+        stream.insert(stream.end(), security_pkt.begin(), security_pkt.end());
+        stream.insert(stream.end(), unknown_pkt.begin(), unknown_pkt.end());
+        stream.insert(stream.end(), two_byte_pkt.begin(), two_byte_pkt.end());
+
+        registry.add(KlvUniversalKey(test_pkt.data()),
+                     KlvKeyRegistry::Rule({KlvParser::KEY_ENCODING_BER_OID}, KlvKeyRegistry::CHECKSUM_ST0601));
+        registry.add(KlvUniversalKey(security_pkt.data()), KlvKeyRegistry::Rule({KlvParser::KEY_ENCODING_BER_OID}));
+        registry.add(KlvUniversalKey(two_byte_pkt.data()), KlvKeyRegistry::Rule({KlvParser::KEY_ENCODING_2_BYTE}));
+    }
+
+    virtual void TearDown() {
+
+    }
+
+    // objects delclared here can be used by all tests in the test case for KlvKeyRegistry
+    std::vector<uint8_t> test_pkt;
+    std::vector<uint8_t> security_pkt;
+    std::vector<uint8_t> two_byte_pkt;
+    std::vector<uint8_t> unknown_pkt;
+    std::vector<uint8_t> stream;
+    KlvKeyRegistry registry;
+
+};
+
+TEST_F(KlvKeyRegistryTest, TestFind) {
+    EXPECT_EQ(3, registry.size());
+    EXPECT_EQ(0, registry.find(KlvUniversalKey(test_pkt.data())));
+    EXPECT_EQ(2, registry.find(KlvUniversalKey(two_byte_pkt.data())));
+    EXPECT_EQ(KlvKeyRegistry::NOT_FOUND, registry.find(KlvUniversalKey(unknown_pkt.data())));
+    EXPECT_EQ(KlvKeyRegistry::NOT_FOUND, KlvKeyRegistry().find(KlvUniversalKey(test_pkt.data())));
+
+    // a second rule for a key replaces the first
+    registry.add(KlvUniversalKey(security_pkt.data()), KlvKeyRegistry::Rule());
+    EXPECT_EQ(3, registry.size());
+    EXPECT_FALSE(registry.getRule(1).descend);
+
+    // every key is found as the table grows
+    KlvKeyRegistry many;
+    std::vector<uint8_t> key(test_pkt.begin(), test_pkt.begin() + 16);
+    for(int i = 0; i < 100; i++) {
+        key[14] = (uint8_t) i;
+        many.add(KlvUniversalKey(key.data()), KlvKeyRegistry::Rule());
+    }
+    for(int i = 0; i < 100; i++) {
+        key[14] = (uint8_t) i;
+        EXPECT_EQ(i, many.find(KlvUniversalKey(key.data())));
+    }
+    key[14] = 100;
+    EXPECT_EQ(KlvKeyRegistry::NOT_FOUND, many.find(KlvUniversalKey(key.data())));
+}
+
+TEST_F(KlvKeyRegistryTest, TestMixedStream) {
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    parser.setChecksumMode(KlvParser::CHECKSUM_DROP);
+    parser.setKeyRegistry(registry);
+
+    // the same packets in one go and byte by byte
+    const size_t chunk_sizes[] = {1, 1000};
+    for(size_t chunk_size : chunk_sizes) {
+        std::vector<KLV*> klvs;
+        for(size_t offset = 0; offset < stream.size(); offset += chunk_size)
+            parser.parse(stream.data() + offset, std::min(chunk_size, stream.size() - offset), klvs);
+
+        ASSERT_EQ(3, klvs.size()) << chunk_size;
+        EXPECT_EQ(26, countChildren(klvs[0]));
+        EXPECT_EQ(KLV_CHECKSUM_VALID, klvs[0]->getChecksumStatus());
+
+        // no checksum item, and none expected
+        EXPECT_EQ(2, countChildren(klvs[1]));
+        EXPECT_EQ(KLV_CHECKSUM_UNCHECKED, klvs[1]->getChecksumStatus());
+
+        ASSERT_EQ(1, countChildren(klvs[2]));
+        EXPECT_EQ(std::vector<uint8_t>({0x00, 0x05}), klvs[2]->getChild()->getKey());
+        EXPECT_EQ(std::vector<uint8_t>({0xAA}), klvs[2]->getChild()->getValue());
+
+        for(KLV* klv : klvs)
+            KLV::deleteTree(klv);
+    }
+    EXPECT_EQ(0, parser.getNumErrors());
+    EXPECT_EQ(4, parser.getStats().snapshot().num_filtered);
+
+    // lazily decoded by the same rules
+    parser.setLazyNesting(true);
+    std::vector<KLV*> klvs = parser.parse(stream);
+    ASSERT_EQ(3, klvs.size());
+    EXPECT_EQ(26, countChildren(klvs[0]));
+    EXPECT_EQ(std::vector<uint8_t>({0x00, 0x05}), klvs[2]->getChild()->getKey());
+    for(KLV* klv : klvs)
+        KLV::deleteTree(klv);
+
+    // and back to the parser's own encodings, unknown sets included
+    parser.setLazyNesting(false);
+    parser.clearKeyRegistry();
+    parser.setChecksumMode(KlvParser::CHECKSUM_OFF);
+    klvs = parser.parse(stream);
+    EXPECT_EQ(5, klvs.size());
+    for(KLV* klv : klvs)
+        KLV::deleteTree(klv);
+}
+
+TEST_F(KlvKeyRegistryTest, TestTrees) {
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    parser.setKeyRegistry(registry);
+
+    std::vector<size_t> sizes;
+    KlvTree tree;
+    for(size_t offset = 0; offset < stream.size(); ) {
+        offset += parser.parseTree(stream.data() + offset, std::min((size_t) 50, stream.size() - offset), tree);
+        if(!tree.empty())
+            sizes.push_back(tree.getRoot()->getValue().size);
+    }
+    EXPECT_EQ(std::vector<size_t>({144, 6, 4}), sizes);
+    ASSERT_TRUE(tree.find(5) != NULL);
+    EXPECT_EQ(0xAA, tree.find(5)->getValue()[0]);
+
+    KlvFlatTree flat;
+    std::vector<size_t> num_nodes;
+    for(size_t offset = 0; offset < stream.size(); ) {
+        offset += parser.parseFlat(stream.data() + offset, stream.size() - offset, flat);
+        if(!flat.empty())
+            num_nodes.push_back(flat.size());
+    }
+    EXPECT_EQ(std::vector<size_t>({27, 3, 2}), num_nodes);
+    EXPECT_EQ(2, flat[1].key_size);
+    EXPECT_EQ(5, flat[1].tag);
+}
+
+TEST_F(KlvKeyRegistryTest, TestHandlers) {
+    // the security sets go to their own visitor, checked against no checksum
+    CountingVisitor security;
+    registry.add(KlvUniversalKey(security_pkt.data()),
+                 KlvKeyRegistry::Rule({KlvParser::KEY_ENCODING_BER_OID}, KlvKeyRegistry::CHECKSUM_NONE, &security));
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    parser.setChecksumMode(KlvParser::CHECKSUM_MARK);
+    parser.setKeyRegistry(registry);
+
+    CountingVisitor visitor;
+    EXPECT_EQ(KLV_OK, parser.parse(stream.data(), stream.size(), visitor));
+    EXPECT_EQ(2, visitor.num_sets);
+    EXPECT_EQ(27, visitor.num_items);
+    EXPECT_EQ(0, visitor.num_bad);
+    EXPECT_EQ(1, security.num_sets);
+    EXPECT_EQ(std::vector<uint64_t>({1, 2}), security.tags);
+    EXPECT_EQ(0, security.num_bad);
+}
+
+TEST_F(KlvKeyRegistryTest, TestRawSets) {
+    // a rule that does not descend keeps the value raw
+    registry.add(KlvUniversalKey(test_pkt.data()), KlvKeyRegistry::Rule());
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    parser.setKeyRegistry(registry);
+
+    std::vector<KLV*> klvs = parser.parse(stream);
+    ASSERT_EQ(3, klvs.size());
+    EXPECT_TRUE(klvs[0]->getChild() == NULL);
+    EXPECT_EQ(144, klvs[0]->getValue().size());
+    EXPECT_EQ(2, countChildren(klvs[1]));
+    for(KLV* klv : klvs)
+        KLV::deleteTree(klv);
+
+    CountingVisitor visitor;
+    parser.parse(stream.data(), stream.size(), visitor);
+    EXPECT_EQ(2, visitor.num_sets);
+    EXPECT_EQ(4, visitor.num_items);         // the raw packet and three items
+
+    // a registry needs universal keys on the top level
+    KlvParser local_parser({KlvParser::KEY_ENCODING_BER_OID});
+    EXPECT_THROW(local_parser.setKeyRegistry(registry), std::invalid_argument);
+}
+
+TEST_F(KlvKeyRegistryTest, TestFilters) {
+    // the parser's top level filter picks the sets, and its item filter is
+    // meant for ST 0601 tags, so it leaves the security sets alone
+    KlvFilter sets;
+    sets.addKey(KlvUniversalKey(test_pkt.data()));
+    sets.addKey(KlvUniversalKey(security_pkt.data()));
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    parser.setKeyRegistry(registry);
+    parser.setFilter(0, sets);
+    parser.setFilter(1, KlvFilter({2, 13}));
+
+    std::vector<KLV*> klvs = parser.parse(stream);
+    ASSERT_EQ(2, klvs.size());
+    EXPECT_EQ(26, countChildren(klvs[0]));
+    EXPECT_EQ(2, countChildren(klvs[1]));
+    for(KLV* klv : klvs)
+        KLV::deleteTree(klv);
+
+    // a rule's own filters apply to its sets only, lazily decoded ones included
+    KlvKeyRegistry::Rule st0601({KlvParser::KEY_ENCODING_BER_OID}, KlvKeyRegistry::CHECKSUM_ST0601);
+    st0601.filters.push_back(KlvFilter({2, 13}));
+    registry.add(KlvUniversalKey(test_pkt.data()), st0601);
+    parser.clearFilters();
+    parser.setFilter(0, sets);
+    parser.setKeyRegistry(registry);
+    const bool lazy[] = {false, true};
+    for(bool lazy_nesting : lazy) {
+        parser.setLazyNesting(lazy_nesting);
+        klvs = parser.parse(stream);
+        ASSERT_EQ(2, klvs.size());
+        ASSERT_EQ(2, countChildren(klvs[0]));
+        EXPECT_EQ(std::vector<uint8_t>({0x0D}), klvs[0]->getChild()->getNext()->getKey());
+        EXPECT_EQ(2, countChildren(klvs[1]));
+        for(KLV* klv : klvs)
+            KLV::deleteTree(klv);
+    }
+
+    CountingVisitor visitor;
+    parser.parse(stream.data(), stream.size(), visitor);
+    EXPECT_EQ(2, visitor.num_sets);
+    EXPECT_EQ(std::vector<uint64_t>({2, 13, 1, 2}), visitor.tags);
+}
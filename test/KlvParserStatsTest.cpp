@@ -0,0 +1,213 @@
+#include <algorithm>
+#include <atomic>
+#include <stdint.h>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include "KlvParser.hpp"
+#include "KlvParserStats.hpp"
+#include "KlvTree.hpp"
+
+
+class KlvParserStatsTest : public ::testing::Test {
+protected:
+    KlvParserStatsTest() {
+    }
+
+    virtual ~KlvParserStatsTest() {
+    }
+
+    virtual void SetUp() {
+        // key: 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x0B, 0x01, 0x01, 0x0E, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00
+        // len: 0x81, 0x90 (144 bytes)
+        // val: the rest
+        test_pkt = { 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x0B, 0x01, 0x01, 0x0E, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00, 0x81, 0x90, 0x02, 0x08, 0x00, 0x04, 0x6C, 0xAE, 0x70, 0xF9, 0x80, 0xCF, 0x41, 0x01, 0x01, 0x05, 0x02, 0xE1, 0x91, 0x06, 0x02, 0x06, 0x0D, 0x07, 0x02, 0x0A, 0xE1, 0x0B, 0x02, 0x49, 0x52, 0x0C, 0x0E, 0x47, 0x65, 0x6F, 0x64, 0x65, 0x74, 0x69, 0x63, 0x20, 0x57, 0x47, 0x53, 0x38, 0x34, 0x0D, 0x04, 0x4D, 0xCC, 0x41, 0x90, 0x0E, 0x04, 0xB1, 0xD0, 0x3D, 0x96, 0x0F, 0x02, 0x1B, 0x2E, 0x10, 0x02, 0x00, 0x84, 0x11, 0x02, 0x00, 0x4A, 0x12, 0x04, 0xE7, 0x23, 0x0B, 0x61, 0x13, 0x04, 0xFD, 0xE8, 0x63, 0x8E, 0x14, 0x04, 0x03, 0x0B, 0xC7, 0x1C, 0x15, 0x04, 0x00, 0x9F, 0xB9, 0x38, 0x16, 0x04, 0x00, 0x00, 0x01, 0xF8, 0x17, 0x04, 0x4D, 0xEC, 0xDA, 0xF4, 0x18, 0x04, 0xB1, 0xBC, 0x81, 0x74, 0x19, 0x02, 0x0B, 0x8A, 0x28, 0x04, 0x4D, 0xEC, 0xDA, 0xF4, 0x29, 0x04, 0xB1, 0xBC, 0x81, 0x74, 0x2A, 0x02, 0x0B, 0x8A, 0x38, 0x01, 0x31, 0x39, 0x04, 0x00, 0x9F, 0x85, 0x4D, 0x01, 0x02, 0xB7, 0xEB };
+    }
+
+    virtual void TearDown() {
+
+    }
+
+    // objects delclared here can be used by all tests in the test case for KlvParserStats
+    std::vector<uint8_t> test_pkt;
+
+};
+
+static void deleteAll(const std::vector<KLV*>& klvs) {
+    for(KLV* klv : klvs)
+        KLV::deleteTree(klv);
+}
+
+TEST_F(KlvParserStatsTest, TestCounts) {
+    // garbage, two packets of one universal set and one of another
+    std::vector<uint8_t> other(test_pkt);
+    other[13] = 0x01;
+    std::vector<uint8_t> buf = {0xFF, 0x06, 0x0E, 0x00, 0x00};
+    buf.insert(buf.end(), test_pkt.begin(), test_pkt.end());
+    buf.insert(buf.end(), other.begin(), other.end());
+    buf.insert(buf.end(), test_pkt.begin(), test_pkt.end());
+
+    // in one go, in chunks, and framed in place
+    const size_t chunk_sizes[] = {1, 7, 1000};
+    for(size_t chunk_size : chunk_sizes) {
+        for(int tree = 0; tree < 2; tree++) {
+            KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+            KlvTree klv_tree;
+            for(size_t offset = 0; offset < buf.size(); ) {
+                size_t n = std::min(chunk_size, buf.size() - offset);
+                if(tree) {
+                    n = parser.parseTree(buf.data() + offset, n, klv_tree);
+                } else {
+                    deleteAll(parser.parse(buf.data() + offset, n));
+                }
+                offset += n;
+            }
+
+            KlvParserStats::Snapshot s = parser.getStats().snapshot();
+            EXPECT_EQ(buf.size(), s.bytes_read) << chunk_size << " " << tree;
+            EXPECT_EQ(5, s.bytes_discarded) << chunk_size;
+            EXPECT_EQ(3, s.num_klvs);
+            EXPECT_EQ(0, s.num_filtered);
+            EXPECT_EQ(0, s.num_ber_length_errors + s.num_value_size_errors + s.num_checksum_failures);
+            EXPECT_EQ(1, s.max_depth);
+            EXPECT_EQ(3, s.value_sizes[8]);        // 144 bytes
+            ASSERT_EQ(2, s.keys.size());
+            EXPECT_EQ(KlvUniversalKey(test_pkt.data()), s.keys[0].first);
+            EXPECT_EQ(2, s.keys[0].second);
+            EXPECT_EQ(KlvUniversalKey(other.data()), s.keys[1].first);
+            EXPECT_EQ(1, s.keys[1].second);
+            EXPECT_EQ(0, s.num_other_keys);
+        }
+    }
+
+    // only top level KLVs are counted, whatever the depth
+    KlvParser top_parser({KlvParser::KEY_ENCODING_16_BYTE});
+    deleteAll(top_parser.parse(buf));
+    EXPECT_EQ(3, top_parser.getStats().snapshot().num_klvs);
+    EXPECT_EQ(0, top_parser.getStats().snapshot().max_depth);
+}
+
+TEST_F(KlvParserStatsTest, TestErrors) {
+    // a length field with too many length bytes, a value over the limit, a bad
+    // checksum, and a filtered packet
+    std::vector<uint8_t> buf(test_pkt.begin(), test_pkt.begin() + 16);
+    buf.insert(buf.end(), {0x89, 0x00});
+    std::vector<uint8_t> too_long(test_pkt);
+    too_long[17] = 0xFF;
+    buf.insert(buf.end(), too_long.begin(), too_long.begin() + 18);
+    std::vector<uint8_t> bad(test_pkt);
+    bad[41] ^= 0x01;
+    buf.insert(buf.end(), bad.begin(), bad.end());
+    std::vector<uint8_t> other(test_pkt);
+    other[13] = 0x01;
+    buf.insert(buf.end(), other.begin(), other.end());
+    buf.insert(buf.end(), test_pkt.begin(), test_pkt.end());
+
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    parser.setChecksumMode(KlvParser::CHECKSUM_DROP);
+    KlvParser::Limits limits;
+    limits.max_value_size = 200;
+    parser.setLimits(limits);
+    KlvFilter sets;
+    sets.addKey(KlvUniversalKey(test_pkt.data()));
+    parser.setFilter(0, sets);
+
+    std::vector<KLV*> klvs;
+    parser.parse(buf.data(), buf.size(), klvs);
+    EXPECT_EQ(1, klvs.size());
+    deleteAll(klvs);
+
+    KlvParserStats::Snapshot s = parser.getStats().snapshot();
+    EXPECT_EQ(1, s.num_ber_length_errors);
+    EXPECT_EQ(1, s.num_value_size_errors);
+    EXPECT_EQ(1, s.num_checksum_failures);
+    EXPECT_EQ(1, s.num_filtered);
+    EXPECT_EQ(2, s.num_klvs);                  // the bad checksum and the good packet
+    EXPECT_EQ(3, parser.getNumErrors());
+    EXPECT_EQ(buf.size(), s.bytes_read);
+
+    // the rejected key and length fields, and the zero left behind the first
+    EXPECT_EQ(17 + 1 + 18, s.bytes_discarded);
+}
+
+TEST_F(KlvParserStatsTest, TestKeys) {
+    std::vector<uint8_t> buf;
+    for(size_t i = 0; i < KlvParserStats::MAX_KEYS + 4; i++) {
+        std::vector<uint8_t> pkt(test_pkt);
+        pkt[15] = (uint8_t) i;
+        buf.insert(buf.end(), pkt.begin(), pkt.end());
+    }
+
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE});
+    deleteAll(parser.parse(buf));
+    deleteAll(parser.parse(test_pkt));
+
+    KlvParserStats::Snapshot s = parser.getStats().snapshot();
+    ASSERT_EQ(KlvParserStats::MAX_KEYS, s.keys.size());
+    EXPECT_EQ(2, s.keys[0].second);
+    EXPECT_EQ(1, s.keys[KlvParserStats::MAX_KEYS - 1].second);
+    EXPECT_EQ(4, s.num_other_keys);
+    EXPECT_EQ(KlvParserStats::MAX_KEYS + 5, s.num_klvs);
+}
+
+TEST_F(KlvParserStatsTest, TestSnapshotWhileParsing) {
+    std::vector<uint8_t> buf;
+    for(int i = 0; i < 50; i++)
+        buf.insert(buf.end(), test_pkt.begin(), test_pkt.end());
+    const int rounds = 200;
+
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    std::atomic<bool> done(false);
+    bool monotonic = true;
+    std::thread reader([&]() {
+        uint64_t last = 0;
+        while(!done.load()) {
+            KlvParserStats::Snapshot s = parser.getStats().snapshot();
+            if(s.bytes_read < last)
+                monotonic = false;
+            last = s.bytes_read;
+        }
+    });
+
+    KlvTree tree;
+    for(int r = 0; r < rounds; r++) {
+        for(size_t offset = 0; offset < buf.size(); )
+            offset += parser.parseTree(buf.data() + offset, buf.size() - offset, tree);
+    }
+    done.store(true);
+    reader.join();
+
+    EXPECT_TRUE(monotonic);
+    KlvParserStats::Snapshot s = parser.getStats().snapshot();
+    EXPECT_EQ(buf.size() * rounds, s.bytes_read);
+    EXPECT_EQ(50 * rounds, s.num_klvs);
+    ASSERT_EQ(1, s.keys.size());
+    EXPECT_EQ(50 * rounds, s.keys[0].second);
+}
+
+TEST_F(KlvParserStatsTest, TestStateTiming) {
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    for(uint8_t byte : test_pkt) {
+        KLV* klv = parser.parseByte(byte);
+        if(klv != NULL)
+            KLV::deleteTree(klv);
+    }
+    deleteAll(parser.parse(test_pkt));
+
+    KlvParserStats::Snapshot s = parser.getStats().snapshot();
+    uint64_t cycles = 0;
+    uint64_t entries = 0;
+    for(size_t i = 0; i < KlvParserStats::NUM_STATES; i++) {
+        cycles += s.state_cycles[i];
+        entries += s.state_entries[i];
+    }
+#ifdef KLV_ENABLE_STATE_TIMING
+    EXPECT_LT(0, cycles);
+    EXPECT_LE(8, entries);                      // key, length, value, and back for each packet
+#else
+    EXPECT_EQ(0, cycles);
+    EXPECT_EQ(0, entries);
+#endif
+}
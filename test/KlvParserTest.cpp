@@ -1,8 +1,11 @@
+#include <algorithm>
 #include <stdint.h>
 #include <vector>
 
 #include "gtest/gtest.h"
 #include "gmock/gmock.h"
+#include "KlvAllocCounter.hpp"
+#include "KlvFormatException.hpp"
 #include "KlvParser.hpp"
 
 
@@ -19,6 +22,11 @@ protected:
     virtual void SetUp() {
         // Code here will be called immediately after each test (right
 		// before the destructor).
+
+        // key: 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x0B, 0x01, 0x01, 0x0E, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00
+        // len: 0x81, 0x90 (144 bytes)
+        // val: the rest
+        test_pkt = { 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x0B, 0x01, 0x01, 0x0E, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00, 0x81, 0x90, 0x02, 0x08, 0x00, 0x04, 0x6C, 0xAE, 0x70, 0xF9, 0x80, 0xCF, 0x41, 0x01, 0x01, 0x05, 0x02, 0xE1, 0x91, 0x06, 0x02, 0x06, 0x0D, 0x07, 0x02, 0x0A, 0xE1, 0x0B, 0x02, 0x49, 0x52, 0x0C, 0x0E, 0x47, 0x65, 0x6F, 0x64, 0x65, 0x74, 0x69, 0x63, 0x20, 0x57, 0x47, 0x53, 0x38, 0x34, 0x0D, 0x04, 0x4D, 0xCC, 0x41, 0x90, 0x0E, 0x04, 0xB1, 0xD0, 0x3D, 0x96, 0x0F, 0x02, 0x1B, 0x2E, 0x10, 0x02, 0x00, 0x84, 0x11, 0x02, 0x00, 0x4A, 0x12, 0x04, 0xE7, 0x23, 0x0B, 0x61, 0x13, 0x04, 0xFD, 0xE8, 0x63, 0x8E, 0x14, 0x04, 0x03, 0x0B, 0xC7, 0x1C, 0x15, 0x04, 0x00, 0x9F, 0xB9, 0x38, 0x16, 0x04, 0x00, 0x00, 0x01, 0xF8, 0x17, 0x04, 0x4D, 0xEC, 0xDA, 0xF4, 0x18, 0x04, 0xB1, 0xBC, 0x81, 0x74, 0x19, 0x02, 0x0B, 0x8A, 0x28, 0x04, 0x4D, 0xEC, 0xDA, 0xF4, 0x29, 0x04, 0xB1, 0xBC, 0x81, 0x74, 0x2A, 0x02, 0x0B, 0x8A, 0x38, 0x01, 0x31, 0x39, 0x04, 0x00, 0x9F, 0x85, 0x4D, 0x01, 0x02, 0xB7, 0xEB };
     }
 
     virtual void TearDown() {
@@ -26,6 +34,7 @@ protected:
     }
 
     // objects delclared here can be used by all tests in the test case forKlvParserTestKlvTest
+    std::vector<uint8_t> test_pkt;
 
 };
 
@@ -114,13 +123,432 @@ TEST_F(KlvParserTest, TestTree) {
 }
 
 TEST_F(KlvParserTest, TestParseMultiplePkts) {
-    
+    // three packets back to back in one buffer
+    std::vector<uint8_t> buf;
+    for(int i = 0; i < 3; i++)
+        buf.insert(buf.end(), test_pkt.begin(), test_pkt.end());
+
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    std::vector<KLV*> klvs = parser.parse(buf);
+
+    ASSERT_EQ(3, klvs.size());
+    for(KLV* klv : klvs) {
+        EXPECT_EQ(144, klv->getLen());
+        EXPECT_EQ(144, klv->getValue().size());
+        ASSERT_TRUE(klv->getChild() != NULL);
+        EXPECT_EQ(0x02, klv->getChild()->getKey()[0]);
+        delete klv;
+    }
 }
 
 TEST_F(KlvParserTest, TestParsePartialPkt) {
-    
+    // split the packet in the middle of the BER length and in the middle of the value
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+
+    EXPECT_TRUE(parser.parse(test_pkt.data(), 17).empty());
+    EXPECT_TRUE(parser.parse(test_pkt.data() + 17, 60).empty());
+    std::vector<KLV*> klvs = parser.parse(test_pkt.data() + 77, test_pkt.size() - 77);
+
+    ASSERT_EQ(1, klvs.size());
+    std::vector<uint8_t> test_val(test_pkt.begin() + 18, test_pkt.end());
+    EXPECT_THAT(test_val, ::testing::ContainerEq(klvs[0]->getValue()));
+    delete klvs[0];
 }
 
 TEST_F(KlvParserTest, TestParsePktExtraFront) {
-    
-}
\ No newline at end of file
+    // junk in front of the packet must be skipped, including a lone UL header byte
+    std::vector<uint8_t> buf = {0x00, 0xFF, 0x06, 0x0E, 0x12};
+    buf.insert(buf.end(), test_pkt.begin(), test_pkt.end());
+
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE});
+    std::vector<KLV*> klvs = parser.parse(buf);
+
+    ASSERT_EQ(1, klvs.size());
+    std::vector<uint8_t> test_key(test_pkt.begin(), test_pkt.begin() + 16);
+    EXPECT_THAT(test_key, ::testing::ContainerEq(klvs[0]->getKey()));
+    delete klvs[0];
+}
+
+TEST_F(KlvParserTest, TestParseMatchesParseByte) {
+    // bulk parsing must produce the same tree as feeding the parser one byte at a time
+    KlvParser byte_parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    KLV* byte_klv = NULL;
+    for(size_t i = 0; i < test_pkt.size() && byte_klv == NULL; i++)
+        byte_klv = byte_parser.parseByte(test_pkt[i]);
+    ASSERT_TRUE(byte_klv != NULL);
+
+    KlvParser bulk_parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    std::vector<KLV*> klvs = bulk_parser.parse(test_pkt);
+    ASSERT_EQ(1, klvs.size());
+
+    KLV* a = byte_klv->getChild();
+    KLV* b = klvs[0]->getChild();
+    int num_children = 0;
+    while(a != NULL && b != NULL) {
+        EXPECT_THAT(a->getKey(), ::testing::ContainerEq(b->getKey()));
+        EXPECT_THAT(a->getValue(), ::testing::ContainerEq(b->getValue()));
+        a = a->getNext();
+        b = b->getNext();
+        num_children++;
+    }
+    EXPECT_TRUE(a == NULL && b == NULL);
+    EXPECT_EQ(26, num_children);
+
+    delete byte_klv;
+    delete klvs[0];
+}
+
+TEST_F(KlvParserTest, TestParseZeroLengthValue) {
+    // a zero-length item completes on its length byte
+    std::vector<uint8_t> buf = {0x05, 0x00, 0x06, 0x01, 0xAA};
+
+    KlvParser parser({KlvParser::KEY_ENCODING_BER_OID});
+    std::vector<KLV*> klvs = parser.parse(buf);
+
+    ASSERT_EQ(2, klvs.size());
+    EXPECT_EQ(0, klvs[0]->getLen());
+    EXPECT_TRUE(klvs[0]->getValue().empty());
+    EXPECT_EQ(0x06, klvs[1]->getKey()[0]);
+    EXPECT_EQ(1, klvs[1]->getValue().size());
+    delete klvs[0];
+    delete klvs[1];
+}
+
+TEST_F(KlvParserTest, TestLazyNesting) {
+    // nested KLVs are only parsed once they are asked for, and then match eager parsing
+    KlvParser lazy_parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    lazy_parser.setLazyNesting(true);
+    std::vector<KLV*> lazy_klvs = lazy_parser.parse(test_pkt);
+    ASSERT_EQ(1, lazy_klvs.size());
+    KLV* lazy_klv = lazy_klvs[0];
+    EXPECT_FALSE(lazy_klv->isDecoded());
+    EXPECT_EQ(144, lazy_klv->getValue().size());
+
+    KlvParser eager_parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    std::vector<KLV*> eager_klvs = eager_parser.parse(test_pkt);
+    ASSERT_EQ(1, eager_klvs.size());
+    EXPECT_TRUE(eager_klvs[0]->isDecoded());
+
+    KLV* a = lazy_klv->getChild();
+    EXPECT_TRUE(lazy_klv->isDecoded());
+    EXPECT_EQ(a, lazy_klv->getChild());
+    KLV* b = eager_klvs[0]->getChild();
+    while(a != NULL && b != NULL) {
+        EXPECT_THAT(a->getKey(), ::testing::ContainerEq(b->getKey()));
+        EXPECT_THAT(a->getValue(), ::testing::ContainerEq(b->getValue()));
+        EXPECT_EQ(lazy_klv, a->getParent());
+        a = a->getNext();
+        b = b->getNext();
+    }
+    EXPECT_TRUE(a == NULL && b == NULL);
+
+    // indexing a lazy KLV decodes it too
+    KlvParser index_parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    index_parser.setLazyNesting(true);
+    std::vector<KLV*> index_klvs = index_parser.parse(test_pkt);
+    EXPECT_EQ(27, index_klvs[0]->indexToMap().size());
+
+    delete lazy_klv;
+    delete eager_klvs[0];
+    delete index_klvs[0];
+}
+
+TEST_F(KlvParserTest, TestChecksumMark) {
+    // a good packet and a corrupted one, fed in uneven chunks
+    std::vector<uint8_t> buf(test_pkt);
+    std::vector<uint8_t> bad(test_pkt);
+    bad[40] ^= 0x01;
+    buf.insert(buf.end(), bad.begin(), bad.end());
+
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    parser.setChecksumMode(KlvParser::CHECKSUM_MARK);
+    std::vector<KLV*> klvs = parser.parse(buf.data(), 101);
+    std::vector<KLV*> rest = parser.parse(buf.data() + 101, buf.size() - 101);
+    klvs.insert(klvs.end(), rest.begin(), rest.end());
+
+    ASSERT_EQ(2, klvs.size());
+    EXPECT_EQ(KLV_CHECKSUM_VALID, klvs[0]->getChecksumStatus());
+    EXPECT_EQ(KLV_CHECKSUM_INVALID, klvs[1]->getChecksumStatus());
+    EXPECT_EQ(0, parser.getNumChecksumFailures());
+
+    // byte at a time gives the same result
+    KlvParser byte_parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    byte_parser.setChecksumMode(KlvParser::CHECKSUM_MARK);
+    KLV* byte_klv = NULL;
+    for(size_t i = 0; i < test_pkt.size() && byte_klv == NULL; i++)
+        byte_klv = byte_parser.parseByte(test_pkt[i]);
+    ASSERT_TRUE(byte_klv != NULL);
+    EXPECT_EQ(KLV_CHECKSUM_VALID, byte_klv->getChecksumStatus());
+
+    // unchecked by default
+    KlvParser off_parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    std::vector<KLV*> off_klvs = off_parser.parse(bad);
+    ASSERT_EQ(1, off_klvs.size());
+    EXPECT_EQ(KLV_CHECKSUM_UNCHECKED, off_klvs[0]->getChecksumStatus());
+
+    delete klvs[0];
+    delete klvs[1];
+    delete byte_klv;
+    delete off_klvs[0];
+}
+
+TEST_F(KlvParserTest, TestChecksumReject) {
+    std::vector<uint8_t> bad(test_pkt);
+    bad[bad.size() - 1] ^= 0xFF;
+    std::vector<uint8_t> buf(bad);
+    buf.insert(buf.end(), test_pkt.begin(), test_pkt.end());
+
+    // dropped and counted
+    KlvParser drop_parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    drop_parser.setChecksumMode(KlvParser::CHECKSUM_DROP);
+    std::vector<KLV*> klvs = drop_parser.parse(buf);
+    ASSERT_EQ(1, klvs.size());
+    EXPECT_EQ(KLV_CHECKSUM_VALID, klvs[0]->getChecksumStatus());
+    EXPECT_EQ(1, drop_parser.getNumChecksumFailures());
+    delete klvs[0];
+
+    // thrown, and the parser carries on with the next packet
+    KlvParser throw_parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    throw_parser.setChecksumMode(KlvParser::CHECKSUM_THROW);
+    EXPECT_THROW(throw_parser.parse(bad), KlvFormatException);
+    std::vector<KLV*> next = throw_parser.parse(test_pkt);
+    ASSERT_EQ(1, next.size());
+    EXPECT_EQ(KLV_CHECKSUM_VALID, next[0]->getChecksumStatus());
+    EXPECT_EQ(1, throw_parser.getNumChecksumFailures());
+    delete next[0];
+
+    // the good packets parsed along with a bad one are freed, items and all
+    std::vector<uint8_t> both(test_pkt);
+    both.insert(both.end(), bad.begin(), bad.end());
+    KlvAllocCounter allocs;
+    EXPECT_THROW(throw_parser.parse(both), KlvFormatException);
+    EXPECT_EQ(allocs.allocations(), allocs.deallocations());
+}
+
+TEST_F(KlvParserTest, TestLimits) {
+    std::vector<uint8_t> key(test_pkt.begin(), test_pkt.begin() + 16);
+
+    // a length that would need 2^64 - 1 bytes, an indefinite length, and 9 length bytes
+    std::vector<uint8_t> buf(key);
+    buf.insert(buf.end(), {0x88, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF, 0xFF});
+    buf.insert(buf.end(), key.begin(), key.end());
+    buf.push_back(0x80);
+    buf.insert(buf.end(), key.begin(), key.end());
+    buf.insert(buf.end(), {0x89, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10});
+    buf.insert(buf.end(), test_pkt.begin(), test_pkt.end());
+
+    // each is rejected at its length field, and the packet behind them still comes out
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    std::vector<KLV*> klvs;
+    EXPECT_EQ(KLV_ERROR_BER_LENGTH, parser.parse(buf.data(), buf.size(), klvs));
+    ASSERT_EQ(1, klvs.size());
+    EXPECT_THAT(klvs[0]->getValue(), ::testing::ElementsAreArray(test_pkt.data() + 18, 144));
+    EXPECT_EQ(3, parser.getNumErrors());
+    EXPECT_EQ(KLV_ERROR_BER_LENGTH, parser.getLastError());
+    delete klvs[0];
+
+    // the same one byte at a time, through the throwing API
+    KlvParser byte_parser({KlvParser::KEY_ENCODING_16_BYTE});
+    int count = 0;
+    for(uint8_t b : buf) {
+        KLV* klv = byte_parser.parseByte(b);
+        if(klv != NULL) {
+            count++;
+            delete klv;
+        }
+    }
+    EXPECT_EQ(1, count);
+    EXPECT_EQ(3, byte_parser.getNumErrors());
+
+    // a value size limit below the packet size rejects the packet
+    KlvParser small_parser({KlvParser::KEY_ENCODING_16_BYTE});
+    KlvParser::Limits limits;
+    limits.max_value_size = 100;
+    small_parser.setLimits(limits);
+    klvs.clear();
+    EXPECT_EQ(KLV_ERROR_VALUE_SIZE, small_parser.parse(test_pkt.data(), test_pkt.size(), klvs));
+    EXPECT_EQ(0, klvs.size());
+    EXPECT_TRUE(small_parser.parseViews(test_pkt.data(), test_pkt.size()).empty());
+    EXPECT_EQ(2, small_parser.getNumErrors());
+
+    limits.max_ber_bytes = sizeof(unsigned long) + 1;
+    EXPECT_THROW(small_parser.setLimits(limits), std::invalid_argument);
+}
+
+TEST_F(KlvParserTest, TestLimitsDepth) {
+    std::vector<KlvParser::KeyEncoding> encodings = {KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID};
+    KlvParser::Limits limits;
+    limits.max_depth = 0;
+
+    // nested items are left in the value
+    KlvParser parser(encodings);
+    parser.setLimits(limits);
+    std::vector<KLV*> klvs = parser.parse(test_pkt);
+    ASSERT_EQ(1, klvs.size());
+    EXPECT_TRUE(klvs[0]->getChild() == NULL);
+    EXPECT_EQ(144, klvs[0]->getValue().size());
+    delete klvs[0];
+
+    KlvParser lazy_parser(encodings);
+    lazy_parser.setLimits(limits);
+    lazy_parser.setLazyNesting(true);
+    klvs = lazy_parser.parse(test_pkt);
+    ASSERT_EQ(1, klvs.size());
+    EXPECT_TRUE(klvs[0]->getChild() == NULL);
+    delete klvs[0];
+
+    KlvTree tree;
+    parser.parseTree(test_pkt.data(), test_pkt.size(), tree);
+    ASSERT_FALSE(tree.empty());
+    EXPECT_TRUE(tree.getRoot()->getChild() == NULL);
+
+    KlvFlatTree flat;
+    parser.parseFlat(test_pkt.data(), test_pkt.size(), flat);
+    EXPECT_EQ(1, flat.size());
+}
+
+TEST_F(KlvParserTest, TestStatusApiDoesNotThrow) {
+    std::vector<uint8_t> bad(test_pkt);
+    bad[bad.size() - 1] ^= 0xFF;
+    std::vector<uint8_t> buf(bad);
+    buf.insert(buf.end(), test_pkt.begin(), test_pkt.end());
+
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    parser.setChecksumMode(KlvParser::CHECKSUM_THROW);
+    std::vector<KLV*> klvs;
+    EXPECT_EQ(KLV_ERROR_CHECKSUM, parser.parse(buf.data(), buf.size(), klvs));
+    ASSERT_EQ(1, klvs.size());
+    EXPECT_EQ(KLV_CHECKSUM_VALID, klvs[0]->getChecksumStatus());
+    EXPECT_EQ(1, parser.getNumChecksumFailures());
+    EXPECT_EQ(1, parser.getNumErrors());
+    delete klvs[0];
+
+    klvs.clear();
+    EXPECT_EQ(KLV_OK, parser.parse(test_pkt.data(), test_pkt.size(), klvs));
+    ASSERT_EQ(1, klvs.size());
+    delete klvs[0];
+
+    // the throwing API reports the same status
+    try {
+        parser.parse(bad);
+        FAIL();
+    } catch(const KlvFormatException& e) {
+        EXPECT_EQ(KLV_ERROR_CHECKSUM, e.getStatus());
+        EXPECT_STREQ(klvStatusString(KLV_ERROR_CHECKSUM), e.what());
+    }
+}
+
+TEST_F(KlvParserTest, TestNestedParserReuse) {
+    // the value of the first packet ends in a truncated item, which must not
+    // carry over into the children of the next packet
+    std::vector<uint8_t> buf(test_pkt.begin(), test_pkt.begin() + 16);
+    std::vector<uint8_t> val = {0x02, 0x01, 0xAA, 0x05, 0x04, 0x11};
+    buf.push_back((uint8_t) val.size());
+    buf.insert(buf.end(), val.begin(), val.end());
+    buf.insert(buf.end(), test_pkt.begin(), test_pkt.end());
+
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    std::vector<KLV*> klvs = parser.parse(buf);
+    ASSERT_EQ(2, klvs.size());
+
+    ASSERT_TRUE(klvs[0]->getChild() != NULL);
+    EXPECT_TRUE(klvs[0]->getChild()->getNext() == NULL);
+
+    int num_children = 0;
+    for(KLV* child = klvs[1]->getChild(); child != NULL; child = child->getNext())
+        num_children++;
+    EXPECT_EQ(26, num_children);
+    EXPECT_EQ(0x02, klvs[1]->getChild()->getKey()[0]);
+
+    KLV::deleteTree(klvs[0]);
+    KLV::deleteTree(klvs[1]);
+}
+
+TEST_F(KlvParserTest, TestNestedParsingAllocations) {
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    std::vector<KLV*> klvs;
+    klvs.reserve(1);
+
+    // the first packet sets up the parser for the nested level and its buffers
+    parser.parse(test_pkt.data(), test_pkt.size(), klvs);
+    ASSERT_EQ(1, klvs.size());
+    KLV::deleteTree(klvs[0]);
+
+    // after that, every allocation made while parsing belongs to the returned
+    // tree: nothing is freed during parsing, and freeing the tree frees exactly
+    // what was allocated
+    for(int i = 0; i < 10; i++) {
+        klvs.clear();
+        KlvAllocCounter allocs;
+        parser.parse(test_pkt.data(), test_pkt.size(), klvs);
+        ASSERT_EQ(1, klvs.size());
+        size_t num_allocations = allocs.allocations();
+        EXPECT_EQ(0, allocs.deallocations());
+
+        allocs.restart();
+        KLV::deleteTree(klvs[0]);
+        EXPECT_EQ(num_allocations, allocs.deallocations());
+    }
+
+    // the same goes for a packet fed one byte at a time
+    KlvAllocCounter allocs;
+    KLV* klv = NULL;
+    for(size_t i = 0; i < test_pkt.size() && klv == NULL; i++)
+        klv = parser.parseByte(test_pkt[i]);
+    ASSERT_TRUE(klv != NULL);
+    size_t num_allocations = allocs.allocations();
+    EXPECT_EQ(0, allocs.deallocations());
+    allocs.restart();
+    KLV::deleteTree(klv);
+    EXPECT_EQ(num_allocations, allocs.deallocations());
+}
+
+TEST_F(KlvParserTest, TestTreeParsingAllocations) {
+    // packets split across calls go through the parser's own buffers, which
+    // are kept from one packet to the next
+    std::vector<uint8_t> buf;
+    for(int i = 0; i < 20; i++)
+        buf.insert(buf.end(), test_pkt.begin(), test_pkt.end());
+    const size_t chunk = 100;
+
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    KlvTree tree;
+    KlvFlatTree flat;
+
+    for(int pass = 0; pass < 2; pass++) {
+        // the second pass is steady state
+        KlvAllocCounter allocs;
+        size_t num_trees = 0;
+        for(size_t begin = 0; begin < buf.size(); begin += chunk) {
+            size_t end = std::min(buf.size(), begin + chunk);
+            size_t offset = begin;
+            while(offset < end) {
+                offset += parser.parseTree(&buf[offset], end - offset, tree);
+                if(!tree.empty())
+                    num_trees++;
+            }
+        }
+        EXPECT_EQ(20, num_trees);
+        if(pass == 1) {
+            EXPECT_EQ(0, allocs.allocations());
+        }
+    }
+
+    for(int pass = 0; pass < 2; pass++) {
+        KlvAllocCounter allocs;
+        size_t num_trees = 0;
+        for(size_t begin = 0; begin < buf.size(); begin += chunk) {
+            size_t end = std::min(buf.size(), begin + chunk);
+            size_t offset = begin;
+            while(offset < end) {
+                offset += parser.parseFlat(&buf[offset], end - offset, flat);
+                if(!flat.empty())
+                    num_trees++;
+            }
+        }
+        EXPECT_EQ(20, num_trees);
+        if(pass == 1) {
+            EXPECT_EQ(0, allocs.allocations());
+        }
+    }
+}
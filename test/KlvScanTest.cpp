@@ -0,0 +1,100 @@
+#include <stdint.h>
+#include <cstdlib>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include "KlvParser.hpp"
+#include "KlvScan.hpp"
+
+class KlvScanTest : public ::testing::Test {
+protected:
+    KlvScanTest() {
+
+    }
+
+    virtual ~KlvScanTest() {
+
+    }
+
+    virtual void SetUp() {
+        // key: 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x0B, 0x01, 0x01, 0x0E, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00
+        // len: 0x81, 0x90 (144 bytes)
+        // val: the rest
+        test_pkt = { 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x0B, 0x01, 0x01, 0x0E, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00, 0x81, 0x90, 0x02, 0x08, 0x00, 0x04, 0x6C, 0xAE, 0x70, 0xF9, 0x80, 0xCF, 0x41, 0x01, 0x01, 0x05, 0x02, 0xE1, 0x91, 0x06, 0x02, 0x06, 0x0D, 0x07, 0x02, 0x0A, 0xE1, 0x0B, 0x02, 0x49, 0x52, 0x0C, 0x0E, 0x47, 0x65, 0x6F, 0x64, 0x65, 0x74, 0x69, 0x63, 0x20, 0x57, 0x47, 0x53, 0x38, 0x34, 0x0D, 0x04, 0x4D, 0xCC, 0x41, 0x90, 0x0E, 0x04, 0xB1, 0xD0, 0x3D, 0x96, 0x0F, 0x02, 0x1B, 0x2E, 0x10, 0x02, 0x00, 0x84, 0x11, 0x02, 0x00, 0x4A, 0x12, 0x04, 0xE7, 0x23, 0x0B, 0x61, 0x13, 0x04, 0xFD, 0xE8, 0x63, 0x8E, 0x14, 0x04, 0x03, 0x0B, 0xC7, 0x1C, 0x15, 0x04, 0x00, 0x9F, 0xB9, 0x38, 0x16, 0x04, 0x00, 0x00, 0x01, 0xF8, 0x17, 0x04, 0x4D, 0xEC, 0xDA, 0xF4, 0x18, 0x04, 0xB1, 0xBC, 0x81, 0x74, 0x19, 0x02, 0x0B, 0x8A, 0x28, 0x04, 0x4D, 0xEC, 0xDA, 0xF4, 0x29, 0x04, 0xB1, 0xBC, 0x81, 0x74, 0x2A, 0x02, 0x0B, 0x8A, 0x38, 0x01, 0x31, 0x39, 0x04, 0x00, 0x9F, 0x85, 0x4D, 0x01, 0x02, 0xB7, 0xEB };
+    }
+
+    virtual void TearDown() {
+
+    }
+
+    // objects delclared here can be used by all tests in the test case for KlvScanTest
+    std::vector<uint8_t> test_pkt;
+};
+
+TEST_F(KlvScanTest, TestImplementationsAgree) {
+    // random garbage with a lot of 0x06 0x0E and a few headers planted at odd offsets
+    srand(1234);
+    std::vector<uint8_t> buf(1000);
+    for(size_t i = 0; i < buf.size(); i++)
+        buf[i] = (rand() % 3 == 0) ? 0x06 : ((rand() % 2) ? 0x0E : (uint8_t) rand());
+
+    for(size_t start = 0; start < 100; start++) {
+        for(size_t size = 0; size + start <= buf.size(); size += 37) {
+            size_t expected = KlvScan::findUlHeaderScalar(buf.data() + start, size);
+            EXPECT_EQ(expected, KlvScan::findUlHeaderSse2(buf.data() + start, size));
+            if(KlvScan::hasAvx2()) {
+                EXPECT_EQ(expected, KlvScan::findUlHeaderAvx2(buf.data() + start, size));
+            }
+            EXPECT_EQ(expected, KlvScan::findUlHeader(buf.data() + start, size));
+        }
+    }
+
+    const size_t offsets[] = {996, 500, 63, 31, 17, 0};
+    for(size_t i = 0; i < sizeof(offsets) / sizeof(offsets[0]); i++) {
+        std::copy(test_pkt.begin(), test_pkt.begin() + 4, buf.begin() + offsets[i]);
+        size_t expected = KlvScan::findUlHeaderScalar(buf.data(), buf.size());
+        EXPECT_LE(expected, offsets[i]);
+        EXPECT_EQ(expected, KlvScan::findUlHeaderSse2(buf.data(), buf.size()));
+        EXPECT_EQ(expected, KlvScan::findUlHeader(buf.data(), buf.size()));
+    }
+    EXPECT_EQ(0, KlvScan::findUlHeader(buf.data(), buf.size()));
+}
+
+TEST_F(KlvScanTest, TestPrefixSuffix) {
+    const uint8_t a[] = {0x00, 0x06, 0x0E, 0x2B};
+    const uint8_t b[] = {0x06, 0x0E, 0x00};
+    EXPECT_EQ(3, KlvScan::ulHeaderPrefixSuffix(a, 4));
+    EXPECT_EQ(2, KlvScan::ulHeaderPrefixSuffix(a, 3));
+    EXPECT_EQ(0, KlvScan::ulHeaderPrefixSuffix(b, 3));
+    EXPECT_EQ(0, KlvScan::ulHeaderPrefixSuffix(a, 0));
+}
+
+TEST_F(KlvScanTest, TestResyncAcrossChunks) {
+    // garbage, then a packet whose header is split across every possible chunk boundary
+    std::vector<uint8_t> buf(3000, 0x06);
+    for(size_t i = 0; i < buf.size(); i += 7)
+        buf[i] = 0x0E;
+    size_t pkt_offset = buf.size();
+    buf.insert(buf.end(), test_pkt.begin(), test_pkt.end());
+
+    for(size_t split = pkt_offset - 4; split <= pkt_offset + 17; split++) {
+        KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+        std::vector<KLV*> klvs = parser.parse(buf.data(), split);
+        EXPECT_TRUE(klvs.empty());
+        klvs = parser.parse(buf.data() + split, buf.size() - split);
+        ASSERT_EQ(1, klvs.size());
+        EXPECT_EQ(144, klvs[0]->getLen());
+        delete klvs[0];
+    }
+
+    // and one byte at a time
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE});
+    KLV* klv = NULL;
+    for(size_t i = 0; i < buf.size() && klv == NULL; i++)
+        klv = parser.parseByte(buf[i]);
+    ASSERT_TRUE(klv != NULL);
+    std::vector<uint8_t> test_key(test_pkt.begin(), test_pkt.begin() + 16);
+    EXPECT_THAT(klv->getKey(), ::testing::ContainerEq(test_key));
+    delete klv;
+}
@@ -0,0 +1,149 @@
+#include <stdint.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <stdexcept>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include "KlvParser.hpp"
+#include "KlvSt0601Batch.hpp"
+
+class KlvSt0601BatchTest : public ::testing::Test {
+protected:
+    KlvSt0601BatchTest() {
+
+    }
+
+    virtual ~KlvSt0601BatchTest() {
+
+    }
+
+    virtual void SetUp() {
+        // key: 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x0B, 0x01, 0x01, 0x0E, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00
+        // len: 0x81, 0x90 (144 bytes)
+        // val: the rest
+        test_pkt = { 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x0B, 0x01, 0x01, 0x0E, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00, 0x81, 0x90, 0x02, 0x08, 0x00, 0x04, 0x6C, 0xAE, 0x70, 0xF9, 0x80, 0xCF, 0x41, 0x01, 0x01, 0x05, 0x02, 0xE1, 0x91, 0x06, 0x02, 0x06, 0x0D, 0x07, 0x02, 0x0A, 0xE1, 0x0B, 0x02, 0x49, 0x52, 0x0C, 0x0E, 0x47, 0x65, 0x6F, 0x64, 0x65, 0x74, 0x69, 0x63, 0x20, 0x57, 0x47, 0x53, 0x38, 0x34, 0x0D, 0x04, 0x4D, 0xCC, 0x41, 0x90, 0x0E, 0x04, 0xB1, 0xD0, 0x3D, 0x96, 0x0F, 0x02, 0x1B, 0x2E, 0x10, 0x02, 0x00, 0x84, 0x11, 0x02, 0x00, 0x4A, 0x12, 0x04, 0xE7, 0x23, 0x0B, 0x61, 0x13, 0x04, 0xFD, 0xE8, 0x63, 0x8E, 0x14, 0x04, 0x03, 0x0B, 0xC7, 0x1C, 0x15, 0x04, 0x00, 0x9F, 0xB9, 0x38, 0x16, 0x04, 0x00, 0x00, 0x01, 0xF8, 0x17, 0x04, 0x4D, 0xEC, 0xDA, 0xF4, 0x18, 0x04, 0xB1, 0xBC, 0x81, 0x74, 0x19, 0x02, 0x0B, 0x8A, 0x28, 0x04, 0x4D, 0xEC, 0xDA, 0xF4, 0x29, 0x04, 0xB1, 0xBC, 0x81, 0x74, 0x2A, 0x02, 0x0B, 0x8A, 0x38, 0x01, 0x31, 0x39, 0x04, 0x00, 0x9F, 0x85, 0x4D, 0x01, 0x02, 0xB7, 0xEB };
+    }
+
+    virtual void TearDown() {
+
+    }
+
+    // objects delclared here can be used by all tests in the test case for KlvSt0601BatchTest
+    std::vector<uint8_t> test_pkt;
+};
+
+TEST_F(KlvSt0601BatchTest, TestColumns) {
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    KLV* full = parser.parse(test_pkt)[0];
+
+    // second packet: time, an "out of range" latitude, a longitude with the wrong length, no altitude
+    std::vector<uint8_t> key(test_pkt.begin(), test_pkt.begin() + 16);
+    KLV* partial = new KLV(key, {});
+    partial->appendChild(new KLV({0x02}, {0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x07}));
+    partial->appendChild(new KLV({0x0D}, {0x80, 0x00, 0x00, 0x00}));
+    partial->appendChild(new KLV({0x0E}, {0x12, 0x34}));
+
+    St0601::Batch batch({St0601::PrecisionTimeStamp::TAG, St0601::SensorLatitude::TAG,
+                         St0601::SensorLongitude::TAG, St0601::SensorTrueAltitude::TAG});
+    batch.add(std::vector<KLV*>{full, partial, full});
+    ASSERT_EQ(3u, batch.size());
+
+    const uint64_t* time = batch.getRaw(St0601::PrecisionTimeStamp::TAG);
+    EXPECT_EQ(St0601::get<St0601::PrecisionTimeStamp>(*full), time[0]);
+    EXPECT_EQ(7u, time[1]);
+
+    // mapped values match the single item decode exactly
+    const double* lat = batch.getValues(St0601::SensorLatitude::TAG);
+    const double* lon = batch.getValues(St0601::SensorLongitude::TAG);
+    const double* alt = batch.getValues(St0601::SensorTrueAltitude::TAG);
+    EXPECT_EQ(St0601::get<St0601::SensorLatitude>(*full), lat[0]);
+    EXPECT_EQ(St0601::get<St0601::SensorLongitude>(*full), lon[0]);
+    EXPECT_EQ(St0601::get<St0601::SensorTrueAltitude>(*full), alt[2]);
+    EXPECT_TRUE(std::isnan(lat[1]));
+    EXPECT_TRUE(std::isnan(lon[1]));
+    EXPECT_TRUE(std::isnan(alt[1]));
+
+    EXPECT_EQ(0x7u, batch.getPresence(St0601::PrecisionTimeStamp::TAG)[0]);
+    EXPECT_EQ(0x5u, batch.getPresence(St0601::SensorLatitude::TAG)[0]);
+    EXPECT_TRUE(batch.isPresent(St0601::SensorTrueAltitude::TAG, 2));
+    EXPECT_FALSE(batch.isPresent(St0601::SensorTrueAltitude::TAG, 1));
+    EXPECT_EQ(0u, batch.getRaw(St0601::SensorLatitude::TAG)[1]);
+
+    // signed items are sign extended
+    EXPECT_GT(0, (int64_t) batch.getRaw(St0601::SensorLongitude::TAG)[0]);
+
+    // not in the batch
+    EXPECT_TRUE(batch.getValues(St0601::SlantRange::TAG) == NULL);
+    EXPECT_TRUE(batch.getRaw(200) == NULL);
+    EXPECT_FALSE(batch.isPresent(St0601::SlantRange::TAG, 0));
+
+    // rows added later are mapped on the next read
+    batch.add(*partial);
+    lat = batch.getValues(St0601::SensorLatitude::TAG);
+    EXPECT_TRUE(std::isnan(lat[3]));
+    EXPECT_EQ(St0601::get<St0601::SensorLatitude>(*full), lat[2]);
+
+    batch.clear();
+    EXPECT_EQ(0u, batch.size());
+
+    delete full;
+    delete partial;
+}
+
+TEST_F(KlvSt0601BatchTest, TestBadTags) {
+    EXPECT_THROW(St0601::Batch({St0601::SensorLatitude::TAG, 11}), std::invalid_argument);
+    EXPECT_THROW(St0601::Batch({St0601::SensorLatitude::TAG, St0601::SensorLatitude::TAG}), std::invalid_argument);
+}
+
+TEST_F(KlvSt0601BatchTest, TestRawBuffer) {
+    // 100 packets, so the presence bitmaps have more than one word
+    std::vector<uint8_t> buf;
+    for(int i = 0; i < 100; i++)
+        buf.insert(buf.end(), test_pkt.begin(), test_pkt.end());
+
+    St0601::Batch batch({St0601::SensorLongitude::TAG, St0601::GroundRange::TAG});
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+
+    // chunks that split packets
+    size_t rows = 0;
+    for(size_t offset = 0; offset < buf.size(); offset += 1000)
+        rows += batch.add(parser, buf.data() + offset, std::min<size_t>(1000, buf.size() - offset));
+    EXPECT_EQ(100u, rows);
+    ASSERT_EQ(100u, batch.size());
+
+    KLV* klv = parser.parse(test_pkt)[0];
+    const double* lon = batch.getValues(St0601::SensorLongitude::TAG);
+    const double* range = batch.getValues(St0601::GroundRange::TAG);
+    for(size_t i = 0; i < batch.size(); i++) {
+        EXPECT_EQ(St0601::get<St0601::SensorLongitude>(*klv), lon[i]);
+        EXPECT_EQ(St0601::get<St0601::GroundRange>(*klv), range[i]);
+    }
+    EXPECT_EQ(~0ull, batch.getPresence(St0601::SensorLongitude::TAG)[0]);
+    EXPECT_EQ((1ull << 36) - 1, batch.getPresence(St0601::SensorLongitude::TAG)[1]);
+    delete klv;
+}
+
+TEST_F(KlvSt0601BatchTest, TestKernelsAgree) {
+    std::vector<uint64_t> raw;
+    srand(7);
+    for(int i = 0; i < 1001; i++) {
+        int64_t v = ((int64_t) rand() << 20) ^ rand();
+        raw.push_back((uint64_t) (i % 2 ? v : -v));
+    }
+    raw.push_back((uint64_t) (int64_t) -2147483647);
+    raw.push_back(0xFFFFFFFFull);
+
+    double scale = 180.0 / 4294967294.0;
+    std::vector<double> expected(raw.size()), out(raw.size());
+    St0601::Batch::mapScalar(raw.data(), raw.size(), scale, -900.0, expected.data());
+
+    St0601::Batch::mapSse2(raw.data(), raw.size(), scale, -900.0, out.data());
+    EXPECT_EQ(expected, out);
+    St0601::Batch::mapAvx2(raw.data(), raw.size(), scale, -900.0, out.data());
+    EXPECT_EQ(expected, out);
+    St0601::Batch::map(raw.data(), raw.size(), scale, -900.0, out.data());
+    EXPECT_EQ(expected, out);
+}
@@ -0,0 +1,161 @@
+#include <stdint.h>
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include "KlvParser.hpp"
+#include "KlvSt0601.hpp"
+
+class KlvSt0601Test : public ::testing::Test {
+protected:
+    KlvSt0601Test() {
+
+    }
+
+    virtual ~KlvSt0601Test() {
+
+    }
+
+    virtual void SetUp() {
+        // key: 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x0B, 0x01, 0x01, 0x0E, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00
+        // len: 0x81, 0x90 (144 bytes)
+        // val: the rest
+        test_pkt = { 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x0B, 0x01, 0x01, 0x0E, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00, 0x81, 0x90, 0x02, 0x08, 0x00, 0x04, 0x6C, 0xAE, 0x70, 0xF9, 0x80, 0xCF, 0x41, 0x01, 0x01, 0x05, 0x02, 0xE1, 0x91, 0x06, 0x02, 0x06, 0x0D, 0x07, 0x02, 0x0A, 0xE1, 0x0B, 0x02, 0x49, 0x52, 0x0C, 0x0E, 0x47, 0x65, 0x6F, 0x64, 0x65, 0x74, 0x69, 0x63, 0x20, 0x57, 0x47, 0x53, 0x38, 0x34, 0x0D, 0x04, 0x4D, 0xCC, 0x41, 0x90, 0x0E, 0x04, 0xB1, 0xD0, 0x3D, 0x96, 0x0F, 0x02, 0x1B, 0x2E, 0x10, 0x02, 0x00, 0x84, 0x11, 0x02, 0x00, 0x4A, 0x12, 0x04, 0xE7, 0x23, 0x0B, 0x61, 0x13, 0x04, 0xFD, 0xE8, 0x63, 0x8E, 0x14, 0x04, 0x03, 0x0B, 0xC7, 0x1C, 0x15, 0x04, 0x00, 0x9F, 0xB9, 0x38, 0x16, 0x04, 0x00, 0x00, 0x01, 0xF8, 0x17, 0x04, 0x4D, 0xEC, 0xDA, 0xF4, 0x18, 0x04, 0xB1, 0xBC, 0x81, 0x74, 0x19, 0x02, 0x0B, 0x8A, 0x28, 0x04, 0x4D, 0xEC, 0xDA, 0xF4, 0x29, 0x04, 0xB1, 0xBC, 0x81, 0x74, 0x2A, 0x02, 0x0B, 0x8A, 0x38, 0x01, 0x31, 0x39, 0x04, 0x00, 0x9F, 0x85, 0x4D, 0x01, 0x02, 0xB7, 0xEB };
+    }
+
+    virtual void TearDown() {
+
+    }
+
+    KLV* parse(const std::vector<uint8_t>& bytes) {
+        KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+        std::vector<KLV*> klvs = parser.parse(bytes);
+        return klvs.size() == 1 ? klvs[0] : NULL;
+    }
+
+    // objects delclared here can be used by all tests in the test case for KlvSt0601Test
+    std::vector<uint8_t> test_pkt;
+};
+
+TEST_F(KlvSt0601Test, TestGet) {
+    KLV* klv = parse(test_pkt);
+    ASSERT_TRUE(klv != NULL);
+
+    EXPECT_EQ(1245396382351567ull, St0601::get<St0601::PrecisionTimeStamp>(*klv));
+    EXPECT_EQ(1u, St0601::get<St0601::UasLdsVersionNumber>(*klv));
+    EXPECT_NEAR(317.2075990, St0601::get<St0601::PlatformHeadingAngle>(*klv), 1e-6);
+    EXPECT_NEAR(0.9454634, St0601::get<St0601::PlatformPitchAngle>(*klv), 1e-6);
+    EXPECT_NEAR(4.2497024, St0601::get<St0601::PlatformRollAngle>(*klv), 1e-6);
+    EXPECT_NEAR(54.7016312, St0601::get<St0601::SensorLatitude>(*klv), 1e-6);
+    EXPECT_NEAR(-109.9498504, St0601::get<St0601::SensorLongitude>(*klv), 1e-6);
+    EXPECT_NEAR(1212.8282597, St0601::get<St0601::SensorTrueAltitude>(*klv), 1e-6);
+    EXPECT_NEAR(-2.9421997, St0601::get<St0601::SensorRelativeElevationAngle>(*klv), 1e-6);
+    EXPECT_NEAR(12185.9367965, St0601::get<St0601::SlantRange>(*klv), 1e-6);
+    EXPECT_DOUBLE_EQ(49.0, St0601::get<St0601::PlatformGroundSpeed>(*klv));
+
+    // not in the packet
+    EXPECT_TRUE(std::isnan(St0601::get<St0601::PlatformTrueAirspeed>(*klv)));
+    double value = 0;
+    EXPECT_FALSE(St0601::get<St0601::PlatformTrueAirspeed>(*klv, value));
+    EXPECT_EQ(0, value);
+
+    EXPECT_EQ(13, St0601::SensorLatitude::TAG);
+    EXPECT_EQ(4u, St0601::SensorLatitude::LENGTH);
+    EXPECT_STREQ("deg", St0601::SensorLatitude::units());
+
+    delete klv;
+}
+
+TEST_F(KlvSt0601Test, TestGetFromTrees) {
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    KLV* klv = parse(test_pkt);
+    ASSERT_TRUE(klv != NULL);
+
+    KlvTree tree;
+    parser.parseTree(test_pkt.data(), test_pkt.size(), tree);
+    ASSERT_FALSE(tree.empty());
+
+    KlvFlatTree flat;
+    parser.parseFlat(test_pkt.data(), test_pkt.size(), flat);
+    ASSERT_FALSE(flat.empty());
+
+    // every representation of the packet decodes the same
+    double lat = St0601::get<St0601::SensorLatitude>(*klv);
+    EXPECT_EQ(lat, St0601::get<St0601::SensorLatitude>(tree));
+    EXPECT_EQ(lat, St0601::get<St0601::SensorLatitude>(*tree.getRoot()));
+    EXPECT_EQ(lat, St0601::get<St0601::SensorLatitude>(flat));
+    EXPECT_TRUE(std::isnan(St0601::get<St0601::TargetWidth>(KlvTree())));
+    EXPECT_TRUE(std::isnan(St0601::get<St0601::TargetWidth>(KlvFlatTree())));
+
+    delete klv;
+}
+
+TEST_F(KlvSt0601Test, TestMapping) {
+    // signed: full scale both ways, and the "out of range" value
+    uint8_t max[] = {0x7F, 0xFF, 0xFF, 0xFF};
+    uint8_t min[] = {0x80, 0x00, 0x00, 0x01};
+    uint8_t error[] = {0x80, 0x00, 0x00, 0x00};
+    EXPECT_DOUBLE_EQ(90.0, St0601::SensorLatitude::decode(max));
+    EXPECT_DOUBLE_EQ(-90.0, St0601::SensorLatitude::decode(min));
+    EXPECT_TRUE(std::isnan(St0601::SensorLatitude::decode(error)));
+
+    double value;
+    EXPECT_FALSE(St0601::decodeValue<St0601::SensorLatitude>(error, sizeof(error), value));
+    EXPECT_TRUE(St0601::decodeValue<St0601::SensorLatitude>(max, sizeof(max), value));
+    // wrong length
+    EXPECT_FALSE(St0601::decodeValue<St0601::SensorLatitude>(max, 2, value));
+
+    // unsigned with an offset
+    uint8_t zero[] = {0x00, 0x00};
+    uint8_t full[] = {0xFF, 0xFF};
+    EXPECT_DOUBLE_EQ(-900.0, St0601::SensorTrueAltitude::decode(zero));
+    EXPECT_DOUBLE_EQ(19000.0, St0601::SensorTrueAltitude::decode(full));
+}
+
+TEST_F(KlvSt0601Test, TestDecodeAll) {
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    KLV* klv = parse(test_pkt);
+    ASSERT_TRUE(klv != NULL);
+
+    St0601::Values values;
+    St0601::decode(*klv, values);
+
+    EXPECT_TRUE(values.has<St0601::PrecisionTimeStamp>());
+    EXPECT_TRUE(values.has<St0601::SensorLatitude>());
+    EXPECT_TRUE(values.has<St0601::GroundRange>());
+    EXPECT_FALSE(values.has<St0601::PlatformTrueAirspeed>());
+    EXPECT_TRUE(std::isnan(values.platform_true_airspeed));
+
+    EXPECT_EQ(1245396382351567ull, values.precision_time_stamp);
+    EXPECT_EQ(St0601::get<St0601::SensorLatitude>(*klv), values.sensor_latitude);
+    EXPECT_EQ(St0601::get<St0601::SensorLongitude>(*klv), values.sensor_longitude);
+    EXPECT_EQ(St0601::get<St0601::FrameCenterElevation>(*klv), values.frame_center_elevation);
+
+    // the packet has 23 of the supported tags (it also has 1, 11, 12, which are not),
+    // but its target width (22) is 4 bytes long instead of 2, so that one is rejected
+    EXPECT_EQ(22, __builtin_popcountll(values.present));
+    EXPECT_FALSE(values.has<St0601::TargetWidth>());
+
+    // the other representations fill the same struct
+    KlvTree tree;
+    parser.parseTree(test_pkt.data(), test_pkt.size(), tree);
+    St0601::Values tree_values;
+    St0601::decode(tree, tree_values);
+    EXPECT_EQ(values.present, tree_values.present);
+    EXPECT_EQ(values.slant_range, tree_values.slant_range);
+
+    KlvFlatTree flat;
+    parser.parseFlat(test_pkt.data(), test_pkt.size(), flat);
+    St0601::Values flat_values;
+    St0601::decode(flat, flat_values);
+    EXPECT_EQ(values.present, flat_values.present);
+    EXPECT_EQ(values.target_location_latitude, flat_values.target_location_latitude);
+
+    // decoding again starts from scratch
+    St0601::decode(KlvFlatTree(), flat_values);
+    EXPECT_EQ(0u, flat_values.present);
+    EXPECT_EQ(0u, flat_values.precision_time_stamp);
+
+    delete klv;
+}
@@ -0,0 +1,192 @@
+#include <algorithm>
+#include <stdint.h>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include "KlvStreamSet.hpp"
+#include "KlvAllocCounter.hpp"
+
+class KlvStreamSetTest : public ::testing::Test {
+protected:
+    KlvStreamSetTest() {
+
+    }
+
+    virtual ~KlvStreamSetTest() {
+
+    }
+
+    virtual void SetUp() {
+        // key: 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x0B, 0x01, 0x01, 0x0E, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00
+        // len: 0x81, 0x90 (144 bytes)
+        // val: the rest
+        test_pkt = { 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x0B, 0x01, 0x01, 0x0E, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00, 0x81, 0x90, 0x02, 0x08, 0x00, 0x04, 0x6C, 0xAE, 0x70, 0xF9, 0x80, 0xCF, 0x41, 0x01, 0x01, 0x05, 0x02, 0xE1, 0x91, 0x06, 0x02, 0x06, 0x0D, 0x07, 0x02, 0x0A, 0xE1, 0x0B, 0x02, 0x49, 0x52, 0x0C, 0x0E, 0x47, 0x65, 0x6F, 0x64, 0x65, 0x74, 0x69, 0x63, 0x20, 0x57, 0x47, 0x53, 0x38, 0x34, 0x0D, 0x04, 0x4D, 0xCC, 0x41, 0x90, 0x0E, 0x04, 0xB1, 0xD0, 0x3D, 0x96, 0x0F, 0x02, 0x1B, 0x2E, 0x10, 0x02, 0x00, 0x84, 0x11, 0x02, 0x00, 0x4A, 0x12, 0x04, 0xE7, 0x23, 0x0B, 0x61, 0x13, 0x04, 0xFD, 0xE8, 0x63, 0x8E, 0x14, 0x04, 0x03, 0x0B, 0xC7, 0x1C, 0x15, 0x04, 0x00, 0x9F, 0xB9, 0x38, 0x16, 0x04, 0x00, 0x00, 0x01, 0xF8, 0x17, 0x04, 0x4D, 0xEC, 0xDA, 0xF4, 0x18, 0x04, 0xB1, 0xBC, 0x81, 0x74, 0x19, 0x02, 0x0B, 0x8A, 0x28, 0x04, 0x4D, 0xEC, 0xDA, 0xF4, 0x29, 0x04, 0xB1, 0xBC, 0x81, 0x74, 0x2A, 0x02, 0x0B, 0x8A, 0x38, 0x01, 0x31, 0x39, 0x04, 0x00, 0x9F, 0x85, 0x4D, 0x01, 0x02, 0xB7, 0xEB };
+    }
+
+    virtual void TearDown() {
+
+    }
+
+    /**
+     * Bytes of one stream: num_packets copies of the test packet, with the
+     * stream id and the packet's sequence number in the last two bytes of the
+     * timestamp (value bytes 8 and 9).
+     */
+    std::vector<uint8_t> makeStream(uint32_t id, int num_packets) {
+        std::vector<uint8_t> bytes;
+        for(int i = 0; i < num_packets; i++) {
+            std::vector<uint8_t> pkt(test_pkt);
+            pkt[26] = (uint8_t) id;
+            pkt[27] = (uint8_t) i;
+            bytes.insert(bytes.end(), pkt.begin(), pkt.end());
+        }
+        return bytes;
+    }
+
+    /**
+     * Size of the next piece of a stream to submit, different from stream to
+     * stream and from piece to piece so that packets are split everywhere.
+     */
+    size_t pieceSize(uint32_t id, size_t offset) {
+        return (id * 37 + offset * 13) % 200 + 1;
+    }
+
+    // objects delclared here can be used by all tests in the test case for KlvStreamSet
+    std::vector<uint8_t> test_pkt;
+};
+
+TEST_F(KlvStreamSetTest, TestHandlers) {
+    const uint32_t num_streams = 40;
+    const int num_packets = 10;
+
+    KlvStreamSet set({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID}, 4);
+    std::vector<std::vector<KLV*> > received(num_streams);
+    std::vector<std::vector<uint8_t> > bytes(num_streams);
+    for(uint32_t id = 0; id < num_streams; id++) {
+        // each handler only touches its own stream's vector, on that stream's worker
+        set.addStream(id, [&received](KlvStreamSet::StreamId id, KLV* klv) { received[id].push_back(klv); });
+        bytes[id] = makeStream(id, num_packets);
+    }
+    EXPECT_EQ(num_streams, set.getNumStreams());
+    EXPECT_EQ(4, set.getNumWorkers());
+
+    // interleave pieces of every stream
+    std::vector<size_t> offsets(num_streams, 0);
+    bool more = true;
+    while(more) {
+        more = false;
+        for(uint32_t id = 0; id < num_streams; id++) {
+            size_t n = std::min(pieceSize(id, offsets[id]), bytes[id].size() - offsets[id]);
+            if(n == 0)
+                continue;
+            set.submit(id, &bytes[id][offsets[id]], n);
+            offsets[id] += n;
+            more = true;
+        }
+    }
+    set.flush();
+
+    for(uint32_t id = 0; id < num_streams; id++) {
+        ASSERT_EQ(num_packets, received[id].size());
+        for(int i = 0; i < num_packets; i++) {
+            KLV* klv = received[id][i];
+            ASSERT_EQ(144, klv->getValue().size());
+            EXPECT_EQ(id, klv->getValue()[8]);
+            EXPECT_EQ(i, klv->getValue()[9]);
+            ASSERT_TRUE(klv->getChild() != NULL);
+            EXPECT_EQ(0x02, klv->getChild()->getKey()[0]);
+            delete klv;
+        }
+    }
+}
+
+TEST_F(KlvStreamSetTest, TestPoll) {
+    // small rings and queues, so that the rings wrap and the workers have to
+    // wait for the consumer
+    const uint32_t num_streams = 7;
+    const int num_packets = 30;
+
+    KlvStreamSet set({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID}, 3, 4096, 4);
+    std::vector<std::vector<uint8_t> > bytes(num_streams);
+    for(uint32_t id = 0; id < num_streams; id++) {
+        set.addStream(id);
+        bytes[id] = makeStream(id, num_packets);
+    }
+
+    std::vector<int> next_seq(num_streams, 0);
+    size_t num_received = 0;
+    auto drain = [&]() {
+        KlvStreamSet::Output out;
+        while(set.poll(out)) {
+            ASSERT_LT(out.stream_id, num_streams);
+            EXPECT_EQ(out.stream_id, out.klv->getValue()[8]);
+            EXPECT_EQ(next_seq[out.stream_id]++, out.klv->getValue()[9]);
+            num_received++;
+            delete out.klv;
+        }
+    };
+
+    // submit and poll on the same thread, so only trySubmit() may be used
+    std::vector<size_t> offsets(num_streams, 0);
+    bool more = true;
+    while(more) {
+        more = false;
+        for(uint32_t id = 0; id < num_streams; id++) {
+            size_t n = std::min(pieceSize(id, offsets[id]), bytes[id].size() - offsets[id]);
+            if(n == 0)
+                continue;
+            more = true;
+            if(set.trySubmit(id, &bytes[id][offsets[id]], n))
+                offsets[id] += n;
+            else
+                drain();
+        }
+    }
+    while(num_received < num_streams * num_packets)
+        drain();
+
+    for(uint32_t id = 0; id < num_streams; id++)
+        EXPECT_EQ(num_packets, next_seq[id]);
+}
+
+TEST_F(KlvStreamSetTest, TestAddRemove) {
+    KlvStreamSet set({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID}, 2);
+    set.addStream(5);
+    EXPECT_THROW(set.addStream(5), std::invalid_argument);
+    EXPECT_THROW(set.submit(6, test_pkt.data(), test_pkt.size()), std::invalid_argument);
+    EXPECT_THROW(set.removeStream(6), std::invalid_argument);
+
+    // a partial packet is dropped with its stream
+    set.submit(5, test_pkt.data(), 100);
+    set.removeStream(5);
+    EXPECT_FALSE(set.hasStream(5));
+    set.addStream(5);
+    set.submit(5, test_pkt.data(), test_pkt.size());
+    set.flush();
+
+    KlvStreamSet::Output out;
+    ASSERT_TRUE(set.poll(out));
+    EXPECT_EQ(5, out.stream_id);
+    EXPECT_THAT(out.klv->getValue(), ::testing::ElementsAreArray(test_pkt.data() + 18, 144));
+    delete out.klv;
+    EXPECT_FALSE(set.poll(out));
+
+    // left in the queue and in the ring for the destructor
+    set.submit(5, test_pkt.data(), test_pkt.size());
+    set.submit(5, test_pkt.data(), 50);
+    set.removeStream(5);
+}
+
+TEST_F(KlvStreamSetTest, TestDestroyFreesTrees) {
+    // packets never polled are freed with their decoded items
+    KlvAllocCounter allocs;
+    {
+        KlvStreamSet set({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID}, 2);
+        set.addStream(1);
+        set.submit(1, test_pkt.data(), test_pkt.size());
+        set.submit(1, test_pkt.data(), test_pkt.size());
+        set.flush();
+    }
+    EXPECT_EQ(allocs.allocations(), allocs.deallocations());
+}
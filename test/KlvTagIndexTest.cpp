@@ -0,0 +1,108 @@
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include "KlvParser.hpp"
+#include "KlvTagIndex.hpp"
+#include "KlvUniversalKey.hpp"
+
+class KlvTagIndexTest : public ::testing::Test {
+protected:
+    KlvTagIndexTest() {
+
+    }
+
+    virtual ~KlvTagIndexTest() {
+
+    }
+
+    virtual void SetUp() {
+        // key: 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x0B, 0x01, 0x01, 0x0E, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00
+        // len: 0x81, 0x90 (144 bytes)
+        // val: the rest
+        test_pkt = { 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x0B, 0x01, 0x01, 0x0E, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00, 0x81, 0x90, 0x02, 0x08, 0x00, 0x04, 0x6C, 0xAE, 0x70, 0xF9, 0x80, 0xCF, 0x41, 0x01, 0x01, 0x05, 0x02, 0xE1, 0x91, 0x06, 0x02, 0x06, 0x0D, 0x07, 0x02, 0x0A, 0xE1, 0x0B, 0x02, 0x49, 0x52, 0x0C, 0x0E, 0x47, 0x65, 0x6F, 0x64, 0x65, 0x74, 0x69, 0x63, 0x20, 0x57, 0x47, 0x53, 0x38, 0x34, 0x0D, 0x04, 0x4D, 0xCC, 0x41, 0x90, 0x0E, 0x04, 0xB1, 0xD0, 0x3D, 0x96, 0x0F, 0x02, 0x1B, 0x2E, 0x10, 0x02, 0x00, 0x84, 0x11, 0x02, 0x00, 0x4A, 0x12, 0x04, 0xE7, 0x23, 0x0B, 0x61, 0x13, 0x04, 0xFD, 0xE8, 0x63, 0x8E, 0x14, 0x04, 0x03, 0x0B, 0xC7, 0x1C, 0x15, 0x04, 0x00, 0x9F, 0xB9, 0x38, 0x16, 0x04, 0x00, 0x00, 0x01, 0xF8, 0x17, 0x04, 0x4D, 0xEC, 0xDA, 0xF4, 0x18, 0x04, 0xB1, 0xBC, 0x81, 0x74, 0x19, 0x02, 0x0B, 0x8A, 0x28, 0x04, 0x4D, 0xEC, 0xDA, 0xF4, 0x29, 0x04, 0xB1, 0xBC, 0x81, 0x74, 0x2A, 0x02, 0x0B, 0x8A, 0x38, 0x01, 0x31, 0x39, 0x04, 0x00, 0x9F, 0x85, 0x4D, 0x01, 0x02, 0xB7, 0xEB };
+    }
+
+    virtual void TearDown() {
+
+    }
+
+    // objects delclared here can be used by all tests in the test case for KlvTagIndexTest
+    std::vector<uint8_t> test_pkt;
+};
+
+TEST_F(KlvTagIndexTest, TestDirectAndOverflow) {
+    KlvTagIndex<int> index(-1);
+
+    index.insert(13, 1);
+    index.insert(127, 2);
+    index.insert(128, 3);
+    index.insert(300, 4);
+    index.insert(300, 5);
+
+    EXPECT_EQ(1, index.find(13));
+    EXPECT_EQ(2, index.find(127));
+    EXPECT_EQ(3, index.find(128));
+    EXPECT_EQ(5, index.find(300));
+    EXPECT_EQ(-1, index.find(14));
+    EXPECT_EQ(-1, index.find(1000));
+    EXPECT_TRUE(index.contains(128));
+
+    index.clear();
+    EXPECT_FALSE(index.contains(13));
+    EXPECT_FALSE(index.contains(300));
+}
+
+TEST_F(KlvTagIndexTest, TestBerOidTag) {
+    // 0x81 0x01 is the two byte BER-OID encoding of tag 129
+    const uint8_t key[] = {0x81, 0x01};
+    EXPECT_EQ(129, KlvParser::decodeTag(key, 2, KlvParser::KEY_ENCODING_BER_OID));
+    EXPECT_EQ(0x8101, KlvParser::decodeTag(key, 2, KlvParser::KEY_ENCODING_2_BYTE));
+}
+
+TEST_F(KlvTagIndexTest, TestFindInTrees) {
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+
+    KlvFlatTree flat;
+    parser.parseFlat(test_pkt.data(), test_pkt.size(), flat);
+    KlvTree tree;
+    parser.parseTree(test_pkt.data(), test_pkt.size(), tree);
+
+    // sensor latitude, longitude and true altitude
+    std::vector<uint8_t> test_lat = {0x4D, 0xCC, 0x41, 0x90};
+    std::vector<uint8_t> test_lon = {0xB1, 0xD0, 0x3D, 0x96};
+    std::vector<uint8_t> test_alt = {0x1B, 0x2E};
+
+    ASSERT_NE(KlvFlatTree::NONE, flat.find(13));
+    EXPECT_THAT(flat.getValue(flat[flat.find(13)]).toVector(), ::testing::ContainerEq(test_lat));
+    EXPECT_THAT(flat.getValue(flat[flat.find(14)]).toVector(), ::testing::ContainerEq(test_lon));
+    EXPECT_THAT(flat.getValue(flat[flat.find(15)]).toVector(), ::testing::ContainerEq(test_alt));
+    EXPECT_EQ(KlvFlatTree::NONE, flat.find(3));
+
+    ASSERT_TRUE(tree.find(13) != NULL);
+    EXPECT_THAT(tree.find(13)->getValue().toVector(), ::testing::ContainerEq(test_lat));
+    EXPECT_THAT(tree.find(14)->getValue().toVector(), ::testing::ContainerEq(test_lon));
+    EXPECT_EQ(tree.getRoot(), tree.find(15)->getParent());
+    EXPECT_TRUE(tree.find(3) == NULL);
+}
+
+TEST_F(KlvTagIndexTest, TestUniversalKey) {
+    KlvUniversalKey uas_key(test_pkt.data());
+    std::vector<uint8_t> other_bytes(test_pkt.begin(), test_pkt.begin() + 16);
+    other_bytes[15] = 0x01;
+    KlvUniversalKey other_key(other_bytes.data());
+
+    EXPECT_THAT(uas_key.toVector(), ::testing::ElementsAreArray(test_pkt.data(), 16));
+    EXPECT_EQ(uas_key, KlvUniversalKey(KlvSpan(test_pkt.data(), 16)));
+    EXPECT_NE(uas_key, other_key);
+    EXPECT_TRUE(uas_key < other_key);
+    EXPECT_NE(uas_key.hash(), other_key.hash());
+
+    std::unordered_map<KlvUniversalKey, int> sets;
+    sets[uas_key] = 601;
+    sets[other_key] = 102;
+    EXPECT_EQ(601, sets[KlvUniversalKey(test_pkt.data())]);
+    EXPECT_EQ(2, sets.size());
+}
@@ -0,0 +1,52 @@
+//
+//  KlvTestHelpers.hpp
+//  libklv
+//
+
+#ifndef KlvTestHelpers_hpp
+#define KlvTestHelpers_hpp
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+#include "Klv.h"
+#include "KlvVisitor.hpp"
+
+/**
+ * @brief Test visitor that counts the sets and items it is shown, and the sets
+ *        that ended badly, and records the tag of each item.
+ */
+class CountingVisitor : public KlvVisitor {
+
+public:
+    CountingVisitor() : num_sets(0), num_items(0), num_bad(0) {}
+
+    void onSetBegin(size_t /*depth*/, const KlvSpan& /*key*/, const KlvSpan& /*len*/, const KlvSpan& /*value*/) {
+        num_sets++;
+    }
+    void onItem(size_t /*depth*/, uint64_t tag, const KlvSpan& /*key*/, const KlvSpan& /*len*/, const KlvSpan& /*value*/) {
+        num_items++;
+        tags.push_back(tag);
+    }
+    void onSetEnd(size_t /*depth*/, bool ok) {
+        if(!ok)
+            num_bad++;
+    }
+
+    size_t               num_sets;        /// onSetBegin() calls
+    size_t               num_items;       /// onItem() calls
+    size_t               num_bad;         /// onSetEnd() calls that were not ok
+    std::vector<uint64_t> tags;           /// tag of each item, in order
+};
+
+/**
+ * @return number of direct children of a KLV
+ */
+inline size_t countChildren(const KLV* klv) {
+    size_t n = 0;
+    for(const KLV* child = klv->getChild(); child != NULL; child = child->getNext())
+        n++;
+    return n;
+}
+
+#endif /* KlvTestHelpers_hpp */
@@ -0,0 +1,29 @@
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "KlvTrace.hpp"
+
+static void collectMessage(KlvTraceLevel /*level*/, const char* message, void* user_data) {
+    std::vector<std::string>* messages = (std::vector<std::string>*) user_data;
+    messages->push_back(message);
+}
+
+TEST(KlvTraceTest, TestLevelAndCallback) {
+    std::vector<std::string> messages;
+    KlvTraceLevel old_level = KlvTrace::getLevel();
+    KlvTrace::setCallback(collectMessage, &messages);
+
+    KlvTrace::setLevel(KLV_TRACE_INFO);
+    EXPECT_TRUE(KlvTrace::isEnabled(KLV_TRACE_ERROR));
+    EXPECT_TRUE(KlvTrace::isEnabled(KLV_TRACE_INFO));
+    EXPECT_FALSE(KlvTrace::isEnabled(KLV_TRACE_DEBUG));
+    EXPECT_FALSE(KlvTrace::isEnabled(KLV_TRACE_NONE));
+
+    KlvTrace::write(KLV_TRACE_INFO, "value length: %lu", 144ul);
+    ASSERT_EQ(1, messages.size());
+    EXPECT_EQ("value length: 144", messages[0]);
+
+    KlvTrace::setCallback(NULL, NULL);
+    KlvTrace::setLevel(old_level);
+}
@@ -0,0 +1,203 @@
+#include <stdint.h>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include "KlvTsDemuxer.hpp"
+#include "KlvAllocCounter.hpp"
+#include "KlvFormatException.hpp"
+
+class KlvTsDemuxerTest : public ::testing::Test {
+protected:
+    KlvTsDemuxerTest() {
+
+    }
+
+    virtual ~KlvTsDemuxerTest() {
+
+    }
+
+    virtual void SetUp() {
+        // key: 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x0B, 0x01, 0x01, 0x0E, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00
+        // len: 0x81, 0x90 (144 bytes)
+        // val: the rest
+        test_pkt = { 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x0B, 0x01, 0x01, 0x0E, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00, 0x81, 0x90, 0x02, 0x08, 0x00, 0x04, 0x6C, 0xAE, 0x70, 0xF9, 0x80, 0xCF, 0x41, 0x01, 0x01, 0x05, 0x02, 0xE1, 0x91, 0x06, 0x02, 0x06, 0x0D, 0x07, 0x02, 0x0A, 0xE1, 0x0B, 0x02, 0x49, 0x52, 0x0C, 0x0E, 0x47, 0x65, 0x6F, 0x64, 0x65, 0x74, 0x69, 0x63, 0x20, 0x57, 0x47, 0x53, 0x38, 0x34, 0x0D, 0x04, 0x4D, 0xCC, 0x41, 0x90, 0x0E, 0x04, 0xB1, 0xD0, 0x3D, 0x96, 0x0F, 0x02, 0x1B, 0x2E, 0x10, 0x02, 0x00, 0x84, 0x11, 0x02, 0x00, 0x4A, 0x12, 0x04, 0xE7, 0x23, 0x0B, 0x61, 0x13, 0x04, 0xFD, 0xE8, 0x63, 0x8E, 0x14, 0x04, 0x03, 0x0B, 0xC7, 0x1C, 0x15, 0x04, 0x00, 0x9F, 0xB9, 0x38, 0x16, 0x04, 0x00, 0x00, 0x01, 0xF8, 0x17, 0x04, 0x4D, 0xEC, 0xDA, 0xF4, 0x18, 0x04, 0xB1, 0xBC, 0x81, 0x74, 0x19, 0x02, 0x0B, 0x8A, 0x28, 0x04, 0x4D, 0xEC, 0xDA, 0xF4, 0x29, 0x04, 0xB1, 0xBC, 0x81, 0x74, 0x2A, 0x02, 0x0B, 0x8A, 0x38, 0x01, 0x31, 0x39, 0x04, 0x00, 0x9F, 0x85, 0x4D, 0x01, 0x02, 0xB7, 0xEB };
+        for(int i = 0; i < 16; i++)
+            cc[i] = 0;
+    }
+
+    virtual void TearDown() {
+
+    }
+
+    // appends TS packets carrying payload on pid, padding the last one with adaptation field stuffing
+    void addPes(std::vector<uint8_t>& ts, uint16_t pid, const std::vector<uint8_t>& payload) {
+        size_t offset = 0;
+        while(offset < payload.size()) {
+            size_t n = std::min((size_t) 184, payload.size() - offset);
+            ts.push_back(0x47);
+            ts.push_back((uint8_t) ((offset == 0 ? 0x40 : 0x00) | (pid >> 8)));
+            ts.push_back((uint8_t) pid);
+            ts.push_back((uint8_t) ((n < 184 ? 0x30 : 0x10) | (cc[pid & 0x0F]++ & 0x0F)));
+            if(n < 184) {
+                ts.push_back((uint8_t) (183 - n));
+                if(n < 183)
+                    ts.push_back(0x00);
+                for(size_t i = n + 2; i < 184; i++)
+                    ts.push_back(0xFF);
+            }
+            ts.insert(ts.end(), payload.begin() + offset, payload.begin() + offset + n);
+            offset += n;
+        }
+    }
+
+    // PSI section in one TS packet, with a dummy CRC
+    void addSection(std::vector<uint8_t>& ts, uint16_t pid, std::vector<uint8_t> section) {
+        section.insert(section.end(), {0x00, 0x00, 0x00, 0x00});
+        section[1] = (uint8_t) (0xB0 | ((section.size() - 3) >> 8));
+        section[2] = (uint8_t) (section.size() - 3);
+        section.insert(section.begin(), 0x00);
+        section.resize(184, 0xFF);
+        addPes(ts, pid, section);
+    }
+
+    // PAT pointing to a PMT on 0x100 that lists video on 0x101 and metadata on 0x102
+    void addTables(std::vector<uint8_t>& ts, uint8_t stream_type) {
+        addSection(ts, 0x0000, {0x00, 0x00, 0x00, 0x00, 0x01, 0xC1, 0x00, 0x00, 0x00, 0x01, 0xE1, 0x00});
+        std::vector<uint8_t> pmt = {0x02, 0x00, 0x00, 0x00, 0x01, 0xC1, 0x00, 0x00, 0xE1, 0x01, 0xF0, 0x00,
+                                    0x1B, 0xE1, 0x01, 0xF0, 0x00};
+        if(stream_type == 0x06)
+            pmt.insert(pmt.end(), {0x06, 0xE1, 0x02, 0xF0, 0x06, 0x05, 0x04, 'K', 'L', 'V', 'A'});
+        else
+            pmt.insert(pmt.end(), {0x15, 0xE1, 0x02, 0xF0, 0x00});
+        addSection(ts, 0x0100, pmt);
+    }
+
+    std::vector<uint8_t> pesPacket(uint8_t stream_id, uint64_t pts, const std::vector<uint8_t>& data) {
+        std::vector<uint8_t> pes = {0x00, 0x00, 0x01, stream_id, 0x00, 0x00, 0x84, 0x80, 0x05,
+                                    (uint8_t) (0x21 | ((pts >> 29) & 0x0E)), (uint8_t) (pts >> 22),
+                                    (uint8_t) (0x01 | ((pts >> 14) & 0xFE)), (uint8_t) (pts >> 7),
+                                    (uint8_t) (0x01 | ((pts << 1) & 0xFE))};
+        pes.insert(pes.end(), data.begin(), data.end());
+        pes[4] = (uint8_t) ((pes.size() - 6) >> 8);
+        pes[5] = (uint8_t) (pes.size() - 6);
+        return pes;
+    }
+
+    void deleteKlvs(std::vector<KLV*>& klvs) {
+        for(size_t i = 0; i < klvs.size(); i++)
+            delete klvs[i];
+        klvs.clear();
+    }
+
+    // objects delclared here can be used by all tests in the test case for KlvTsDemuxerTest
+    std::vector<uint8_t> test_pkt;
+    uint8_t cc[16];
+};
+
+TEST_F(KlvTsDemuxerTest, TestAsyncKlv) {
+    // junk, tables, a video packet, then two PES packets with two KLV packets each
+    std::vector<uint8_t> ts = {0x12, 0x47, 0x00};
+    addTables(ts, 0x06);
+    addPes(ts, 0x0101, std::vector<uint8_t>(300, 0x47));
+    std::vector<uint8_t> two(test_pkt);
+    two.insert(two.end(), test_pkt.begin(), test_pkt.end());
+    addPes(ts, 0x0102, pesPacket(0xBD, 900000, two));
+    addPes(ts, 0x0102, pesPacket(0xBD, 903003, two));
+
+    // in chunks that cut TS packets anywhere
+    size_t chunk_sizes[] = {1, 100, 188, 1000, ts.size()};
+    for(size_t chunk_size : chunk_sizes) {
+        SCOPED_TRACE(chunk_size);
+        KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+        KlvTsDemuxer demuxer(parser);
+        std::vector<KLV*> klvs;
+        for(size_t offset = 0; offset < ts.size(); offset += chunk_size) {
+            std::vector<KLV*> pushed = demuxer.push(ts.data() + offset, std::min(chunk_size, ts.size() - offset));
+            klvs.insert(klvs.end(), pushed.begin(), pushed.end());
+        }
+
+        EXPECT_EQ(0x0102, demuxer.getKlvPid());
+        EXPECT_EQ(0x06, demuxer.getKlvStreamType());
+        EXPECT_EQ(903003, demuxer.getPts());
+        EXPECT_EQ(0, demuxer.getNumContinuityErrors());
+        ASSERT_EQ(4, klvs.size());
+        for(KLV* klv : klvs)
+            EXPECT_THAT(klv->toBytes(), ::testing::ContainerEq(test_pkt));
+        deleteKlvs(klvs);
+    }
+}
+
+TEST_F(KlvTsDemuxerTest, TestChecksumThrow) {
+    std::vector<uint8_t> bad(test_pkt);
+    bad[bad.size() - 1] ^= 0xFF;
+    std::vector<uint8_t> head;
+    addTables(head, 0x06);
+    addPes(head, 0x0102, pesPacket(0xBD, 900000, test_pkt));
+    std::vector<uint8_t> ts;
+    addPes(ts, 0x0102, pesPacket(0xBD, 903003, test_pkt));
+    addPes(ts, 0x0102, pesPacket(0xBD, 906006, bad));
+
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    parser.setChecksumMode(KlvParser::CHECKSUM_THROW);
+    KlvTsDemuxer demuxer(parser);
+    std::vector<KLV*> klvs = demuxer.push(head.data(), head.size());
+    ASSERT_EQ(1, klvs.size());
+    KLV::deleteTree(klvs[0]);
+
+    // the good packet pushed along with the bad one is freed, items and all
+    KlvAllocCounter allocs;
+    EXPECT_THROW(demuxer.push(ts.data(), ts.size()), KlvFormatException);
+    EXPECT_EQ(allocs.allocations(), allocs.deallocations());
+}
+
+TEST_F(KlvTsDemuxerTest, TestSyncMetadataCells) {
+    // stream_type 0x15: each KLV packet in its own AU cell
+    std::vector<uint8_t> cells;
+    for(int i = 0; i < 3; i++) {
+        cells.insert(cells.end(), {0x00, (uint8_t) i, 0xDF, (uint8_t) (test_pkt.size() >> 8), (uint8_t) test_pkt.size()});
+        cells.insert(cells.end(), test_pkt.begin(), test_pkt.end());
+    }
+
+    std::vector<uint8_t> ts;
+    addTables(ts, 0x15);
+    addPes(ts, 0x0102, pesPacket(0xFC, 1234, cells));
+
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    KlvTsDemuxer demuxer(parser);
+    std::vector<KLV*> klvs = demuxer.push(ts.data(), ts.size());
+    EXPECT_EQ(0x15, demuxer.getKlvStreamType());
+    EXPECT_EQ(1234, demuxer.getPts());
+    ASSERT_EQ(3, klvs.size());
+    for(KLV* klv : klvs)
+        EXPECT_THAT(klv->toBytes(), ::testing::ContainerEq(test_pkt));
+    deleteKlvs(klvs);
+}
+
+TEST_F(KlvTsDemuxerTest, TestLossAndResync) {
+    std::vector<uint8_t> two(test_pkt);
+    two.insert(two.end(), test_pkt.begin(), test_pkt.end());
+    std::vector<uint8_t> first;
+    addPes(first, 0x0102, pesPacket(0xBD, 0, two));
+    std::vector<uint8_t> second;
+    addPes(second, 0x0102, pesPacket(0xBD, 0, test_pkt));
+
+    // lose the second TS packet of the first PES, with the start of its second
+    // KLV packet in the first TS packet, and a few bytes of sync
+    std::vector<uint8_t> ts(first.begin(), first.begin() + 188);
+    ts.insert(ts.end(), {0x00, 0x01, 0x02});
+    ts.insert(ts.end(), second.begin(), second.end());
+
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE});
+    KlvTsDemuxer demuxer(parser);
+    demuxer.setKlvPid(0x0102);
+    std::vector<KLV*> klvs = demuxer.push(ts.data(), ts.size());
+    EXPECT_EQ(1, demuxer.getNumSyncLosses());
+    EXPECT_EQ(1, demuxer.getNumContinuityErrors());
+
+    // the cut off KLV is dropped, the next PES is picked up cleanly
+    ASSERT_EQ(2, klvs.size());
+    EXPECT_THAT(klvs[0]->toBytes(), ::testing::ContainerEq(test_pkt));
+    EXPECT_THAT(klvs[1]->toBytes(), ::testing::ContainerEq(test_pkt));
+    deleteKlvs(klvs);
+}
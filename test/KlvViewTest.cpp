@@ -0,0 +1,106 @@
+#include <stdint.h>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include "KlvParser.hpp"
+#include "KlvView.hpp"
+
+class KlvViewTest : public ::testing::Test {
+protected:
+    KlvViewTest() {
+
+    }
+
+    virtual ~KlvViewTest() {
+
+    }
+
+    virtual void SetUp() {
+        // key: 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x0B, 0x01, 0x01, 0x0E, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00
+        // len: 0x81, 0x90 (144 bytes)
+        // val: the rest
+        test_pkt = { 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x0B, 0x01, 0x01, 0x0E, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00, 0x81, 0x90, 0x02, 0x08, 0x00, 0x04, 0x6C, 0xAE, 0x70, 0xF9, 0x80, 0xCF, 0x41, 0x01, 0x01, 0x05, 0x02, 0xE1, 0x91, 0x06, 0x02, 0x06, 0x0D, 0x07, 0x02, 0x0A, 0xE1, 0x0B, 0x02, 0x49, 0x52, 0x0C, 0x0E, 0x47, 0x65, 0x6F, 0x64, 0x65, 0x74, 0x69, 0x63, 0x20, 0x57, 0x47, 0x53, 0x38, 0x34, 0x0D, 0x04, 0x4D, 0xCC, 0x41, 0x90, 0x0E, 0x04, 0xB1, 0xD0, 0x3D, 0x96, 0x0F, 0x02, 0x1B, 0x2E, 0x10, 0x02, 0x00, 0x84, 0x11, 0x02, 0x00, 0x4A, 0x12, 0x04, 0xE7, 0x23, 0x0B, 0x61, 0x13, 0x04, 0xFD, 0xE8, 0x63, 0x8E, 0x14, 0x04, 0x03, 0x0B, 0xC7, 0x1C, 0x15, 0x04, 0x00, 0x9F, 0xB9, 0x38, 0x16, 0x04, 0x00, 0x00, 0x01, 0xF8, 0x17, 0x04, 0x4D, 0xEC, 0xDA, 0xF4, 0x18, 0x04, 0xB1, 0xBC, 0x81, 0x74, 0x19, 0x02, 0x0B, 0x8A, 0x28, 0x04, 0x4D, 0xEC, 0xDA, 0xF4, 0x29, 0x04, 0xB1, 0xBC, 0x81, 0x74, 0x2A, 0x02, 0x0B, 0x8A, 0x38, 0x01, 0x31, 0x39, 0x04, 0x00, 0x9F, 0x85, 0x4D, 0x01, 0x02, 0xB7, 0xEB };
+    }
+
+    virtual void TearDown() {
+
+    }
+
+    // objects delclared here can be used by all tests in the test case for KlvViewTest
+    std::vector<uint8_t> test_pkt;
+};
+
+TEST_F(KlvViewTest, TestViewPointsIntoBuffer) {
+    // a packet that is entirely in the buffer is viewed in place
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    std::vector<const KlvView*> views = parser.parseViews(test_pkt.data(), test_pkt.size());
+
+    ASSERT_EQ(1, views.size());
+    const KlvView* view = views[0];
+    EXPECT_EQ(test_pkt.data(), view->getKey().data);
+    EXPECT_EQ(16, view->getKey().size);
+    EXPECT_EQ(test_pkt.data() + 16, view->getLenEncoded().data);
+    EXPECT_EQ(test_pkt.data() + 18, view->getValue().data);
+    EXPECT_EQ(144, view->getLen());
+    EXPECT_EQ(1, view->getBerLen());
+
+    // children point into the value of their parent
+    const KlvView* child = view->getChild();
+    ASSERT_TRUE(child != NULL);
+    EXPECT_EQ(test_pkt.data() + 18, child->getKey().data);
+    EXPECT_EQ(view, child->getParent());
+    EXPECT_EQ(8, child->getLen());
+
+    int num_children = 0;
+    const KlvView* last = NULL;
+    for(const KlvView* node = child; node != NULL; node = node->getNext()) {
+        EXPECT_EQ(last, node->getPrevious());
+        last = node;
+        num_children++;
+    }
+    EXPECT_EQ(26, num_children);
+    EXPECT_EQ(0x01, last->getKey()[0]);
+    EXPECT_EQ(test_pkt.data() + test_pkt.size(), last->getValue().end());
+}
+
+TEST_F(KlvViewTest, TestViewSpanningCalls) {
+    // a packet split across calls is still returned, backed by the parser's copy
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+
+    std::vector<uint8_t> buf(test_pkt.begin() + 100, test_pkt.end());
+    buf.insert(buf.end(), test_pkt.begin(), test_pkt.end());
+
+    EXPECT_TRUE(parser.parseViews(test_pkt.data(), 100).empty());
+    std::vector<const KlvView*> views = parser.parseViews(buf.data(), buf.size());
+
+    ASSERT_EQ(2, views.size());
+    EXPECT_THAT(views[0]->getValue().toVector(), ::testing::ContainerEq(views[1]->getValue().toVector()));
+    EXPECT_EQ(buf.data() + (test_pkt.size() - 100), views[1]->getKey().data);
+    ASSERT_TRUE(views[0]->getChild() != NULL);
+    EXPECT_EQ(0x02, views[0]->getChild()->getKey()[0]);
+}
+
+TEST_F(KlvViewTest, TestToOwned) {
+    // toOwned gives the same tree as the KLV parsing path
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    std::vector<const KlvView*> views = parser.parseViews(test_pkt.data(), test_pkt.size());
+    ASSERT_EQ(1, views.size());
+
+    KLV* owned = views[0]->toOwned();
+    std::vector<uint8_t> test_key(test_pkt.begin(), test_pkt.begin() + 16);
+    EXPECT_THAT(owned->getKey(), ::testing::ContainerEq(test_key));
+    EXPECT_EQ(144, owned->getLen());
+
+    const KlvView* view_child = views[0]->getChild();
+    KLV* owned_child = owned->getChild();
+    while(view_child != NULL && owned_child != NULL) {
+        EXPECT_THAT(owned_child->getValue(), ::testing::ContainerEq(view_child->getValue().toVector()));
+        EXPECT_EQ(owned, owned_child->getParent());
+        view_child = view_child->getNext();
+        owned_child = owned_child->getNext();
+    }
+    EXPECT_TRUE(view_child == NULL && owned_child == NULL);
+
+    delete owned;
+}
@@ -0,0 +1,240 @@
+#include <algorithm>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "gmock/gmock.h"
+#include "KlvAllocCounter.hpp"
+#include "KlvParser.hpp"
+#include "KlvVisitor.hpp"
+
+
+class KlvVisitorTest : public ::testing::Test {
+protected:
+    KlvVisitorTest() {
+    }
+
+    virtual ~KlvVisitorTest() {
+    }
+
+    virtual void SetUp() {
+        // key: 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x0B, 0x01, 0x01, 0x0E, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00
+        // len: 0x81, 0x90 (144 bytes)
+        // val: the rest
+        test_pkt = { 0x06, 0x0E, 0x2B, 0x34, 0x02, 0x0B, 0x01, 0x01, 0x0E, 0x01, 0x03, 0x01, 0x01, 0x00, 0x00, 0x00, 0x81, 0x90, 0x02, 0x08, 0x00, 0x04, 0x6C, 0xAE, 0x70, 0xF9, 0x80, 0xCF, 0x41, 0x01, 0x01, 0x05, 0x02, 0xE1, 0x91, 0x06, 0x02, 0x06, 0x0D, 0x07, 0x02, 0x0A, 0xE1, 0x0B, 0x02, 0x49, 0x52, 0x0C, 0x0E, 0x47, 0x65, 0x6F, 0x64, 0x65, 0x74, 0x69, 0x63, 0x20, 0x57, 0x47, 0x53, 0x38, 0x34, 0x0D, 0x04, 0x4D, 0xCC, 0x41, 0x90, 0x0E, 0x04, 0xB1, 0xD0, 0x3D, 0x96, 0x0F, 0x02, 0x1B, 0x2E, 0x10, 0x02, 0x00, 0x84, 0x11, 0x02, 0x00, 0x4A, 0x12, 0x04, 0xE7, 0x23, 0x0B, 0x61, 0x13, 0x04, 0xFD, 0xE8, 0x63, 0x8E, 0x14, 0x04, 0x03, 0x0B, 0xC7, 0x1C, 0x15, 0x04, 0x00, 0x9F, 0xB9, 0x38, 0x16, 0x04, 0x00, 0x00, 0x01, 0xF8, 0x17, 0x04, 0x4D, 0xEC, 0xDA, 0xF4, 0x18, 0x04, 0xB1, 0xBC, 0x81, 0x74, 0x19, 0x02, 0x0B, 0x8A, 0x28, 0x04, 0x4D, 0xEC, 0xDA, 0xF4, 0x29, 0x04, 0xB1, 0xBC, 0x81, 0x74, 0x2A, 0x02, 0x0B, 0x8A, 0x38, 0x01, 0x31, 0x39, 0x04, 0x00, 0x9F, 0x85, 0x4D, 0x01, 0x02, 0xB7, 0xEB };
+    }
+
+    virtual void TearDown() {
+
+    }
+
+    // objects delclared here can be used by all tests in the test case for KlvVisitor
+    std::vector<uint8_t> test_pkt;
+
+};
+
+namespace {
+    // writes each event down as a line of text
+    class RecordingVisitor : public KlvVisitor {
+    public:
+        void onSetBegin(size_t depth, const KlvSpan& /*key*/, const KlvSpan& /*len*/, const KlvSpan& value) {
+            events.push_back("begin " + std::to_string(depth) + " " + std::to_string(value.size));
+        }
+        void onItem(size_t depth, uint64_t tag, const KlvSpan& /*key*/, const KlvSpan& /*len*/, const KlvSpan& value) {
+            std::string event = "item " + std::to_string(depth) + " " + std::to_string(tag) + ":";
+            for(size_t i = 0; i < value.size; i++)
+                event += " " + std::to_string(value[i]);
+            events.push_back(event);
+        }
+        void onSetEnd(size_t depth, bool ok) {
+            events.push_back("end " + std::to_string(depth) + (ok ? " ok" : " bad"));
+        }
+
+        std::vector<std::string> events;
+    };
+
+    // reacts to the timestamp only
+    class TimestampVisitor : public KlvVisitor {
+    public:
+        TimestampVisitor() : num_timestamps(0), timestamp(0) {}
+
+        void onItem(size_t depth, uint64_t tag, const KlvSpan& /*key*/, const KlvSpan& /*len*/, const KlvSpan& value) {
+            if(depth != 1 || tag != 2 || value.size != 8)
+                return;
+            num_timestamps++;
+            timestamp = 0;
+            for(size_t i = 0; i < value.size; i++)
+                timestamp = (timestamp << 8) | value[i];
+        }
+
+        size_t   num_timestamps;
+        uint64_t timestamp;
+    };
+}
+
+static void expectSameTree(const KLV* expected, const KLV* actual) {
+    ASSERT_TRUE(actual != NULL);
+    EXPECT_EQ(expected->getKey(), actual->getKey());
+    EXPECT_EQ(expected->getLenEncoded(), actual->getLenEncoded());
+    EXPECT_EQ(expected->getValue(), actual->getValue());
+
+    const KLV* a = actual->getChild();
+    for(const KLV* e = expected->getChild(); e != NULL; e = e->getNext()) {
+        ASSERT_TRUE(a != NULL);
+        EXPECT_EQ(actual, a->getParent());
+        EXPECT_EQ(a->getPrevious() == NULL, e->getPrevious() == NULL);
+        expectSameTree(e, a);
+        a = a->getNext();
+    }
+    EXPECT_TRUE(a == NULL);
+}
+
+TEST_F(KlvVisitorTest, TestEvents) {
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    RecordingVisitor visitor;
+    EXPECT_EQ(KLV_OK, parser.parse(test_pkt.data(), test_pkt.size(), visitor));
+
+    // the packet, its timestamp first and its checksum last
+    ASSERT_EQ(28, visitor.events.size());
+    EXPECT_EQ("begin 0 144", visitor.events[0]);
+    EXPECT_EQ("item 1 2: 0 4 108 174 112 249 128 207", visitor.events[1]);
+    EXPECT_EQ("item 1 1: 183 235", visitor.events[26]);
+    EXPECT_EQ("end 0 ok", visitor.events[27]);
+
+    // one event per item of the tree parse() builds
+    std::vector<KLV*> klvs = parser.parse(test_pkt);
+    ASSERT_EQ(1, klvs.size());
+    size_t num_items = 0;
+    for(KLV* item = klvs[0]->getChild(); item != NULL; item = item->getNext())
+        num_items++;
+    EXPECT_EQ(26, num_items);
+    KLV::deleteTree(klvs[0]);
+
+    // the timestamp as it flies by
+    TimestampVisitor timestamps;
+    parser.parse(test_pkt.data(), test_pkt.size(), timestamps);
+    EXPECT_EQ(1, timestamps.num_timestamps);
+    EXPECT_EQ(0x00046CAE70F980CFull, timestamps.timestamp);
+
+    // a single level parser reports the packet as an item
+    KlvParser top_parser({KlvParser::KEY_ENCODING_16_BYTE});
+    RecordingVisitor top_visitor;
+    top_parser.parse(test_pkt.data(), test_pkt.size(), top_visitor);
+    ASSERT_EQ(1, top_visitor.events.size());
+    EXPECT_EQ(0, top_visitor.events[0].find("item 0 0: 2 8 0 4"));
+}
+
+TEST_F(KlvVisitorTest, TestChunks) {
+    // garbage, three packets, and a partial UL header in front of the last one
+    std::vector<uint8_t> buf = {0x00, 0x06, 0x0E, 0xFF};
+    for(int i = 0; i < 3; i++) {
+        if(i == 2)
+            buf.insert(buf.end(), {0x06, 0x0E, 0x2B});
+        buf.insert(buf.end(), test_pkt.begin(), test_pkt.end());
+    }
+
+    KlvParser whole_parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    RecordingVisitor whole;
+    whole_parser.parse(buf.data(), buf.size(), whole);
+    ASSERT_EQ(84, whole.events.size());
+
+    // the same events whatever the chunking
+    const size_t chunk_sizes[] = {1, 7, 100, 161, 162, 163};
+    for(size_t chunk_size : chunk_sizes) {
+        KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+        RecordingVisitor visitor;
+        for(size_t offset = 0; offset < buf.size(); offset += chunk_size)
+            parser.parse(buf.data() + offset, std::min(chunk_size, buf.size() - offset), visitor);
+        EXPECT_EQ(whole.events, visitor.events) << "chunk size " << chunk_size;
+    }
+}
+
+TEST_F(KlvVisitorTest, TestBuilder) {
+    // a good packet, a packet with an over long length field, and a packet
+    // whose value ends in the middle of an item
+    std::vector<uint8_t> buf(test_pkt);
+    buf.insert(buf.end(), test_pkt.begin(), test_pkt.begin() + 16);
+    buf.insert(buf.end(), {0x89, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10});
+    std::vector<uint8_t> truncated(test_pkt);
+    truncated[17] += 3;
+    truncated.insert(truncated.end(), {0x02, 0x08, 0x00});
+    buf.insert(buf.end(), truncated.begin(), truncated.end());
+
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    std::vector<KLV*> expected;
+    EXPECT_EQ(KLV_ERROR_BER_LENGTH, parser.parse(buf.data(), buf.size(), expected));
+
+    KlvParser visit_parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    std::vector<KLV*> klvs;
+    KlvBuilder builder(klvs);
+    EXPECT_EQ(KLV_ERROR_BER_LENGTH, visit_parser.parse(buf.data(), buf.size(), builder));
+    EXPECT_EQ(1, visit_parser.getNumErrors());
+
+    ASSERT_EQ(2, expected.size());
+    ASSERT_EQ(2, klvs.size());
+    for(size_t i = 0; i < klvs.size(); i++) {
+        expectSameTree(expected[i], klvs[i]);
+        KLV::deleteTree(expected[i]);
+        KLV::deleteTree(klvs[i]);
+    }
+
+    // the truncated item makes the set not ok
+    RecordingVisitor visitor;
+    visit_parser.parse(truncated.data(), truncated.size(), visitor);
+    EXPECT_EQ("end 0 bad", visitor.events.back());
+}
+
+TEST_F(KlvVisitorTest, TestChecksum) {
+    std::vector<uint8_t> bad(test_pkt);
+    bad[41] ^= 0x01;
+    std::vector<uint8_t> buf(bad);
+    buf.insert(buf.end(), test_pkt.begin(), test_pkt.end());
+
+    // marked
+    KlvParser mark_parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    mark_parser.setChecksumMode(KlvParser::CHECKSUM_MARK);
+    RecordingVisitor marked;
+    EXPECT_EQ(KLV_OK, mark_parser.parse(buf.data(), buf.size(), marked));
+    ASSERT_EQ(56, marked.events.size());
+    EXPECT_EQ("end 0 bad", marked.events[27]);
+    EXPECT_EQ("end 0 ok", marked.events[55]);
+
+    // dropped before any event, in every mode but CHECKSUM_MARK
+    const KlvParser::ChecksumMode modes[] = {KlvParser::CHECKSUM_DROP, KlvParser::CHECKSUM_THROW};
+    for(KlvParser::ChecksumMode mode : modes) {
+        KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+        parser.setChecksumMode(mode);
+        RecordingVisitor visitor;
+        EXPECT_EQ(KLV_ERROR_CHECKSUM, parser.parse(buf.data(), buf.size(), visitor));
+        ASSERT_EQ(28, visitor.events.size());
+        EXPECT_EQ("end 0 ok", visitor.events.back());
+        EXPECT_EQ(1, parser.getNumChecksumFailures());
+    }
+}
+
+TEST_F(KlvVisitorTest, TestAllocations) {
+    std::vector<uint8_t> buf;
+    for(int i = 0; i < 20; i++)
+        buf.insert(buf.end(), test_pkt.begin(), test_pkt.end());
+    const size_t chunk = 100;
+
+    // packets in one buffer are walked in place
+    KlvParser parser({KlvParser::KEY_ENCODING_16_BYTE, KlvParser::KEY_ENCODING_BER_OID});
+    parser.setChecksumMode(KlvParser::CHECKSUM_DROP);
+    TimestampVisitor visitor;
+    KlvAllocCounter allocs;
+    parser.parse(buf.data(), buf.size(), visitor);
+    EXPECT_EQ(20, visitor.num_timestamps);
+    EXPECT_EQ(0, allocs.allocations());
+
+    // packets split across calls are walked in the parser's copy, whose
+    // buffers are kept once the first packet has set them up
+    parser.parse(buf.data(), chunk, visitor);
+    parser.parse(buf.data() + chunk, test_pkt.size() * 2 - chunk, visitor);
+    allocs.restart();
+    for(size_t offset = 0; offset < buf.size(); offset += chunk)
+        parser.parse(buf.data() + offset, std::min(chunk, buf.size() - offset), visitor);
+    EXPECT_EQ(42, visitor.num_timestamps);
+    EXPECT_EQ(0, allocs.allocations());
+}